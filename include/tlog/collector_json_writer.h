@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Collector JSON message writer.
+ *
+ * An implementation of a writer sending JSON log messages to the tlog
+ * collector daemon over a local (Unix domain) socket.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_COLLECTOR_JSON_WRITER_H
+#define _TLOG_COLLECTOR_JSON_WRITER_H
+
+#include <assert.h>
+#include <tlog/json_writer.h>
+
+/**
+ * Collector message writer type
+ *
+ * Creation arguments:
+ *
+ * const char  *path    Path to the collector daemon socket.
+ *
+ * Each message is sent as a single newline-terminated line over a
+ * connection to the collector, which keeps the order of the messages
+ * received from a writer. The writer blocks while the collector is not
+ * accepting more data.
+ */
+extern const struct tlog_json_writer_type tlog_collector_json_writer_type;
+
+/**
+ * Create a collector writer, connecting it to the collector daemon.
+ *
+ * @param pwriter   Location for the created writer pointer, will be set to
+ *                  NULL in case of error.
+ * @param path      Path to the collector daemon socket.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_collector_json_writer_create(struct tlog_json_writer **pwriter,
+                                  const char *path)
+{
+    assert(pwriter != NULL);
+    assert(path != NULL);
+    return tlog_json_writer_create(pwriter, &tlog_collector_json_writer_type,
+                                   path);
+}
+
+#endif /* _TLOG_COLLECTOR_JSON_WRITER_H */
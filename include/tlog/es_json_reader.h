@@ -29,6 +29,7 @@
 #define _TLOG_ES_JSON_READER_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <tlog/json_reader.h>
 
 /**
@@ -45,9 +46,31 @@
  * const char  *base_url    The base URL to request ElasticSearch, without the
  *                          query or the fragment parts.
  * const char  *query       The query string to send to ElastiSearch.
+ * uint64_t     pos_min     Minimum position to request messages covering, ms.
+ * uint64_t     pos_max     Maximum position of messages to request, ms,
+ *                          UINT64_MAX for no limit.
+ * uint64_t     span_max    Maximum time a message can span, ms.
  * size_t       size        Number of messages to request from ElasticSearch
  *                          in one HTTP request.
+ * unsigned int connect_timeout
+ *                          Maximum time to wait for a connection to be
+ *                          established, seconds, zero for no limit.
+ * unsigned int timeout     Maximum time a request can take, including
+ *                          connecting, seconds, zero for no limit.
  *
+ * Messages are requested in pages sorted by ID, session ID and host, each
+ * page following the last message of the previous one with "search_after",
+ * so that no messages sharing an ID are skipped, and so that deep pages
+ * cost no more than the first one. A background thread fetches the pages,
+ * handing each message over as soon as its hit is received, without
+ * waiting for the rest of the reply, and fetches the next page while a
+ * full one is being read. Replies are trimmed to the message fields with
+ * "filter_path" and "_source", requested compressed, and transferred over
+ * a single kept-alive connection. With a non-zero minimum position, or a
+ * maximum position, the query is combined with a range filter on the
+ * message positions, so the messages outside the range are never
+ * transferred. The range starts the maximum message span before the
+ * minimum position, so the message covering it is not dropped.
  */
 extern const struct tlog_json_reader_type tlog_es_json_reader_type;
 
@@ -69,8 +92,19 @@ extern bool tlog_es_json_reader_base_url_is_valid(const char *base_url);
  * @param base_url  The base URL to request ElasticSearch, without the query
  *                  or the fragment parts.
  * @param query     The query string to send to ElastiSearch.
+ * @param pos_min   Minimum position to request messages covering, ms,
+ *                  zero for no limit.
+ * @param pos_max   Maximum position of messages to request, ms, UINT64_MAX
+ *                  for no limit.
+ * @param span_max  Maximum time a message can span, ms, i.e. the latency
+ *                  the messages were recorded with.
  * @param size      Number of messages to request from ElasticSearch in one
  *                  HTTP request.
+ * @param connect_timeout
+ *                  Maximum time to wait for a connection to be established,
+ *                  seconds, zero for no limit.
+ * @param timeout   Maximum time a request can take, including connecting,
+ *                  seconds, zero for no limit.
  *
  * @return Global return code.
  */
@@ -78,13 +112,20 @@ static inline tlog_grc
 tlog_es_json_reader_create(struct tlog_json_reader **preader,
                            const char *base_url,
                            const char *query,
-                           size_t size)
+                           uint64_t pos_min,
+                           uint64_t pos_max,
+                           uint64_t span_max,
+                           size_t size,
+                           unsigned int connect_timeout,
+                           unsigned int timeout)
 {
     assert(preader != NULL);
     assert(tlog_es_json_reader_base_url_is_valid(base_url));
     assert(query != NULL);
+    assert(pos_min <= pos_max);
     return tlog_json_reader_create(preader, &tlog_es_json_reader_type,
-                                   base_url, query, size);
+                                   base_url, query, pos_min, pos_max,
+                                   span_max, size, connect_timeout, timeout);
 }
 
 #endif /* _TLOG_ES_JSON_READER_H */
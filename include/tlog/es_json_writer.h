@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief ElasticSearch JSON message writer.
+ *
+ * An implementation of a writer sending JSON log messages to ElasticSearch
+ * in batches, using the bulk API.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_ES_JSON_WRITER_H
+#define _TLOG_ES_JSON_WRITER_H
+
+#include <assert.h>
+#include <tlog/json_writer.h>
+
+/** Minimum size of a batch (bulk request body), bytes */
+#define TLOG_ES_JSON_WRITER_BATCH_SIZE_MIN   1
+
+/** Delay before the first retry of a failed bulk request, milliseconds */
+#define TLOG_ES_JSON_WRITER_BACKOFF_MIN_MS  100
+
+/** Maximum delay between retries of a failed bulk request, milliseconds */
+#define TLOG_ES_JSON_WRITER_BACKOFF_MAX_MS  5000
+
+/**
+ * ElasticSearch message writer type
+ *
+ * Creation arguments:
+ *
+ * const char      *base_url    The bulk API URL to send messages to, without
+ *                              the query or the fragment parts.
+ * size_t           batch_size  Bulk request body size to send at, bytes.
+ * unsigned int     batch_age   Maximum time a message can wait in a batch
+ *                              before it is sent, seconds, zero for no
+ *                              limit.
+ * unsigned int     retries     Number of times to retry a failed request.
+ * unsigned int     connect_timeout
+ *                              Maximum time to wait for a connection to be
+ *                              established, seconds, zero for no limit.
+ * unsigned int     timeout     Maximum time a request can take, including
+ *                              connecting, seconds, zero for no limit.
+ * bool             gzip        True if request bodies should be compressed
+ *                              with gzip, false otherwise.
+ *
+ * Messages are accumulated in a batch, which is handed over to a
+ * background sending thread when it reaches the size limit, when a message
+ * is written into a batch older than the age limit, and when the writer is
+ * flushed, so that writing and flushing never wait for the server. The
+ * sending thread sends the handed-over messages in batches of up to the
+ * size limit, keeping the same connection alive and reusing it for all the
+ * requests. Requests failed because of transport errors, including
+ * timeouts, HTTP 429 or 5xx statuses, as well as the individual messages
+ * rejected with those statuses, are retried with exponential backoff. The
+ * messages still not accepted when the retries run out are kept in memory
+ * and sent with the next request. Failures to deliver messages are not
+ * reported by writing or flushing, only running out of memory is, but can
+ * be retrieved with tlog_es_json_writer_drain(). When the writer is
+ * destroyed, a last, single attempt is made to send the remaining messages.
+ */
+extern const struct tlog_json_writer_type tlog_es_json_writer_type;
+
+/**
+ * Check if a base URL is valid for use with an ElasticSearch writer, that is,
+ * if it doesn't contain the query (?...) or the fragment (#...) parts.
+ *
+ * @param base_url   The base URL to check.
+ *
+ * @return True if the base URL is valid, false otherwise.
+ */
+extern bool tlog_es_json_writer_base_url_is_valid(const char *base_url);
+
+/**
+ * Wait for the sending thread of an ElasticSearch writer to finish sending
+ * the messages handed over to it so far, and retrieve the result.
+ *
+ * @param writer    The ElasticSearch writer to wait for.
+ *
+ * @return Global return code of the last failed sending since the previous
+ *         call, including:
+ *         TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED, if some messages were
+ *         rejected permanently and were dropped,
+ *         TLOG_RC_ES_JSON_WRITER_ITEMS_HELD, if none were dropped, but some
+ *         were still rejected temporarily when the retries ran out, and
+ *         were kept for the next request.
+ */
+extern tlog_grc tlog_es_json_writer_drain(struct tlog_json_writer *writer);
+
+/**
+ * Create an ElasticSearch writer.
+ *
+ * @param pwriter       Location for the created writer pointer, will be set
+ *                      to NULL in case of error.
+ * @param base_url      The bulk API URL to send messages to, without the
+ *                      query or the fragment parts.
+ * @param batch_size    Bulk request body size to send at, bytes.
+ * @param batch_age     Maximum time a message can wait in a batch, seconds,
+ *                      zero for no limit.
+ * @param retries       Number of times to retry a failed request.
+ * @param connect_timeout
+ *                      Maximum time to wait for a connection to be
+ *                      established, seconds, zero for no limit.
+ * @param timeout       Maximum time a request can take, including
+ *                      connecting, seconds, zero for no limit.
+ * @param gzip          True if request bodies should be compressed with
+ *                      gzip, false otherwise.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_es_json_writer_create(struct tlog_json_writer **pwriter,
+                           const char *base_url,
+                           size_t batch_size,
+                           unsigned int batch_age,
+                           unsigned int retries,
+                           unsigned int connect_timeout,
+                           unsigned int timeout,
+                           bool gzip)
+{
+    assert(pwriter != NULL);
+    assert(tlog_es_json_writer_base_url_is_valid(base_url));
+    assert(batch_size >= TLOG_ES_JSON_WRITER_BATCH_SIZE_MIN);
+    return tlog_json_writer_create(pwriter, &tlog_es_json_writer_type,
+                                   base_url, batch_size, batch_age,
+                                   retries, connect_timeout, timeout, gzip);
+}
+
+#endif /* _TLOG_ES_JSON_WRITER_H */
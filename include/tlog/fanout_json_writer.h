@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief Fan-out JSON message writer.
+ *
+ * An implementation of a writer passing each JSON log message to several
+ * other writers.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_FANOUT_JSON_WRITER_H
+#define _TLOG_FANOUT_JSON_WRITER_H
+
+#include <assert.h>
+#include <tlog/json_writer.h>
+
+/** Fan-out writer child description */
+struct tlog_fanout_json_writer_child {
+    struct tlog_json_writer    *writer;     /**< Child writer */
+    bool                        owned;      /**< True if the child writer
+                                                 should be destroyed with the
+                                                 fan-out writer */
+    bool                        required;   /**< True if failing to deliver
+                                                 to the child is an error,
+                                                 false if best-effort */
+    size_t                      queue;      /**< Maximum size of messages
+                                                 to keep for retrying, when
+                                                 the child fails, bytes */
+};
+
+/**
+ * Fan-out message writer type
+ *
+ * Creation arguments:
+ *
+ * const struct tlog_fanout_json_writer_child  *child_list  Child
+ *                                                          descriptions.
+ * size_t                                       child_num   Number of
+ *                                                          children.
+ *
+ * Each message is written to every child. Messages a child fails to
+ * accept are queued for it, and retried, in order, before the next message
+ * written, and on flushing. Once a child's queue is full, a best-effort
+ * child loses its oldest messages, and a required child fails the write.
+ * A required child failing to flush fails the flush.
+ */
+extern const struct tlog_json_writer_type tlog_fanout_json_writer_type;
+
+/**
+ * Create a fan-out writer.
+ *
+ * @param pwriter       Location for the created writer pointer, will be set
+ *                      to NULL in case of error.
+ * @param child_list    Child descriptions, the owned children are only
+ *                      taken over on success.
+ * @param child_num     Number of children.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_fanout_json_writer_create(
+                    struct tlog_json_writer **pwriter,
+                    const struct tlog_fanout_json_writer_child *child_list,
+                    size_t child_num)
+{
+    assert(pwriter != NULL);
+    assert(child_list != NULL || child_num == 0);
+    return tlog_json_writer_create(pwriter, &tlog_fanout_json_writer_type,
+                                   child_list, child_num);
+}
+
+#endif /* _TLOG_FANOUT_JSON_WRITER_H */
@@ -0,0 +1,194 @@
+/**
+ * @file
+ * @brief Log file index.
+ *
+ * An index of a log file, mapping runs of consecutive messages of each
+ * session to their byte offsets and lines, along with their message ID and
+ * position ranges, so readers can skip the other sessions' messages
+ * without parsing them.
+ *
+ * The index is kept in a sidecar file, starting with TLOG_INDEX_MAGIC and
+ * followed by records, each starting with a type character: string records
+ * ('S'), holding host and user names, numbered in order of appearance, and
+ * run records ('R'), referring to them. All numbers are little-endian. The
+ * index is updated by appending records, rewriting the last run record in
+ * place, if the run continues, and an incomplete record at the end is
+ * ignored and overwritten. Updates hold an exclusive flock(2) on the file,
+ * and loading holds a shared one, so neither sees a half-written update.
+ * An update reloads the index first, if the file was changed since.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_INDEX_H
+#define _TLOG_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <tlog/grc.h>
+
+/** Index file magic, including the format version */
+#define TLOG_INDEX_MAGIC        "TLOGIDX2"
+
+/** Index file magic length */
+#define TLOG_INDEX_MAGIC_LEN    (sizeof(TLOG_INDEX_MAGIC) - 1)
+
+/** Suffix added to a log file path to get the default index file path */
+#define TLOG_INDEX_PATH_SUFFIX  ".idx"
+
+/** Run of consecutive messages of one session */
+struct tlog_index_run {
+    size_t          start;      /**< Offset of the first message line */
+    size_t          end;        /**< Offset past the last message line */
+    size_t          line;       /**< Number of the first message line */
+    size_t          lines;      /**< Number of lines in the run */
+    size_t          host;       /**< Index of the host name string */
+    size_t          user;       /**< Index of the user name string */
+    unsigned int    session;    /**< Audit session ID */
+    size_t          num;        /**< Number of messages */
+    size_t          first_id;   /**< ID of the first message */
+    size_t          last_id;    /**< ID of the last message */
+    uint64_t        first_pos;  /**< Position of the first message, ms */
+    uint64_t        last_pos;   /**< Position of the last message, ms */
+    uint64_t        end_pos;    /**< Position of the end of the latest
+                                     ending message, ms */
+};
+
+/** Index */
+struct tlog_index {
+    char                  **str_list;   /**< Host and user name strings */
+    size_t                  str_num;    /**< Number of strings */
+    size_t                  str_size;   /**< Allocated number of strings */
+    size_t                 *str_hash;   /**< Hash table of string numbers
+                                             (indexes plus one) by string,
+                                             with linear probing, zero
+                                             for free slots */
+    size_t                  str_hash_size;  /**< Number of hash table
+                                                 slots, a power of two */
+    struct tlog_index_run  *run_list;   /**< Runs, in order of offsets */
+    size_t                  run_num;    /**< Number of runs */
+    size_t                  run_size;   /**< Allocated number of runs */
+
+    size_t                  len;        /**< Length of the index file data
+                                             loaded or written */
+    size_t                  last_off;   /**< Offset of the last run record
+                                             in the index file */
+    size_t                  str_saved;  /**< Number of strings saved */
+    size_t                  run_saved;  /**< Number of runs saved, the
+                                             last one possibly modified */
+};
+
+/**
+ * Create an index, loading it from an index file.
+ *
+ * @param pindex    Location for the created index pointer, will be set to
+ *                  NULL in case of error.
+ * @param fd        File descriptor of the index file to load, or -1 to
+ *                  create an empty index. An empty file is an empty index.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_index_create(struct tlog_index **pindex, int fd);
+
+/**
+ * Check if an index is valid.
+ *
+ * @param index The index to check.
+ *
+ * @return True if the index is valid, false otherwise.
+ */
+extern bool tlog_index_is_valid(const struct tlog_index *index);
+
+/**
+ * Retrieve the end of the indexed part of a log file.
+ *
+ * @param index The index to retrieve the end of.
+ * @param pline Location for the number of the line at the end.
+ *
+ * @return Offset of the end of the indexed part.
+ */
+extern size_t tlog_index_get_end(const struct tlog_index *index,
+                                 size_t *pline);
+
+/**
+ * Index the complete lines of a log file following the indexed part, and
+ * save the changes to the index file. The index is reloaded from the file
+ * first, if another update changed it since it was loaded or saved, and
+ * nothing is done, if that update indexed more of the log than given.
+ *
+ * @param index The index to update.
+ * @param fd    File descriptor of the index file to save the changes to,
+ *              the one the index was loaded from, or -1 to not save.
+ * @param text  The log file text.
+ * @param len   The log file text length.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_index_update(struct tlog_index *index, int fd,
+                                  const char *text, size_t len);
+
+/**
+ * Index the messages added to a log file since the last update, reading
+ * the file in chunks, and save the changes to the index file after each.
+ * The file is read rather than mapped, so it being truncated meanwhile
+ * can't raise SIGBUS, only ending the update early.
+ *
+ * @param index     The index to update.
+ * @param fd        File descriptor of the index file to save the changes
+ *                  to, the one the index was loaded from, or -1 to not
+ *                  save.
+ * @param log_fd    File descriptor of the log file.
+ *
+ * @return Global return code, TLOG_RC_INDEX_LOG_TRUNCATED, if the log file
+ *         is shorter than the indexed part.
+ */
+extern tlog_grc tlog_index_update_log(struct tlog_index *index, int fd,
+                                      int log_fd);
+
+/**
+ * Find the first run of messages of a session, ending after an offset,
+ * with the last message ending at or after a position, so the run with the
+ * message covering the position is kept.
+ *
+ * @param index     The index to search.
+ * @param offset    The offset the run should end after.
+ * @param host      The host name of the session, or NULL for any.
+ * @param session   The audit session ID.
+ * @param pos       The position the last message of the run should end at,
+ *                  or after, ms.
+ *
+ * @return The found run, or NULL if not found in the indexed part.
+ */
+extern const struct tlog_index_run *tlog_index_find(
+                                        const struct tlog_index *index,
+                                        size_t offset,
+                                        const char *host,
+                                        unsigned int session,
+                                        uint64_t pos);
+
+/**
+ * Destroy (cleanup and free) an index.
+ *
+ * @param index The index to destroy, can be NULL.
+ */
+extern void tlog_index_destroy(struct tlog_index *index);
+
+#endif /* _TLOG_INDEX_H */
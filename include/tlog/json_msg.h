@@ -30,6 +30,7 @@
 #define _TLOG_JSON_MSG_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <json_object.h>
 #include <tlog/grc.h>
@@ -38,14 +39,60 @@
 /** Minimum I/O buffer size (longest UTF-8 character) */
 #define TLOG_JSON_MSG_IO_SIZE_MIN    4
 
+/** Maximum number of timing records decoded at once */
+#define TLOG_JSON_MSG_TIMING_NUM     64
+
+/** Timing record type */
+enum tlog_json_msg_timing_type {
+    TLOG_JSON_MSG_TIMING_TYPE_END,      /**< End of timing */
+    TLOG_JSON_MSG_TIMING_TYPE_INVALID,  /**< Invalid timing */
+    TLOG_JSON_MSG_TIMING_TYPE_DELAY,    /**< Delay */
+    TLOG_JSON_MSG_TIMING_TYPE_WINDOW,   /**< Window size */
+    TLOG_JSON_MSG_TIMING_TYPE_IN_TXT,   /**< Input text */
+    TLOG_JSON_MSG_TIMING_TYPE_IN_BIN,   /**< Input binary */
+    TLOG_JSON_MSG_TIMING_TYPE_OUT_TXT,  /**< Output text */
+    TLOG_JSON_MSG_TIMING_TYPE_OUT_BIN,  /**< Output binary */
+};
+
+/** Decoded timing record */
+struct tlog_json_msg_timing {
+    enum tlog_json_msg_timing_type  type;   /**< Record type */
+    uint64_t                        first;  /**< Delay in milliseconds,
+                                                 window width, text
+                                                 characters, or binary
+                                                 replacement characters */
+    uint64_t                        second; /**< Window height, or binary
+                                                 bytes */
+};
+
+/** Reusable buffer holding the data of messages parsed from text */
+struct tlog_json_msg_buf {
+    uint8_t    *ptr;                    /**< Buffer, NULL if not allocated */
+    size_t      size;                   /**< Buffer size */
+};
+
+/** Message filter */
+struct tlog_json_msg_filter {
+    const char     *host;               /**< Hostname to match, NULL for
+                                             any */
+    const char     *user;               /**< Username to match, NULL for
+                                             any */
+    unsigned int    session;            /**< Audit session ID to match,
+                                             zero for any */
+};
+
 /**
  * Message.
  * NOTE: Members are named after JSON properties, where possible.
  */
 struct tlog_json_msg {
     struct json_object *obj;            /**< The JSON object behind the
-                                             message, NULL for a void
-                                             message */
+                                             message, NULL if parsed from
+                                             text, or void */
+    struct tlog_json_msg_buf
+                       *buf;            /**< The buffer behind the message
+                                             parsed from text, NULL if
+                                             parsed from an object, or void */
     unsigned int        ver;            /**< Version */
     const char         *host;           /**< Hostname */
     const char         *user;           /**< Username */
@@ -54,18 +101,33 @@ struct tlog_json_msg {
     size_t              id;             /**< Message ID */
     struct timespec     pos;            /**< Position timestamp */
 
-    const char         *timing_ptr;     /**< Timing string position */
+    const char         *timing_ptr;     /**< Timing string position, past
+                                             the decoded records */
+    struct tlog_json_msg_timing
+                        timing_list[TLOG_JSON_MSG_TIMING_NUM];
+                                        /**< Decoded timing records, the
+                                             last one being end or invalid,
+                                             if the whole timing fit */
+    size_t              timing_num;     /**< Number of decoded records */
+    size_t              timing_idx;     /**< Current record index */
 
     const char         *in_txt_ptr;     /**< Input text string position */
     size_t              in_txt_len;     /**< Input text remaining length */
 
-    struct json_object *in_bin_obj;     /**< Input binary array object */
+    const uint8_t      *in_bin_ptr;     /**< Input binary bytes */
+    size_t              in_bin_len;     /**< Input binary bytes length, up
+                                             to the first invalid one */
     int                 in_bin_pos;     /**< Input binary array position */
 
     const char         *out_txt_ptr;    /**< Output text string position */
     size_t              out_txt_len;    /**< Output text remaining length */
 
-    struct json_object *out_bin_obj;    /**< Output binary array object */
+    const uint8_t      *out_bin_ptr;    /**< Output binary bytes */
+    size_t              out_bin_len;    /**< Output binary bytes length, up
+                                             to the first invalid one */
+    uint8_t            *bin_buf;        /**< Buffer holding binary bytes
+                                             decoded from the object, NULL
+                                             if none */
     int                 out_bin_pos;    /**< Output binary array position */
 
     bool                output;         /**< True if currently processing an
@@ -78,10 +140,19 @@ struct tlog_json_msg {
     const char            **ptxt_ptr;   /**< Current text string position */
     size_t                 *ptxt_len;   /**< Current text remaining length */
 
-    struct json_object     *bin_obj;    /**< Current binary array object */
+    const uint8_t          *bin_ptr;    /**< Current binary bytes */
+    size_t                  bin_len;    /**< Current binary bytes length */
     int                    *pbin_pos;   /**< Current binary array position */
 };
 
+/**
+ * Cleanup a message text buffer, freeing the memory.
+ * Can be called repeatedly with no additional effect.
+ *
+ * @param buf   The buffer to cleanup.
+ */
+extern void tlog_json_msg_buf_cleanup(struct tlog_json_msg_buf *buf);
+
 /**
  * Initialize a message.
  *
@@ -95,6 +166,44 @@ struct tlog_json_msg {
 extern tlog_grc tlog_json_msg_init(struct tlog_json_msg *msg,
                                    struct json_object *obj);
 
+/**
+ * Initialize a message by parsing JSON text directly, without creating
+ * JSON objects. Only accepts a single-level object with the exact set of
+ * the version 1 message fields, each appearing once, the strings and the
+ * binary arrays decoded into a reusable buffer. Anything else is left to
+ * be parsed into an object and passed to tlog_json_msg_init.
+ *
+ * @param msg   The message to initialize.
+ * @param buf   The buffer to decode strings and binary arrays into, must
+ *              be kept intact until the message is cleaned up.
+ * @param text  The text to parse, not necessarily zero-terminated. Text
+ *              following the object is ignored.
+ * @param len   The text length.
+ *
+ * @return Global return code, TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED, if the
+ *         text needs to be parsed into an object instead.
+ */
+extern tlog_grc tlog_json_msg_parse(struct tlog_json_msg *msg,
+                                    struct tlog_json_msg_buf *buf,
+                                    const char *text, size_t len);
+
+/**
+ * Check if a message text could match a filter, without parsing it, by
+ * looking for the "host", "user" and "session" values in the raw text.
+ * Only rejects the text if a value is found unambiguously and definitely
+ * doesn't match, so texts laid out or escaped unusually, as well as
+ * invalid ones, are left to be parsed and checked.
+ *
+ * @param filter    The filter to match against.
+ * @param text      The message text, not necessarily zero-terminated.
+ * @param len       The text length.
+ *
+ * @return False if the text definitely doesn't match, true if it might.
+ */
+extern bool tlog_json_msg_filter_prematch(
+                        const struct tlog_json_msg_filter *filter,
+                        const char *text, size_t len);
+
 /**
  * Check if a message is valid.
  *
@@ -113,6 +222,17 @@ extern bool tlog_json_msg_is_valid(const struct tlog_json_msg *msg);
  */
 extern bool tlog_json_msg_is_void(const struct tlog_json_msg *msg);
 
+/**
+ * Get the time span of a message timing string: the sum of its delays, up
+ * to the first invalid record, where reading the message stops.
+ *
+ * @param timing    The timing string, e.g. the "timing_ptr" of a message
+ *                  not read yet.
+ *
+ * @return The timing span, ms.
+ */
+extern uint64_t tlog_json_msg_timing_get_span(const char *timing);
+
 /**
  * Read a packet from the message.
  *
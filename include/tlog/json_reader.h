@@ -96,6 +96,26 @@ extern char *tlog_json_reader_loc_fmt(const struct tlog_json_reader *reader,
 extern tlog_grc tlog_json_reader_read(struct tlog_json_reader *reader,
                                       struct json_object **pobject);
 
+/**
+ * Read and parse a message from a reader, bypassing JSON object creation,
+ * if the reader supports that. Also skip messages definitely not matching
+ * a filter, without parsing them, if the reader supports that.
+ *
+ * @param reader    The reader to read from.
+ * @param filter    The filter to skip messages with, or NULL for none.
+ *                  The messages returned can still not match it.
+ * @param msg       The void message to initialize with the next message
+ *                  read, left void on end of stream; call
+ *                  tlog_json_msg_cleanup after the message is no longer
+ *                  needed, and before reading the next one.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_json_reader_read_msg(
+                        struct tlog_json_reader *reader,
+                        const struct tlog_json_msg_filter *filter,
+                        struct tlog_json_msg *msg);
+
 /**
  * Cleanup and deallocate a reader.
  *
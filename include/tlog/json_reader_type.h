@@ -33,6 +33,7 @@
 #include <stdarg.h>
 #include <json.h>
 #include <tlog/grc.h>
+#include <tlog/json_msg.h>
 
 /* Forward declaration */
 struct tlog_json_reader;
@@ -95,6 +96,25 @@ typedef tlog_grc (*tlog_json_reader_type_read_fn)(
                         struct tlog_json_reader *reader,
                         struct json_object **pobject);
 
+/**
+ * Message reading and parsing function prototype.
+ *
+ * @param reader    The reader to operate on.
+ * @param filter    The filter to skip messages with, before parsing them,
+ *                  if they definitely don't match, or NULL for none.
+ *                  Messages which could match still need to be checked.
+ * @param msg       The void message to initialize with the next message
+ *                  read, left void on end of stream; call
+ *                  tlog_json_msg_cleanup after the message is no longer
+ *                  needed, and before reading the next one.
+ *
+ * @return Global return code.
+ */
+typedef tlog_grc (*tlog_json_reader_type_read_msg_fn)(
+                        struct tlog_json_reader *reader,
+                        const struct tlog_json_msg_filter *filter,
+                        struct tlog_json_msg *msg);
+
 /**
  * Cleanup function prototype.
  *
@@ -117,6 +137,8 @@ struct tlog_json_reader_type {
     tlog_json_reader_type_loc_fmt_fn    loc_fmt;
     /** Reading function */
     tlog_json_reader_type_read_fn       read;
+    /** Message reading and parsing function, optional */
+    tlog_json_reader_type_read_msg_fn   read_msg;
     /** Cleanup function */
     tlog_json_reader_type_cleanup_fn    cleanup;
 };
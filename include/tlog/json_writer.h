@@ -72,6 +72,15 @@ extern bool tlog_json_writer_is_valid(const struct tlog_json_writer *writer);
 extern tlog_grc tlog_json_writer_write(struct tlog_json_writer *writer,
                                        const uint8_t *buf, size_t len);
 
+/**
+ * Flush a writer, delivering any messages it accumulated.
+ *
+ * @param writer    The writer to flush.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_json_writer_flush(struct tlog_json_writer *writer);
+
 /**
  * Cleanup and deallocate a writer.
  *
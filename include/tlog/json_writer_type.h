@@ -73,6 +73,17 @@ typedef tlog_grc (*tlog_json_writer_type_write_fn)(
                                 const uint8_t *buf,
                                 size_t len);
 
+/**
+ * Flushing function prototype: deliver any messages the writer has
+ * accumulated but not yet written.
+ *
+ * @param writer    The writer to operate on.
+ *
+ * @return Global return code.
+ */
+typedef tlog_grc (*tlog_json_writer_type_flush_fn)(
+                                struct tlog_json_writer *writer);
+
 /**
  * Cleanup function prototype.
  *
@@ -87,6 +98,9 @@ struct tlog_json_writer_type {
     tlog_json_writer_type_init_fn      init;       /**< Init function */
     tlog_json_writer_type_is_valid_fn  is_valid;   /**< Validation function */
     tlog_json_writer_type_write_fn     write;      /**< Writing function */
+    tlog_json_writer_type_flush_fn     flush;      /**< Flushing function,
+                                                        NULL if the writer
+                                                        doesn't buffer */
     tlog_json_writer_type_cleanup_fn   cleanup;    /**< Cleanup function */
 };
 
@@ -30,6 +30,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include <tlog/grc.h>
 
 /** Tlog version and license information */
@@ -44,6 +45,9 @@ extern const char *tlog_version;
 /** Return minimum of two numbers */
 #define TLOG_MIN(_a, _b) ((_a) < (_b) ? (_a) : (_b))
 
+/** Round a number up to a multiple of another number */
+#define TLOG_ROUND_UP(_x, _n) (((_x) + (_n) - 1) / (_n) * (_n))
+
 /** Return an offset of a type member */
 #define TLOG_OFFSET_OF(_type, _member) ((size_t) &((_type *)0)->_member)
 
@@ -109,4 +113,20 @@ extern tlog_grc tlog_build_or_inst_path(char          **ppath,
                                         const char     *build_rel_path,
                                         const char     *inst_abs_path);
 
+/**
+ * Find the offset past the last non-zero byte in a part of a file, i.e.
+ * the end of the data followed by the zero-filled tail preallocated by the
+ * memory-mapped writer. Reads the file, so a concurrent truncation can't
+ * cause a SIGBUS, as it could with a mapping.
+ *
+ * @param fd    The file descriptor to look in.
+ * @param start The offset to look from.
+ * @param size  The offset to look up to, e.g. the file size.
+ * @param pend  Location for the found offset, start if everything is zero.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_find_zero_tail(int fd, off_t start, off_t size,
+                                    off_t *pend);
+
 #endif /* _TLOG_MISC_H */
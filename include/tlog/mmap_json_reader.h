@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Memory-mapped file JSON message reader.
+ *
+ * An implementation of a JSON message reader retrieving log messages from a
+ * regular file, mapped into memory.
+ */
+/*
+ * Copyright (C) YEAR Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_MMAP_JSON_READER_H
+#define _TLOG_MMAP_JSON_READER_H
+
+#include <assert.h>
+#include <tlog/json_reader.h>
+#include <tlog/index.h>
+
+/**
+ * Memory-mapped file message reader type
+ *
+ * Creation arguments:
+ *
+ * int      fd          File descriptor of a regular file to read messages
+ *                      from.
+ * bool     fd_owned    True if the file descriptor should be closed upon
+ *                      destruction of the reader, false otherwise.
+ * unsigned int threads Number of threads to parse messages with, zero or
+ *                      one to parse them in the reading thread.
+ * const struct tlog_index *index
+ *                      Index of the file to skip other sessions' messages
+ *                      with, or NULL. Must outlive the reader.
+ * uint64_t pos_min     Position of the earliest message of interest, ms.
+ *                      Runs of messages indexed as ending before it are
+ *                      skipped.
+ *
+ * The whole file is mapped, line boundaries are found with memchr(3), and
+ * each line is passed to the parser at once. The mapping is extended when
+ * the end is reached and the file has grown since. A zero-filled tail, as
+ * preallocated by the memory-mapped writer, is found with pread(2) instead
+ * of through the mapping, and neither it nor an incomplete last line is
+ * read until written, so the writer truncating it doesn't raise SIGBUS.
+ * Zeros left between lines by a crashed writer are skipped as whitespace.
+ *
+ * The file size is checked with fstat(2) before each line is read, or
+ * blocks are queued, and if the file was truncated below the text mapped,
+ * it is read over from the beginning, without the index, and with the
+ * blocks parsed ahead dropped. This keeps the mapping from being accessed
+ * past the end of a file truncated externally, e.g. by logrotate's
+ * copytruncate, except for a truncation racing the reading of a line.
+ *
+ * With more than one thread, messages read with tlog_json_reader_read_msg
+ * are parsed ahead, in blocks of lines cut at line boundaries and handed
+ * to a pool of worker threads, and are delivered in the original order.
+ * The workers read their blocks with pread(2), not through the mapping,
+ * and a block found cut short by a truncation is dropped as above.
+ * The filter given with the first message read is applied by the workers
+ * and must be the same for all reads, and objects cannot be read with
+ * tlog_json_reader_read after that.
+ *
+ * With an index, messages read with a filter specifying a session skip the
+ * indexed runs of other sessions, along with any invalid lines between
+ * them, without reading them. Runs ending before the minimum position are
+ * skipped the same way, jumping straight to the byte offset of the first
+ * run reaching it.
+ */
+extern const struct tlog_json_reader_type tlog_mmap_json_reader_type;
+
+/**
+ * Create a memory-mapped file reader.
+ *
+ * @param preader   Location for the created reader pointer, will be set to
+ *                  NULL in case of error.
+ * @param fd        File descriptor of a regular file to read messages from.
+ * @param fd_owned  True if the file descriptor should be closed upon
+ *                  destruction of the reader, false otherwise.
+ * @param threads   Number of threads to parse messages with, zero or one
+ *                  to parse them in the reading thread.
+ * @param index     Index of the file to skip other sessions' messages
+ *                  with, or NULL. Must outlive the reader.
+ * @param pos_min   Position of the earliest message of interest, ms. Runs
+ *                  of messages indexed as ending before it are skipped.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_mmap_json_reader_create(struct tlog_json_reader **preader,
+                             int fd, bool fd_owned, unsigned int threads,
+                             const struct tlog_index *index,
+                             uint64_t pos_min)
+{
+    assert(preader != NULL);
+    assert(fd >= 0);
+    assert(index == NULL || tlog_index_is_valid(index));
+    return tlog_json_reader_create(preader, &tlog_mmap_json_reader_type,
+                                   fd, fd_owned, threads, index,
+                                   pos_min);
+}
+
+#endif /* _TLOG_MMAP_JSON_READER_H */
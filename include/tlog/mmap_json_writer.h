@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief Memory-mapped file JSON message writer.
+ *
+ * An implementation of a writer appending JSON log messages to a file
+ * through a memory-mapped window.
+ */
+/*
+ * Copyright (C) YEAR Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_MMAP_JSON_WRITER_H
+#define _TLOG_MMAP_JSON_WRITER_H
+
+#include <assert.h>
+#include <tlog/json_writer.h>
+
+/** Minimum size of a file extent, bytes */
+#define TLOG_MMAP_JSON_WRITER_EXTENT_MIN    4096
+
+/**
+ * Memory-mapped file message writer type
+ *
+ * Creation arguments:
+ *
+ * const char  *path    Path to the log file to append to.
+ * size_t       extent  Size to grow the file by, and of the mapped window,
+ *                      bytes.
+ *
+ * The file is grown in extents, allocated in advance, and messages are
+ * copied straight into the mapped window over the file's tail, without a
+ * system call per message. On destruction the file is truncated back to
+ * the end of the last message. If the writing process crashes, the
+ * allocated, but unused, zero-filled tail is left in the file, and is
+ * removed when the file is opened with this writer again.
+ *
+ * The file is locked with an exclusive flock(2) for the lifetime of the
+ * writer, as the tail beyond the last message cannot be shared with other
+ * appenders. Creating another memory-mapped writer for the file fails with
+ * TLOG_RC_MMAP_JSON_WRITER_LOCKED, without waiting, so the caller can use
+ * another file instead. Plain file writers don't take the lock, and must
+ * not append to the file.
+ */
+extern const struct tlog_json_writer_type tlog_mmap_json_writer_type;
+
+/**
+ * Create a memory-mapped file writer.
+ *
+ * @param pwriter   Location for the created writer pointer, will be set to
+ *                  NULL in case of error.
+ * @param path      Path to the log file to append to.
+ * @param extent    Size to grow the file by, and of the mapped window,
+ *                  bytes.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_mmap_json_writer_create(struct tlog_json_writer **pwriter,
+                             const char *path,
+                             size_t extent)
+{
+    assert(pwriter != NULL);
+    assert(path != NULL);
+    assert(extent >= TLOG_MMAP_JSON_WRITER_EXTENT_MIN);
+    return tlog_json_writer_create(pwriter, &tlog_mmap_json_writer_type,
+                                   path, extent);
+}
+
+#endif /* _TLOG_MMAP_JSON_WRITER_H */
@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @brief Prefetching source.
+ *
+ * An implementation of a source reading packets from another source ahead,
+ * in a separate thread.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_PREFETCH_SOURCE_H
+#define _TLOG_PREFETCH_SOURCE_H
+
+#include <assert.h>
+#include <tlog/source.h>
+
+/**
+ * Prefetching source type
+ *
+ * Creation arguments:
+ *
+ * struct tlog_source  *source      The source to read packets from.
+ * bool                 source_owned
+ *                                  True if the source should be destroyed
+ *                                  upon destruction of the prefetching
+ *                                  source, false otherwise.
+ * size_t               size        Maximum number of packets to read
+ *                                  ahead, must be positive.
+ *
+ * A thread with all signals blocked reads packets from the source into a
+ * bounded queue, while there's space in it, copying their I/O data.
+ * Packets are delivered from the queue in the original order, with their
+ * I/O data valid until the next read. The source must not be accessed
+ * directly while the prefetching source exists.
+ *
+ * Reading stops at the end of stream and at errors, which are delivered
+ * in order, and is resumed when the next packet is requested after them,
+ * so a source growing after its end was reached can still be followed.
+ */
+extern const struct tlog_source_type tlog_prefetch_source_type;
+
+/**
+ * Create (allocate and initialize) a prefetching source.
+ *
+ * @param psource       Location for created source pointer, set to NULL
+ *                      in case of error.
+ * @param source        The source to read packets from.
+ * @param source_owned  True if the source should be destroyed upon
+ *                      destruction of the prefetching source, false
+ *                      otherwise.
+ * @param size          Maximum number of packets to read ahead, must be
+ *                      positive.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_prefetch_source_create(struct tlog_source **psource,
+                            struct tlog_source *source,
+                            bool source_owned,
+                            size_t size)
+{
+    assert(psource != NULL);
+    assert(tlog_source_is_valid(source));
+    assert(size > 0);
+
+    return tlog_source_create(psource, &tlog_prefetch_source_type,
+                              source, source_owned, size);
+}
+
+#endif /* _TLOG_PREFETCH_SOURCE_H */
@@ -46,6 +46,7 @@ typedef enum tlog_rc {
     TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING,
     TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TXT,
     TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN,
+    TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED,
     TLOG_RC_FD_JSON_READER_INCOMPLETE_LINE,
     TLOG_RC_JSON_SOURCE_MSG_ID_OUT_OF_ORDER,
     TLOG_RC_JSON_SOURCE_PKT_TS_OUT_OF_ORDER,
@@ -53,6 +54,19 @@ typedef enum tlog_rc {
     TLOG_RC_ES_JSON_READER_CURL_INIT_FAILED,
     TLOG_RC_ES_JSON_READER_REPLY_INVALID,
     TLOG_RC_MEM_JSON_READER_INCOMPLETE_LINE,
+    TLOG_RC_ES_JSON_WRITER_CURL_INIT_FAILED,
+    TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED,
+    TLOG_RC_ES_JSON_WRITER_HTTP_ERROR,
+    TLOG_RC_ES_JSON_WRITER_REPLY_INVALID,
+    TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED,
+    TLOG_RC_ES_JSON_WRITER_ITEMS_HELD,
+    TLOG_RC_SPOOL_JSON_WRITER_LOCKED,
+    TLOG_RC_SPOOL_JSON_WRITER_FULL,
+    TLOG_RC_MMAP_JSON_WRITER_LOCKED,
+    TLOG_RC_INDEX_INVALID,
+    TLOG_RC_INDEX_LOG_TRUNCATED,
+    TLOG_RC_SESSION_LIST_CURL_INIT_FAILED,
+    TLOG_RC_SESSION_LIST_REPLY_INVALID,
     /* Return code upper boundary (not a valid return code) */
     TLOG_RC_MAX_PLUS_ONE
 } tlog_rc;
@@ -28,8 +28,25 @@
 
 #include <tlog/grc.h>
 #include <tlog/errs.h>
+#include <tlog/json_writer.h>
 #include <json.h>
 
+/**
+ * Load the default tlog-rec configuration, the one built from the schema,
+ * e.g. to get the log writer parameter defaults.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param pconf     Location for the pointer to the JSON object representing
+ *                  the loaded configuration. Cannot be NULL.
+ * @param prog_path Path to the running program (argv[0]), used to find the
+ *                  configuration in the build tree. Cannot be NULL.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_rec_conf_load_default(struct tlog_errs **perrs,
+                                           struct json_object **pconf,
+                                           const char *prog_path);
+
 /**
  * Load tlog-rec configuration from various sources and extract program name.
  *
@@ -65,4 +82,46 @@ extern tlog_grc tlog_rec_conf_get_shell(struct tlog_errs **perrs,
                                         const char **ppath,
                                         char ***pargv);
 
+/**
+ * Create a log writer of the specified type, configured with its parameters
+ * from a loaded tlog-rec configuration JSON object.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param conf      Tlog-rec configuration JSON object.
+ * @param type      Writer type name, e.g. "file" or "syslog".
+ * @param pwriter   Location for the created writer pointer.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_rec_conf_get_writer(struct tlog_errs **perrs,
+                                         struct json_object *conf,
+                                         const char *type,
+                                         struct tlog_json_writer **pwriter);
+
+/**
+ * Put a spool in front of a log writer, if configured in a loaded tlog-rec
+ * configuration JSON object.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param conf      Tlog-rec configuration JSON object.
+ * @param pwriter   Location of the writer pointer, replaced with the spool
+ *                  writer taking over the original one, if configured.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_rec_conf_get_spool(struct tlog_errs **perrs,
+                                        struct json_object *conf,
+                                        struct tlog_json_writer **pwriter);
+
+/**
+ * Check if a comma-separated list, such as "fanout" "writers" value,
+ * contains an item.
+ *
+ * @param list  The list to look in.
+ * @param item  The item to look for.
+ *
+ * @return True if the list contains the item, false otherwise.
+ */
+extern bool tlog_rec_conf_list_has(const char *list, const char *item);
+
 #endif /* _TLOG_REC_CONF_H */
@@ -0,0 +1,235 @@
+/**
+ * @file
+ * @brief Terminal screen model.
+ *
+ * A model of a VT100/xterm-compatible terminal screen, interpreting the
+ * terminal output and keeping the resulting screen contents: characters
+ * with their attributes, the cursor, the scrolling region, the alternate
+ * screen and the modes affecting further output. A screen can be rendered
+ * as terminal output reproducing it on a real terminal of the same size,
+ * or as plain text.
+ *
+ * Only the UTF-8 output is supported, and the characters are positioned
+ * according to the widths returned by wcwidth(3) for the current locale.
+ * Zero-width (combining) characters, and the control sequences not
+ * affecting the screen contents are ignored.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_SCREEN_H
+#define _TLOG_SCREEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <tlog/grc.h>
+
+/** Default color */
+#define TLOG_SCREEN_COLOR_DEFAULT   0
+
+/** Indexed (palette) color flag, ORed with the index */
+#define TLOG_SCREEN_COLOR_INDEX     0x1000000
+
+/** Direct (RGB) color flag, ORed with the 0xRRGGBB value */
+#define TLOG_SCREEN_COLOR_RGB       0x2000000
+
+/** Character attribute flags */
+#define TLOG_SCREEN_ATTR_BOLD       0x01
+#define TLOG_SCREEN_ATTR_DIM        0x02
+#define TLOG_SCREEN_ATTR_ITALIC     0x04
+#define TLOG_SCREEN_ATTR_UNDERLINE  0x08
+#define TLOG_SCREEN_ATTR_BLINK      0x10
+#define TLOG_SCREEN_ATTR_REVERSE    0x20
+#define TLOG_SCREEN_ATTR_HIDDEN     0x40
+#define TLOG_SCREEN_ATTR_STRIKE     0x80
+
+/** Character attributes */
+struct tlog_screen_attr {
+    uint32_t    fg;         /**< Foreground color */
+    uint32_t    bg;         /**< Background color */
+    uint8_t     flags;      /**< Attribute flags, TLOG_SCREEN_ATTR_* */
+};
+
+/** Screen cell */
+struct tlog_screen_cell {
+    uint32_t                ch;     /**< Character code point, zero for the
+                                         right half of a wide character */
+    struct tlog_screen_attr attr;   /**< Character attributes */
+};
+
+/** Cursor state, saved and restored as a whole */
+struct tlog_screen_cursor {
+    unsigned short int      x;          /**< Column, zero-based */
+    unsigned short int      y;          /**< Row, zero-based */
+    bool                    wrapnext;   /**< True if the next character
+                                             goes to the next line */
+    struct tlog_screen_attr attr;       /**< Attributes for new characters */
+    bool                    g_graph[2]; /**< True for G0/G1 set to DEC
+                                             special graphics */
+    unsigned int            gl;         /**< Character set shifted in,
+                                             0 for G0, 1 for G1 */
+    bool                    origin;     /**< True if the origin mode is on */
+};
+
+/** Output parser state */
+enum tlog_screen_state {
+    TLOG_SCREEN_STATE_GROUND,   /**< Outputting characters */
+    TLOG_SCREEN_STATE_ESC,      /**< After ESC */
+    TLOG_SCREEN_STATE_ESC_INTER,/**< After ESC and an intermediate byte */
+    TLOG_SCREEN_STATE_CHARSET,  /**< After ESC designating a character set */
+    TLOG_SCREEN_STATE_CSI,      /**< In a control sequence */
+    TLOG_SCREEN_STATE_STR,      /**< In a control string (OSC, DCS, etc.) */
+};
+
+/** Maximum number of control sequence parameters kept */
+#define TLOG_SCREEN_PARAM_MAX   16
+
+/** Screen */
+struct tlog_screen {
+    unsigned short int          width;      /**< Width, columns */
+    unsigned short int          height;     /**< Height, rows */
+    struct tlog_screen_cell    *cells[2];   /**< Main and alternate screen
+                                                 cells, row by row */
+    bool                        alt;        /**< True if the alternate
+                                                 screen is shown */
+    bool                       *tabs;       /**< Tab stops, per column */
+
+    struct tlog_screen_cursor   cursor;     /**< Current cursor */
+    struct tlog_screen_cursor   saved[2];   /**< Cursors saved for the main
+                                                 and the alternate screen */
+    unsigned short int          top;        /**< Scrolling region top row */
+    unsigned short int          bottom;     /**< Scrolling region bottom row */
+    bool                        autowrap;   /**< True if wrapping at the
+                                                 right margin */
+    bool                        insert;     /**< True if inserting chars */
+    bool                        visible;    /**< True if cursor is visible */
+    uint32_t                    last_ch;    /**< Last output character */
+
+    enum tlog_screen_state      state;      /**< Output parser state */
+    uint32_t                    utf8_ch;    /**< Character being decoded */
+    unsigned int                utf8_left;  /**< Number of UTF-8 bytes left
+                                                 in the character */
+    unsigned int                params[TLOG_SCREEN_PARAM_MAX];
+                                            /**< Control sequence params */
+    size_t                      param_num;  /**< Number of params */
+    uint8_t                     marker;     /**< Control sequence private
+                                                 marker, or zero */
+    uint8_t                     inter;      /**< Control sequence
+                                                 intermediate, or zero */
+    unsigned int                charset_g;  /**< Character set being
+                                                 designated */
+};
+
+/**
+ * Check if a screen is valid.
+ *
+ * @param screen    The screen to check.
+ *
+ * @return True if the screen is valid, false otherwise.
+ */
+extern bool tlog_screen_is_valid(const struct tlog_screen *screen);
+
+/**
+ * Create (allocate and initialize) a blank screen.
+ *
+ * @param pscreen   Location for the created screen pointer, will be set to
+ *                  NULL in case of error.
+ * @param width     Screen width, columns, must be positive.
+ * @param height    Screen height, rows, must be positive.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_screen_create(struct tlog_screen **pscreen,
+                                   unsigned short int width,
+                                   unsigned short int height);
+
+/**
+ * Create (allocate and initialize) a copy of a screen.
+ *
+ * @param pscreen   Location for the created screen pointer, will be set to
+ *                  NULL in case of error.
+ * @param orig      The screen to copy.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_screen_copy(struct tlog_screen **pscreen,
+                                 const struct tlog_screen *orig);
+
+/**
+ * Resize a screen, keeping the top left part of the contents, shifted up
+ * to keep the cursor on the screen, if needed.
+ *
+ * @param screen    The screen to resize.
+ * @param width     New width, columns, must be positive.
+ * @param height    New height, rows, must be positive.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_screen_resize(struct tlog_screen *screen,
+                                   unsigned short int width,
+                                   unsigned short int height);
+
+/**
+ * Interpret terminal output, updating a screen.
+ *
+ * @param screen    The screen to output to.
+ * @param buf       The output buffer.
+ * @param len       The output length.
+ */
+extern void tlog_screen_write(struct tlog_screen *screen,
+                              const uint8_t *buf, size_t len);
+
+/**
+ * Render a screen as terminal output reproducing it on a terminal of the
+ * same size, in any state.
+ *
+ * @param screen    The screen to render.
+ * @param pbuf      Location for the pointer to the allocated output,
+ *                  to be freed by the caller.
+ * @param plen      Location for the output length.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_screen_render(const struct tlog_screen *screen,
+                                   char **pbuf, size_t *plen);
+
+/**
+ * Render the text shown on a screen, without attributes, with trailing
+ * spaces and empty lines removed, and each line terminated with a newline.
+ *
+ * @param screen    The screen to render the text of.
+ * @param pbuf      Location for the pointer to the allocated text,
+ *                  to be freed by the caller.
+ * @param plen      Location for the text length.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_screen_text(const struct tlog_screen *screen,
+                                 char **pbuf, size_t *plen);
+
+/**
+ * Destroy (cleanup and free) a screen.
+ *
+ * @param screen    The screen to destroy, can be NULL.
+ */
+extern void tlog_screen_destroy(struct tlog_screen *screen);
+
+#endif /* _TLOG_SCREEN_H */
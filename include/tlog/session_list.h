@@ -0,0 +1,130 @@
+/**
+ * @file
+ * @brief Recorded session list.
+ *
+ * A summary of the sessions recorded in a log, built either from an index
+ * of a log file, or with a single aggregation request to ElasticSearch,
+ * without reading the messages.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_SESSION_LIST_H
+#define _TLOG_SESSION_LIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <tlog/grc.h>
+#include <tlog/index.h>
+
+/** Minimum number of hosts and sessions to request from ElasticSearch */
+#define TLOG_SESSION_LIST_SIZE_MIN  1
+
+/** Value of a session byte count which is unknown */
+#define TLOG_SESSION_LIST_BYTES_UNKNOWN SIZE_MAX
+
+/** Summary of a recorded session */
+struct tlog_session_info {
+    char           *host;       /**< Host name */
+    char           *user;       /**< User name */
+    unsigned int    session;    /**< Audit session ID */
+    uint64_t        first_pos;  /**< Position of the first message, ms */
+    uint64_t        last_pos;   /**< Position of the last message, ms */
+    uint64_t        end_pos;    /**< Position of the end of the latest
+                                     ending message, ms */
+    size_t          num;        /**< Number of messages */
+    size_t          bytes;      /**< Length of the messages in the log,
+                                     or TLOG_SESSION_LIST_BYTES_UNKNOWN */
+};
+
+/** Session list */
+struct tlog_session_list {
+    struct tlog_session_info   *info_list;  /**< Sessions, sorted by host
+                                                 name and session ID */
+    size_t                      info_num;   /**< Number of sessions */
+    bool                        partial;    /**< True if some sessions
+                                                 were left out */
+};
+
+/**
+ * Create a session list from an index of a log file.
+ *
+ * @param plist     Location for the created list pointer, will be set to
+ *                  NULL in case of error.
+ * @param index     The index to summarize the runs of.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_session_list_create_index(
+                            struct tlog_session_list **plist,
+                            const struct tlog_index *index);
+
+/**
+ * Create a session list from the messages stored in ElasticSearch.
+ *
+ * The sessions are retrieved with a single search request for nested
+ * "terms" aggregations over the host names and the session IDs, with the
+ * user names, the number of messages and the minimum and maximum positions
+ * for each, without the messages themselves. ElasticSearch doesn't store
+ * the message lengths, so the byte counts are unknown. The end position is
+ * taken from the timing of the last message, retrieved with a "top_hits"
+ * aggregation.
+ *
+ * @param plist     Location for the created list pointer, will be set to
+ *                  NULL in case of error.
+ * @param base_url  The base URL of the ElasticSearch "_search" endpoint,
+ *                  without the query or the fragment parts.
+ * @param query     The query string selecting the messages.
+ * @param size      Maximum number of hosts, and sessions per host, to
+ *                  retrieve. The list is marked partial if exceeded.
+ * @param connect_timeout
+ *                  Maximum time to wait for a connection to be established,
+ *                  seconds, zero for no limit.
+ * @param timeout   Maximum time the request can take, including connecting,
+ *                  seconds, zero for no limit.
+ *
+ * @return Global return code.
+ */
+extern tlog_grc tlog_session_list_create_es(
+                            struct tlog_session_list **plist,
+                            const char *base_url,
+                            const char *query,
+                            size_t size,
+                            unsigned int connect_timeout,
+                            unsigned int timeout);
+
+/**
+ * Check if a session list is valid.
+ *
+ * @param list  The list to check.
+ *
+ * @return True if the list is valid, false otherwise.
+ */
+extern bool tlog_session_list_is_valid(const struct tlog_session_list *list);
+
+/**
+ * Destroy (cleanup and free) a session list.
+ *
+ * @param list  The list to destroy, can be NULL.
+ */
+extern void tlog_session_list_destroy(struct tlog_session_list *list);
+
+#endif /* _TLOG_SESSION_LIST_H */
@@ -0,0 +1,99 @@
+/**
+ * @file
+ * @brief Spool JSON message writer.
+ *
+ * An implementation of a writer storing JSON log messages in a
+ * memory-mapped ring file and forwarding them to another writer, keeping
+ * them until that writer accepts and flushes them.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_SPOOL_JSON_WRITER_H
+#define _TLOG_SPOOL_JSON_WRITER_H
+
+#include <assert.h>
+#include <tlog/json_writer.h>
+
+/** Minimum size of the spool ring, bytes */
+#define TLOG_SPOOL_JSON_WRITER_SIZE_MIN 4096
+
+/**
+ * Spool message writer type
+ *
+ * Creation arguments:
+ *
+ * struct tlog_json_writer *writer          The writer to forward messages
+ *                                          to.
+ * bool                     writer_owned    True if the forwarding writer
+ *                                          should be destroyed upon
+ *                                          destruction of the spool writer.
+ * const char              *path            Path to the spool file.
+ * size_t                   size            Size of the spool ring to create,
+ *                                          bytes. An existing valid spool
+ *                                          keeps its size.
+ * unsigned int             retry           Seconds to wait before retrying
+ *                                          forwarding after a failure.
+ *
+ * Each message is appended to the ring with a checksum and forwarded to the
+ * writer. The spool's read cursor is only advanced when the writer is
+ * successfully flushed, so messages written before a crash, or during the
+ * writer's outage, are forwarded again when the spool is reopened or the
+ * retry delay passes. Messages can thus be delivered more than once.
+ *
+ * The spool file is locked for exclusive use by the writer. The ring is
+ * never synced to disk synchronously, so it survives the writing process
+ * crashing, but not necessarily the system crashing.
+ */
+extern const struct tlog_json_writer_type tlog_spool_json_writer_type;
+
+/**
+ * Create a spool writer, replaying the messages left in the spool, if any.
+ *
+ * @param pwriter       Location for the created writer pointer, will be set
+ *                      to NULL in case of error.
+ * @param writer        The writer to forward messages to.
+ * @param writer_owned  True if the forwarding writer should be destroyed
+ *                      upon destruction of the spool writer, false
+ *                      otherwise. Only taken over on success.
+ * @param path          Path to the spool file.
+ * @param size          Size of the spool ring to create, bytes.
+ * @param retry         Seconds to wait before retrying forwarding after a
+ *                      failure.
+ *
+ * @return Global return code.
+ */
+static inline tlog_grc
+tlog_spool_json_writer_create(struct tlog_json_writer **pwriter,
+                              struct tlog_json_writer *writer,
+                              bool writer_owned,
+                              const char *path,
+                              size_t size,
+                              unsigned int retry)
+{
+    assert(pwriter != NULL);
+    assert(tlog_json_writer_is_valid(writer));
+    assert(path != NULL);
+    assert(size >= TLOG_SPOOL_JSON_WRITER_SIZE_MIN);
+    return tlog_json_writer_create(pwriter, &tlog_spool_json_writer_type,
+                                   writer, writer_owned, path, size, retry);
+}
+
+#endif /* _TLOG_SPOOL_JSON_WRITER_H */
@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Followed log file.
+ *
+ * Waiting for new messages to be added to a log file, watching it with
+ * inotify(7), if it's a regular file, or polling with exponential backoff
+ * otherwise, and detecting the file being replaced (rotated), or
+ * truncated.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_TAIL_H
+#define _TLOG_TAIL_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <tlog/grc.h>
+
+/** Minimum delay between polls for new messages, ms */
+#define TLOG_TAIL_POLL_DELAY_MIN    100
+
+/** Maximum delay between polls for new messages, ms */
+#define TLOG_TAIL_POLL_DELAY_MAX    2000
+
+/** Period of checking a watched log file without notifications, ms */
+#define TLOG_TAIL_WATCH_PERIOD      30000
+
+/** Size of the log file head compared to detect it was rewritten, bytes */
+#define TLOG_TAIL_HEAD_SIZE         256
+
+/** Followed log state */
+struct tlog_tail {
+    const char     *path;       /**< Path of the log file, or NULL if not
+                                     following a regular file */
+    dev_t           dev;        /**< Device of the file being read */
+    ino_t           ino;        /**< Inode of the file being read */
+    bool            rotated;    /**< True if the path refers to another
+                                     file now */
+    bool            truncated;  /**< True if the file was truncated */
+    char            head[TLOG_TAIL_HEAD_SIZE];
+                                /**< The file head seen, up to the first
+                                     zero, as the preallocated tail of a
+                                     memory-mapped writer is */
+    size_t          head_len;   /**< Length of the file head seen */
+    int             fd;         /**< inotify FD, or -1 to poll */
+    int             delay;      /**< Current polling delay, ms */
+};
+
+/**
+ * Initialize following a log, watching the log file with inotify(7), if
+ * it's a regular file, falling back to polling otherwise.
+ *
+ * @param tail  The log state to initialize.
+ * @param path  Path of the log file, or NULL if not reading a file. Must
+ *              stay valid until the state is cleaned up.
+ */
+extern void tlog_tail_init(struct tlog_tail *tail, const char *path);
+
+/**
+ * Wait for new messages to be added to a followed log, or for the log file
+ * to be replaced (rotated), or truncated, setting the corresponding flags.
+ * Besides shrinking, the file is considered truncated if its head differs
+ * from the one seen before, so a truncation followed by writing past the
+ * old size before the check is not missed.
+ *
+ * @param tail  The log state to wait with.
+ *
+ * @return Global return code, TLOG_GRC_FROM(errno, EINTR), if interrupted
+ *         by a signal.
+ */
+extern tlog_grc tlog_tail_wait(struct tlog_tail *tail);
+
+/**
+ * Note that new messages were read from a followed log, resetting the
+ * polling delay.
+ *
+ * @param tail  The log state to reset.
+ */
+static inline void
+tlog_tail_reset(struct tlog_tail *tail)
+{
+    tail->delay = TLOG_TAIL_POLL_DELAY_MIN;
+}
+
+/**
+ * Cleanup a followed log state.
+ *
+ * @param tail  The log state to cleanup.
+ */
+extern void tlog_tail_cleanup(struct tlog_tail *tail);
+
+#endif /* _TLOG_TAIL_H */
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief Test HTTP server.
+ *
+ * A minimal HTTP/1.1 server running in a thread, replying to requests with
+ * a scripted list of responses and recording the requests, to stand in for
+ * ElasticSearch in tests.
+ */
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _TLOG_TEST_HTTP_SERVER_H
+#define _TLOG_TEST_HTTP_SERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/** Maximum number of requests a test HTTP server records */
+#define TLOG_TEST_HTTP_SERVER_REQ_MAX   32
+
+/** Scripted response of a test HTTP server */
+struct tlog_test_http_server_rsp {
+    int                 status;     /**< HTTP status code,
+                                         zero terminates the script,
+                                         negative drops the connection
+                                         without responding, after
+                                         -status seconds */
+    const char         *body;       /**< Response body */
+};
+
+/** Request recorded by a test HTTP server */
+struct tlog_test_http_server_req {
+    char               *line;       /**< Request line */
+    char               *headers;    /**< Header lines, CRLF-terminated */
+    uint8_t            *body;       /**< Body, decompressed if it had
+                                         "Content-Encoding: gzip" */
+    size_t              body_len;   /**< Body length */
+    size_t              conn;       /**< Number of the connection the
+                                         request came through, from zero */
+    size_t              rsp_len;    /**< Length of the response body as
+                                         transferred, compressed with gzip
+                                         if the request accepted that */
+};
+
+/** Test HTTP server */
+struct tlog_test_http_server {
+    const struct tlog_test_http_server_rsp
+                       *rsp_list;   /**< Response script, terminated by
+                                         a zero status, responses after
+                                         its end have status 500 */
+    int                 listen_fd;  /**< Listening socket */
+    int                 stop_fd[2]; /**< Stop-signalling pipe */
+    uint16_t            port;       /**< Port listened on, at localhost */
+    pthread_t           thread;     /**< Serving thread */
+    struct tlog_test_http_server_req
+                        req_list[TLOG_TEST_HTTP_SERVER_REQ_MAX];
+                                    /**< Recorded requests */
+    size_t              req_num;    /**< Number of received requests */
+    pthread_mutex_t     mutex;      /**< Request number mutex */
+    pthread_cond_t      cond;       /**< Request number change
+                                         condition */
+    size_t              conn_num;   /**< Number of accepted connections */
+};
+
+/**
+ * Start a test HTTP server listening on an ephemeral port at localhost.
+ *
+ * @param server    The server to start.
+ * @param rsp_list  The response script, terminated by a zero status.
+ *
+ * @return True if the server started, false otherwise, with errno set.
+ */
+extern bool tlog_test_http_server_start(
+                    struct tlog_test_http_server *server,
+                    const struct tlog_test_http_server_rsp *rsp_list);
+
+/**
+ * Wait for a test HTTP server to receive a number of requests, to
+ * continue a test at a definite point of a client's background requests.
+ *
+ * @param server    The server to wait for.
+ * @param req_num   The number of requests to wait for.
+ */
+extern void tlog_test_http_server_wait(struct tlog_test_http_server *server,
+                                       size_t req_num);
+
+/**
+ * Stop a test HTTP server, keeping the recorded requests available for
+ * inspection until the server is cleaned up.
+ *
+ * @param server    The server to stop.
+ */
+extern void tlog_test_http_server_stop(struct tlog_test_http_server *server);
+
+/**
+ * Free the requests recorded by a stopped test HTTP server.
+ *
+ * @param server    The server to cleanup.
+ */
+extern void tlog_test_http_server_cleanup(
+                    struct tlog_test_http_server *server);
+
+#endif /* _TLOG_TEST_HTTP_SERVER_H */
@@ -62,7 +62,7 @@ tlog_timespec_add(const struct timespec *a,
 {
     res->tv_sec = a->tv_sec + b->tv_sec;
     res->tv_nsec = a->tv_nsec + b->tv_nsec;
-    if (res->tv_nsec > 1000000000) {
+    if (res->tv_nsec >= 1000000000) {
         res->tv_sec++;
         res->tv_nsec -= 1000000000;
     }
@@ -113,4 +113,26 @@ tlog_timespec_cmp(const struct timespec *a, const struct timespec *b)
     return 0;
 }
 
+/**
+ * Multiply a non-negative timespec by a non-negative floating-point number,
+ * rounding to nanoseconds.
+ *
+ * @param a     Timespec to multiply.
+ * @param b     Number to multiply by.
+ * @param res   Location for result.
+ */
+extern void tlog_timespec_fp_mul(const struct timespec *a, double b,
+                                 struct timespec *res);
+
+/**
+ * Parse a time position in [[HH:]MM:]SS[.FRACTION] format, with the
+ * minutes and seconds following other fields being less than 60.
+ *
+ * @param str   The string to parse.
+ * @param res   Location for the parsed position.
+ *
+ * @return True if the string was parsed, false if it's invalid.
+ */
+extern bool tlog_timespec_parse(const char *str, struct timespec *res);
+
 #endif /* _TLOG_TIMESPEC_H */
@@ -0,0 +1,140 @@
+/*
+ * Collector JSON log message writer.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <tlog/rc.h>
+#include <tlog/collector_json_writer.h>
+
+/** Collector writer data */
+struct tlog_collector_json_writer {
+    struct tlog_json_writer writer; /**< Abstract writer instance */
+    int fd;                         /**< Collector connection socket FD */
+};
+
+static tlog_grc
+tlog_collector_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    struct tlog_collector_json_writer *collector_json_writer =
+                                (struct tlog_collector_json_writer*)writer;
+    const char *path = va_arg(ap, const char *);
+    struct sockaddr_un addr;
+    tlog_grc grc;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return TLOG_GRC_FROM(errno, ENAMETOOLONG);
+    }
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+
+    while (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        if (errno != EINTR) {
+            grc = TLOG_GRC_ERRNO;
+            close(fd);
+            return grc;
+        }
+    }
+
+    collector_json_writer->fd = fd;
+    return TLOG_RC_OK;
+}
+
+static void
+tlog_collector_json_writer_cleanup(struct tlog_json_writer *writer)
+{
+    struct tlog_collector_json_writer *collector_json_writer =
+                                (struct tlog_collector_json_writer*)writer;
+    close(collector_json_writer->fd);
+    collector_json_writer->fd = -1;
+}
+
+static tlog_grc
+tlog_collector_json_writer_write(struct tlog_json_writer *writer,
+                                 const uint8_t *buf,
+                                 size_t len)
+{
+    struct tlog_collector_json_writer *collector_json_writer =
+                                (struct tlog_collector_json_writer*)writer;
+    static char newline = '\n';
+    struct iovec iov[2];
+    struct msghdr msg;
+    ssize_t rc;
+
+    /* The collector separates messages by newlines */
+    iov[0].iov_base = (void *)buf;
+    iov[0].iov_len = len;
+    iov[1].iov_base = &newline;
+    iov[1].iov_len = (len > 0 && buf[len - 1] == '\n') ? 0 : 1;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    while (iov[0].iov_len > 0 || iov[1].iov_len > 0) {
+        /* Don't get killed with SIGPIPE if the collector goes away */
+        rc = sendmsg(collector_json_writer->fd, &msg, MSG_NOSIGNAL);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else {
+                return TLOG_GRC_ERRNO;
+            }
+        }
+        if ((size_t)rc >= iov[0].iov_len) {
+            rc -= iov[0].iov_len;
+            iov[0].iov_len = 0;
+            iov[1].iov_len -= (size_t)rc;
+        } else {
+            iov[0].iov_base = (uint8_t *)iov[0].iov_base + rc;
+            iov[0].iov_len -= (size_t)rc;
+        }
+    }
+
+    return TLOG_RC_OK;
+}
+
+static bool
+tlog_collector_json_writer_is_valid(const struct tlog_json_writer *writer)
+{
+    struct tlog_collector_json_writer *collector_json_writer =
+                                (struct tlog_collector_json_writer*)writer;
+    return collector_json_writer->fd >= 0;
+}
+
+const struct tlog_json_writer_type tlog_collector_json_writer_type = {
+    .size       = sizeof(struct tlog_collector_json_writer),
+    .init       = tlog_collector_json_writer_init,
+    .is_valid   = tlog_collector_json_writer_is_valid,
+    .write      = tlog_collector_json_writer_write,
+    .cleanup    = tlog_collector_json_writer_cleanup,
+};
@@ -25,29 +25,103 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <pthread.h>
 #include <json_tokener.h>
 #include <curl/curl.h>
 #include <tlog/es_json_reader.h>
 #include <tlog/rc.h>
+#include <tlog/misc.h>
+
+/** Reply scanning state, tracking the hits as they arrive */
+struct tlog_es_json_reader_scan {
+    size_t      depth;      /**< Container nesting depth */
+    bool        str;        /**< True if inside a string */
+    bool        esc;        /**< True if after a backslash in a string */
+    char        key[8];     /**< Last string seen at depth one or two,
+                                 possibly an object key */
+    size_t      key_len;    /**< Length of the last string, more than
+                                 the key buffer size if it didn't fit */
+    bool        key_track;  /**< True if tracking the current string */
+    bool        hits_obj;   /**< True if inside the top "hits" object */
+    bool        hits_obj_seen;  /**< True if the top "hits" was seen */
+    bool        hits_arr;   /**< True if inside the "hits.hits" array */
+    bool        hits_arr_seen;  /**< True if "hits.hits" was seen */
+    bool        hit;        /**< True if capturing a hit */
+    tlog_grc    grc;        /**< Scanning failure return code */
+    size_t      count;      /**< Number of hits scanned */
+    char       *last_after; /**< Sort values of the last hit, to request
+                                 the hits after it with, NULL if it had
+                                 none */
+};
 
 /** ElasticSearch reader data */
 struct tlog_es_json_reader {
     struct tlog_json_reader     reader;     /**< Base type */
+
+    /*
+     * Fetching thread data, not accessed by the reading side after
+     * initialization
+     */
     CURL                       *curl;       /**< libcurl handle */
-    char                       *url_pfx;    /**< URL without the "from"
-                                                 query field value */
+    struct curl_slist          *headers;    /**< Request header list */
+    char                       *body_pfx;   /**< Request body without the
+                                                 "search_after" part and
+                                                 the closing brace */
+    struct json_tokener        *tok;        /**< JSON tokener object */
+    struct tlog_es_json_reader_scan
+                                scan;       /**< Reply scanning state */
+    char                       *hit_buf;    /**< Captured hit text */
+    size_t                      hit_size;   /**< Captured hit buffer size */
+    size_t                      hit_len;    /**< Captured hit text length */
+
+    /* Reading side data */
     size_t                      size;       /**< Number of messages retrieved
                                                  in one request */
-    struct json_tokener        *tok;        /**< JSON tokener object */
-    struct json_object         *array;      /**< JSON array of retrieved
-                                                 messages */
-    size_t                      array_idx;  /**< Index of the first message in
-                                                 the array */
-    size_t                      array_len;  /**< Number of messages in the
-                                                 array */
     size_t                      idx;        /**< Index of the message to be
                                                  read next */
     size_t                      last_id;    /**< Last received message ID */
+    char                       *last_after; /**< Sort values of the last
+                                                 received message */
+    bool                        streaming;  /**< True if hits were requested
+                                                 and the end of them wasn't
+                                                 read yet */
+
+    /* Data shared with the fetching thread, protected by the mutex */
+    bool                        sync_init;  /**< True if the mutex and the
+                                                 condition are initialized */
+    pthread_mutex_t             mutex;      /**< Shared data mutex */
+    pthread_cond_t              cond;       /**< Shared data change
+                                                 condition */
+    bool                        thread_init;/**< True if the fetching thread
+                                                 is started */
+    pthread_t                   thread;     /**< Fetching thread */
+    bool                        stop;       /**< True if the fetching thread
+                                                 should exit */
+    bool                        fetch;      /**< True if the fetching thread
+                                                 is requested to, or is
+                                                 fetching pages */
+    bool                        cancel;     /**< True if fetching should
+                                                 stop before the next page */
+    char                       *after;      /**< Sort values of the message
+                                                 the first page should
+                                                 follow, NULL to start from
+                                                 the first one */
+    struct json_object        **queue;      /**< Queue of fetched hits */
+    size_t                      queue_size; /**< Queue allocated size */
+    size_t                      queue_start;/**< Index of the first hit */
+    size_t                      queue_end;  /**< Index past the last hit */
+    size_t                      consumed;   /**< Number of hits taken since
+                                                 fetching was requested */
+    bool                        done;       /**< True if fetching stopped
+                                                 after the last page */
+    bool                        more;       /**< True if the last page was
+                                                 not empty, and more
+                                                 messages could follow */
+    tlog_grc                    done_grc;   /**< Return code of fetching */
 };
 
 bool
@@ -58,148 +132,604 @@ tlog_es_json_reader_base_url_is_valid(const char *base_url)
            strchr(base_url, '#') == NULL;
 }
 
+/**
+ * Empty the hit queue of an ElasticSearch reader, with the mutex held.
+ *
+ * @param es_json_reader    The reader to empty the queue of.
+ */
+static void
+tlog_es_json_reader_queue_empty(struct tlog_es_json_reader *es_json_reader)
+{
+    for (; es_json_reader->queue_start < es_json_reader->queue_end;
+         es_json_reader->queue_start++) {
+        json_object_put(
+            es_json_reader->queue[es_json_reader->queue_start]);
+    }
+    es_json_reader->queue_start = 0;
+    es_json_reader->queue_end = 0;
+}
+
 static void
 tlog_es_json_reader_cleanup(struct tlog_json_reader *reader)
 {
     struct tlog_es_json_reader *es_json_reader =
                                 (struct tlog_es_json_reader*)reader;
-    if (es_json_reader->array != NULL) {
-        json_object_put(es_json_reader->array);
-        es_json_reader->array = NULL;
+
+    /* Stop the fetching thread, aborting the current request */
+    if (es_json_reader->thread_init) {
+        pthread_mutex_lock(&es_json_reader->mutex);
+        es_json_reader->stop = true;
+        pthread_cond_broadcast(&es_json_reader->cond);
+        pthread_mutex_unlock(&es_json_reader->mutex);
+        pthread_join(es_json_reader->thread, NULL);
+        es_json_reader->thread_init = false;
     }
+    if (es_json_reader->sync_init) {
+        pthread_cond_destroy(&es_json_reader->cond);
+        pthread_mutex_destroy(&es_json_reader->mutex);
+        es_json_reader->sync_init = false;
+    }
+
+    tlog_es_json_reader_queue_empty(es_json_reader);
+    free(es_json_reader->after);
+    es_json_reader->after = NULL;
+    free(es_json_reader->last_after);
+    es_json_reader->last_after = NULL;
+    free(es_json_reader->scan.last_after);
+    es_json_reader->scan.last_after = NULL;
+    free(es_json_reader->queue);
+    es_json_reader->queue = NULL;
+    es_json_reader->queue_size = 0;
+    free(es_json_reader->hit_buf);
+    es_json_reader->hit_buf = NULL;
     if (es_json_reader->tok != NULL) {
         json_tokener_free(es_json_reader->tok);
         es_json_reader->tok = NULL;
     }
-    free(es_json_reader->url_pfx);
-    es_json_reader->url_pfx = NULL;
+    free(es_json_reader->body_pfx);
+    es_json_reader->body_pfx = NULL;
     if (es_json_reader->curl != NULL) {
         curl_easy_cleanup(es_json_reader->curl);
         es_json_reader->curl = NULL;
     }
+    curl_slist_free_all(es_json_reader->headers);
+    es_json_reader->headers = NULL;
 }
 
 /**
- * Format an ElasticSearch request URL prefix: the URL ending with "from=",
- * ready for the addition of the message index.
+ * Format an ElasticSearch search request body prefix: the body without the
+ * "search_after" part and the closing brace, ready for the addition of
+ * those.
  *
- * @param purl_pfx  The location for the dynamically-allocated URL prefix.
- * @param curl      The CURL handle to escape with.
- * @param base_url  The base URL to request ElasticSearch, without the query
- *                  or the fragment parts.
+ * @param pbody_pfx The location for the dynamically-allocated body prefix.
  * @param query     The query string to send to ElastiSearch.
+ * @param pos_min   Minimum position of messages to request, ms.
+ * @param pos_max   Maximum position of messages to request, ms, UINT64_MAX
+ *                  for no limit.
  * @param size      Number of messages to request from ElasticSearch in one
  *                  HTTP request.
  *
  * @return Global return code.
  */
 static tlog_grc
-tlog_es_json_reader_format_url_pfx(char **purl_pfx,
-                                   CURL *curl,
-                                   const char *base_url,
-                                   const char *query,
-                                   size_t size)
+tlog_es_json_reader_format_body_pfx(char **pbody_pfx,
+                                    const char *query,
+                                    uint64_t pos_min,
+                                    uint64_t pos_max,
+                                    size_t size)
 {
-    static const char *sort = "id:asc";
-
     tlog_grc grc;
-    char *url_pfx;
-    char *esc_query = NULL;
-    char *esc_sort = NULL;
+    struct json_object *str = NULL;
+    char *query_str = NULL;
+    char range[64];
+    int len;
+    int rc;
 
-    assert(purl_pfx != NULL);
-    assert(curl != NULL);
-    assert(tlog_es_json_reader_base_url_is_valid(base_url));
+    assert(pbody_pfx != NULL);
     assert(query != NULL);
     assert(size >= TLOG_ES_JSON_READER_SIZE_MIN);
 
-#define ESC(_token) \
-    do {                                                    \
-        esc_##_token = curl_easy_escape(curl, _token, 0);   \
-        if (esc_##_token == NULL) {                         \
-            grc = TLOG_GRC_FROM(errno, ENOMEM);             \
-            goto cleanup;                                   \
-        }                                                   \
-    } while (0)
-
-    ESC(query);
-    ESC(sort);
-
-#undef ESC
+    /* Let json-c escape the query */
+    str = json_object_new_string(query);
+    if (str == NULL) {
+        grc = TLOG_GRC_FROM(errno, ENOMEM);
+        goto cleanup;
+    }
 
-    if (asprintf(&url_pfx,
-                 "%s?q=%s&fields=&_source&sort=%s&size=%zu&from=",
-                 base_url, esc_query, esc_sort, size) < 0) {
+    /* Filter out the messages outside the positions without scoring */
+    if (pos_min == 0 && pos_max == UINT64_MAX) {
+        rc = asprintf(&query_str, "{\"query_string\":{\"query\":%s}}",
+                      json_object_to_json_string(str));
+    } else {
+        len = 0;
+        if (pos_min != 0) {
+            len += snprintf(range, sizeof(range),
+                            "\"gte\":%" PRIu64, pos_min);
+        }
+        if (pos_max != UINT64_MAX) {
+            snprintf(range + len, sizeof(range) - len,
+                     "%s\"lte\":%" PRIu64, (len == 0 ? "" : ","), pos_max);
+        }
+        rc = asprintf(&query_str,
+                      "{\"bool\":{"
+                        "\"must\":{\"query_string\":{\"query\":%s}},"
+                        "\"filter\":{\"range\":{\"pos\":{%s}}}}}",
+                      json_object_to_json_string(str), range);
+    }
+    if (rc < 0) {
+        query_str = NULL;
         grc = TLOG_GRC_FROM(errno, ENOMEM);
         goto cleanup;
     }
 
-    *purl_pfx = url_pfx;
+    if (asprintf(pbody_pfx,
+                 "{\"query\":%s,"
+                 "\"sort\":[{\"id\":\"asc\"},{\"session\":\"asc\"},"
+                           "{\"host.raw\":\"asc\"}],\"size\":%zu,"
+                 "\"_source\":[\"ver\",\"host\",\"user\",\"term\","
+                              "\"session\",\"id\",\"pos\",\"timing\","
+                              "\"in_txt\",\"in_bin\","
+                              "\"out_txt\",\"out_bin\"]",
+                 query_str, size) < 0) {
+        grc = TLOG_GRC_FROM(errno, ENOMEM);
+        goto cleanup;
+    }
 
     grc = TLOG_RC_OK;
 
 cleanup:
 
-    if (esc_sort != NULL) {
-        curl_free(esc_sort);
-    }
-    if (esc_query != NULL) {
-        curl_free(esc_query);
+    free(query_str);
+    if (str != NULL) {
+        json_object_put(str);
     }
     return grc;
 }
 
-/** CURL write function data */
-struct tlog_es_json_reader_write_data {
-    struct json_tokener        *tok;    /**< JSON tokener object to use */
-    enum json_tokener_error     rc;     /**< Return status of the tokener */
-    struct json_object         *obj;    /**< The parsed JSON response */
-};
+/**
+ * Retrieve the ID of a hit.
+ *
+ * @param hit       The hit to retrieve the ID of.
+ * @param pid       Location for the retrieved ID.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_reader_get_id(struct json_object *hit, int64_t *pid)
+{
+    struct json_object *object;
+    struct json_object *field;
+    int64_t id;
+
+    if (!json_object_object_get_ex(hit, "_source", &object) ||
+        !json_object_object_get_ex(object, "id", &field) ||
+        json_object_get_type(field) != json_type_int) {
+        return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+    }
+    id = json_object_get_int64(field);
+    if (id < 0) {
+        return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+    }
+    *pid = id;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Format the "search_after" sort values of a hit, for requesting the hits
+ * following it. Messages are sorted by ID, and then by session ID and
+ * host, as only all three identify a message uniquely.
+ *
+ * @param hit       The hit to format the sort values of.
+ * @param pafter    Location for the allocated sort values text.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_reader_format_after(struct json_object *hit, char **pafter)
+{
+    struct json_object *object;
+    struct json_object *id;
+    struct json_object *session;
+    struct json_object *host;
+
+    if (!json_object_object_get_ex(hit, "_source", &object) ||
+        !json_object_object_get_ex(object, "id", &id) ||
+        json_object_get_type(id) != json_type_int ||
+        !json_object_object_get_ex(object, "session", &session) ||
+        json_object_get_type(session) != json_type_int ||
+        !json_object_object_get_ex(object, "host", &host) ||
+        json_object_get_type(host) != json_type_string) {
+        return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+    }
+    if (asprintf(pafter, "[%" PRId64 ",%" PRId64 ",%s]",
+                 json_object_get_int64(id),
+                 json_object_get_int64(session),
+                 json_object_to_json_string(host)) < 0) {
+        *pafter = NULL;
+        return TLOG_GRC_FROM(errno, ENOMEM);
+    }
+    return TLOG_RC_OK;
+}
+
+/**
+ * Parse a captured hit and queue it for reading, in the fetching thread.
+ *
+ * @param es_json_reader    The reader to queue the hit for.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_reader_queue_hit(struct tlog_es_json_reader *es_json_reader)
+{
+    struct tlog_es_json_reader_scan *scan = &es_json_reader->scan;
+    struct json_object *hit;
+    struct json_object **queue;
+    size_t size;
+
+    if (es_json_reader->hit_len > INT_MAX) {
+        return TLOG_GRC_FROM(json, json_tokener_error_size);
+    }
+    json_tokener_reset(es_json_reader->tok);
+    hit = json_tokener_parse_ex(es_json_reader->tok,
+                                es_json_reader->hit_buf,
+                                (int)es_json_reader->hit_len);
+    if (hit == NULL) {
+        return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+    }
+
+    /* Remember where to continue from, leave errors to reading */
+    scan->count++;
+    free(scan->last_after);
+    if (tlog_es_json_reader_format_after(hit,
+                                         &scan->last_after) != TLOG_RC_OK) {
+        scan->last_after = NULL;
+    }
+
+    pthread_mutex_lock(&es_json_reader->mutex);
+    if (es_json_reader->queue_end >= es_json_reader->queue_size) {
+        /* Move the hits to the start, or grow the queue */
+        if (es_json_reader->queue_start > 0) {
+            memmove(es_json_reader->queue,
+                    es_json_reader->queue + es_json_reader->queue_start,
+                    (es_json_reader->queue_end -
+                        es_json_reader->queue_start) * sizeof(*queue));
+            es_json_reader->queue_end -= es_json_reader->queue_start;
+            es_json_reader->queue_start = 0;
+        } else {
+            size = es_json_reader->queue_size == 0
+                        ? es_json_reader->size
+                        : es_json_reader->queue_size * 2;
+            queue = realloc(es_json_reader->queue, size * sizeof(*queue));
+            if (queue == NULL) {
+                pthread_mutex_unlock(&es_json_reader->mutex);
+                json_object_put(hit);
+                return TLOG_GRC_ERRNO;
+            }
+            es_json_reader->queue = queue;
+            es_json_reader->queue_size = size;
+        }
+    }
+    es_json_reader->queue[es_json_reader->queue_end++] = hit;
+    pthread_cond_broadcast(&es_json_reader->cond);
+    pthread_mutex_unlock(&es_json_reader->mutex);
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Scan a piece of a reply, queueing each of the hits as soon as it
+ * arrives, in the fetching thread.
+ *
+ * @param es_json_reader    The reader to scan the reply for.
+ * @param ptr               The reply piece.
+ * @param len               The reply piece length.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_reader_scan(struct tlog_es_json_reader *es_json_reader,
+                         const char *ptr, size_t len)
+{
+    struct tlog_es_json_reader_scan *scan = &es_json_reader->scan;
+    const char *end = ptr + len;
+    bool key;
+    char c;
+    char *buf;
+    size_t size;
+    tlog_grc grc;
+
+    for (; ptr < end; ptr++) {
+        c = *ptr;
+
+        /* Capture the hit text */
+        if (scan->hit || (scan->hits_arr && scan->depth == 3 && c == '{')) {
+            if (es_json_reader->hit_len >= es_json_reader->hit_size) {
+                size = es_json_reader->hit_size == 0
+                            ? 4096 : es_json_reader->hit_size * 2;
+                buf = realloc(es_json_reader->hit_buf, size);
+                if (buf == NULL) {
+                    return TLOG_GRC_ERRNO;
+                }
+                es_json_reader->hit_buf = buf;
+                es_json_reader->hit_size = size;
+            }
+            es_json_reader->hit_buf[es_json_reader->hit_len++] = c;
+        }
+
+        /* Skip string contents, tracking possible keys */
+        if (scan->str) {
+            if (scan->esc) {
+                scan->esc = false;
+            } else if (c == '\\') {
+                scan->esc = true;
+            } else if (c == '"') {
+                scan->str = false;
+            } else if (scan->key_track &&
+                       scan->key_len++ < sizeof(scan->key)) {
+                scan->key[scan->key_len - 1] = c;
+            }
+            continue;
+        }
+
+        /* Only objects are expected in the hit list */
+        if (scan->hits_arr && scan->depth == 3 && !scan->hit &&
+            c != '{' && c != ']' && c != ',' && !isspace((unsigned char)c)) {
+            return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+        }
+
+        switch (c) {
+        case '"':
+            scan->str = true;
+            scan->key_track = !scan->hit &&
+                              (scan->depth == 1 || scan->depth == 2);
+            if (scan->key_track) {
+                scan->key_len = 0;
+            }
+            break;
+        case '{':
+        case '[':
+            key = scan->key_len == 4 && memcmp(scan->key, "hits", 4) == 0;
+            if (scan->hit) {
+                /* Nothing to look for inside a hit */
+            } else if (scan->depth == 1 && key) {
+                if (c != '{') {
+                    return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+                }
+                scan->hits_obj = true;
+                scan->hits_obj_seen = true;
+            } else if (scan->depth == 2 && scan->hits_obj && key) {
+                if (c != '[') {
+                    return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+                }
+                scan->hits_arr = true;
+                scan->hits_arr_seen = true;
+            } else if (scan->depth == 3 && scan->hits_arr) {
+                scan->hit = true;
+            }
+            scan->depth++;
+            break;
+        case '}':
+        case ']':
+            if (scan->depth == 0) {
+                return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+            }
+            scan->depth--;
+            if (scan->depth == 3 && scan->hit) {
+                scan->hit = false;
+                grc = tlog_es_json_reader_queue_hit(es_json_reader);
+                es_json_reader->hit_len = 0;
+                if (grc != TLOG_RC_OK) {
+                    return grc;
+                }
+            } else if (scan->depth == 2) {
+                scan->hits_arr = false;
+            } else if (scan->depth == 1) {
+                scan->hits_obj = false;
+            }
+            break;
+        }
+    }
+
+    return TLOG_RC_OK;
+}
 
 /**
- * Parse the data retrieved by CURL into a JSON object - to be supplied to
- * curl_easy_setopt with CURLOPT_WRITEFUNCTION and called by
- * curl_easy_perform.
+ * Scan the data retrieved by CURL - to be supplied to curl_easy_setopt
+ * with CURLOPT_WRITEFUNCTION and called by curl_easy_perform.
  *
  * @param ptr       Pointer to the retrieved (piece of) data that should be
- *                  parsed.
+ *                  scanned.
  * @param size      Size of each retrieved data chunk.
  * @param nmemb     Number of retrieved data chunks.
- * @param userdata  The data supplied to curl_easy_setopt as
- *                  CURLOPT_WRITEDATA, must be struct
- *                  tlog_es_json_reader_write_data.
+ * @param userdata  The reader, as supplied with CURLOPT_WRITEDATA.
  *
  * @return Number of bytes processed, signals error if different from
- *         size*nmemb, can be CURL_WRITEFUNC_PAUSE to signal transfer pause.
+ *         size*nmemb.
  */
 static size_t
 tlog_es_json_reader_write_func(char *ptr, size_t size, size_t nmemb,
                                void *userdata)
 {
-    struct tlog_es_json_reader_write_data *data =
-                (struct tlog_es_json_reader_write_data *)userdata;
+    struct tlog_es_json_reader *es_json_reader =
+                (struct tlog_es_json_reader *)userdata;
     size_t len = size * nmemb;
+    bool abort;
 
     assert(ptr != NULL || len == 0);
-    assert(data != NULL);
+    assert(es_json_reader != NULL);
 
-    if (len == 0) {
-        return len;
+    /* Abort the transfer, if the reader is being destroyed */
+    pthread_mutex_lock(&es_json_reader->mutex);
+    abort = es_json_reader->stop;
+    pthread_mutex_unlock(&es_json_reader->mutex);
+    if (abort) {
+        return !len;
     }
 
-    if (data->obj != NULL) {
-        return !len;
+    es_json_reader->scan.grc = tlog_es_json_reader_scan(es_json_reader,
+                                                        ptr, len);
+    return es_json_reader->scan.grc == TLOG_RC_OK ? len : !len;
+}
+
+/**
+ * Fetch a page of messages, queueing hits as they arrive, in the fetching
+ * thread.
+ *
+ * @param es_json_reader    The reader to fetch the page for.
+ * @param after             Sort values of the message the page should
+ *                          follow, NULL if it should start from the first
+ *                          one.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_reader_fetch(struct tlog_es_json_reader *es_json_reader,
+                          const char *after)
+{
+    struct tlog_es_json_reader_scan *scan = &es_json_reader->scan;
+    tlog_grc grc;
+    char *body = NULL;
+    int len;
+    long status;
+    CURLcode rc;
+
+    /* Reset the scanning state */
+    free(scan->last_after);
+    memset(scan, 0, sizeof(*scan));
+    es_json_reader->hit_len = 0;
+
+    /* Format request body */
+    len = after != NULL
+            ? asprintf(&body, "%s,\"search_after\":%s}",
+                       es_json_reader->body_pfx, after)
+            : asprintf(&body, "%s}", es_json_reader->body_pfx);
+    if (len < 0) {
+        body = NULL;
+        grc = TLOG_GRC_FROM(errno, ENOMEM);
+        goto cleanup;
     }
 
-    data->obj = json_tokener_parse_ex(data->tok, ptr, (int)len);
-    if (data->obj == NULL) {
-        data->rc = json_tokener_get_error(data->tok);
-        if (data->rc != json_tokener_continue) {
-            return !len;
+#define SETOPT(_opt, _val) \
+    do {                                                            \
+        rc = curl_easy_setopt(es_json_reader->curl, _opt, _val);    \
+        if (rc != CURLE_OK) {                                       \
+            grc = TLOG_GRC_FROM(curl, rc);                          \
+            goto cleanup;                                           \
+        }                                                           \
+    } while (0)
+
+    SETOPT(CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)len);
+    SETOPT(CURLOPT_POSTFIELDS, body);
+
+#undef SETOPT
+
+    /* Perform the request */
+    rc = curl_easy_perform(es_json_reader->curl);
+    if (rc != CURLE_OK) {
+        if (rc == CURLE_WRITE_ERROR && scan->grc != TLOG_RC_OK) {
+            grc = scan->grc;
+        } else {
+            grc = TLOG_GRC_FROM(curl, rc);
         }
+        goto cleanup;
     }
 
-    return len;
+    /*
+     * Check the reply was complete, and had a hit list, if it had the
+     * outer hits object, as filtering drops empty hit lists from it
+     */
+    rc = curl_easy_getinfo(es_json_reader->curl,
+                           CURLINFO_RESPONSE_CODE, &status);
+    if (rc != CURLE_OK) {
+        grc = TLOG_GRC_FROM(curl, rc);
+        goto cleanup;
+    }
+    if ((status != 0 && (status < 200 || status >= 300)) ||
+        scan->depth != 0 || scan->str ||
+        scan->hits_obj_seen != scan->hits_arr_seen) {
+        grc = TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+        goto cleanup;
+    }
+
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    free(body);
+    return grc;
+}
+
+/**
+ * Fetching thread function: on request, fetch pages one after another,
+ * until a page is not full, staying at most one page ahead of the
+ * reading side.
+ *
+ * @param arg   The reader to fetch pages for.
+ *
+ * @return NULL.
+ */
+static void *
+tlog_es_json_reader_thread(void *arg)
+{
+    struct tlog_es_json_reader *es_json_reader =
+                                (struct tlog_es_json_reader *)arg;
+    struct tlog_es_json_reader_scan *scan = &es_json_reader->scan;
+    char *after;
+    size_t total;
+    tlog_grc grc;
+
+    pthread_mutex_lock(&es_json_reader->mutex);
+    while (true) {
+        while (!es_json_reader->fetch && !es_json_reader->stop) {
+            pthread_cond_wait(&es_json_reader->cond, &es_json_reader->mutex);
+        }
+        if (es_json_reader->stop) {
+            break;
+        }
+        after = es_json_reader->after;
+        es_json_reader->after = NULL;
+        total = 0;
+
+        while (true) {
+            pthread_mutex_unlock(&es_json_reader->mutex);
+            grc = tlog_es_json_reader_fetch(es_json_reader, after);
+            free(after);
+            after = NULL;
+            pthread_mutex_lock(&es_json_reader->mutex);
+            total += scan->count;
+
+            /* If failed, or the page was not full, or can't continue */
+            if (grc != TLOG_RC_OK ||
+                scan->count < es_json_reader->size ||
+                scan->last_after == NULL) {
+                es_json_reader->done = true;
+                es_json_reader->done_grc = grc;
+                es_json_reader->more = grc == TLOG_RC_OK &&
+                                       scan->count > 0;
+                break;
+            }
+
+            /* Wait for the page before this one to be taken */
+            while (es_json_reader->consumed < total - scan->count &&
+                   !es_json_reader->cancel && !es_json_reader->stop) {
+                pthread_cond_wait(&es_json_reader->cond,
+                                  &es_json_reader->mutex);
+            }
+            if (es_json_reader->cancel || es_json_reader->stop) {
+                break;
+            }
+
+            after = scan->last_after;
+            scan->last_after = NULL;
+        }
+        free(after);
+
+        es_json_reader->fetch = false;
+        pthread_cond_broadcast(&es_json_reader->cond);
+    }
+    pthread_mutex_unlock(&es_json_reader->mutex);
+
+    return NULL;
 }
 
 static tlog_grc
@@ -209,31 +739,92 @@ tlog_es_json_reader_init(struct tlog_json_reader *reader, va_list ap)
                                 (struct tlog_es_json_reader*)reader;
     const char *base_url = va_arg(ap, const char *);
     const char *query = va_arg(ap, const char *);
+    uint64_t pos_min = va_arg(ap, uint64_t);
+    uint64_t pos_max = va_arg(ap, uint64_t);
+    uint64_t span_max = va_arg(ap, uint64_t);
     size_t size = va_arg(ap, size_t);
+    unsigned int connect_timeout = va_arg(ap, unsigned int);
+    unsigned int timeout = va_arg(ap, unsigned int);
+    static const char *header_list[] = {
+        "Content-Type: application/json",
+        /* Don't wait for "100 Continue" before sending the body */
+        "Expect:",
+    };
+    struct curl_slist *headers;
+    char *url = NULL;
     CURLcode rc;
     tlog_grc grc;
+    size_t i;
+    int err;
+    sigset_t all_set;
+    sigset_t orig_set;
 
     assert(tlog_es_json_reader_base_url_is_valid(base_url));
     assert(query != NULL);
     assert(size >= TLOG_ES_JSON_READER_SIZE_MIN);
 
+    /* Build the request header list */
+    for (i = 0; i < TLOG_ARRAY_SIZE(header_list); i++) {
+        headers = curl_slist_append(es_json_reader->headers,
+                                    header_list[i]);
+        if (headers == NULL) {
+            grc = TLOG_GRC_FROM(errno, ENOMEM);
+            goto error;
+        }
+        es_json_reader->headers = headers;
+    }
+
     /* Create and initialize CURL handle */
     es_json_reader->curl = curl_easy_init();
     if (es_json_reader->curl == NULL) {
         grc = TLOG_RC_ES_JSON_READER_CURL_INIT_FAILED;
         goto error;
     }
-    rc = curl_easy_setopt(es_json_reader->curl, CURLOPT_WRITEFUNCTION,
-                          tlog_es_json_reader_write_func);
-    if (rc != CURLE_OK) {
-        grc = TLOG_GRC_FROM(curl, rc);
+
+#define SETOPT(_opt, _val) \
+    do {                                                            \
+        rc = curl_easy_setopt(es_json_reader->curl, _opt, _val);    \
+        if (rc != CURLE_OK) {                                       \
+            grc = TLOG_GRC_FROM(curl, rc);                          \
+            goto error;                                             \
+        }                                                           \
+    } while (0)
+
+    /* Have only the message sources returned */
+    if (asprintf(&url, "%s?filter_path=hits.hits._source", base_url) < 0) {
+        url = NULL;
+        grc = TLOG_GRC_FROM(errno, ENOMEM);
         goto error;
     }
+    SETOPT(CURLOPT_URL, url);
+    free(url);
+    url = NULL;
+    SETOPT(CURLOPT_POST, 1L);
+    SETOPT(CURLOPT_HTTPHEADER, es_json_reader->headers);
+    SETOPT(CURLOPT_WRITEFUNCTION, tlog_es_json_reader_write_func);
+    SETOPT(CURLOPT_WRITEDATA, es_json_reader);
+    SETOPT(CURLOPT_NOSIGNAL, 1L);
+    SETOPT(CURLOPT_CONNECTTIMEOUT, (long)connect_timeout);
+    SETOPT(CURLOPT_TIMEOUT, (long)timeout);
+    /* Accept any compression supported by libcurl */
+#if LIBCURL_VERSION_NUM >= 0x071506
+    SETOPT(CURLOPT_ACCEPT_ENCODING, "");
+#else
+    SETOPT(CURLOPT_ENCODING, "");
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071900
+    SETOPT(CURLOPT_TCP_KEEPALIVE, 1L);
+#endif
 
-    /* Format URL prefix */
-    grc = tlog_es_json_reader_format_url_pfx(&es_json_reader->url_pfx,
-                                        es_json_reader->curl,
-                                        base_url, query, size);
+#undef SETOPT
+
+    /* Request the messages starting before, but covering the minimum */
+    pos_min = (pos_min > span_max ? pos_min - span_max : 0);
+
+    /* Format request body prefix */
+    grc = tlog_es_json_reader_format_body_pfx(&es_json_reader->body_pfx,
+                                              query, pos_min, pos_max,
+                                              size);
     if (grc != TLOG_RC_OK) {
         goto error;
     }
@@ -248,9 +839,36 @@ tlog_es_json_reader_init(struct tlog_json_reader *reader, va_list ap)
         goto error;
     }
 
+    /* Start the fetching thread */
+    err = pthread_mutex_init(&es_json_reader->mutex, NULL);
+    if (err != 0) {
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    err = pthread_cond_init(&es_json_reader->cond, NULL);
+    if (err != 0) {
+        pthread_mutex_destroy(&es_json_reader->mutex);
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    es_json_reader->sync_init = true;
+
+    /* Start the thread with signals blocked, to leave them to the caller */
+    sigfillset(&all_set);
+    pthread_sigmask(SIG_SETMASK, &all_set, &orig_set);
+    err = pthread_create(&es_json_reader->thread, NULL,
+                         tlog_es_json_reader_thread, es_json_reader);
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+    if (err != 0) {
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    es_json_reader->thread_init = true;
+
     return TLOG_RC_OK;
 
 error:
+    free(url);
     tlog_es_json_reader_cleanup(reader);
     return grc;
 }
@@ -261,14 +879,10 @@ tlog_es_json_reader_is_valid(const struct tlog_json_reader *reader)
     struct tlog_es_json_reader *es_json_reader =
                                 (struct tlog_es_json_reader*)reader;
     return es_json_reader->curl != NULL &&
-           es_json_reader->url_pfx != NULL &&
+           es_json_reader->body_pfx != NULL &&
            es_json_reader->size >= TLOG_ES_JSON_READER_SIZE_MIN &&
            es_json_reader->tok != NULL &&
-           (es_json_reader->array != NULL ||
-            es_json_reader->array_len == 0) &&
-           es_json_reader->idx >= es_json_reader->array_idx &&
-           es_json_reader->idx <=
-                es_json_reader->array_idx + es_json_reader->size;
+           es_json_reader->thread_init;
 }
 
 static size_t
@@ -287,122 +901,22 @@ tlog_es_json_reader_loc_fmt(const struct tlog_json_reader *reader,
 }
 
 /**
- * Format an ElasticSearch request URL for the current message index of a
- * reader.
+ * Stop fetching hits and drop the fetched ones, with the mutex held.
  *
- * @param reader    The reader to format the URL for.
- * @param purl      The location for the dynamically-allocated URL.
- *
- * @return Global return code.
+ * @param es_json_reader    The reader to stop fetching for.
  */
-static tlog_grc
-tlog_es_json_reader_format_url(struct tlog_es_json_reader *es_json_reader,
-                               char **purl)
-{
-    char *url;
-
-    assert(tlog_es_json_reader_is_valid(
-                    (struct tlog_json_reader*)es_json_reader));
-
-    if (asprintf(&url, "%s%zu",
-                 es_json_reader->url_pfx, es_json_reader->idx) < 0) {
-        return TLOG_GRC_FROM(errno, ENOMEM);
-    }
-
-    *purl = url;
-
-    return TLOG_RC_OK;
-}
-
-/**
- * Refill the retrieved message array of a reader.
- *
- * @param reader    The reader to refill the message array for.
- *
- * @return Global return code.
- */
-static tlog_grc
-tlog_es_json_reader_refill_array(struct tlog_es_json_reader *es_json_reader)
+static void
+tlog_es_json_reader_cancel(struct tlog_es_json_reader *es_json_reader)
 {
-    tlog_grc grc;
-    char *url = NULL;
-    struct tlog_es_json_reader_write_data data;
-    CURLcode rc;
-
-    assert(tlog_es_json_reader_is_valid(
-                    (struct tlog_json_reader *)es_json_reader));
-
-    /* Initialize callback data */
-    data.tok = es_json_reader->tok;
-    data.rc = json_tokener_success;
-    data.obj = NULL;
-
-    /* Free the previous array, if any */
-    if (es_json_reader->array != NULL) {
-        json_object_put(es_json_reader->array);
-        es_json_reader->array = NULL;
-        es_json_reader->array_len = 0;
-    }
-
-    /* Format request URL */
-    grc = tlog_es_json_reader_format_url(es_json_reader, &url);
-    if (grc != TLOG_RC_OK) {
-        goto cleanup;
-    }
-
-    /* Set request URL */
-    rc = curl_easy_setopt(es_json_reader->curl, CURLOPT_URL, url);
-    if (rc != CURLE_OK) {
-        grc = TLOG_GRC_FROM(curl, rc);
-        goto cleanup;
-    }
-
-    /* Set callback data */
-    rc = curl_easy_setopt(es_json_reader->curl, CURLOPT_WRITEDATA, &data);
-    if (rc != CURLE_OK) {
-        grc = TLOG_GRC_FROM(curl, rc);
-        goto cleanup;
-    }
-
-    /* Perform the request */
-    rc = curl_easy_perform(es_json_reader->curl);
-    if (rc != CURLE_OK) {
-        if (rc == CURLE_WRITE_ERROR && data.rc != json_tokener_success) {
-            grc = TLOG_GRC_FROM(json, data.rc);
-        } else {
-            grc = TLOG_GRC_FROM(curl, rc);
-        }
-        goto cleanup;
-    }
-
-    /* If no data was read */
-    if (data.obj == NULL) {
-        es_json_reader->array = NULL;
-        es_json_reader->array_len = 0;
-    } else {
-        struct json_object *obj;
-        /* Extract the array */
-        if (!json_object_object_get_ex(data.obj, "hits", &obj) ||
-            !json_object_object_get_ex(obj, "hits", &obj) ||
-            json_object_get_type(obj) != json_type_array) {
-            grc = TLOG_RC_ES_JSON_READER_REPLY_INVALID;
-            goto cleanup;
-        }
-        es_json_reader->array = json_object_get(obj);
-        es_json_reader->array_len = json_object_array_length(obj);
+    es_json_reader->cancel = true;
+    pthread_cond_broadcast(&es_json_reader->cond);
+    while (es_json_reader->fetch) {
+        pthread_cond_wait(&es_json_reader->cond, &es_json_reader->mutex);
     }
-
-    es_json_reader->array_idx = es_json_reader->idx;
-
-    grc = TLOG_RC_OK;
-
-cleanup:
-
-    if (data.obj != NULL) {
-        json_object_put(data.obj);
-    }
-    free(url);
-    return grc;
+    es_json_reader->cancel = false;
+    es_json_reader->done = false;
+    tlog_es_json_reader_queue_empty(es_json_reader);
+    es_json_reader->streaming = false;
 }
 
 tlog_grc
@@ -412,65 +926,92 @@ tlog_es_json_reader_read(struct tlog_json_reader *reader,
     struct tlog_es_json_reader *es_json_reader =
                                 (struct tlog_es_json_reader*)reader;
     tlog_grc grc;
-    struct json_object *hit;
+    struct json_object *hit = NULL;
     struct json_object *object;
-    struct json_object *field;
     int64_t id;
+    char *after;
 
-    /* If we're outside the array */
-    if (es_json_reader->idx >=
-            es_json_reader->array_idx + es_json_reader->array_len) {
-        /* Try refilling it */
-        grc = tlog_es_json_reader_refill_array(es_json_reader);
-        if (grc != TLOG_RC_OK) {
-            return grc;
-        }
-    }
+    pthread_mutex_lock(&es_json_reader->mutex);
 
-    /* If we're still outside the array */
-    if (es_json_reader->idx >=
-            es_json_reader->array_idx + es_json_reader->array_len) {
-        object = NULL;
-    } else {
-        /* Get next object from the array */
-        hit = json_object_array_get_idx(es_json_reader->array,
-                                        es_json_reader->idx -
-                                            es_json_reader->array_idx);
-        assert(hit != NULL);
-        if (!json_object_object_get_ex(hit, "_source", &object)) {
-            es_json_reader->idx++;
-            return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+    while (true) {
+        /* Request hits following the last read message, if not yet */
+        if (!es_json_reader->streaming) {
+            free(es_json_reader->after);
+            es_json_reader->after = NULL;
+            if (es_json_reader->last_after != NULL) {
+                es_json_reader->after = strdup(es_json_reader->last_after);
+                if (es_json_reader->after == NULL) {
+                    grc = TLOG_GRC_ERRNO;
+                    pthread_mutex_unlock(&es_json_reader->mutex);
+                    return grc;
+                }
+            }
+            es_json_reader->fetch = true;
+            es_json_reader->consumed = 0;
+            es_json_reader->streaming = true;
+            pthread_cond_broadcast(&es_json_reader->cond);
         }
 
-        /* Get message ID */
-        if (!json_object_object_get_ex(object, "id", &field) ||
-            json_object_get_type(field) != json_type_int) {
-            es_json_reader->idx++;
-            return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+        /* Wait for the next hit, or the end of them */
+        while (es_json_reader->queue_start == es_json_reader->queue_end &&
+               !es_json_reader->done) {
+            pthread_cond_wait(&es_json_reader->cond, &es_json_reader->mutex);
         }
-        id = json_object_get_int64(field);
-        if (id < 0) {
-            es_json_reader->idx++;
-            return TLOG_RC_ES_JSON_READER_REPLY_INVALID;
+        if (es_json_reader->queue_start < es_json_reader->queue_end) {
+            break;
         }
 
-        /* If this is the first message or ID is not ahead */
-        if (es_json_reader->idx == 0 ||
-            (size_t)id <= es_json_reader->last_id + 1) {
-            es_json_reader->idx++;
-            json_object_get(object);
-            es_json_reader->last_id = (size_t)id;
-        } else {
-            /* The message ID is ahead - produce EOF */
-            es_json_reader->array_len =
-                (es_json_reader->idx - es_json_reader->array_idx);
-            object = NULL;
+        /* Fetching stopped, request more if the last page wasn't empty */
+        grc = es_json_reader->done_grc;
+        es_json_reader->done = false;
+        es_json_reader->streaming = false;
+        if (!es_json_reader->more) {
+            pthread_mutex_unlock(&es_json_reader->mutex);
+            if (grc == TLOG_RC_OK) {
+                *pobject = NULL;
+            }
+            return grc;
         }
     }
 
-    *pobject = object;
+    /* Take the next hit */
+    hit = es_json_reader->queue[es_json_reader->queue_start++];
+    es_json_reader->consumed++;
+    pthread_cond_broadcast(&es_json_reader->cond);
 
-    return TLOG_RC_OK;
+    /* Get message ID */
+    grc = tlog_es_json_reader_get_id(hit, &id);
+    if (grc != TLOG_RC_OK) {
+        es_json_reader->idx++;
+        goto cleanup;
+    }
+
+    /* If this is the first message or ID is not ahead */
+    if (es_json_reader->idx == 0 ||
+        (size_t)id <= es_json_reader->last_id + 1) {
+        grc = tlog_es_json_reader_format_after(hit, &after);
+        es_json_reader->idx++;
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        json_object_object_get_ex(hit, "_source", &object);
+        *pobject = json_object_get(object);
+        es_json_reader->last_id = (size_t)id;
+        free(es_json_reader->last_after);
+        es_json_reader->last_after = after;
+    } else {
+        /*
+         * The message ID is ahead - produce EOF, dropping the fetched
+         * hits, to retry after the last read message
+         */
+        tlog_es_json_reader_cancel(es_json_reader);
+        *pobject = NULL;
+    }
+
+cleanup:
+    pthread_mutex_unlock(&es_json_reader->mutex);
+    json_object_put(hit);
+    return grc;
 }
 
 const struct tlog_json_reader_type tlog_es_json_reader_type = {
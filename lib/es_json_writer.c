@@ -0,0 +1,1000 @@
+/*
+ * ElasticSearch JSON log message writer.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <json_tokener.h>
+#include <curl/curl.h>
+#include <tlog/es_json_writer.h>
+#include <tlog/timespec.h>
+#include <tlog/misc.h>
+#include <tlog/rc.h>
+
+/** Bulk API action line preceding each message in a batch */
+static const char tlog_es_json_writer_action[] = "{\"index\":{}}\n";
+
+/** Batch of bulk items */
+struct tlog_es_json_writer_batch {
+    char       *body_buf;       /**< Body buffer */
+    size_t      body_size;      /**< Body buffer size */
+    size_t      body_len;       /**< Body length */
+    size_t     *item_list;      /**< Item offsets */
+    size_t      item_size;      /**< Item offset list size */
+    size_t      item_num;       /**< Number of items */
+};
+
+/** ElasticSearch writer data */
+struct tlog_es_json_writer {
+    struct tlog_json_writer     writer;         /**< Abstract writer instance */
+
+    /* Writing side data */
+    struct tlog_es_json_writer_batch
+                                fill;           /**< Batch being filled */
+    struct timespec             fill_ts;        /**< Time the first item was
+                                                     added to the filled
+                                                     batch */
+    size_t                      batch_size;     /**< Batch size limit, bytes */
+    unsigned int                batch_age;      /**< Batch age limit, seconds,
+                                                     zero for no limit */
+
+    /*
+     * Sending thread data, not accessed by the writing side after
+     * initialization
+     */
+    CURL                       *curl;           /**< libcurl handle, reused to
+                                                     keep the connection */
+    struct curl_slist          *headers;        /**< Request header list */
+    struct json_tokener        *tok;            /**< Reply JSON tokener */
+    unsigned int                retries;        /**< Request retry limit */
+    bool                        gzip;           /**< True if compressing
+                                                     request bodies */
+    z_stream                    zstream;        /**< Compression stream */
+    bool                        zstream_init;   /**< True if zstream was
+                                                     initialized */
+    struct tlog_es_json_writer_batch
+                                send;           /**< Batch being sent,
+                                                     including the items held
+                                                     for retrying */
+    uint8_t                    *gzip_buf;       /**< Compressed body buffer */
+    size_t                      gzip_size;      /**< Compressed buffer size */
+    char                       *reply_buf;      /**< Reply body buffer */
+    size_t                      reply_size;     /**< Reply buffer size */
+    size_t                      reply_len;      /**< Reply body length */
+
+    /* Data shared with the sending thread, protected by the mutex */
+    bool                        sync_init;      /**< True if the mutex and the
+                                                     condition are
+                                                     initialized */
+    pthread_mutex_t             mutex;          /**< Shared data mutex */
+    pthread_cond_t              cond;           /**< Shared data change
+                                                     condition */
+    bool                        thread_init;    /**< True if the sending
+                                                     thread is started */
+    pthread_t                   thread;         /**< Sending thread */
+    bool                        stop;           /**< True if the sending
+                                                     thread should make a last
+                                                     attempt and exit */
+    struct tlog_es_json_writer_batch
+                                queue;          /**< Items handed over to the
+                                                     sending thread */
+    bool                        pending;        /**< True if the sending
+                                                     thread is requested to
+                                                     send */
+    bool                        busy;           /**< True if the sending
+                                                     thread is sending */
+    tlog_grc                    sent_grc;       /**< Last failure of sending
+                                                     since the last drain */
+    tlog_grc                    fatal_grc;      /**< Failure stopping the
+                                                     sending, if any */
+};
+
+bool
+tlog_es_json_writer_base_url_is_valid(const char *base_url)
+{
+    return base_url != NULL &&
+           strchr(base_url, '?') == NULL &&
+           strchr(base_url, '#') == NULL;
+}
+
+/**
+ * Make sure a dynamically-allocated buffer has at least the specified size,
+ * growing it exponentially, if necessary.
+ *
+ * @param pbuf      Location of the buffer pointer.
+ * @param psize     Location of the buffer size, in elements.
+ * @param elem_size Size of a buffer element, bytes.
+ * @param size      The required buffer size, in elements.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_writer_reserve(void *pbuf, size_t *psize,
+                            size_t elem_size, size_t size)
+{
+    void **pptr = (void **)pbuf;
+    size_t new_size;
+    void *new_buf;
+
+    assert(pptr != NULL);
+    assert(psize != NULL);
+    assert(elem_size > 0);
+
+    if (size <= *psize) {
+        return TLOG_RC_OK;
+    }
+
+    for (new_size = TLOG_MAX(*psize, 64); new_size < size; new_size *= 2);
+
+    new_buf = realloc(*pptr, new_size * elem_size);
+    if (new_buf == NULL) {
+        return TLOG_GRC_ERRNO;
+    }
+    *pptr = new_buf;
+    *psize = new_size;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Free the buffers of a batch.
+ *
+ * @param batch The batch to cleanup.
+ */
+static void
+tlog_es_json_writer_batch_cleanup(struct tlog_es_json_writer_batch *batch)
+{
+    free(batch->body_buf);
+    batch->body_buf = NULL;
+    batch->body_size = 0;
+    batch->body_len = 0;
+    free(batch->item_list);
+    batch->item_list = NULL;
+    batch->item_size = 0;
+    batch->item_num = 0;
+}
+
+/**
+ * Move items from the start of one batch to the end of another, as long as
+ * the receiving batch stays within a size limit, but at least one item, if
+ * it's empty.
+ *
+ * @param dst   The batch to move the items to.
+ * @param src   The batch to move the items from.
+ * @param size  The size limit of the receiving batch, bytes.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_writer_batch_move(struct tlog_es_json_writer_batch *dst,
+                               struct tlog_es_json_writer_batch *src,
+                               size_t size)
+{
+    tlog_grc grc;
+    size_t num;
+    size_t len;
+    size_t end;
+    size_t i;
+
+    assert(dst != NULL);
+    assert(src != NULL);
+
+    /* Count the items which fit */
+    for (num = 0, len = 0; num < src->item_num; num++, len = end) {
+        end = (num + 1 < src->item_num ? src->item_list[num + 1]
+                                       : src->body_len);
+        if (dst->item_num + num > 0 && dst->body_len + end > size) {
+            break;
+        }
+    }
+    if (num == 0) {
+        return TLOG_RC_OK;
+    }
+
+    grc = tlog_es_json_writer_reserve(&dst->body_buf, &dst->body_size,
+                                      1, dst->body_len + len);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    grc = tlog_es_json_writer_reserve(&dst->item_list, &dst->item_size,
+                                      sizeof(*dst->item_list),
+                                      dst->item_num + num);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+
+    memcpy(dst->body_buf + dst->body_len, src->body_buf, len);
+    for (i = 0; i < num; i++) {
+        dst->item_list[dst->item_num + i] = dst->body_len + src->item_list[i];
+    }
+    dst->item_num += num;
+    dst->body_len += len;
+
+    memmove(src->body_buf, src->body_buf + len, src->body_len - len);
+    for (i = num; i < src->item_num; i++) {
+        src->item_list[i - num] = src->item_list[i] - len;
+    }
+    src->item_num -= num;
+    src->body_len -= len;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Collect an HTTP reply body - to be supplied to curl_easy_setopt with
+ * CURLOPT_WRITEFUNCTION and called by curl_easy_perform.
+ *
+ * @param ptr       Pointer to the retrieved piece of the body.
+ * @param size      Size of each retrieved data chunk.
+ * @param nmemb     Number of retrieved data chunks.
+ * @param userdata  The writer, as supplied with CURLOPT_WRITEDATA.
+ *
+ * @return Number of bytes processed, signals error if different from
+ *         size*nmemb.
+ */
+static size_t
+tlog_es_json_writer_reply_func(char *ptr, size_t size, size_t nmemb,
+                               void *userdata)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer *)userdata;
+    size_t len = size * nmemb;
+
+    assert(ptr != NULL || len == 0);
+    assert(es_json_writer != NULL);
+
+    if (tlog_es_json_writer_reserve(&es_json_writer->reply_buf,
+                                    &es_json_writer->reply_size,
+                                    1, es_json_writer->reply_len + len) !=
+            TLOG_RC_OK) {
+        return len == 0;
+    }
+    memcpy(es_json_writer->reply_buf + es_json_writer->reply_len, ptr, len);
+    es_json_writer->reply_len += len;
+    return len;
+}
+
+/**
+ * Compress the batch being sent by a writer into its compressed body buffer.
+ *
+ * @param es_json_writer    The writer to compress the batch of.
+ * @param plen              Location for the compressed body length.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_writer_compress(struct tlog_es_json_writer *es_json_writer,
+                             size_t *plen)
+{
+    z_stream *zstream = &es_json_writer->zstream;
+    tlog_grc grc;
+
+    assert(es_json_writer->zstream_init);
+    assert(plen != NULL);
+
+    if (deflateReset(zstream) != Z_OK) {
+        return TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED;
+    }
+
+    grc = tlog_es_json_writer_reserve(
+                    &es_json_writer->gzip_buf, &es_json_writer->gzip_size, 1,
+                    deflateBound(zstream, es_json_writer->send.body_len));
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+
+    zstream->next_in = (Bytef *)es_json_writer->send.body_buf;
+    zstream->avail_in = es_json_writer->send.body_len;
+    zstream->next_out = es_json_writer->gzip_buf;
+    zstream->avail_out = es_json_writer->gzip_size;
+    if (deflate(zstream, Z_FINISH) != Z_STREAM_END) {
+        return TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED;
+    }
+
+    *plen = zstream->total_out;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Post the batch being sent by a writer to the server once and collect the
+ * reply.
+ *
+ * @param es_json_writer    The writer to post the batch of.
+ * @param pstatus           Location for the HTTP status code of the reply.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_writer_post(struct tlog_es_json_writer *es_json_writer,
+                         long *pstatus)
+{
+    CURL *curl = es_json_writer->curl;
+    const void *body;
+    size_t len;
+    CURLcode rc;
+    tlog_grc grc;
+
+    assert(pstatus != NULL);
+
+    if (es_json_writer->gzip) {
+        grc = tlog_es_json_writer_compress(es_json_writer, &len);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+        body = es_json_writer->gzip_buf;
+    } else {
+        body = es_json_writer->send.body_buf;
+        len = es_json_writer->send.body_len;
+    }
+
+    rc = curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)len);
+    if (rc != CURLE_OK) {
+        return TLOG_GRC_FROM(curl, rc);
+    }
+    rc = curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+    if (rc != CURLE_OK) {
+        return TLOG_GRC_FROM(curl, rc);
+    }
+
+    es_json_writer->reply_len = 0;
+    rc = curl_easy_perform(curl);
+    if (rc != CURLE_OK) {
+        return TLOG_GRC_FROM(curl, rc);
+    }
+
+    rc = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, pstatus);
+    if (rc != CURLE_OK) {
+        return TLOG_GRC_FROM(curl, rc);
+    }
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Check if an HTTP status (of a reply or a bulk item) signals a temporary
+ * failure, so the request (or the item) should be retried.
+ *
+ * @param status    The status to check.
+ *
+ * @return True if the status is a temporary failure, false otherwise.
+ */
+static bool
+tlog_es_json_writer_status_is_temporary(long status)
+{
+    return status == 429 || status >= 500;
+}
+
+/**
+ * Process a successful bulk reply collected by a writer: remove the items
+ * which were accepted or permanently rejected from the batch being sent,
+ * keeping the ones rejected temporarily.
+ *
+ * @param es_json_writer    The writer to process the reply for.
+ *
+ * @return Global return code:
+ *         TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED, if some items were rejected
+ *         permanently and were dropped.
+ */
+static tlog_grc
+tlog_es_json_writer_sift(struct tlog_es_json_writer *es_json_writer)
+{
+    struct tlog_es_json_writer_batch *send = &es_json_writer->send;
+    tlog_grc grc;
+    struct json_object *reply;
+    struct json_object *obj;
+    struct json_object *items;
+    size_t i;
+    size_t kept_num;
+    size_t kept_len;
+    size_t item_start;
+    size_t item_len;
+    bool rejected = false;
+
+    if (es_json_writer->reply_len > INT_MAX) {
+        return TLOG_RC_ES_JSON_WRITER_REPLY_INVALID;
+    }
+    json_tokener_reset(es_json_writer->tok);
+    reply = json_tokener_parse_ex(es_json_writer->tok,
+                                  es_json_writer->reply_buf,
+                                  (int)es_json_writer->reply_len);
+    if (reply == NULL) {
+        return TLOG_RC_ES_JSON_WRITER_REPLY_INVALID;
+    }
+
+    /* If all items were accepted */
+    if (!json_object_object_get_ex(reply, "errors", &obj) ||
+        json_object_get_type(obj) != json_type_boolean) {
+        grc = TLOG_RC_ES_JSON_WRITER_REPLY_INVALID;
+        goto cleanup;
+    }
+    if (!json_object_get_boolean(obj)) {
+        send->body_len = 0;
+        send->item_num = 0;
+        grc = TLOG_RC_OK;
+        goto cleanup;
+    }
+
+    /* Check the status of each item */
+    if (!json_object_object_get_ex(reply, "items", &items) ||
+        json_object_get_type(items) != json_type_array ||
+        (size_t)json_object_array_length(items) != send->item_num) {
+        grc = TLOG_RC_ES_JSON_WRITER_REPLY_INVALID;
+        goto cleanup;
+    }
+    kept_num = 0;
+    kept_len = 0;
+    for (i = 0; i < send->item_num; i++) {
+        struct json_object *status = NULL;
+        long status_code;
+
+        /* Get the status from the single (action) member of the item */
+        obj = json_object_array_get_idx(items, i);
+        if (json_object_get_type(obj) == json_type_object) {
+            json_object_object_foreach(obj, action, result) {
+                (void)action;
+                json_object_object_get_ex(result, "status", &status);
+                break;
+            }
+        }
+        if (json_object_get_type(status) != json_type_int) {
+            grc = TLOG_RC_ES_JSON_WRITER_REPLY_INVALID;
+            goto cleanup;
+        }
+        status_code = (long)json_object_get_int64(status);
+
+        /* Keep the temporarily-rejected item for retrying */
+        if (tlog_es_json_writer_status_is_temporary(status_code)) {
+            item_start = send->item_list[i];
+            item_len = (i + 1 < send->item_num
+                            ? send->item_list[i + 1]
+                            : send->body_len) - item_start;
+            memmove(send->body_buf + kept_len,
+                    send->body_buf + item_start, item_len);
+            send->item_list[kept_num] = kept_len;
+            kept_num++;
+            kept_len += item_len;
+        } else if (status_code < 200 || status_code >= 300) {
+            rejected = true;
+        }
+    }
+    send->item_num = kept_num;
+    send->body_len = kept_len;
+
+    grc = rejected ? TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED : TLOG_RC_OK;
+
+cleanup:
+    json_object_put(reply);
+    return grc;
+}
+
+/**
+ * Wait before retrying a request, unless the writer is being destroyed.
+ *
+ * @param es_json_writer    The writer to wait for.
+ * @param attempt           Number of the attempt which failed, starting
+ *                          from zero.
+ *
+ * @return True if waited, false if the writer is being destroyed.
+ */
+static bool
+tlog_es_json_writer_backoff(struct tlog_es_json_writer *es_json_writer,
+                            unsigned int attempt)
+{
+    unsigned int ms = TLOG_ES_JSON_WRITER_BACKOFF_MIN_MS;
+    struct timespec delay;
+    struct timespec ts;
+    bool stop;
+
+    for (; attempt > 0 && ms < TLOG_ES_JSON_WRITER_BACKOFF_MAX_MS; attempt--) {
+        ms *= 2;
+    }
+    ms = TLOG_MIN(ms, TLOG_ES_JSON_WRITER_BACKOFF_MAX_MS);
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = (long)(ms % 1000) * 1000000;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    tlog_timespec_add(&ts, &delay, &ts);
+
+    pthread_mutex_lock(&es_json_writer->mutex);
+    while (!es_json_writer->stop &&
+           pthread_cond_timedwait(&es_json_writer->cond,
+                                  &es_json_writer->mutex, &ts) != ETIMEDOUT);
+    stop = es_json_writer->stop;
+    pthread_mutex_unlock(&es_json_writer->mutex);
+    return !stop;
+}
+
+/**
+ * Send the batch being sent by a writer, retrying temporary failures.
+ *
+ * Temporarily-failed items are kept in the batch if the retries are
+ * exhausted, permanently-rejected items are discarded.
+ *
+ * @param es_json_writer    The writer to send the batch of.
+ * @param retries           Maximum number of retries.
+ *
+ * @return Global return code:
+ *         TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED, if some items were rejected
+ *         permanently and were dropped,
+ *         TLOG_RC_ES_JSON_WRITER_ITEMS_HELD, if none were dropped, but some
+ *         were still rejected temporarily when the retries ran out, and
+ *         were kept in the batch.
+ */
+static tlog_grc
+tlog_es_json_writer_send(struct tlog_es_json_writer *es_json_writer,
+                         unsigned int retries)
+{
+    tlog_grc grc;
+    tlog_grc rejected_grc = TLOG_RC_OK;
+    unsigned int attempt;
+    long status;
+
+    assert(es_json_writer->send.item_num > 0);
+
+    for (attempt = 0; ; attempt++) {
+        grc = tlog_es_json_writer_post(es_json_writer, &status);
+        if (grc == TLOG_RC_OK) {
+            if (tlog_es_json_writer_status_is_temporary(status)) {
+                grc = TLOG_RC_ES_JSON_WRITER_HTTP_ERROR;
+            } else if (status < 200 || status >= 300) {
+                /* The server won't ever accept this batch */
+                es_json_writer->send.body_len = 0;
+                es_json_writer->send.item_num = 0;
+                return TLOG_RC_ES_JSON_WRITER_HTTP_ERROR;
+            } else {
+                grc = tlog_es_json_writer_sift(es_json_writer);
+                if (grc == TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED) {
+                    rejected_grc = grc;
+                } else if (grc != TLOG_RC_OK) {
+                    return grc;
+                }
+                if (es_json_writer->send.item_num == 0) {
+                    return rejected_grc;
+                }
+                grc = rejected_grc != TLOG_RC_OK
+                        ? rejected_grc
+                        : TLOG_RC_ES_JSON_WRITER_ITEMS_HELD;
+            }
+        } else if (grc == TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED ||
+                   grc == TLOG_GRC_FROM(errno, ENOMEM)) {
+            return grc;
+        }
+
+        if (attempt >= retries ||
+            !tlog_es_json_writer_backoff(es_json_writer, attempt)) {
+            return grc;
+        }
+    }
+}
+
+/**
+ * Check if a sending failure is fatal, that is, not caused by the server,
+ * so that no further sending is attempted.
+ *
+ * @param grc   The return code of the failed sending.
+ *
+ * @return True if the failure is fatal, false otherwise.
+ */
+static bool
+tlog_es_json_writer_grc_is_fatal(tlog_grc grc)
+{
+    return grc == TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED ||
+           grc == TLOG_GRC_FROM(errno, ENOMEM);
+}
+
+/**
+ * The sending thread of a writer: send the items handed over to it in
+ * batches, whenever requested, keeping the items the server didn't accept
+ * in time for the next request, and make a last attempt to send the
+ * remaining items when stopped.
+ *
+ * @param arg   The writer.
+ *
+ * @return NULL.
+ */
+static void *
+tlog_es_json_writer_thread(void *arg)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer *)arg;
+    struct tlog_es_json_writer_batch *send = &es_json_writer->send;
+    tlog_grc grc;
+    bool stop;
+
+    pthread_mutex_lock(&es_json_writer->mutex);
+    while (true) {
+        while (!es_json_writer->stop && !es_json_writer->pending) {
+            pthread_cond_wait(&es_json_writer->cond, &es_json_writer->mutex);
+        }
+        stop = es_json_writer->stop;
+        es_json_writer->pending = false;
+
+        /* Add the handed-over items fitting into a batch */
+        if (es_json_writer->fatal_grc == TLOG_RC_OK) {
+            es_json_writer->fatal_grc = tlog_es_json_writer_batch_move(
+                                            send, &es_json_writer->queue,
+                                            es_json_writer->batch_size);
+        }
+
+        if (es_json_writer->fatal_grc == TLOG_RC_OK && send->item_num > 0) {
+            es_json_writer->busy = true;
+            pthread_mutex_unlock(&es_json_writer->mutex);
+            grc = tlog_es_json_writer_send(es_json_writer,
+                                           stop ? 0 : es_json_writer->retries);
+            pthread_mutex_lock(&es_json_writer->mutex);
+            es_json_writer->busy = false;
+            if (grc != TLOG_RC_OK) {
+                es_json_writer->sent_grc = grc;
+                if (tlog_es_json_writer_grc_is_fatal(grc)) {
+                    es_json_writer->fatal_grc = grc;
+                }
+            }
+            /* Carry on with the rest, unless the server is failing */
+            if (send->item_num == 0 && es_json_writer->queue.item_num > 0) {
+                es_json_writer->pending = true;
+            }
+        }
+
+        pthread_cond_broadcast(&es_json_writer->cond);
+        if (stop && !es_json_writer->pending) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&es_json_writer->mutex);
+
+    return NULL;
+}
+
+static void
+tlog_es_json_writer_cleanup(struct tlog_json_writer *writer);
+
+static tlog_grc
+tlog_es_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer*)writer;
+    const char *base_url = va_arg(ap, const char *);
+    size_t batch_size = va_arg(ap, size_t);
+    unsigned int batch_age = va_arg(ap, unsigned int);
+    unsigned int retries = va_arg(ap, unsigned int);
+    unsigned int connect_timeout = va_arg(ap, unsigned int);
+    unsigned int timeout = va_arg(ap, unsigned int);
+    bool gzip = (bool)va_arg(ap, int);
+    static const char *header_list[] = {
+        "Content-Type: application/x-ndjson",
+        /* Don't wait for "100 Continue" before sending large batches */
+        "Expect:",
+    };
+    struct curl_slist *headers;
+    CURLcode rc;
+    tlog_grc grc;
+    size_t i;
+    int err;
+    sigset_t all_set;
+    sigset_t orig_set;
+
+    assert(tlog_es_json_writer_base_url_is_valid(base_url));
+    assert(batch_size >= TLOG_ES_JSON_WRITER_BATCH_SIZE_MIN);
+
+    es_json_writer->batch_size = batch_size;
+    es_json_writer->batch_age = batch_age;
+    es_json_writer->retries = retries;
+    es_json_writer->gzip = gzip;
+
+    /* Build the request header list */
+    for (i = 0; i < TLOG_ARRAY_SIZE(header_list) + gzip; i++) {
+        headers = curl_slist_append(es_json_writer->headers,
+                                    i < TLOG_ARRAY_SIZE(header_list)
+                                        ? header_list[i]
+                                        : "Content-Encoding: gzip");
+        if (headers == NULL) {
+            grc = TLOG_GRC_FROM(errno, ENOMEM);
+            goto error;
+        }
+        es_json_writer->headers = headers;
+    }
+
+    /* Initialize the compression stream, producing gzip format */
+    if (gzip) {
+        if (deflateInit2(&es_json_writer->zstream, Z_DEFAULT_COMPRESSION,
+                         Z_DEFLATED, MAX_WBITS + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            grc = TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED;
+            goto error;
+        }
+        es_json_writer->zstream_init = true;
+    }
+
+    /* Create reply JSON tokener */
+    es_json_writer->tok = json_tokener_new();
+    if (es_json_writer->tok == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    /* Create and initialize CURL handle */
+    es_json_writer->curl = curl_easy_init();
+    if (es_json_writer->curl == NULL) {
+        grc = TLOG_RC_ES_JSON_WRITER_CURL_INIT_FAILED;
+        goto error;
+    }
+
+#define SETOPT(_opt, _val) \
+    do {                                                            \
+        rc = curl_easy_setopt(es_json_writer->curl, _opt, _val);    \
+        if (rc != CURLE_OK) {                                       \
+            grc = TLOG_GRC_FROM(curl, rc);                          \
+            goto error;                                             \
+        }                                                           \
+    } while (0)
+
+    SETOPT(CURLOPT_URL, base_url);
+    SETOPT(CURLOPT_POST, 1L);
+    SETOPT(CURLOPT_HTTPHEADER, es_json_writer->headers);
+    SETOPT(CURLOPT_WRITEFUNCTION, tlog_es_json_writer_reply_func);
+    SETOPT(CURLOPT_WRITEDATA, es_json_writer);
+    SETOPT(CURLOPT_NOSIGNAL, 1L);
+    /* Don't let a stalled server hold the messages back forever */
+    SETOPT(CURLOPT_CONNECTTIMEOUT, (long)connect_timeout);
+    SETOPT(CURLOPT_TIMEOUT, (long)timeout);
+#if LIBCURL_VERSION_NUM >= 0x071900
+    SETOPT(CURLOPT_TCP_KEEPALIVE, 1L);
+#endif
+
+#undef SETOPT
+
+    /* Start the sending thread */
+    err = pthread_mutex_init(&es_json_writer->mutex, NULL);
+    if (err != 0) {
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    err = pthread_cond_init(&es_json_writer->cond, NULL);
+    if (err != 0) {
+        pthread_mutex_destroy(&es_json_writer->mutex);
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    es_json_writer->sync_init = true;
+
+    /* Start the thread with signals blocked, to leave them to the caller */
+    sigfillset(&all_set);
+    pthread_sigmask(SIG_SETMASK, &all_set, &orig_set);
+    err = pthread_create(&es_json_writer->thread, NULL,
+                         tlog_es_json_writer_thread, es_json_writer);
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+    if (err != 0) {
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    es_json_writer->thread_init = true;
+
+    return TLOG_RC_OK;
+
+error:
+    tlog_es_json_writer_cleanup(writer);
+    return grc;
+}
+
+static bool
+tlog_es_json_writer_is_valid(const struct tlog_json_writer *writer)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer*)writer;
+    return es_json_writer->curl != NULL &&
+           es_json_writer->headers != NULL &&
+           es_json_writer->tok != NULL &&
+           es_json_writer->batch_size >= TLOG_ES_JSON_WRITER_BATCH_SIZE_MIN &&
+           es_json_writer->gzip == es_json_writer->zstream_init &&
+           es_json_writer->thread_init &&
+           es_json_writer->fill.body_len <= es_json_writer->fill.body_size &&
+           es_json_writer->fill.item_num <= es_json_writer->fill.item_size &&
+           (es_json_writer->fill.item_num == 0) ==
+                (es_json_writer->fill.body_len == 0);
+}
+
+/**
+ * Hand the filled batch of a writer over to the sending thread, and request
+ * it to send, along with any items held for retrying.
+ *
+ * @param es_json_writer    The writer to hand the batch over for.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_es_json_writer_hand_over(struct tlog_es_json_writer *es_json_writer)
+{
+    tlog_grc grc;
+
+    pthread_mutex_lock(&es_json_writer->mutex);
+    grc = es_json_writer->fatal_grc;
+    if (grc == TLOG_RC_OK) {
+        grc = tlog_es_json_writer_batch_move(&es_json_writer->queue,
+                                             &es_json_writer->fill,
+                                             SIZE_MAX);
+    }
+    if (grc == TLOG_RC_OK) {
+        es_json_writer->pending = true;
+        pthread_cond_broadcast(&es_json_writer->cond);
+    }
+    pthread_mutex_unlock(&es_json_writer->mutex);
+    return grc;
+}
+
+static tlog_grc
+tlog_es_json_writer_write(struct tlog_json_writer *writer,
+                          const uint8_t *buf,
+                          size_t len)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer*)writer;
+    struct tlog_es_json_writer_batch *fill = &es_json_writer->fill;
+    const size_t action_len = sizeof(tlog_es_json_writer_action) - 1;
+    bool add_newline = (len == 0 || buf[len - 1] != '\n');
+    size_t item_len = action_len + len + add_newline;
+    char *p;
+    tlog_grc grc;
+
+    /* Add the message to the batch */
+    grc = tlog_es_json_writer_reserve(&fill->body_buf, &fill->body_size, 1,
+                                      fill->body_len + item_len);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    grc = tlog_es_json_writer_reserve(&fill->item_list, &fill->item_size,
+                                      sizeof(*fill->item_list),
+                                      fill->item_num + 1);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    if (fill->item_num == 0 &&
+        clock_gettime(CLOCK_MONOTONIC, &es_json_writer->fill_ts) != 0) {
+        return TLOG_GRC_ERRNO;
+    }
+    fill->item_list[fill->item_num++] = fill->body_len;
+    p = fill->body_buf + fill->body_len;
+    memcpy(p, tlog_es_json_writer_action, action_len);
+    p += action_len;
+    memcpy(p, buf, len);
+    p += len;
+    if (add_newline) {
+        *p = '\n';
+    }
+    fill->body_len += item_len;
+
+    /* Hand the batch over for sending, if it reached the size limit */
+    if (fill->body_len >= es_json_writer->batch_size) {
+        return tlog_es_json_writer_hand_over(es_json_writer);
+    }
+
+    /* Hand the batch over for sending, if it reached the age limit */
+    if (es_json_writer->batch_age > 0) {
+        struct timespec now;
+        struct timespec age;
+        if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+            return TLOG_GRC_ERRNO;
+        }
+        tlog_timespec_sub(&now, &es_json_writer->fill_ts, &age);
+        if (age.tv_sec >= (time_t)es_json_writer->batch_age) {
+            return tlog_es_json_writer_hand_over(es_json_writer);
+        }
+    }
+
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+tlog_es_json_writer_flush(struct tlog_json_writer *writer)
+{
+    return tlog_es_json_writer_hand_over(
+                            (struct tlog_es_json_writer*)writer);
+}
+
+tlog_grc
+tlog_es_json_writer_drain(struct tlog_json_writer *writer)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer*)writer;
+    tlog_grc grc;
+
+    assert(tlog_json_writer_is_valid(writer));
+    assert(writer->type == &tlog_es_json_writer_type);
+
+    pthread_mutex_lock(&es_json_writer->mutex);
+    while (es_json_writer->pending || es_json_writer->busy) {
+        pthread_cond_wait(&es_json_writer->cond, &es_json_writer->mutex);
+    }
+    grc = es_json_writer->fatal_grc != TLOG_RC_OK
+            ? es_json_writer->fatal_grc
+            : es_json_writer->sent_grc;
+    es_json_writer->sent_grc = TLOG_RC_OK;
+    pthread_mutex_unlock(&es_json_writer->mutex);
+
+    return grc;
+}
+
+static void
+tlog_es_json_writer_cleanup(struct tlog_json_writer *writer)
+{
+    struct tlog_es_json_writer *es_json_writer =
+                                (struct tlog_es_json_writer*)writer;
+
+    /*
+     * Hand the remaining messages over and let the sending thread make a
+     * last, single attempt to deliver them
+     */
+    if (es_json_writer->thread_init) {
+        pthread_mutex_lock(&es_json_writer->mutex);
+        if (es_json_writer->fatal_grc == TLOG_RC_OK) {
+            es_json_writer->fatal_grc = tlog_es_json_writer_batch_move(
+                                                &es_json_writer->queue,
+                                                &es_json_writer->fill,
+                                                SIZE_MAX);
+        }
+        es_json_writer->stop = true;
+        pthread_cond_broadcast(&es_json_writer->cond);
+        pthread_mutex_unlock(&es_json_writer->mutex);
+        pthread_join(es_json_writer->thread, NULL);
+        es_json_writer->thread_init = false;
+    }
+    if (es_json_writer->sync_init) {
+        pthread_cond_destroy(&es_json_writer->cond);
+        pthread_mutex_destroy(&es_json_writer->mutex);
+        es_json_writer->sync_init = false;
+    }
+
+    if (es_json_writer->curl != NULL) {
+        curl_easy_cleanup(es_json_writer->curl);
+        es_json_writer->curl = NULL;
+    }
+    if (es_json_writer->tok != NULL) {
+        json_tokener_free(es_json_writer->tok);
+        es_json_writer->tok = NULL;
+    }
+    if (es_json_writer->zstream_init) {
+        deflateEnd(&es_json_writer->zstream);
+        es_json_writer->zstream_init = false;
+    }
+    curl_slist_free_all(es_json_writer->headers);
+    es_json_writer->headers = NULL;
+    free(es_json_writer->reply_buf);
+    es_json_writer->reply_buf = NULL;
+    free(es_json_writer->gzip_buf);
+    es_json_writer->gzip_buf = NULL;
+    tlog_es_json_writer_batch_cleanup(&es_json_writer->send);
+    tlog_es_json_writer_batch_cleanup(&es_json_writer->queue);
+    tlog_es_json_writer_batch_cleanup(&es_json_writer->fill);
+}
+
+const struct tlog_json_writer_type tlog_es_json_writer_type = {
+    .size       = sizeof(struct tlog_es_json_writer),
+    .init       = tlog_es_json_writer_init,
+    .is_valid   = tlog_es_json_writer_is_valid,
+    .write      = tlog_es_json_writer_write,
+    .flush      = tlog_es_json_writer_flush,
+    .cleanup    = tlog_es_json_writer_cleanup,
+};
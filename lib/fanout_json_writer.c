@@ -0,0 +1,279 @@
+/*
+ * Fan-out JSON message writer.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <tlog/rc.h>
+#include <tlog/fanout_json_writer.h>
+
+/** Fan-out writer child state */
+struct tlog_fanout_json_writer_node {
+    struct tlog_fanout_json_writer_child    child;      /**< Description */
+    uint8_t                                *buf;        /**< Queue buffer,
+                                                             holding a length
+                                                             (size_t) before
+                                                             each message */
+    size_t                                  buf_size;   /**< Queue buffer
+                                                             size */
+    size_t                                  start;      /**< Offset of the
+                                                             first queued
+                                                             message */
+    size_t                                  end;        /**< Offset past the
+                                                             last queued
+                                                             message */
+};
+
+/** Fan-out writer data */
+struct tlog_fanout_json_writer {
+    struct tlog_json_writer                 writer;     /**< Abstract writer
+                                                             instance */
+    struct tlog_fanout_json_writer_node    *node_list;  /**< Children */
+    size_t                                  node_num;   /**< Number of
+                                                             children */
+};
+
+/** Size a message takes in a child queue */
+#define TLOG_FANOUT_JSON_WRITER_ITEM_SIZE(_len) (sizeof(size_t) + (_len))
+
+/**
+ * Drop the oldest message from a child queue.
+ *
+ * @param node  The child to drop the message of, must have one queued.
+ */
+static void
+tlog_fanout_json_writer_node_drop(struct tlog_fanout_json_writer_node *node)
+{
+    size_t len;
+    assert(node->start < node->end);
+    memcpy(&len, node->buf + node->start, sizeof(len));
+    node->start += TLOG_FANOUT_JSON_WRITER_ITEM_SIZE(len);
+    if (node->start == node->end) {
+        node->start = node->end = 0;
+    }
+}
+
+/**
+ * Write the queued messages of a child, in order, stopping at the first
+ * failure.
+ *
+ * @param node  The child to deliver the queue of.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_fanout_json_writer_node_drain(struct tlog_fanout_json_writer_node *node)
+{
+    size_t len;
+    tlog_grc grc;
+
+    while (node->start < node->end) {
+        memcpy(&len, node->buf + node->start, sizeof(len));
+        grc = tlog_json_writer_write(node->child.writer,
+                                     node->buf + node->start + sizeof(len),
+                                     len);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+        tlog_fanout_json_writer_node_drop(node);
+    }
+    return TLOG_RC_OK;
+}
+
+/**
+ * Put a message into a child queue, making room by dropping the oldest
+ * messages, if the child is best-effort.
+ *
+ * @param node  The child to queue the message for.
+ * @param buf   The message buffer.
+ * @param len   The message length.
+ *
+ * @return True if the message was queued, false if there was no room, or
+ *         no memory.
+ */
+static bool
+tlog_fanout_json_writer_node_queue(struct tlog_fanout_json_writer_node *node,
+                                   const uint8_t *buf, size_t len)
+{
+    size_t size = TLOG_FANOUT_JSON_WRITER_ITEM_SIZE(len);
+    size_t new_buf_size;
+    uint8_t *new_buf;
+
+    if (size > node->child.queue) {
+        return false;
+    }
+    while (node->end - node->start + size > node->child.queue) {
+        if (node->child.required) {
+            return false;
+        }
+        tlog_fanout_json_writer_node_drop(node);
+    }
+
+    /* Make room at the end */
+    if (node->end + size > node->buf_size) {
+        memmove(node->buf, node->buf + node->start, node->end - node->start);
+        node->end -= node->start;
+        node->start = 0;
+    }
+    if (node->end + size > node->buf_size) {
+        new_buf_size = node->buf_size == 0 ? 4096 : node->buf_size;
+        while (new_buf_size < node->end + size) {
+            new_buf_size *= 2;
+        }
+        if (new_buf_size > node->child.queue) {
+            new_buf_size = node->child.queue;
+        }
+        new_buf = realloc(node->buf, new_buf_size);
+        if (new_buf == NULL) {
+            return false;
+        }
+        node->buf = new_buf;
+        node->buf_size = new_buf_size;
+    }
+
+    memcpy(node->buf + node->end, &len, sizeof(len));
+    memcpy(node->buf + node->end + sizeof(len), buf, len);
+    node->end += size;
+    return true;
+}
+
+static tlog_grc
+tlog_fanout_json_writer_write(struct tlog_json_writer *writer,
+                              const uint8_t *buf,
+                              size_t len)
+{
+    struct tlog_fanout_json_writer *fanout_json_writer =
+                                (struct tlog_fanout_json_writer*)writer;
+    struct tlog_fanout_json_writer_node *node;
+    tlog_grc result = TLOG_RC_OK;
+    tlog_grc grc;
+    size_t i;
+
+    for (i = 0; i < fanout_json_writer->node_num; i++) {
+        node = &fanout_json_writer->node_list[i];
+        grc = tlog_fanout_json_writer_node_drain(node);
+        if (grc == TLOG_RC_OK) {
+            grc = tlog_json_writer_write(node->child.writer, buf, len);
+        }
+        /* Keep the message for retrying, if the child fails */
+        if (grc != TLOG_RC_OK &&
+            !tlog_fanout_json_writer_node_queue(node, buf, len) &&
+            node->child.required && result == TLOG_RC_OK) {
+            result = grc;
+        }
+    }
+
+    return result;
+}
+
+static tlog_grc
+tlog_fanout_json_writer_flush(struct tlog_json_writer *writer)
+{
+    struct tlog_fanout_json_writer *fanout_json_writer =
+                                (struct tlog_fanout_json_writer*)writer;
+    struct tlog_fanout_json_writer_node *node;
+    tlog_grc result = TLOG_RC_OK;
+    tlog_grc grc;
+    size_t i;
+
+    for (i = 0; i < fanout_json_writer->node_num; i++) {
+        node = &fanout_json_writer->node_list[i];
+        grc = tlog_fanout_json_writer_node_drain(node);
+        if (grc == TLOG_RC_OK) {
+            grc = tlog_json_writer_flush(node->child.writer);
+        }
+        if (grc != TLOG_RC_OK && node->child.required &&
+            result == TLOG_RC_OK) {
+            result = grc;
+        }
+    }
+
+    return result;
+}
+
+static void
+tlog_fanout_json_writer_cleanup(struct tlog_json_writer *writer)
+{
+    struct tlog_fanout_json_writer *fanout_json_writer =
+                                (struct tlog_fanout_json_writer*)writer;
+    struct tlog_fanout_json_writer_node *node;
+    size_t i;
+
+    if (fanout_json_writer->node_list == NULL) {
+        return;
+    }
+
+    /* Deliver what we can */
+    tlog_fanout_json_writer_flush(writer);
+
+    for (i = 0; i < fanout_json_writer->node_num; i++) {
+        node = &fanout_json_writer->node_list[i];
+        if (node->child.owned) {
+            tlog_json_writer_destroy(node->child.writer);
+        }
+        free(node->buf);
+    }
+    free(fanout_json_writer->node_list);
+    fanout_json_writer->node_list = NULL;
+    fanout_json_writer->node_num = 0;
+}
+
+static tlog_grc
+tlog_fanout_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    struct tlog_fanout_json_writer *fanout_json_writer =
+                                (struct tlog_fanout_json_writer*)writer;
+    const struct tlog_fanout_json_writer_child *child_list =
+                    va_arg(ap, const struct tlog_fanout_json_writer_child *);
+    size_t child_num = va_arg(ap, size_t);
+    size_t i;
+
+    fanout_json_writer->node_list =
+        calloc(child_num == 0 ? 1 : child_num,
+               sizeof(*fanout_json_writer->node_list));
+    if (fanout_json_writer->node_list == NULL) {
+        return TLOG_GRC_ERRNO;
+    }
+    for (i = 0; i < child_num; i++) {
+        assert(tlog_json_writer_is_valid(child_list[i].writer));
+        fanout_json_writer->node_list[i].child = child_list[i];
+    }
+    fanout_json_writer->node_num = child_num;
+
+    return TLOG_RC_OK;
+}
+
+static bool
+tlog_fanout_json_writer_is_valid(const struct tlog_json_writer *writer)
+{
+    struct tlog_fanout_json_writer *fanout_json_writer =
+                                (struct tlog_fanout_json_writer*)writer;
+    return fanout_json_writer->node_list != NULL;
+}
+
+const struct tlog_json_writer_type tlog_fanout_json_writer_type = {
+    .size       = sizeof(struct tlog_fanout_json_writer),
+    .init       = tlog_fanout_json_writer_init,
+    .is_valid   = tlog_fanout_json_writer_is_valid,
+    .write      = tlog_fanout_json_writer_write,
+    .flush      = tlog_fanout_json_writer_flush,
+    .cleanup    = tlog_fanout_json_writer_cleanup,
+};
@@ -0,0 +1,970 @@
+/*
+ * Log file index.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <json_tokener.h>
+#include <tlog/index.h>
+#include <tlog/json_msg.h>
+#include <tlog/misc.h>
+#include <tlog/rc.h>
+
+/** String record type */
+#define TLOG_INDEX_REC_STR  'S'
+
+/** Run record type */
+#define TLOG_INDEX_REC_RUN  'R'
+
+/** Run record length */
+#define TLOG_INDEX_REC_RUN_LEN  (1 + 8 * 4 + 4 * 3 + 8 * 6)
+
+/** Size of a log file chunk read for an update at once, bytes */
+#define TLOG_INDEX_LOG_CHUNK_SIZE   (1024 * 1024)
+
+/** Output buffer for encoding records */
+struct tlog_index_out {
+    uint8_t    *ptr;    /**< Buffer */
+    size_t      len;    /**< Data length */
+    size_t      size;   /**< Buffer size */
+};
+
+/**
+ * Reserve space in an output buffer.
+ *
+ * @param out   The buffer to reserve space in.
+ * @param len   The length to reserve.
+ *
+ * @return Pointer to the reserved space, or NULL if failed to allocate.
+ */
+static uint8_t *
+tlog_index_out_reserve(struct tlog_index_out *out, size_t len)
+{
+    size_t size;
+    uint8_t *ptr;
+
+    if (out->len + len > out->size) {
+        size = out->size == 0 ? 4096 : out->size;
+        while (size < out->len + len) {
+            size *= 2;
+        }
+        ptr = realloc(out->ptr, size);
+        if (ptr == NULL) {
+            return NULL;
+        }
+        out->ptr = ptr;
+        out->size = size;
+    }
+    ptr = out->ptr + out->len;
+    out->len += len;
+    return ptr;
+}
+
+/**
+ * Encode a little-endian number.
+ *
+ * @param ptr   The location to encode at.
+ * @param val   The number to encode.
+ * @param len   The number of bytes to encode.
+ *
+ * @return Pointer past the encoded number.
+ */
+static uint8_t *
+tlog_index_put(uint8_t *ptr, uint64_t val, size_t len)
+{
+    for (; len > 0; len--, val >>= 8) {
+        *ptr++ = (uint8_t)val;
+    }
+    return ptr;
+}
+
+/**
+ * Decode a little-endian number.
+ *
+ * @param pptr  Location of the pointer to decode at, advanced past the
+ *              number.
+ * @param len   The number of bytes to decode.
+ *
+ * @return The decoded number.
+ */
+static uint64_t
+tlog_index_get(const uint8_t **pptr, size_t len)
+{
+    uint64_t val = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        val |= (uint64_t)(*pptr)[i] << (i * 8);
+    }
+    *pptr += len;
+    return val;
+}
+
+/**
+ * Encode a run record.
+ *
+ * @param ptr   The location to encode at, TLOG_INDEX_REC_RUN_LEN bytes.
+ * @param run   The run to encode.
+ */
+static void
+tlog_index_run_encode(uint8_t *ptr, const struct tlog_index_run *run)
+{
+    *ptr++ = TLOG_INDEX_REC_RUN;
+    ptr = tlog_index_put(ptr, run->start, 8);
+    ptr = tlog_index_put(ptr, run->end, 8);
+    ptr = tlog_index_put(ptr, run->line, 8);
+    ptr = tlog_index_put(ptr, run->lines, 8);
+    ptr = tlog_index_put(ptr, run->host, 4);
+    ptr = tlog_index_put(ptr, run->user, 4);
+    ptr = tlog_index_put(ptr, run->session, 4);
+    ptr = tlog_index_put(ptr, run->num, 8);
+    ptr = tlog_index_put(ptr, run->first_id, 8);
+    ptr = tlog_index_put(ptr, run->last_id, 8);
+    ptr = tlog_index_put(ptr, run->first_pos, 8);
+    ptr = tlog_index_put(ptr, run->last_pos, 8);
+    tlog_index_put(ptr, run->end_pos, 8);
+}
+
+/**
+ * Decode a run record, without the type.
+ *
+ * @param ptr   The location to decode at.
+ * @param run   The run to decode into.
+ */
+static void
+tlog_index_run_decode(const uint8_t *ptr, struct tlog_index_run *run)
+{
+    run->start = (size_t)tlog_index_get(&ptr, 8);
+    run->end = (size_t)tlog_index_get(&ptr, 8);
+    run->line = (size_t)tlog_index_get(&ptr, 8);
+    run->lines = (size_t)tlog_index_get(&ptr, 8);
+    run->host = (size_t)tlog_index_get(&ptr, 4);
+    run->user = (size_t)tlog_index_get(&ptr, 4);
+    run->session = (unsigned int)tlog_index_get(&ptr, 4);
+    run->num = (size_t)tlog_index_get(&ptr, 8);
+    run->first_id = (size_t)tlog_index_get(&ptr, 8);
+    run->last_id = (size_t)tlog_index_get(&ptr, 8);
+    run->first_pos = tlog_index_get(&ptr, 8);
+    run->last_pos = tlog_index_get(&ptr, 8);
+    run->end_pos = tlog_index_get(&ptr, 8);
+}
+
+/**
+ * Hash a string with FNV-1a.
+ *
+ * @param str   The string to hash.
+ * @param len   The string length.
+ *
+ * @return The string hash.
+ */
+static size_t
+tlog_index_str_hash(const char *str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    for (; len > 0; len--, str++) {
+        hash = (hash ^ (uint8_t)*str) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Double the size of the string hash table of an index, rehashing the
+ * strings.
+ *
+ * @param index The index to grow the string hash table of.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_str_hash_grow(struct tlog_index *index)
+{
+    size_t size;
+    size_t *hash;
+    size_t i;
+    size_t j;
+
+    size = index->str_hash_size == 0 ? 64 : index->str_hash_size * 2;
+    hash = calloc(size, sizeof(*hash));
+    if (hash == NULL) {
+        return TLOG_GRC_ERRNO;
+    }
+    for (i = 0; i < index->str_num; i++) {
+        for (j = tlog_index_str_hash(index->str_list[i],
+                                     strlen(index->str_list[i])) &
+                 (size - 1);
+             hash[j] != 0;
+             j = (j + 1) & (size - 1));
+        hash[j] = i + 1;
+    }
+    free(index->str_hash);
+    index->str_hash = hash;
+    index->str_hash_size = size;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Add a string to an index, if not there yet.
+ *
+ * @param index The index to add the string to.
+ * @param str   The string to add.
+ * @param len   The string length.
+ * @param pidx  Location for the index of the string.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_str_add(struct tlog_index *index,
+                   const char *str, size_t len, size_t *pidx)
+{
+    tlog_grc grc;
+    size_t i;
+    size_t slot;
+    size_t size;
+    char **str_list;
+    char *copy;
+
+    /* Keep the hash table at most half full */
+    if ((index->str_num + 1) * 2 > index->str_hash_size) {
+        grc = tlog_index_str_hash_grow(index);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+    }
+
+    /* Look the string up, stopping at the free slot to take otherwise */
+    for (i = tlog_index_str_hash(str, len) & (index->str_hash_size - 1);
+         (slot = index->str_hash[i]) != 0;
+         i = (i + 1) & (index->str_hash_size - 1)) {
+        if (strncmp(index->str_list[slot - 1], str, len) == 0 &&
+            index->str_list[slot - 1][len] == '\0') {
+            *pidx = slot - 1;
+            return TLOG_RC_OK;
+        }
+    }
+
+    if (index->str_num >= index->str_size) {
+        size = index->str_size == 0 ? 16 : index->str_size * 2;
+        str_list = realloc(index->str_list, size * sizeof(*str_list));
+        if (str_list == NULL) {
+            return TLOG_GRC_ERRNO;
+        }
+        index->str_list = str_list;
+        index->str_size = size;
+    }
+    copy = strndup(str, len);
+    if (copy == NULL) {
+        return TLOG_GRC_ERRNO;
+    }
+    *pidx = index->str_num;
+    index->str_list[index->str_num++] = copy;
+    index->str_hash[i] = index->str_num;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Add a run to an index.
+ *
+ * @param index The index to add the run to.
+ * @param run   The run to add.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_run_add(struct tlog_index *index,
+                   const struct tlog_index_run *run)
+{
+    size_t size;
+    struct tlog_index_run *run_list;
+
+    if (index->run_num >= index->run_size) {
+        size = index->run_size == 0 ? 256 : index->run_size * 2;
+        run_list = realloc(index->run_list, size * sizeof(*run_list));
+        if (run_list == NULL) {
+            return TLOG_GRC_ERRNO;
+        }
+        index->run_list = run_list;
+        index->run_size = size;
+    }
+    index->run_list[index->run_num++] = *run;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Lock or unlock an index file with flock(2), waiting for the lock, and
+ * retrying if interrupted.
+ *
+ * @param fd    File descriptor of the index file.
+ * @param op    The flock(2) operation: LOCK_SH, LOCK_EX, or LOCK_UN.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_lock(int fd, int op)
+{
+    while (flock(fd, op) < 0) {
+        if (errno != EINTR) {
+            return TLOG_GRC_ERRNO;
+        }
+    }
+    return TLOG_RC_OK;
+}
+
+/**
+ * Empty an index, keeping the allocated lists.
+ *
+ * @param index The index to empty.
+ */
+static void
+tlog_index_clear(struct tlog_index *index)
+{
+    size_t i;
+
+    for (i = 0; i < index->str_num; i++) {
+        free(index->str_list[i]);
+    }
+    index->str_num = 0;
+    if (index->str_hash != NULL) {
+        memset(index->str_hash, 0,
+               index->str_hash_size * sizeof(*index->str_hash));
+    }
+    index->run_num = 0;
+    index->len = 0;
+    index->last_off = 0;
+    index->str_saved = 0;
+    index->run_saved = 0;
+}
+
+/**
+ * Load an index file into an empty index, with the file locked.
+ *
+ * @param index The index to load into.
+ * @param fd    File descriptor of the index file.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_load(struct tlog_index *index, int fd)
+{
+    tlog_grc grc;
+    struct stat st;
+    uint8_t *buf = NULL;
+    const uint8_t *p;
+    const uint8_t *end;
+    size_t len;
+    size_t idx;
+    ssize_t rc;
+    struct tlog_index_run run;
+
+    if (fstat(fd, &st) < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+    if (st.st_size == 0) {
+        return TLOG_RC_OK;
+    }
+
+    /* Read the whole file */
+    buf = malloc((size_t)st.st_size);
+    if (buf == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto cleanup;
+    }
+    for (len = 0; len < (size_t)st.st_size; len += (size_t)rc) {
+        rc = pread(fd, buf + len, (size_t)st.st_size - len, (off_t)len);
+        if (rc < 0) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        } else if (rc == 0) {
+            break;
+        }
+    }
+
+    if (len < TLOG_INDEX_MAGIC_LEN ||
+        memcmp(buf, TLOG_INDEX_MAGIC, TLOG_INDEX_MAGIC_LEN) != 0) {
+        grc = TLOG_RC_INDEX_INVALID;
+        goto cleanup;
+    }
+
+    /* Decode the records, up to an incomplete one */
+    p = buf + TLOG_INDEX_MAGIC_LEN;
+    end = buf + len;
+    index->len = TLOG_INDEX_MAGIC_LEN;
+    while (p < end) {
+        if (*p == TLOG_INDEX_REC_STR) {
+            if (end - p < 5) {
+                break;
+            }
+            p++;
+            len = (size_t)tlog_index_get(&p, 4);
+            if ((size_t)(end - p) < len) {
+                break;
+            }
+            grc = tlog_index_str_add(index, (const char *)p, len, &idx);
+            if (grc != TLOG_RC_OK) {
+                goto cleanup;
+            }
+            p += len;
+        } else if (*p == TLOG_INDEX_REC_RUN) {
+            if (end - p < TLOG_INDEX_REC_RUN_LEN) {
+                break;
+            }
+            tlog_index_run_decode(p + 1, &run);
+            if (run.host >= index->str_num || run.user >= index->str_num ||
+                run.start >= run.end ||
+                (index->run_num > 0 &&
+                 run.start < index->run_list[index->run_num - 1].end)) {
+                grc = TLOG_RC_INDEX_INVALID;
+                goto cleanup;
+            }
+            grc = tlog_index_run_add(index, &run);
+            if (grc != TLOG_RC_OK) {
+                goto cleanup;
+            }
+            index->last_off = p - buf;
+            p += TLOG_INDEX_REC_RUN_LEN;
+        } else {
+            grc = TLOG_RC_INDEX_INVALID;
+            goto cleanup;
+        }
+        index->len = p - buf;
+    }
+
+    index->str_saved = index->str_num;
+    index->run_saved = index->run_num;
+    grc = TLOG_RC_OK;
+
+cleanup:
+    free(buf);
+    return grc;
+}
+
+tlog_grc
+tlog_index_create(struct tlog_index **pindex, int fd)
+{
+    tlog_grc grc;
+    struct tlog_index *index;
+
+    assert(pindex != NULL);
+
+    index = calloc(1, sizeof(*index));
+    if (index == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    if (fd >= 0) {
+        /* Wait for an update in progress to complete */
+        grc = tlog_index_lock(fd, LOCK_SH);
+        if (grc != TLOG_RC_OK) {
+            goto error;
+        }
+        grc = tlog_index_load(index, fd);
+        tlog_index_lock(fd, LOCK_UN);
+        if (grc != TLOG_RC_OK) {
+            goto error;
+        }
+    }
+
+    assert(tlog_index_is_valid(index));
+    *pindex = index;
+    return TLOG_RC_OK;
+
+error:
+    tlog_index_destroy(index);
+    *pindex = NULL;
+    return grc;
+}
+
+bool
+tlog_index_is_valid(const struct tlog_index *index)
+{
+    return index != NULL &&
+           index->str_num <= index->str_size &&
+           index->str_num * 2 <= index->str_hash_size &&
+           index->run_num <= index->run_size &&
+           index->str_saved <= index->str_num &&
+           index->run_saved <= index->run_num;
+}
+
+size_t
+tlog_index_get_end(const struct tlog_index *index, size_t *pline)
+{
+    const struct tlog_index_run *run;
+
+    assert(tlog_index_is_valid(index));
+    assert(pline != NULL);
+
+    if (index->run_num == 0) {
+        *pline = 1;
+        return 0;
+    }
+    run = &index->run_list[index->run_num - 1];
+    *pline = run->line + run->lines;
+    return run->end;
+}
+
+/**
+ * Check if an index file was changed by another update since the index was
+ * loaded or saved: if it has a different length, or if its last saved run
+ * record was rewritten.
+ *
+ * @param index     The index to check.
+ * @param fd        File descriptor of the index file, locked.
+ * @param pstale    Location for the "stale" flag, true if the file was
+ *                  changed.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_is_stale(const struct tlog_index *index, int fd, bool *pstale)
+{
+    struct stat st;
+    uint8_t exp[TLOG_INDEX_REC_RUN_LEN];
+    uint8_t buf[TLOG_INDEX_REC_RUN_LEN];
+    ssize_t rc;
+
+    if (fstat(fd, &st) < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+    if ((size_t)st.st_size != index->len) {
+        *pstale = true;
+        return TLOG_RC_OK;
+    }
+    if (index->run_saved == 0) {
+        *pstale = false;
+        return TLOG_RC_OK;
+    }
+    tlog_index_run_encode(exp, &index->run_list[index->run_saved - 1]);
+    rc = pread(fd, buf, sizeof(buf), (off_t)index->last_off);
+    if (rc < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+    *pstale = (size_t)rc != sizeof(buf) || memcmp(buf, exp, sizeof(buf)) != 0;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Save the changes to an index into its file, with the file locked
+ * exclusively.
+ *
+ * @param index The index to save.
+ * @param fd    File descriptor of the index file.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_save(struct tlog_index *index, int fd)
+{
+    tlog_grc grc;
+    struct tlog_index_out out = {NULL, 0, 0};
+    uint8_t *ptr;
+    size_t len;
+    size_t last_off = index->last_off;
+    size_t run_saved = index->run_saved;
+    size_t i;
+    ssize_t rc;
+
+    /* Rewrite the last saved run in place, as it could have continued */
+    if (run_saved > 0) {
+        ptr = tlog_index_out_reserve(&out, TLOG_INDEX_REC_RUN_LEN);
+        if (ptr == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        }
+        tlog_index_run_encode(ptr, &index->run_list[run_saved - 1]);
+        rc = pwrite(fd, out.ptr, out.len, (off_t)last_off);
+        if (rc < 0) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        } else if ((size_t)rc != out.len) {
+            grc = TLOG_GRC_FROM(errno, EIO);
+            goto cleanup;
+        }
+        out.len = 0;
+    }
+
+    /* Append the new strings before the new runs referring to them */
+    if (index->len == 0) {
+        ptr = tlog_index_out_reserve(&out, TLOG_INDEX_MAGIC_LEN);
+        if (ptr == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        }
+        memcpy(ptr, TLOG_INDEX_MAGIC, TLOG_INDEX_MAGIC_LEN);
+    }
+    for (i = index->str_saved; i < index->str_num; i++) {
+        len = strlen(index->str_list[i]);
+        ptr = tlog_index_out_reserve(&out, 5 + len);
+        if (ptr == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        }
+        *ptr++ = TLOG_INDEX_REC_STR;
+        ptr = tlog_index_put(ptr, len, 4);
+        memcpy(ptr, index->str_list[i], len);
+    }
+    for (i = run_saved; i < index->run_num; i++) {
+        last_off = index->len + out.len;
+        ptr = tlog_index_out_reserve(&out, TLOG_INDEX_REC_RUN_LEN);
+        if (ptr == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        }
+        tlog_index_run_encode(ptr, &index->run_list[i]);
+    }
+
+    for (len = 0; len < out.len; len += (size_t)rc) {
+        rc = pwrite(fd, out.ptr + len, out.len - len,
+                    (off_t)(index->len + len));
+        if (rc < 0) {
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        } else if (rc == 0) {
+            grc = TLOG_GRC_FROM(errno, EIO);
+            goto cleanup;
+        }
+    }
+    /* Drop an incomplete record left after the data */
+    if (ftruncate(fd, (off_t)(index->len + out.len)) < 0) {
+        grc = TLOG_GRC_ERRNO;
+        goto cleanup;
+    }
+
+    index->len += out.len;
+    index->last_off = last_off;
+    index->str_saved = index->str_num;
+    index->run_saved = index->run_num;
+    grc = TLOG_RC_OK;
+
+cleanup:
+    free(out.ptr);
+    return grc;
+}
+
+/**
+ * Index the complete lines of a part of a log file following the indexed
+ * part, and save the changes to the index file, the same as
+ * tlog_index_update does for the whole file.
+ *
+ * @param index The index to update.
+ * @param fd    File descriptor of the index file to save the changes to,
+ *              the one the index was loaded from, or -1 to not save.
+ * @param text  The log file text part.
+ * @param off   Offset of the text part in the log file.
+ * @param len   Offset of the text part end in the log file.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_index_update_part(struct tlog_index *index, int fd,
+                       const char *text, size_t off, size_t len)
+{
+    tlog_grc grc;
+    struct json_tokener *tok = NULL;
+    struct json_object *obj;
+    struct tlog_json_msg msg = {NULL, };
+    struct tlog_json_msg_buf buf = {NULL, 0};
+    struct tlog_index_run run;
+    struct tlog_index_run *last;
+    bool locked = false;
+    bool stale = false;
+    size_t line;
+    size_t pos;
+    const char *p;
+    const char *end;
+    const char *next;
+    size_t host;
+    size_t user;
+    uint64_t msg_pos;
+    uint64_t msg_end_pos;
+
+    assert(tlog_index_is_valid(index));
+    assert(off <= len);
+    assert(text != NULL || len == off);
+
+    tok = json_tokener_new();
+    if (tok == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto cleanup;
+    }
+
+    /*
+     * Lock out other updates and loads, and reload the index, if it was
+     * changed by another update since it was loaded or saved
+     */
+    if (fd >= 0) {
+        grc = tlog_index_lock(fd, LOCK_EX);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        locked = true;
+        grc = tlog_index_is_stale(index, fd, &stale);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        if (stale) {
+            tlog_index_clear(index);
+            grc = tlog_index_load(index, fd);
+            if (grc != TLOG_RC_OK) {
+                goto cleanup;
+            }
+        }
+    }
+
+    pos = tlog_index_get_end(index, &line);
+    if (pos > len) {
+        /* Another update could have indexed a longer part of the log */
+        grc = stale ? TLOG_RC_OK : TLOG_RC_INDEX_INVALID;
+        goto cleanup;
+    }
+    if (pos < off) {
+        /* Another update indexed less, leave the rest to the next one */
+        grc = TLOG_RC_OK;
+        goto cleanup;
+    }
+
+    /* For each complete line */
+    for (p = text + (pos - off);
+         (end = memchr(p, '\n', text + (len - off) - p)) != NULL;
+         p = next, line++) {
+        next = end + 1;
+
+        /* Parse the message, skipping invalid lines */
+        grc = tlog_json_msg_parse(&msg, &buf, p, end - p);
+        if (grc == TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED) {
+            if (end - p > INT_MAX) {
+                continue;
+            }
+            json_tokener_reset(tok);
+            obj = json_tokener_parse_ex(tok, p, (int)(end - p));
+            if (obj == NULL) {
+                continue;
+            }
+            grc = tlog_json_msg_init(&msg, obj);
+            json_object_put(obj);
+        }
+        if (grc != TLOG_RC_OK) {
+            tlog_json_msg_cleanup(&msg);
+            continue;
+        }
+
+        grc = tlog_index_str_add(index, msg.host, strlen(msg.host), &host);
+        if (grc == TLOG_RC_OK) {
+            grc = tlog_index_str_add(index, msg.user, strlen(msg.user),
+                                     &user);
+        }
+        if (grc != TLOG_RC_OK) {
+            tlog_json_msg_cleanup(&msg);
+            goto cleanup;
+        }
+        msg_pos = (uint64_t)msg.pos.tv_sec * 1000 +
+                  (uint64_t)msg.pos.tv_nsec / 1000000;
+        msg_end_pos = msg_pos +
+                      tlog_json_msg_timing_get_span(msg.timing_ptr);
+
+        /* Continue the last run, or start a new one */
+        last = index->run_num > 0 ? &index->run_list[index->run_num - 1]
+                                  : NULL;
+        if (last != NULL && last->host == host && last->user == user &&
+            last->session == msg.session) {
+            last->end = off + (next - text);
+            last->lines = line + 1 - last->line;
+            last->num++;
+            last->last_id = msg.id;
+            last->last_pos = msg_pos;
+            if (msg_end_pos > last->end_pos) {
+                last->end_pos = msg_end_pos;
+            }
+        } else {
+            run.start = off + (p - text);
+            run.end = off + (next - text);
+            run.line = line;
+            run.lines = 1;
+            run.host = host;
+            run.user = user;
+            run.session = msg.session;
+            run.num = 1;
+            run.first_id = msg.id;
+            run.last_id = msg.id;
+            run.first_pos = msg_pos;
+            run.last_pos = msg_pos;
+            run.end_pos = msg_end_pos;
+            grc = tlog_index_run_add(index, &run);
+            if (grc != TLOG_RC_OK) {
+                tlog_json_msg_cleanup(&msg);
+                goto cleanup;
+            }
+        }
+        tlog_json_msg_cleanup(&msg);
+    }
+
+    if (fd >= 0) {
+        grc = tlog_index_save(index, fd);
+    } else {
+        grc = TLOG_RC_OK;
+    }
+
+cleanup:
+    if (locked) {
+        tlog_index_lock(fd, LOCK_UN);
+    }
+    tlog_json_msg_buf_cleanup(&buf);
+    if (tok != NULL) {
+        json_tokener_free(tok);
+    }
+    return grc;
+}
+
+tlog_grc
+tlog_index_update(struct tlog_index *index, int fd,
+                  const char *text, size_t len)
+{
+    return tlog_index_update_part(index, fd, text, 0, len);
+}
+
+tlog_grc
+tlog_index_update_log(struct tlog_index *index, int fd, int log_fd)
+{
+    tlog_grc grc;
+    struct stat st;
+    char *buf = NULL;
+    char *new_buf;
+    size_t size = 0;
+    size_t len = 0;
+    size_t off;
+    size_t line;
+    size_t done;
+    const char *nl;
+    ssize_t rc;
+
+    assert(tlog_index_is_valid(index));
+    assert(log_fd >= 0);
+
+    if (fstat(log_fd, &st) < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+
+    off = tlog_index_get_end(index, &line);
+    if ((size_t)st.st_size < off) {
+        return TLOG_RC_INDEX_LOG_TRUNCATED;
+    }
+
+    /*
+     * Read the rest of the log in chunks, instead of mapping it, so it
+     * being truncated meanwhile can't raise SIGBUS, and index the complete
+     * lines of each, keeping the incomplete last one for the next
+     */
+    while (off + len < (size_t)st.st_size) {
+        if (len == size) {
+            size = size == 0 ? TLOG_INDEX_LOG_CHUNK_SIZE : size * 2;
+            new_buf = realloc(buf, size);
+            if (new_buf == NULL) {
+                grc = TLOG_GRC_ERRNO;
+                goto cleanup;
+            }
+            buf = new_buf;
+        }
+        rc = pread(log_fd, buf + len,
+                   TLOG_MIN(size - len, (size_t)st.st_size - off - len),
+                   (off_t)(off + len));
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            grc = TLOG_GRC_ERRNO;
+            goto cleanup;
+        } else if (rc == 0) {
+            /* Truncated meanwhile, the next update will tell */
+            break;
+        }
+        nl = memrchr(buf + len, '\n', (size_t)rc);
+        len += (size_t)rc;
+        if (nl == NULL) {
+            continue;
+        }
+        done = nl + 1 - buf;
+        grc = tlog_index_update_part(index, fd, buf, off, off + done);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        memmove(buf, buf + done, len - done);
+        len -= done;
+        off += done;
+    }
+    grc = TLOG_RC_OK;
+
+cleanup:
+    free(buf);
+    return grc;
+}
+
+const struct tlog_index_run *
+tlog_index_find(const struct tlog_index *index, size_t offset,
+                const char *host, unsigned int session, uint64_t pos)
+{
+    const struct tlog_index_run *run;
+    const struct tlog_index_run *end;
+    size_t lo = 0;
+    size_t hi;
+    size_t mid;
+
+    assert(tlog_index_is_valid(index));
+
+    /* Find the first run ending after the offset */
+    hi = index->run_num;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (index->run_list[mid].end <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /* Find the first matching run from there */
+    end = index->run_list + index->run_num;
+    for (run = index->run_list + lo; run < end; run++) {
+        if (run->session == session && run->end_pos >= pos &&
+            (host == NULL || strcmp(index->str_list[run->host], host) == 0)) {
+            return run;
+        }
+    }
+    return NULL;
+}
+
+void
+tlog_index_destroy(struct tlog_index *index)
+{
+    if (index == NULL) {
+        return;
+    }
+    tlog_index_clear(index);
+    free(index->str_list);
+    free(index->str_hash);
+    free(index->run_list);
+    free(index);
+}
@@ -20,6 +20,7 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <config.h>
 #include <assert.h>
 #include <string.h>
 #include <limits.h>
@@ -37,20 +38,22 @@ tlog_json_msg_is_valid(const struct tlog_json_msg *msg)
         return false;
     }
 
-    if (msg->obj == NULL) {
+    if (msg->obj == NULL && msg->buf == NULL) {
         return true;
     }
 
-    return msg->host != NULL &&
+    return (msg->obj == NULL || msg->buf == NULL) &&
+           msg->host != NULL &&
            msg->user != NULL &&
            msg->term != NULL &&
            msg->session > 0 &&
            msg->timing_ptr != NULL &&
            msg->in_txt_ptr != NULL &&
-           msg->in_bin_obj != NULL &&
+           (msg->in_bin_ptr != NULL || msg->in_bin_len == 0) &&
            msg->in_bin_pos >= 0 &&
            msg->out_txt_ptr != NULL &&
-           msg->out_bin_obj != NULL &&
+           (msg->out_bin_ptr != NULL || msg->out_bin_len == 0) &&
+           (msg->bin_buf == NULL || msg->obj != NULL) &&
            msg->out_bin_pos >= 0;
 }
 
@@ -58,13 +61,50 @@ bool
 tlog_json_msg_is_void(const struct tlog_json_msg *msg)
 {
     assert(tlog_json_msg_is_valid(msg));
-    return msg->obj == NULL;
+    return msg->obj == NULL && msg->buf == NULL;
+}
+
+/**
+ * Decode a binary array object into bytes, up to the first element which
+ * is not a valid byte.
+ *
+ * @param buf   The buffer to decode into, must be big enough to hold all
+ *              the array elements.
+ * @param array The array object to decode.
+ *
+ * @return Number of bytes decoded.
+ */
+static size_t
+tlog_json_msg_bin_decode(uint8_t *buf, struct json_object *array)
+{
+    size_t i;
+    size_t n = (size_t)json_object_array_length(array);
+    struct json_object *o;
+    int32_t v;
+
+    for (i = 0; i < n; i++) {
+        o = json_object_array_get_idx(array, i);
+        if (json_object_get_type(o) != json_type_int) {
+            break;
+        }
+        v = json_object_get_int(o);
+        if (v < 0 || v > UINT8_MAX) {
+            break;
+        }
+        buf[i] = (uint8_t)v;
+    }
+
+    return i;
 }
 
 tlog_grc
 tlog_json_msg_init(struct tlog_json_msg *msg, struct json_object *obj)
 {
     struct json_object *o;
+    struct json_object *in_bin;
+    struct json_object *out_bin;
+    size_t in_bin_num;
+    size_t out_bin_num;
     int64_t ver;
     int64_t session;
     int64_t id;
@@ -76,7 +116,7 @@ tlog_json_msg_init(struct tlog_json_msg *msg, struct json_object *obj)
 
     if (obj == NULL) {
         assert(tlog_json_msg_is_valid(msg));
-        return true;
+        return TLOG_RC_OK;
     }
 
 #define GET_FIELD(_name_token, _type_token) \
@@ -139,7 +179,7 @@ tlog_json_msg_init(struct tlog_json_msg *msg, struct json_object *obj)
     msg->in_txt_len = (size_t)json_object_get_string_len(o);
 
     GET_FIELD(in_bin, array);
-    msg->in_bin_obj = o;
+    in_bin = o;
     msg->in_bin_pos = 0;
 
     GET_FIELD(out_txt, string);
@@ -147,15 +187,623 @@ tlog_json_msg_init(struct tlog_json_msg *msg, struct json_object *obj)
     msg->out_txt_len = (size_t)json_object_get_string_len(o);
 
     GET_FIELD(out_bin, array);
-    msg->out_bin_obj = o;
+    out_bin = o;
     msg->out_bin_pos = 0;
 #undef GET_FIELD
 
+    /* Decode binary arrays once, leaving invalid bytes to reading */
+    in_bin_num = (size_t)json_object_array_length(in_bin);
+    out_bin_num = (size_t)json_object_array_length(out_bin);
+    if (in_bin_num > INT_MAX || out_bin_num > INT_MAX) {
+        return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN;
+    }
+    if (in_bin_num + out_bin_num > 0) {
+        msg->bin_buf = malloc(in_bin_num + out_bin_num);
+        if (msg->bin_buf == NULL) {
+            return TLOG_GRC_ERRNO;
+        }
+        msg->in_bin_ptr = msg->bin_buf;
+        msg->in_bin_len = tlog_json_msg_bin_decode(msg->bin_buf, in_bin);
+        msg->out_bin_ptr = msg->bin_buf + in_bin_num;
+        msg->out_bin_len = tlog_json_msg_bin_decode(msg->bin_buf +
+                                                    in_bin_num,
+                                                    out_bin);
+    }
+
     msg->obj = json_object_get(obj);
     assert(tlog_json_msg_is_valid(msg));
     return TLOG_RC_OK;
 }
 
+void
+tlog_json_msg_buf_cleanup(struct tlog_json_msg_buf *buf)
+{
+    assert(buf != NULL);
+    free(buf->ptr);
+    buf->ptr = NULL;
+    buf->size = 0;
+}
+
+/** Message text parsing state */
+struct tlog_json_msg_parser {
+    const char *pos;    /**< Text position */
+    const char *end;    /**< Text end */
+    uint8_t    *out;    /**< Buffer output position */
+};
+
+/**
+ * Skip whitespace in message text.
+ *
+ * @param parser    The parser state.
+ */
+static void
+tlog_json_msg_parser_skip_ws(struct tlog_json_msg_parser *parser)
+{
+    for (; parser->pos < parser->end; parser->pos++) {
+        switch (*parser->pos) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            continue;
+        }
+        break;
+    }
+}
+
+/**
+ * Consume a character from message text, skipping whitespace before it.
+ *
+ * @param parser    The parser state.
+ * @param c         The character to expect.
+ *
+ * @return True if the character was consumed, false if something else
+ *         was found.
+ */
+static bool
+tlog_json_msg_parser_char(struct tlog_json_msg_parser *parser, char c)
+{
+    tlog_json_msg_parser_skip_ws(parser);
+    if (parser->pos < parser->end && *parser->pos == c) {
+        parser->pos++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parse four hex digits of a \u escape from message text.
+ *
+ * @param parser    The parser state, positioned at the digits.
+ * @param pval      Location for the parsed value.
+ *
+ * @return True if parsed, false otherwise.
+ */
+static bool
+tlog_json_msg_parser_hex4(struct tlog_json_msg_parser *parser,
+                          unsigned int *pval)
+{
+    unsigned int val = 0;
+    size_t i;
+    char c;
+
+    if (parser->end - parser->pos < 4) {
+        return false;
+    }
+    for (i = 0; i < 4; i++) {
+        c = *parser->pos++;
+        val <<= 4;
+        if (c >= '0' && c <= '9') {
+            val |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            val |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            val |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    *pval = val;
+    return true;
+}
+
+/**
+ * Parse a string from message text, unescaping it into the buffer,
+ * zero-terminated.
+ *
+ * @param parser    The parser state.
+ * @param pptr      Location for the unescaped string pointer.
+ * @param plen      Location for the unescaped string length, not
+ *                  including the terminating zero.
+ *
+ * @return True if parsed, false if the string is not as expected.
+ */
+static bool
+tlog_json_msg_parser_str(struct tlog_json_msg_parser *parser,
+                         const char **pptr, size_t *plen)
+{
+    uint8_t *start;
+    const char *p;
+    unsigned int c;
+    unsigned int lc;
+
+    if (!tlog_json_msg_parser_char(parser, '"')) {
+        return false;
+    }
+    start = parser->out;
+
+    while (true) {
+        /* Copy the run of plain characters */
+        for (p = parser->pos;
+             p < parser->end && *p != '"' && *p != '\\' &&
+                (uint8_t)*p >= 0x20;
+             p++);
+        memcpy(parser->out, parser->pos, p - parser->pos);
+        parser->out += p - parser->pos;
+        parser->pos = p;
+
+        if (p >= parser->end || (uint8_t)*p < 0x20) {
+            return false;
+        } else if (*p == '"') {
+            parser->pos++;
+            break;
+        }
+
+        /* Unescape */
+        parser->pos++;
+        if (parser->pos >= parser->end) {
+            return false;
+        }
+        switch (*parser->pos++) {
+        case '"':
+            *parser->out++ = '"';
+            break;
+        case '\\':
+            *parser->out++ = '\\';
+            break;
+        case '/':
+            *parser->out++ = '/';
+            break;
+        case 'b':
+            *parser->out++ = '\b';
+            break;
+        case 'f':
+            *parser->out++ = '\f';
+            break;
+        case 'n':
+            *parser->out++ = '\n';
+            break;
+        case 'r':
+            *parser->out++ = '\r';
+            break;
+        case 't':
+            *parser->out++ = '\t';
+            break;
+        case 'u':
+            if (!tlog_json_msg_parser_hex4(parser, &c)) {
+                return false;
+            }
+            /* Combine a surrogate pair, leave the rest to json-c */
+            if (c >= 0xdc00 && c <= 0xdfff) {
+                return false;
+            } else if (c >= 0xd800 && c <= 0xdbff) {
+                if (parser->end - parser->pos < 2 ||
+                    parser->pos[0] != '\\' || parser->pos[1] != 'u') {
+                    return false;
+                }
+                parser->pos += 2;
+                if (!tlog_json_msg_parser_hex4(parser, &lc) ||
+                    lc < 0xdc00 || lc > 0xdfff) {
+                    return false;
+                }
+                c = 0x10000 + ((c - 0xd800) << 10) + (lc - 0xdc00);
+            }
+            /* Encode as UTF-8 */
+            if (c < 0x80) {
+                *parser->out++ = c;
+            } else if (c < 0x800) {
+                *parser->out++ = 0xc0 | (c >> 6);
+                *parser->out++ = 0x80 | (c & 0x3f);
+            } else if (c < 0x10000) {
+                *parser->out++ = 0xe0 | (c >> 12);
+                *parser->out++ = 0x80 | ((c >> 6) & 0x3f);
+                *parser->out++ = 0x80 | (c & 0x3f);
+            } else {
+                *parser->out++ = 0xf0 | (c >> 18);
+                *parser->out++ = 0x80 | ((c >> 12) & 0x3f);
+                *parser->out++ = 0x80 | ((c >> 6) & 0x3f);
+                *parser->out++ = 0x80 | (c & 0x3f);
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+
+    *pptr = (const char *)start;
+    *plen = parser->out - start;
+    *parser->out++ = 0;
+    return true;
+}
+
+/**
+ * Parse an integer from message text.
+ *
+ * @param parser    The parser state.
+ * @param pval      Location for the parsed value.
+ *
+ * @return True if parsed, false if the number is not a plain integer, or
+ *         is too long.
+ */
+static bool
+tlog_json_msg_parser_int(struct tlog_json_msg_parser *parser,
+                         int64_t *pval)
+{
+    bool neg = false;
+    int64_t val = 0;
+    const char *start;
+
+    tlog_json_msg_parser_skip_ws(parser);
+    if (parser->pos < parser->end && *parser->pos == '-') {
+        neg = true;
+        parser->pos++;
+    }
+    start = parser->pos;
+    for (; parser->pos < parser->end &&
+           *parser->pos >= '0' && *parser->pos <= '9';
+         parser->pos++) {
+        /* Eighteen digits never overflow, refuse more before they do */
+        if (parser->pos - start >= 18) {
+            return false;
+        }
+        val = val * 10 + (*parser->pos - '0');
+    }
+    /* No digits, a leading zero, a fraction or an exponent */
+    if (parser->pos == start ||
+        (*start == '0' && parser->pos - start > 1) ||
+        (parser->pos < parser->end &&
+         (*parser->pos == '.' || *parser->pos == 'e' ||
+          *parser->pos == 'E'))) {
+        return false;
+    }
+    *pval = neg ? -val : val;
+    return true;
+}
+
+/**
+ * Parse a binary array from message text into the buffer.
+ *
+ * @param parser    The parser state.
+ * @param pptr      Location for the bytes pointer.
+ * @param plen      Location for the number of bytes.
+ *
+ * @return True if parsed, false if the array is not a plain array of byte
+ *         values.
+ */
+static bool
+tlog_json_msg_parser_bin(struct tlog_json_msg_parser *parser,
+                         const uint8_t **pptr, size_t *plen)
+{
+    uint8_t *start;
+    int64_t val;
+
+    if (!tlog_json_msg_parser_char(parser, '[')) {
+        return false;
+    }
+    start = parser->out;
+    if (!tlog_json_msg_parser_char(parser, ']')) {
+        do {
+            if (!tlog_json_msg_parser_int(parser, &val) ||
+                val < 0 || val > UINT8_MAX) {
+                return false;
+            }
+            *parser->out++ = (uint8_t)val;
+        } while (tlog_json_msg_parser_char(parser, ','));
+        if (!tlog_json_msg_parser_char(parser, ']')) {
+            return false;
+        }
+    }
+    *pptr = start;
+    *plen = parser->out - start;
+    return true;
+}
+
+tlog_grc
+tlog_json_msg_parse(struct tlog_json_msg *msg,
+                    struct tlog_json_msg_buf *buf,
+                    const char *text, size_t len)
+{
+    /* Message fields, in the order tlog writes them */
+    static const char *field_list[] = {
+        "ver", "host", "user", "term", "session", "id", "pos",
+        "timing", "in_txt", "in_bin", "out_txt", "out_bin"
+    };
+    const size_t field_num = TLOG_ARRAY_SIZE(field_list);
+    struct tlog_json_msg_parser parser;
+    unsigned int seen = 0;
+    size_t size;
+    uint8_t *ptr;
+    const char *name;
+    size_t name_len;
+    size_t i;
+    size_t l;
+    int64_t ver = 0;
+    int64_t session = 0;
+    int64_t id = 0;
+    int64_t pos = 0;
+    bool ok;
+
+    assert(msg != NULL);
+    assert(buf != NULL);
+    assert(text != NULL || len == 0);
+
+    memset(msg, 0, sizeof(*msg));
+
+    /*
+     * Make sure the decoded data fits, without checking as we go:
+     * unescaping never makes strings longer, each array byte takes at
+     * least one character, and there are a few string terminators to add.
+     */
+    size = len + field_num;
+    if (size > buf->size) {
+        if (size < buf->size * 2) {
+            size = buf->size * 2;
+        }
+        ptr = realloc(buf->ptr, size);
+        if (ptr == NULL) {
+            return TLOG_GRC_ERRNO;
+        }
+        buf->ptr = ptr;
+        buf->size = size;
+    }
+
+    parser.pos = text;
+    parser.end = text + len;
+    parser.out = buf->ptr;
+
+    if (!tlog_json_msg_parser_char(&parser, '{')) {
+        return TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED;
+    }
+
+    do {
+        /* Parse the field name, which needs no unescaping, if known */
+        if (!tlog_json_msg_parser_char(&parser, '"')) {
+            return TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED;
+        }
+        name = parser.pos;
+        for (; parser.pos < parser.end && *parser.pos != '"' &&
+               *parser.pos != '\\';
+             parser.pos++);
+        if (parser.pos >= parser.end || *parser.pos != '"') {
+            return TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED;
+        }
+        name_len = parser.pos - name;
+        parser.pos++;
+        for (i = 0; i < field_num; i++) {
+            if (strlen(field_list[i]) == name_len &&
+                memcmp(field_list[i], name, name_len) == 0) {
+                break;
+            }
+        }
+        /* Leave unknown and repeated fields to json-c */
+        if (i >= field_num || (seen & (1 << i)) ||
+            !tlog_json_msg_parser_char(&parser, ':')) {
+            return TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED;
+        }
+        seen |= 1 << i;
+
+        switch (i) {
+        case 0:
+            ok = tlog_json_msg_parser_int(&parser, &ver);
+            break;
+        case 1:
+            ok = tlog_json_msg_parser_str(&parser, &msg->host, &l);
+            break;
+        case 2:
+            ok = tlog_json_msg_parser_str(&parser, &msg->user, &l);
+            break;
+        case 3:
+            ok = tlog_json_msg_parser_str(&parser, &msg->term, &l);
+            break;
+        case 4:
+            ok = tlog_json_msg_parser_int(&parser, &session);
+            break;
+        case 5:
+            ok = tlog_json_msg_parser_int(&parser, &id);
+            break;
+        case 6:
+            ok = tlog_json_msg_parser_int(&parser, &pos);
+            break;
+        case 7:
+            ok = tlog_json_msg_parser_str(&parser, &msg->timing_ptr, &l);
+            break;
+        case 8:
+            ok = tlog_json_msg_parser_str(&parser, &msg->in_txt_ptr,
+                                          &msg->in_txt_len);
+            break;
+        case 9:
+            ok = tlog_json_msg_parser_bin(&parser, &msg->in_bin_ptr,
+                                          &msg->in_bin_len);
+            break;
+        case 10:
+            ok = tlog_json_msg_parser_str(&parser, &msg->out_txt_ptr,
+                                          &msg->out_txt_len);
+            break;
+        case 11:
+            ok = tlog_json_msg_parser_bin(&parser, &msg->out_bin_ptr,
+                                          &msg->out_bin_len);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok) {
+            return TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED;
+        }
+    } while (tlog_json_msg_parser_char(&parser, ','));
+
+    if (!tlog_json_msg_parser_char(&parser, '}') ||
+        seen != (1u << field_num) - 1 ||
+        msg->in_bin_len > INT_MAX || msg->out_bin_len > INT_MAX) {
+        return TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED;
+    }
+
+    /* Verify the values the same way tlog_json_msg_init does */
+    if (ver != 1) {
+        return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_VER;
+    }
+    msg->ver = (unsigned int)ver;
+
+    if (session < 1 || session > UINT_MAX) {
+        return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_SESSION;
+    }
+    msg->session = (unsigned int)session;
+
+    if (id < 0
+#if INT64_MAX > SIZE_MAX
+        || id > (int64_t)SIZE_MAX
+#endif
+    ) {
+        return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_ID;
+    }
+    msg->id = (size_t)id;
+
+    if (pos < 0 || pos > TLOG_DELAY_MAX_MS_NUM) {
+        return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_POS;
+    }
+    msg->pos.tv_sec = pos / 1000;
+    msg->pos.tv_nsec = pos % 1000 * 1000000;
+
+    msg->buf = buf;
+    assert(tlog_json_msg_is_valid(msg));
+    return TLOG_RC_OK;
+}
+
+/**
+ * Find the value of a field in a message text, for prematching.
+ *
+ * @param text      The text to search.
+ * @param end       The text end.
+ * @param key       The field name, quoted and followed by a colon.
+ * @param key_len   The key length.
+ *
+ * @return Pointer to the value, past any whitespace, or NULL if the field
+ *         wasn't found.
+ */
+static const char *
+tlog_json_msg_filter_find(const char *text, const char *end,
+                          const char *key, size_t key_len)
+{
+    const char *p;
+
+    p = memmem(text, end - text, key, key_len);
+    if (p == NULL) {
+        return NULL;
+    }
+    for (p += key_len; p < end && (*p == ' ' || *p == '\t' ||
+                                   *p == '\n' || *p == '\r'); p++);
+    return p;
+}
+
+/**
+ * Check if a string value in a message text could be equal to a string.
+ *
+ * @param p     The value start.
+ * @param end   The text end.
+ * @param str   The string to compare with.
+ *
+ * @return False if the value definitely isn't equal, true if it might be.
+ */
+static bool
+tlog_json_msg_filter_str_prematch(const char *p, const char *end,
+                                  const char *str)
+{
+    if (p >= end || *p++ != '"') {
+        return true;
+    }
+    for (; p < end && *p != '\\'; p++, str++) {
+        if (*p == '"') {
+            return *str == '\0';
+        } else if (*p != *str) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check if an integer value in a message text could be equal to a number.
+ *
+ * @param p     The value start.
+ * @param end   The text end.
+ * @param num   The number to compare with.
+ *
+ * @return False if the value definitely isn't equal, true if it might be.
+ */
+static bool
+tlog_json_msg_filter_num_prematch(const char *p, const char *end,
+                                  unsigned int num)
+{
+    uint64_t val = 0;
+    const char *start = p;
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        val = val * 10 + (*p - '0');
+        if (val > UINT_MAX) {
+            return true;
+        }
+    }
+    /* Leave anything but plain positive integers to parsing */
+    if (p == start || val == 0 ||
+        (p < end && (*p == '.' || *p == 'e' || *p == 'E'))) {
+        return true;
+    }
+    return val == num;
+}
+
+bool
+tlog_json_msg_filter_prematch(const struct tlog_json_msg_filter *filter,
+                              const char *text, size_t len)
+{
+    const char *end = text + len;
+    const char *p;
+
+    assert(filter != NULL);
+    assert(text != NULL || len == 0);
+
+    /*
+     * Reject if a value doesn't match, but only if its field appears once,
+     * as another could belong to a nested object
+     */
+#define CHECK(_key, _prematch_expr) \
+    do {                                                                \
+        p = tlog_json_msg_filter_find(text, end,                        \
+                                      _key, sizeof(_key) - 1);          \
+        if (p != NULL && !(_prematch_expr) &&                           \
+            tlog_json_msg_filter_find(p, end, _key,                     \
+                                      sizeof(_key) - 1) == NULL) {      \
+            return false;                                               \
+        }                                                               \
+    } while (0)
+
+    if (filter->session != 0) {
+        CHECK("\"session\":",
+              tlog_json_msg_filter_num_prematch(p, end, filter->session));
+    }
+    if (filter->host != NULL) {
+        CHECK("\"host\":",
+              tlog_json_msg_filter_str_prematch(p, end, filter->host));
+    }
+    if (filter->user != NULL) {
+        CHECK("\"user\":",
+              tlog_json_msg_filter_str_prematch(p, end, filter->user));
+    }
+
+#undef CHECK
+
+    return true;
+}
+
 /**
  * Retrieve length of a UTF-8 character.
  *
@@ -179,11 +827,183 @@ tlog_json_msg_utf8_len(uint8_t b)
     }
 };
 
+/**
+ * Parse a timing record number.
+ *
+ * @param pptr  Location of the pointer to the number text, advanced past
+ *              the number on success.
+ * @param pval  Location for the parsed value.
+ *
+ * @return True if parsed, false if there were no digits, or the value
+ *         overflowed.
+ */
+static bool
+tlog_json_msg_timing_parse_num(const char **pptr, uint64_t *pval)
+{
+    const char *p = *pptr;
+    uint64_t val = 0;
+    unsigned int d;
+
+    for (; (d = (unsigned int)(*p - '0')) <= 9; p++) {
+        if (val > (UINT64_MAX - d) / 10) {
+            return false;
+        }
+        val = val * 10 + d;
+    }
+    if (p == *pptr) {
+        return false;
+    }
+    *pptr = p;
+    *pval = val;
+    return true;
+}
+
+/**
+ * Decode the next batch of timing records of a message, replacing the
+ * consumed ones. Zero delays and empty text runs are skipped. Decoding
+ * stops after the end of timing, or an invalid record, which are recorded
+ * as such and never consumed.
+ *
+ * @param msg   The message to decode timing records for.
+ */
+static void
+tlog_json_msg_timing_decode(struct tlog_json_msg *msg)
+{
+    const char *p = msg->timing_ptr;
+    struct tlog_json_msg_timing *timing;
+    char type;
+
+    msg->timing_num = 0;
+    msg->timing_idx = 0;
+
+    while (msg->timing_num < TLOG_ARRAY_SIZE(msg->timing_list)) {
+        timing = &msg->timing_list[msg->timing_num];
+
+        /* Skip leading whitespace */
+        while (*p == ' ' || (*p >= '\t' && *p <= '\r')) {
+            p++;
+        }
+
+        /* If reached the end of timing */
+        if (*p == 0) {
+            timing->type = TLOG_JSON_MSG_TIMING_TYPE_END;
+            msg->timing_num++;
+            break;
+        }
+
+        type = *p++;
+        timing->second = 0;
+        if (!tlog_json_msg_timing_parse_num(&p, &timing->first)) {
+            goto invalid;
+        }
+        switch (type) {
+        case '+':
+            if (timing->first > (uint64_t)TLOG_DELAY_MAX_MS_NUM) {
+                goto invalid;
+            }
+            timing->type = TLOG_JSON_MSG_TIMING_TYPE_DELAY;
+            break;
+        case '=':
+            if (*p != 'x') {
+                goto invalid;
+            }
+            p++;
+            if (!tlog_json_msg_timing_parse_num(&p, &timing->second) ||
+                timing->first > USHRT_MAX || timing->second > USHRT_MAX) {
+                goto invalid;
+            }
+            timing->type = TLOG_JSON_MSG_TIMING_TYPE_WINDOW;
+            break;
+        case '<':
+        case '>':
+#if UINT64_MAX > SIZE_MAX
+            if (timing->first > SIZE_MAX) {
+                goto invalid;
+            }
+#endif
+            timing->type = type == '<' ? TLOG_JSON_MSG_TIMING_TYPE_IN_TXT
+                                       : TLOG_JSON_MSG_TIMING_TYPE_OUT_TXT;
+            break;
+        case '[':
+        case ']':
+            if (*p != '/') {
+                goto invalid;
+            }
+            p++;
+            if (!tlog_json_msg_timing_parse_num(&p, &timing->second)
+#if UINT64_MAX > SIZE_MAX
+                || timing->first > SIZE_MAX || timing->second > SIZE_MAX
+#endif
+            ) {
+                goto invalid;
+            }
+            timing->type = type == '[' ? TLOG_JSON_MSG_TIMING_TYPE_IN_BIN
+                                       : TLOG_JSON_MSG_TIMING_TYPE_OUT_BIN;
+            break;
+        default:
+            goto invalid;
+        }
+
+        /* Drop records having no effect */
+        if (timing->first == 0 &&
+            (timing->type == TLOG_JSON_MSG_TIMING_TYPE_DELAY ||
+             timing->type == TLOG_JSON_MSG_TIMING_TYPE_IN_TXT ||
+             timing->type == TLOG_JSON_MSG_TIMING_TYPE_OUT_TXT)) {
+            continue;
+        }
+        msg->timing_num++;
+    }
+
+    msg->timing_ptr = p;
+    return;
+
+invalid:
+    timing->type = TLOG_JSON_MSG_TIMING_TYPE_INVALID;
+    msg->timing_num++;
+    msg->timing_ptr = p;
+}
+
+uint64_t
+tlog_json_msg_timing_get_span(const char *timing)
+{
+    const char *p = timing;
+    uint64_t span = 0;
+    uint64_t val;
+    char type;
+
+    assert(timing != NULL);
+
+    while (true) {
+        while (*p == ' ' || (*p >= '\t' && *p <= '\r')) {
+            p++;
+        }
+        type = *p++;
+        if (type == 0 || !tlog_json_msg_timing_parse_num(&p, &val)) {
+            break;
+        }
+        if (type == '+') {
+            if (val > (uint64_t)TLOG_DELAY_MAX_MS_NUM) {
+                break;
+            }
+            span += val;
+        } else if ((type == '=' && *p == 'x') ||
+                   ((type == '[' || type == ']') && *p == '/')) {
+            p++;
+            if (!tlog_json_msg_timing_parse_num(&p, &val)) {
+                break;
+            }
+        } else if (type != '<' && type != '>') {
+            break;
+        }
+    }
+
+    return span;
+}
+
 tlog_grc
 tlog_json_msg_read(struct tlog_json_msg *msg, struct tlog_pkt *pkt,
                    uint8_t *io_buf, size_t io_size)
 {
-    const char                 *timing_ptr;
     size_t                      io_len = 0;
     bool                        io_full = false;
     bool                        pkt_output;
@@ -201,82 +1021,43 @@ tlog_json_msg_read(struct tlog_json_msg *msg, struct tlog_pkt *pkt,
          * Read next timing record if the current one is spent
          */
         if (msg->rem == 0) {
-            char            type_buf[2];
-            char            type;
-            int             read;
-            uint64_t        first_val;
-            uint64_t        second_val;
+            const struct tlog_json_msg_timing *timing;
             struct timespec delay;
+            uint64_t first_val;
 
-            /* Skip leading whitespace */
-            while (true) {
-                switch (*msg->timing_ptr) {
-                case ' ':
-                case '\f':
-                case '\n':
-                case '\r':
-                case '\t':
-                case '\v':
-                    msg->timing_ptr++;
-                    continue;
-                }
-                break;
+            /* Decode more records, if all were consumed */
+            if (msg->timing_idx >= msg->timing_num) {
+                tlog_json_msg_timing_decode(msg);
             }
-
-            /* Modify timing pointer on the side to be able to rollback */
-            timing_ptr = msg->timing_ptr;
+            timing = &msg->timing_list[msg->timing_idx];
+            first_val = timing->first;
 
             /* If reached the end of timing and so the end of data */
-            if (*timing_ptr == 0) {
+            if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_END) {
                 /* Return whatever we have */
                 break;
-            }
-
-            if (sscanf(timing_ptr, "%1[][><+=]%" SCNu64 "%n",
-                       type_buf, &first_val, &read) < 2) {
+            /* If the timing is invalid from here on */
+            } else if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_INVALID) {
                 return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-            }
-            type = *type_buf;
-            timing_ptr += read;
-
-            if (type == '[' || type == ']') {
-                if (sscanf(timing_ptr, "/%" SCNu64 "%n", &second_val, &read) < 1) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
-                timing_ptr += read;
-            } else if (type == '=') {
-                if (sscanf(timing_ptr, "x%" SCNu64 "%n", &second_val, &read) < 1) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
-                timing_ptr += read;
-            } else {
-                second_val = 0;
-            }
-
             /* If it is a delay record */
-            if (type == '+') {
-                if (first_val != 0) {
-                    if (first_val > TLOG_DELAY_MAX_MS_NUM) {
-                        return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                    }
-                    /* If there was I/O already */
-                    if (io_len > 0) {
-                        /*
-                         * We gotta return the old pos packet and re-read
-                         * delay record next time
-                         */
-                        break;
-                    }
-                    delay.tv_sec = first_val / 1000;
-                    delay.tv_nsec = first_val % 1000 * 1000000;
-                    tlog_timespec_add(&msg->pos, &delay, &msg->pos);
+            } else if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_DELAY) {
+                /* If there was I/O already */
+                if (io_len > 0) {
+                    /*
+                     * We gotta return the old pos packet and re-read
+                     * delay record next time
+                     */
+                    break;
                 }
+                delay.tv_sec = first_val / 1000;
+                delay.tv_nsec = first_val % 1000 * 1000000;
+                tlog_timespec_add(&msg->pos, &delay, &msg->pos);
                 /* Timing record consumed */
-                msg->timing_ptr = timing_ptr;
+                msg->timing_idx++;
                 /* Read next timing record - no I/O from this one */
                 continue;
             /* If it is a window record */
-            } else if (type == '=') {
+            } else if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_WINDOW) {
                 /* If there was I/O already */
                 if (io_len > 0) {
                     /*
@@ -285,68 +1066,52 @@ tlog_json_msg_read(struct tlog_json_msg *msg, struct tlog_pkt *pkt,
                      */
                     break;
                 }
-                /* Check extents */
-                if (first_val > USHRT_MAX || second_val > USHRT_MAX) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
                 /* Return window packet */
                 tlog_pkt_init_window(pkt, &msg->pos,
                                      (unsigned short int)first_val,
-                                     (unsigned short int)second_val);
+                                     (unsigned short int)timing->second);
                 /* Timing record consumed */
-                msg->timing_ptr = timing_ptr;
+                msg->timing_idx++;
                 return TLOG_RC_OK;
             /* If it is a text input record */
-            } else if (type == '<') {
-                if (first_val > SIZE_MAX) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
+            } else if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_IN_TXT) {
                 msg->output = false;
                 msg->binary = false;
                 msg->rem = first_val;
                 msg->ptxt_ptr = &msg->in_txt_ptr;
                 msg->ptxt_len = &msg->in_txt_len;
             /* If it is a binary input record */
-            } else if (type == '[') {
-                if (first_val > SIZE_MAX || second_val > SIZE_MAX) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
+            } else if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_IN_BIN) {
                 msg->output = false;
                 msg->binary = true;
-                msg->rem = second_val;
+                msg->rem = timing->second;
                 msg->ptxt_ptr = &msg->in_txt_ptr;
                 msg->ptxt_len = &msg->in_txt_len;
-                msg->bin_obj = msg->in_bin_obj;
+                msg->bin_ptr = msg->in_bin_ptr;
+                msg->bin_len = msg->in_bin_len;
                 msg->pbin_pos = &msg->in_bin_pos;
             /* If it is a text output record */
-            } else if (type == '>') {
-                if (first_val > SIZE_MAX) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
+            } else if (timing->type == TLOG_JSON_MSG_TIMING_TYPE_OUT_TXT) {
                 msg->output = true;
                 msg->binary = false;
                 msg->rem = first_val;
                 msg->ptxt_ptr = &msg->out_txt_ptr;
                 msg->ptxt_len = &msg->out_txt_len;
             /* If it is a binary output record */
-            } else if (type == ']') {
-                if (first_val > SIZE_MAX || second_val > SIZE_MAX) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
-                }
+            } else {
+                assert(timing->type == TLOG_JSON_MSG_TIMING_TYPE_OUT_BIN);
                 msg->output = true;
                 msg->binary = true;
-                msg->rem = second_val;
+                msg->rem = timing->second;
                 msg->ptxt_ptr = &msg->out_txt_ptr;
                 msg->ptxt_len = &msg->out_txt_len;
-                msg->bin_obj = msg->out_bin_obj;
+                msg->bin_ptr = msg->out_bin_ptr;
+                msg->bin_len = msg->out_bin_len;
                 msg->pbin_pos = &msg->out_bin_pos;
-            } else {
-                assert(false);
-                return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING;
             }
 
             /* Timing record consumed */
-            msg->timing_ptr = timing_ptr;
+            msg->timing_idx++;
 
             if (msg->binary) {
                 size_t l;
@@ -388,31 +1153,21 @@ tlog_json_msg_read(struct tlog_json_msg *msg, struct tlog_pkt *pkt,
          * Append (a piece of) I/O to the output buffer
          */
         if (msg->binary) {
-            struct json_object *o;
-            int32_t n;
-
-            for (; msg->rem > 0; msg->rem--, io_len++, (*msg->pbin_pos)++) {
-                o = json_object_array_get_idx(msg->bin_obj, *msg->pbin_pos);
-                /* If not enough bytes */
-                if (o == NULL) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN;
-                }
-                /* If supposed byte is not an int */
-                if (json_object_get_type(o) != json_type_int) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN;
-                }
-                n = json_object_get_int(o);
-                /* If supposed byte value is out of range */
-                if (n < 0 || n > UINT8_MAX) {
-                    return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN;
-                }
-                io_buf[io_len] = (uint8_t)n;
-                /* If the I/O buffer is full */
-                if (io_len >= io_size) {
-                    io_full = true;
-                    break;
-                }
+            size_t n = msg->rem;
+
+            /* If the run doesn't fit into the I/O buffer */
+            if (n > io_size - io_len) {
+                n = io_size - io_len;
+                io_full = true;
+            }
+            /* If not enough valid bytes */
+            if (n > msg->bin_len - (size_t)*msg->pbin_pos) {
+                return TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN;
             }
+            memcpy(io_buf + io_len, msg->bin_ptr + *msg->pbin_pos, n);
+            msg->rem -= n;
+            io_len += n;
+            *msg->pbin_pos += (int)n;
         } else {
             uint8_t b;
             size_t l;
@@ -464,5 +1219,8 @@ tlog_json_msg_cleanup(struct tlog_json_msg *msg)
         json_object_put(msg->obj);
         msg->obj = NULL;
     }
+    free(msg->bin_buf);
+    msg->bin_buf = NULL;
+    msg->buf = NULL;
     assert(tlog_json_msg_is_valid(msg));
 }
@@ -111,6 +111,34 @@ tlog_json_reader_read(struct tlog_json_reader *reader,
     return grc;
 }
 
+tlog_grc
+tlog_json_reader_read_msg(struct tlog_json_reader *reader,
+                          const struct tlog_json_msg_filter *filter,
+                          struct tlog_json_msg *msg)
+{
+    tlog_grc grc;
+    struct json_object *obj;
+
+    assert(tlog_json_reader_is_valid(reader));
+    assert(tlog_json_msg_is_void(msg));
+
+    if (reader->type->read_msg != NULL) {
+        grc = reader->type->read_msg(reader, filter, msg);
+    } else {
+        grc = reader->type->read(reader, &obj);
+        if (grc == TLOG_RC_OK && obj != NULL) {
+            grc = tlog_json_msg_init(msg, obj);
+            json_object_put(obj);
+        }
+    }
+    if (grc != TLOG_RC_OK) {
+        tlog_json_msg_cleanup(msg);
+    }
+
+    assert(tlog_json_reader_is_valid(reader));
+    return grc;
+}
+
 void
 tlog_json_reader_destroy(struct tlog_json_reader *reader)
 {
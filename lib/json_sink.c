@@ -156,10 +156,17 @@ tlog_json_sink_is_valid(const struct tlog_sink *sink)
            tlog_json_chunk_is_valid(&json_sink->chunk);
 }
 
+/**
+ * Format the accumulated chunk contents into a message and write it to the
+ * writer, if the chunk is not empty.
+ *
+ * @param json_sink The sink to flush the chunk of.
+ *
+ * @return Global return code.
+ */
 static tlog_grc
-tlog_json_sink_flush(struct tlog_sink *sink)
+tlog_json_sink_flush_chunk(struct tlog_json_sink *json_sink)
 {
-    struct tlog_json_sink *json_sink = (struct tlog_json_sink *)sink;
     tlog_grc grc;
     char pos_buf[32];
     int len;
@@ -233,6 +240,21 @@ tlog_json_sink_flush(struct tlog_sink *sink)
     return TLOG_RC_OK;
 }
 
+static tlog_grc
+tlog_json_sink_flush(struct tlog_sink *sink)
+{
+    struct tlog_json_sink *json_sink = (struct tlog_json_sink *)sink;
+    tlog_grc grc;
+
+    grc = tlog_json_sink_flush_chunk(json_sink);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+
+    /* Let buffering writers deliver what they have accumulated */
+    return tlog_json_writer_flush(json_sink->writer);
+}
+
 static tlog_grc
 tlog_json_sink_cut(struct tlog_sink *sink)
 {
@@ -240,7 +262,7 @@ tlog_json_sink_cut(struct tlog_sink *sink)
     tlog_grc grc;
 
     while (!tlog_json_chunk_cut(&json_sink->chunk)) {
-        grc = tlog_json_sink_flush(sink);
+        grc = tlog_json_sink_flush_chunk(json_sink);
         if (grc != TLOG_RC_OK) {
             return grc;
         }
@@ -274,7 +296,7 @@ tlog_json_sink_write(struct tlog_sink *sink,
 
     /* While the packet is not yet written completely */
     while (!tlog_json_chunk_write(&json_sink->chunk, pkt, ppos, end)) {
-        grc = tlog_json_sink_flush(sink);
+        grc = tlog_json_sink_flush_chunk(json_sink);
         if (grc != TLOG_RC_OK) {
             return grc;
         }
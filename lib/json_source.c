@@ -45,6 +45,9 @@ struct tlog_json_source {
                                              messages, NULL for any */
     unsigned int        session_id;     /**< Session ID to filter messages by,
                                              NULL for unfiltered */
+    struct tlog_json_msg_filter
+                        filter;         /**< Filter to skip messages with
+                                             before parsing them */
 
     bool                got_msg;        /**< Read at least one message */
     size_t              last_msg_id;    /**< Last message ID */
@@ -130,6 +133,15 @@ tlog_json_source_init(struct tlog_source *source, va_list ap)
     }
     json_source->session_id = session_id;
 
+    /*
+     * Prefilter by the same fields, except the session ID if the terminal
+     * is checked, as a terminal mismatch is reported before it
+     */
+    json_source->filter.host = json_source->hostname;
+    json_source->filter.user = json_source->username;
+    json_source->filter.session = json_source->terminal == NULL
+                                    ? session_id : 0;
+
     tlog_json_msg_init(&json_source->msg, NULL);
 
     json_source->io_size = io_size;
@@ -177,26 +189,21 @@ tlog_json_source_read_msg(struct tlog_source *source)
     struct tlog_json_source *json_source =
                                 (struct tlog_json_source *)source;
     tlog_grc grc;
-    struct json_object *obj;
 
     assert(tlog_json_source_is_valid(source));
     assert(tlog_json_msg_is_void(&json_source->msg));
 
     for (; ; tlog_json_msg_cleanup(&json_source->msg)) {
-        grc = tlog_json_reader_read(json_source->reader, &obj);
+        grc = tlog_json_reader_read_msg(json_source->reader,
+                                        &json_source->filter,
+                                        &json_source->msg);
         if (grc != TLOG_RC_OK) {
             return grc;
         }
-        if (obj == NULL) {
+        if (tlog_json_msg_is_void(&json_source->msg)) {
             return TLOG_RC_OK;
         }
 
-        grc = tlog_json_msg_init(&json_source->msg, obj);
-        json_object_put(obj);
-        if (grc != TLOG_RC_OK) {
-            return grc;
-        }
-
         if (json_source->hostname != NULL &&
             strcmp(json_source->msg.host, json_source->hostname) != 0) {
             continue;
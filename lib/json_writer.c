@@ -80,6 +80,15 @@ tlog_json_writer_write(struct tlog_json_writer *writer,
     return writer->type->write(writer, buf, len);
 }
 
+tlog_grc
+tlog_json_writer_flush(struct tlog_json_writer *writer)
+{
+    assert(tlog_json_writer_is_valid(writer));
+
+    return (writer->type->flush != NULL) ? writer->type->flush(writer)
+                                         : TLOG_RC_OK;
+}
+
 void
 tlog_json_writer_destroy(struct tlog_json_writer *writer)
 {
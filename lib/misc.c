@@ -24,6 +24,8 @@
 #include <tlog/rc.h>
 #include <tlog/misc.h>
 #include <libgen.h>
+#include <unistd.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -121,3 +123,35 @@ cleanup:
     free(abs_prog_path);
     return grc;
 }
+
+tlog_grc
+tlog_find_zero_tail(int fd, off_t start, off_t size, off_t *pend)
+{
+    uint8_t buf[4096];
+    off_t off;
+    ssize_t rc;
+
+    assert(fd >= 0);
+    assert(start >= 0);
+    assert(pend != NULL);
+
+    while (size > start) {
+        off = size - start > (off_t)sizeof(buf) ? size - (off_t)sizeof(buf)
+                                                : start;
+        rc = pread(fd, buf, (size_t)(size - off), off);
+        if (rc < 0) {
+            return TLOG_GRC_ERRNO;
+        } else if (rc != size - off) {
+            /* Truncated under us, start over */
+            size = off + rc;
+            continue;
+        }
+        for (; size > off && buf[size - off - 1] == 0; size--);
+        if (size > off) {
+            break;
+        }
+    }
+
+    *pend = size > start ? size : start;
+    return TLOG_RC_OK;
+}
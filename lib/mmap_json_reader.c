@@ -0,0 +1,1266 @@
+/*
+ * Memory-mapped file JSON message reader.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <json_tokener.h>
+#include <tlog/mmap_json_reader.h>
+#include <tlog/misc.h>
+#include <tlog/rc.h>
+
+/** Size of a block of lines parsed by a worker thread at once, bytes */
+#define TLOG_MMAP_JSON_READER_BLOCK_SIZE        65536
+
+/** Number of blocks per worker thread, being parsed or waiting */
+#define TLOG_MMAP_JSON_READER_THREAD_BLOCK_NUM  4
+
+/** Message parsed by a worker thread */
+struct tlog_mmap_json_reader_entry {
+    struct tlog_json_msg        msg;        /**< Parsed message */
+    struct tlog_json_msg_buf    buf;        /**< Buffer for the message
+                                                 parsed directly from text */
+    tlog_grc                    grc;        /**< Parsing return code */
+    size_t                      line;       /**< Number of newlines in the
+                                                 block up to the message
+                                                 end */
+};
+
+/** Block state */
+enum tlog_mmap_json_reader_block_state {
+    TLOG_MMAP_JSON_READER_BLOCK_STATE_FREE,     /**< Not used */
+    TLOG_MMAP_JSON_READER_BLOCK_STATE_QUEUED,   /**< Waiting for a worker */
+    TLOG_MMAP_JSON_READER_BLOCK_STATE_PARSING,  /**< Being parsed */
+    TLOG_MMAP_JSON_READER_BLOCK_STATE_DONE,     /**< Parsed */
+};
+
+/** Block of whole lines parsed by a worker thread */
+struct tlog_mmap_json_reader_block {
+    enum tlog_mmap_json_reader_block_state
+                                        state;      /**< Block state */
+    const char                         *start;      /**< Text start */
+    const char                         *end;        /**< Text end */
+    char                               *text;       /**< Buffer with the
+                                                         text read */
+    size_t                              text_size;  /**< Text buffer
+                                                         size */
+    struct tlog_mmap_json_reader_entry *entry_list; /**< Parsed messages */
+    size_t                              entry_num;  /**< Number of parsed
+                                                         messages */
+    size_t                              entry_size; /**< Number of
+                                                         allocated entries */
+    size_t                              line_num;   /**< Number of newlines
+                                                         in the block */
+    size_t                              line;       /**< Number of the line
+                                                         the block starts
+                                                         at, if lines were
+                                                         skipped before it,
+                                                         zero otherwise */
+    tlog_grc                            grc;        /**< Failure return
+                                                         code, reported
+                                                         after the parsed
+                                                         messages */
+};
+
+/** Worker thread data */
+struct tlog_mmap_json_reader_worker {
+    struct tlog_mmap_json_reader   *reader; /**< The reader working for */
+    struct json_tokener            *tok;    /**< JSON tokener object */
+    bool                            init;   /**< True if thread started */
+    pthread_t                       thread; /**< The thread */
+};
+
+/** Memory-mapped file reader data */
+struct tlog_mmap_json_reader {
+    struct tlog_json_reader     reader;     /**< Base type */
+    struct json_tokener        *tok;        /**< JSON tokener object */
+    int                         fd;         /**< File descriptor */
+    bool                        fd_owned;   /**< True if FD is owned */
+    size_t                      line;       /**< Number of the line being
+                                                 read */
+    const char                 *map;        /**< Mapped file, or NULL if
+                                                 nothing is mapped */
+    size_t                      map_size;   /**< Mapped file size */
+    size_t                      size;       /**< Size of the text to read,
+                                                 excluding the zero-filled
+                                                 tail being written, if
+                                                 any */
+    size_t                      pos;        /**< Reading offset */
+    const struct tlog_index    *index;      /**< Index of the file to skip
+                                                 other sessions with, or
+                                                 NULL */
+    uint64_t                    pos_min;    /**< Position of the earliest
+                                                 message of interest, ms,
+                                                 used with the index */
+    struct tlog_json_msg_buf    buf;        /**< Buffer for messages parsed
+                                                 directly from text */
+
+    /* Parallel parsing data, shared with the workers under the mutex */
+    unsigned int                thread_num; /**< Number of worker threads,
+                                                 zero if parsing in the
+                                                 calling thread */
+    struct tlog_mmap_json_reader_worker
+                               *worker_list;/**< Worker threads */
+    bool                        sync_init;  /**< True if the mutex and the
+                                                 condition are initialized */
+    pthread_mutex_t             mutex;      /**< Shared data mutex */
+    pthread_cond_t              cond;       /**< Shared data change
+                                                 condition */
+    bool                        stop;       /**< True if workers should
+                                                 exit */
+    bool                        truncated;  /**< True if the file was found
+                                                 truncated below the text
+                                                 being parsed */
+    bool                        started;    /**< True if parallel reading
+                                                 has started */
+    bool                        filtered;   /**< True if filtering */
+    struct tlog_json_msg_filter filter;     /**< Filter to skip lines with,
+                                                 if filtering */
+    struct tlog_mmap_json_reader_block
+                               *block_list; /**< Ring of blocks */
+    size_t                      block_num;  /**< Number of blocks */
+    size_t                      block_head; /**< Index of the block being
+                                                 read */
+    size_t                      block_count;/**< Number of blocks being
+                                                 read, parsed, or queued */
+    size_t                      entry_idx;  /**< Index of the next entry to
+                                                 read from the head block */
+    size_t                      line_base;  /**< Number of the line the
+                                                 head block starts at */
+    size_t                      queue_line; /**< Number of the line at the
+                                                 queueing offset, if lines
+                                                 were skipped before it,
+                                                 zero otherwise */
+};
+
+/**
+ * Drop everything read from an mmap_json_reader, and the index, to read the
+ * file over from the beginning.
+ *
+ * @param mmap_json_reader  The reader to restart.
+ */
+static void
+tlog_mmap_json_reader_restart(struct tlog_mmap_json_reader *mmap_json_reader)
+{
+    mmap_json_reader->size = 0;
+    mmap_json_reader->pos = 0;
+    mmap_json_reader->line = 1;
+    mmap_json_reader->line_base = 1;
+    mmap_json_reader->queue_line = 0;
+    mmap_json_reader->index = NULL;
+}
+
+/**
+ * Extend the mapping of an mmap_json_reader to the current end of the file,
+ * if it has grown, or map it over and start reading from the beginning, if
+ * it was truncated. Must not be called while workers use the mapping.
+ *
+ * The zero-filled tail preallocated by a memory-mapped writer is found
+ * with reads, and is not included into the text, along with the last line
+ * before it, if incomplete. So the text is never truncated by the writer,
+ * and can be read through the mapping without a SIGBUS.
+ *
+ * @param mmap_json_reader  The reader to extend the mapping for.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_remap(struct tlog_mmap_json_reader *mmap_json_reader)
+{
+    struct stat st;
+    void *map;
+    off_t end;
+    const char *nl;
+    tlog_grc grc;
+
+    if (fstat(mmap_json_reader->fd, &st) < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+    if ((size_t)st.st_size == mmap_json_reader->map_size &&
+        mmap_json_reader->size == mmap_json_reader->map_size) {
+        return TLOG_RC_OK;
+    }
+
+    /* If the text was truncated, drop everything read, and the index */
+    if ((size_t)st.st_size < mmap_json_reader->size) {
+        tlog_mmap_json_reader_restart(mmap_json_reader);
+    }
+
+    /* Find the end of the text, before the zero-filled tail, if any */
+    grc = tlog_find_zero_tail(mmap_json_reader->fd,
+                              (off_t)mmap_json_reader->size, st.st_size,
+                              &end);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+
+    if ((size_t)st.st_size != mmap_json_reader->map_size) {
+        if (st.st_size == 0) {
+            map = NULL;
+        } else {
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+                       mmap_json_reader->fd, 0);
+            if (map == MAP_FAILED) {
+                return TLOG_GRC_ERRNO;
+            }
+            /* The hint is only an optimization, ignore failures */
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        }
+        if (mmap_json_reader->map != NULL) {
+            munmap((void *)mmap_json_reader->map,
+                   mmap_json_reader->map_size);
+        }
+        mmap_json_reader->map = map;
+        mmap_json_reader->map_size = (size_t)st.st_size;
+    }
+
+    /* Only take complete lines while the tail is being written */
+    if (end < st.st_size) {
+        nl = memrchr(mmap_json_reader->map + mmap_json_reader->size, '\n',
+                     (size_t)end - mmap_json_reader->size);
+        if (nl != NULL) {
+            mmap_json_reader->size = nl + 1 - mmap_json_reader->map;
+        }
+    } else {
+        mmap_json_reader->size = (size_t)end;
+    }
+    return TLOG_RC_OK;
+}
+
+/**
+ * Check if the file of an mmap_json_reader was truncated below the text
+ * mapped, so reading it through the mapping could raise SIGBUS.
+ *
+ * @param mmap_json_reader  The reader to check the file for.
+ * @param ptruncated        Location for the truncation flag.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_check(struct tlog_mmap_json_reader *mmap_json_reader,
+                            bool *ptruncated)
+{
+    struct stat st;
+
+    if (fstat(mmap_json_reader->fd, &st) < 0) {
+        return TLOG_GRC_ERRNO;
+    }
+    *ptruncated = (size_t)st.st_size < mmap_json_reader->size;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Make sure the text of an mmap_json_reader is still in the file, before
+ * reading a line in the calling thread, and map the file over to read it
+ * from the beginning, if it was truncated.
+ *
+ * @param mmap_json_reader  The reader to revalidate the text for.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_revalidate(
+                    struct tlog_mmap_json_reader *mmap_json_reader)
+{
+    tlog_grc grc;
+    bool truncated;
+
+    grc = tlog_mmap_json_reader_check(mmap_json_reader, &truncated);
+    if (grc != TLOG_RC_OK || !truncated) {
+        return grc;
+    }
+    tlog_mmap_json_reader_restart(mmap_json_reader);
+    return tlog_mmap_json_reader_remap(mmap_json_reader);
+}
+
+static void
+tlog_mmap_json_reader_cleanup(struct tlog_json_reader *reader)
+{
+    struct tlog_mmap_json_reader *mmap_json_reader =
+                                (struct tlog_mmap_json_reader*)reader;
+    struct tlog_mmap_json_reader_worker *worker;
+    struct tlog_mmap_json_reader_block *block;
+    size_t i;
+    size_t j;
+
+    /* Stop the workers */
+    if (mmap_json_reader->sync_init) {
+        pthread_mutex_lock(&mmap_json_reader->mutex);
+        mmap_json_reader->stop = true;
+        pthread_cond_broadcast(&mmap_json_reader->cond);
+        pthread_mutex_unlock(&mmap_json_reader->mutex);
+    }
+    if (mmap_json_reader->worker_list != NULL) {
+        for (i = 0; i < mmap_json_reader->thread_num; i++) {
+            worker = &mmap_json_reader->worker_list[i];
+            if (worker->init) {
+                pthread_join(worker->thread, NULL);
+                worker->init = false;
+            }
+            if (worker->tok != NULL) {
+                json_tokener_free(worker->tok);
+                worker->tok = NULL;
+            }
+        }
+        free(mmap_json_reader->worker_list);
+        mmap_json_reader->worker_list = NULL;
+    }
+    if (mmap_json_reader->sync_init) {
+        pthread_cond_destroy(&mmap_json_reader->cond);
+        pthread_mutex_destroy(&mmap_json_reader->mutex);
+        mmap_json_reader->sync_init = false;
+    }
+
+    /* Free the blocks, along with the messages not read */
+    if (mmap_json_reader->block_list != NULL) {
+        for (i = 0; i < mmap_json_reader->block_num; i++) {
+            block = &mmap_json_reader->block_list[i];
+            for (j = 0; j < block->entry_size; j++) {
+                if (j < block->entry_num) {
+                    tlog_json_msg_cleanup(&block->entry_list[j].msg);
+                }
+                tlog_json_msg_buf_cleanup(&block->entry_list[j].buf);
+            }
+            free(block->entry_list);
+            free(block->text);
+        }
+        free(mmap_json_reader->block_list);
+        mmap_json_reader->block_list = NULL;
+    }
+
+    if (mmap_json_reader->tok != NULL) {
+        json_tokener_free(mmap_json_reader->tok);
+        mmap_json_reader->tok = NULL;
+    }
+    if (mmap_json_reader->map != NULL) {
+        munmap((void *)mmap_json_reader->map, mmap_json_reader->map_size);
+        mmap_json_reader->map = NULL;
+    }
+    tlog_json_msg_buf_cleanup(&mmap_json_reader->buf);
+    if (mmap_json_reader->fd_owned) {
+        close(mmap_json_reader->fd);
+        mmap_json_reader->fd_owned = false;
+    }
+}
+
+static bool
+tlog_mmap_json_reader_is_valid(const struct tlog_json_reader *reader)
+{
+    struct tlog_mmap_json_reader *mmap_json_reader =
+                                (struct tlog_mmap_json_reader*)reader;
+    return mmap_json_reader->tok != NULL &&
+           mmap_json_reader->fd >= 0 &&
+           mmap_json_reader->line > 0 &&
+           (mmap_json_reader->map != NULL ||
+            mmap_json_reader->map_size == 0) &&
+           mmap_json_reader->size <= mmap_json_reader->map_size &&
+           mmap_json_reader->pos <= mmap_json_reader->size &&
+           (mmap_json_reader->thread_num == 0 ||
+            (mmap_json_reader->worker_list != NULL &&
+             mmap_json_reader->block_list != NULL &&
+             mmap_json_reader->block_count <=
+                mmap_json_reader->block_num));
+}
+
+static size_t
+tlog_mmap_json_reader_loc_get(const struct tlog_json_reader *reader)
+{
+    return ((struct tlog_mmap_json_reader*)reader)->line;
+}
+
+static char *
+tlog_mmap_json_reader_loc_fmt(const struct tlog_json_reader *reader,
+                              size_t loc)
+{
+    char *str;
+    (void)reader;
+    return asprintf(&str, "line %zu", loc) >= 0 ? str : NULL;
+}
+
+/**
+ * Skip whitespace in the mmap reader text, up to the end of the file.
+ *
+ * @param mmap_json_reader  The mmap reader to skip whitespace for.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_skip_whitespace(
+                    struct tlog_mmap_json_reader *mmap_json_reader)
+{
+    size_t size;
+    tlog_grc grc;
+
+    do {
+        for (; mmap_json_reader->pos < mmap_json_reader->size;
+             mmap_json_reader->pos++) {
+            switch (mmap_json_reader->map[mmap_json_reader->pos]) {
+            case '\n':
+                mmap_json_reader->line++;
+            case '\0':
+            case '\f':
+            case '\r':
+            case '\t':
+            case '\v':
+            case ' ':
+                break;
+            default:
+                return TLOG_RC_OK;
+            }
+        }
+
+        /* Check if the file has grown, or was truncated */
+        size = mmap_json_reader->size;
+        grc = tlog_mmap_json_reader_remap(mmap_json_reader);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+    } while (mmap_json_reader->size != size);
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Skip the text of the mmap reader up to the next run of messages matching
+ * a filter, according to the index, if any.
+ *
+ * @param mmap_json_reader  The mmap reader to skip text for.
+ * @param filter            The filter to skip text with, or NULL.
+ *
+ * @return Number of the line skipped to, or zero if nothing was skipped.
+ */
+static size_t
+tlog_mmap_json_reader_index_skip(
+                    struct tlog_mmap_json_reader *mmap_json_reader,
+                    const struct tlog_json_msg_filter *filter)
+{
+    const struct tlog_index_run *run;
+    size_t pos;
+    size_t line;
+
+    /* Only sessions can be looked up, and only in the indexed part */
+    if (mmap_json_reader->index == NULL ||
+        filter == NULL || filter->session == 0) {
+        return 0;
+    }
+    pos = tlog_index_get_end(mmap_json_reader->index, &line);
+    if (mmap_json_reader->pos >= pos) {
+        return 0;
+    }
+
+    run = tlog_index_find(mmap_json_reader->index, mmap_json_reader->pos,
+                          filter->host, filter->session,
+                          mmap_json_reader->pos_min);
+    if (run != NULL) {
+        if (run->start <= mmap_json_reader->pos) {
+            return 0;
+        }
+        pos = run->start;
+        line = run->line;
+    }
+
+    /* Don't trust an index not matching the file */
+    if (pos > mmap_json_reader->size ||
+        mmap_json_reader->map[pos - 1] != '\n') {
+        return 0;
+    }
+
+    mmap_json_reader->pos = pos;
+    return line;
+}
+
+/**
+ * Find the next non-empty line in the mmap reader text, and advance past it.
+ *
+ * @param mmap_json_reader  The mmap reader to find the line for.
+ * @param pstart            Location for the line start pointer, set to
+ *                          NULL on end of file.
+ * @param pend              Location for the line end pointer, pointing to
+ *                          the newline, or to the end of the file.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_next_line(
+                    struct tlog_mmap_json_reader *mmap_json_reader,
+                    const char **pstart, const char **pend)
+{
+    tlog_grc grc;
+    const char *end;
+    size_t size;
+
+    /* Skip leading whitespace */
+    grc = tlog_mmap_json_reader_skip_whitespace(mmap_json_reader);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    if (mmap_json_reader->pos >= mmap_json_reader->size) {
+        *pstart = NULL;
+        return TLOG_RC_OK;
+    }
+
+    /* Find the end of the line, checking if the file has grown, if not */
+    end = memchr(mmap_json_reader->map + mmap_json_reader->pos, '\n',
+                 mmap_json_reader->size - mmap_json_reader->pos);
+    if (end == NULL) {
+        size = mmap_json_reader->size;
+        grc = tlog_mmap_json_reader_remap(mmap_json_reader);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+        /* Start over, if the file was truncated */
+        if (mmap_json_reader->size < size) {
+            return tlog_mmap_json_reader_next_line(mmap_json_reader,
+                                                   pstart, pend);
+        }
+        end = memchr(mmap_json_reader->map + size, '\n',
+                     mmap_json_reader->size - size);
+    }
+    *pstart = mmap_json_reader->map + mmap_json_reader->pos;
+    if (end == NULL) {
+        end = mmap_json_reader->map + mmap_json_reader->size;
+        mmap_json_reader->pos = mmap_json_reader->size;
+    } else {
+        mmap_json_reader->pos = end - mmap_json_reader->map + 1;
+        mmap_json_reader->line++;
+    }
+    *pend = end;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Parse a line of the mmap reader text into a JSON object.
+ *
+ * @param tok       The tokener to parse the line with.
+ * @param start     The line start.
+ * @param end       The line end.
+ * @param pobject   Location for the parsed object.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_parse_line(struct json_tokener *tok,
+                                 const char *start, const char *end,
+                                 struct json_object **pobject)
+{
+    struct json_object *object;
+    enum json_tokener_error jerr;
+
+    if (end - start > INT_MAX) {
+        return TLOG_GRC_FROM(json, json_tokener_error_size);
+    }
+
+    /* Parse the whole line at once */
+    json_tokener_reset(tok);
+    object = json_tokener_parse_ex(tok, start, (int)(end - start));
+    if (object != NULL) {
+        *pobject = object;
+        return TLOG_RC_OK;
+    }
+    jerr = json_tokener_get_error(tok);
+    if (jerr == json_tokener_continue) {
+        return TLOG_RC_FD_JSON_READER_INCOMPLETE_LINE;
+    }
+    return TLOG_GRC_FROM(json, jerr);
+}
+
+static tlog_grc
+tlog_mmap_json_reader_read(struct tlog_json_reader *reader,
+                           struct json_object **pobject)
+{
+    struct tlog_mmap_json_reader *mmap_json_reader =
+                                (struct tlog_mmap_json_reader*)reader;
+    tlog_grc grc;
+    const char *start;
+    const char *end;
+
+    /* Objects can't be read after messages were parsed in parallel */
+    assert(!mmap_json_reader->started);
+
+    grc = tlog_mmap_json_reader_revalidate(mmap_json_reader);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    grc = tlog_mmap_json_reader_next_line(mmap_json_reader, &start, &end);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    if (start == NULL) {
+        *pobject = NULL;
+        return TLOG_RC_OK;
+    }
+    return tlog_mmap_json_reader_parse_line(mmap_json_reader->tok,
+                                            start, end, pobject);
+}
+
+/**
+ * Parse a line of the mmap reader text into a message.
+ *
+ * @param tok       The tokener to parse the line with, if it's not laid
+ *                  out as expected.
+ * @param buf       The buffer to decode the message into.
+ * @param start     The line start.
+ * @param end       The line end.
+ * @param msg       The message to initialize.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_parse_msg(struct json_tokener *tok,
+                                struct tlog_json_msg_buf *buf,
+                                const char *start, const char *end,
+                                struct tlog_json_msg *msg)
+{
+    tlog_grc grc;
+    struct json_object *object;
+
+    /* Try parsing a message written by tlog directly first */
+    grc = tlog_json_msg_parse(msg, buf, start, (size_t)(end - start));
+    if (grc != TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED) {
+        return grc;
+    }
+
+    /* Fall back to parsing anything else into an object */
+    grc = tlog_mmap_json_reader_parse_line(tok, start, end, &object);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    grc = tlog_json_msg_init(msg, object);
+    json_object_put(object);
+    return grc;
+}
+
+/**
+ * Add an entry to a block, growing the entry list, if necessary.
+ *
+ * @param block     The block to add the entry to.
+ * @param pentry    Location for the added entry pointer.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_block_add(struct tlog_mmap_json_reader_block *block,
+                                struct tlog_mmap_json_reader_entry **pentry)
+{
+    struct tlog_mmap_json_reader_entry *entry_list;
+    size_t entry_size;
+    size_t i;
+
+    if (block->entry_num >= block->entry_size) {
+        entry_size = block->entry_size == 0 ? 64 : block->entry_size * 2;
+        entry_list = realloc(block->entry_list,
+                             entry_size * sizeof(*entry_list));
+        if (entry_list == NULL) {
+            return TLOG_GRC_ERRNO;
+        }
+        memset(entry_list + block->entry_size, 0,
+               (entry_size - block->entry_size) * sizeof(*entry_list));
+        /* Point the parsed messages to their moved buffers */
+        for (i = 0; i < block->entry_num; i++) {
+            if (entry_list[i].msg.buf != NULL) {
+                entry_list[i].msg.buf = &entry_list[i].buf;
+            }
+        }
+        block->entry_list = entry_list;
+        block->entry_size = entry_size;
+    }
+    *pentry = &block->entry_list[block->entry_num++];
+    return TLOG_RC_OK;
+}
+
+/**
+ * Parse the lines of a block, in a worker thread, unless the file was
+ * truncated below the block end. The text is read with pread(2) rather
+ * than through the mapping, so the file being truncated meanwhile can't
+ * raise SIGBUS.
+ *
+ * @param mmap_json_reader  The reader to parse the block for.
+ * @param tok               The worker's tokener.
+ * @param block             The block to parse.
+ *
+ * @return True if the block was parsed, false if the file was truncated.
+ */
+static bool
+tlog_mmap_json_reader_block_parse(
+                    struct tlog_mmap_json_reader *mmap_json_reader,
+                    struct json_tokener *tok,
+                    struct tlog_mmap_json_reader_block *block)
+{
+    size_t len = (size_t)(block->end - block->start);
+    off_t off = block->start - mmap_json_reader->map;
+    const char *p;
+    const char *text_end;
+    const char *end;
+    const char *next;
+    size_t line = 0;
+    struct tlog_mmap_json_reader_entry *entry;
+    char *text;
+    size_t done;
+    ssize_t rc;
+    tlog_grc grc;
+
+    block->entry_num = 0;
+    block->line_num = 0;
+    block->grc = TLOG_RC_OK;
+
+    /* Read the text, stopping at the end of the file */
+    if (len > block->text_size) {
+        text = realloc(block->text, len);
+        if (text == NULL) {
+            block->grc = TLOG_GRC_ERRNO;
+            return true;
+        }
+        block->text = text;
+        block->text_size = len;
+    }
+    for (done = 0; done < len; done += (size_t)rc) {
+        rc = pread(mmap_json_reader->fd, block->text + done,
+                   len - done, off + (off_t)done);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                rc = 0;
+                continue;
+            }
+            block->grc = TLOG_GRC_ERRNO;
+            return true;
+        } else if (rc == 0) {
+            return false;
+        }
+    }
+    p = block->text;
+    text_end = block->text + len;
+
+    while (true) {
+        /* Skip leading whitespace, the same as when reading in order */
+        for (; p < text_end; p++) {
+            if (*p == '\n') {
+                line++;
+            } else if (*p != '\0' && *p != '\f' && *p != '\r' &&
+                       *p != '\t' && *p != '\v' && *p != ' ') {
+                break;
+            }
+        }
+        if (p >= text_end) {
+            break;
+        }
+
+        /* Find the end of the line */
+        end = memchr(p, '\n', text_end - p);
+        if (end == NULL) {
+            end = text_end;
+            next = end;
+        } else {
+            next = end + 1;
+            line++;
+        }
+
+        /* Parse the line, if it could match the filter */
+        if (!mmap_json_reader->filtered ||
+            tlog_json_msg_filter_prematch(&mmap_json_reader->filter,
+                                          p, (size_t)(end - p))) {
+            grc = tlog_mmap_json_reader_block_add(block, &entry);
+            if (grc != TLOG_RC_OK) {
+                block->grc = grc;
+                break;
+            }
+            entry->grc = tlog_mmap_json_reader_parse_msg(tok, &entry->buf,
+                                                         p, end,
+                                                         &entry->msg);
+            entry->line = line;
+        }
+        p = next;
+    }
+
+    block->line_num = line;
+    return true;
+}
+
+/**
+ * Worker thread function: parse queued blocks, until stopped.
+ *
+ * @param arg   The worker data.
+ *
+ * @return NULL.
+ */
+static void *
+tlog_mmap_json_reader_worker(void *arg)
+{
+    struct tlog_mmap_json_reader_worker *worker =
+                        (struct tlog_mmap_json_reader_worker *)arg;
+    struct tlog_mmap_json_reader *mmap_json_reader = worker->reader;
+    struct tlog_mmap_json_reader_block *block;
+    bool parsed;
+    size_t i;
+
+    pthread_mutex_lock(&mmap_json_reader->mutex);
+    while (true) {
+        /* Find the first queued block */
+        block = NULL;
+        for (i = 0; i < mmap_json_reader->block_count; i++) {
+            block = &mmap_json_reader->block_list[
+                        (mmap_json_reader->block_head + i) %
+                        mmap_json_reader->block_num];
+            if (block->state == TLOG_MMAP_JSON_READER_BLOCK_STATE_QUEUED) {
+                break;
+            }
+            block = NULL;
+        }
+        if (block == NULL) {
+            if (mmap_json_reader->stop) {
+                break;
+            }
+            pthread_cond_wait(&mmap_json_reader->cond,
+                              &mmap_json_reader->mutex);
+            continue;
+        }
+
+        block->state = TLOG_MMAP_JSON_READER_BLOCK_STATE_PARSING;
+        pthread_mutex_unlock(&mmap_json_reader->mutex);
+        parsed = tlog_mmap_json_reader_block_parse(mmap_json_reader,
+                                                   worker->tok, block);
+        pthread_mutex_lock(&mmap_json_reader->mutex);
+        if (!parsed) {
+            mmap_json_reader->truncated = true;
+        }
+        block->state = TLOG_MMAP_JSON_READER_BLOCK_STATE_DONE;
+        pthread_cond_broadcast(&mmap_json_reader->cond);
+    }
+    pthread_mutex_unlock(&mmap_json_reader->mutex);
+
+    return NULL;
+}
+
+/**
+ * Queue blocks of lines following the last queued one, for the workers to
+ * parse, while there are free blocks, unless the file was truncated below
+ * the text mapped. Called with the mutex held.
+ *
+ * @param mmap_json_reader  The reader to queue blocks for.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_queue(struct tlog_mmap_json_reader *mmap_json_reader)
+{
+    struct tlog_mmap_json_reader_block *block;
+    const char *start;
+    const char *end;
+    const char *map_end = mmap_json_reader->map + mmap_json_reader->size;
+    size_t line;
+    bool truncated;
+    tlog_grc grc;
+
+    if (mmap_json_reader->block_count >= mmap_json_reader->block_num ||
+        mmap_json_reader->pos >= mmap_json_reader->size) {
+        return TLOG_RC_OK;
+    }
+
+    /* Don't cut blocks past the end of the file */
+    grc = tlog_mmap_json_reader_check(mmap_json_reader, &truncated);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    if (truncated) {
+        mmap_json_reader->truncated = true;
+        return TLOG_RC_OK;
+    }
+
+    while (mmap_json_reader->block_count < mmap_json_reader->block_num) {
+        /* Skip the text not matching the filter, according to the index */
+        line = tlog_mmap_json_reader_index_skip(
+                            mmap_json_reader,
+                            mmap_json_reader->filtered
+                                ? &mmap_json_reader->filter : NULL);
+        if (line != 0) {
+            mmap_json_reader->queue_line = line;
+        }
+        if (mmap_json_reader->pos >= mmap_json_reader->size) {
+            break;
+        }
+
+        /* Cut a block at a line boundary */
+        start = mmap_json_reader->map + mmap_json_reader->pos;
+        if (map_end - start > TLOG_MMAP_JSON_READER_BLOCK_SIZE) {
+            end = memchr(start + TLOG_MMAP_JSON_READER_BLOCK_SIZE - 1, '\n',
+                         map_end - start -
+                            TLOG_MMAP_JSON_READER_BLOCK_SIZE + 1);
+            end = end == NULL ? map_end : end + 1;
+        } else {
+            end = map_end;
+        }
+
+        block = &mmap_json_reader->block_list[
+                    (mmap_json_reader->block_head +
+                     mmap_json_reader->block_count) %
+                    mmap_json_reader->block_num];
+        assert(block->state == TLOG_MMAP_JSON_READER_BLOCK_STATE_FREE);
+        block->state = TLOG_MMAP_JSON_READER_BLOCK_STATE_QUEUED;
+        block->start = start;
+        block->end = end;
+        block->line = mmap_json_reader->queue_line;
+        mmap_json_reader->queue_line = 0;
+        mmap_json_reader->block_count++;
+        mmap_json_reader->pos = end - mmap_json_reader->map;
+        pthread_cond_broadcast(&mmap_json_reader->cond);
+    }
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Drop all the blocks of an mmap_json_reader, along with the messages not
+ * read, once the workers are done with them, and map the file over to
+ * read it from the beginning, after it was found truncated. Called with
+ * the mutex held.
+ *
+ * @param mmap_json_reader  The reader to drop the blocks of.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_drop(struct tlog_mmap_json_reader *mmap_json_reader)
+{
+    struct tlog_mmap_json_reader_block *block;
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < mmap_json_reader->block_count; i++) {
+        block = &mmap_json_reader->block_list[
+                    (mmap_json_reader->block_head + i) %
+                    mmap_json_reader->block_num];
+        while (block->state == TLOG_MMAP_JSON_READER_BLOCK_STATE_PARSING) {
+            pthread_cond_wait(&mmap_json_reader->cond,
+                              &mmap_json_reader->mutex);
+        }
+        for (j = 0; j < block->entry_num; j++) {
+            tlog_json_msg_cleanup(&block->entry_list[j].msg);
+        }
+        block->entry_num = 0;
+        block->line = 0;
+        block->grc = TLOG_RC_OK;
+        block->state = TLOG_MMAP_JSON_READER_BLOCK_STATE_FREE;
+    }
+    mmap_json_reader->block_head = 0;
+    mmap_json_reader->block_count = 0;
+    mmap_json_reader->entry_idx = 0;
+    mmap_json_reader->truncated = false;
+
+    tlog_mmap_json_reader_restart(mmap_json_reader);
+    return tlog_mmap_json_reader_remap(mmap_json_reader);
+}
+
+/**
+ * Continue counting lines from the line the head block starts at, if lines
+ * were skipped before it. Called with the mutex held.
+ *
+ * @param mmap_json_reader  The reader to continue counting lines for.
+ * @param block             The head block.
+ */
+static void
+tlog_mmap_json_reader_block_start(
+                    struct tlog_mmap_json_reader *mmap_json_reader,
+                    struct tlog_mmap_json_reader_block *block)
+{
+    if (block->line != 0) {
+        mmap_json_reader->line_base = block->line;
+        mmap_json_reader->line = block->line;
+        block->line = 0;
+    }
+}
+
+/**
+ * Read a message parsed by the workers, in order.
+ *
+ * @param mmap_json_reader  The reader to read the message from.
+ * @param filter            The filter to skip lines with, or NULL.
+ * @param msg               The void message to initialize.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_reader_read_msg_par(
+                    struct tlog_mmap_json_reader *mmap_json_reader,
+                    const struct tlog_json_msg_filter *filter,
+                    struct tlog_json_msg *msg)
+{
+    struct tlog_mmap_json_reader_block *block;
+    struct tlog_mmap_json_reader_entry *entry;
+    size_t size;
+    tlog_grc grc;
+
+    pthread_mutex_lock(&mmap_json_reader->mutex);
+
+    /* The workers apply the filter given first to all the lines */
+    if (!mmap_json_reader->started) {
+        mmap_json_reader->started = true;
+        mmap_json_reader->line_base = mmap_json_reader->line;
+        mmap_json_reader->filtered = filter != NULL;
+        if (filter != NULL) {
+            mmap_json_reader->filter = *filter;
+        }
+    }
+    assert(mmap_json_reader->filtered == (filter != NULL));
+    assert(filter == NULL ||
+           (filter->host == mmap_json_reader->filter.host &&
+            filter->user == mmap_json_reader->filter.user &&
+            filter->session == mmap_json_reader->filter.session));
+
+    while (true) {
+        block = &mmap_json_reader->block_list[mmap_json_reader->block_head];
+
+        /* Free the head block, if it was read completely */
+        if (mmap_json_reader->block_count > 0 &&
+            block->state == TLOG_MMAP_JSON_READER_BLOCK_STATE_DONE &&
+            mmap_json_reader->entry_idx >= block->entry_num) {
+            tlog_mmap_json_reader_block_start(mmap_json_reader, block);
+            mmap_json_reader->line_base += block->line_num;
+            mmap_json_reader->line = mmap_json_reader->line_base;
+            block->state = TLOG_MMAP_JSON_READER_BLOCK_STATE_FREE;
+            block->entry_num = 0;
+            mmap_json_reader->block_head = (mmap_json_reader->block_head + 1) %
+                                           mmap_json_reader->block_num;
+            mmap_json_reader->block_count--;
+            mmap_json_reader->entry_idx = 0;
+            continue;
+        }
+
+        grc = tlog_mmap_json_reader_queue(mmap_json_reader);
+        if (grc != TLOG_RC_OK) {
+            pthread_mutex_unlock(&mmap_json_reader->mutex);
+            return grc;
+        }
+
+        /* Read the file over, if it was truncated */
+        if (mmap_json_reader->truncated) {
+            grc = tlog_mmap_json_reader_drop(mmap_json_reader);
+            if (grc != TLOG_RC_OK) {
+                pthread_mutex_unlock(&mmap_json_reader->mutex);
+                return grc;
+            }
+            continue;
+        }
+
+        /*
+         * If everything mapped was read, and the workers don't use the
+         * mapping, check if the file has grown, or was truncated
+         */
+        if (mmap_json_reader->block_count == 0) {
+            if (mmap_json_reader->queue_line != 0) {
+                mmap_json_reader->line_base = mmap_json_reader->queue_line;
+                mmap_json_reader->line = mmap_json_reader->queue_line;
+                mmap_json_reader->queue_line = 0;
+            }
+            size = mmap_json_reader->size;
+            grc = tlog_mmap_json_reader_remap(mmap_json_reader);
+            if (grc != TLOG_RC_OK || mmap_json_reader->size == size) {
+                pthread_mutex_unlock(&mmap_json_reader->mutex);
+                return grc;
+            }
+            continue;
+        }
+
+        /* Wait for the head block to be parsed */
+        while (block->state != TLOG_MMAP_JSON_READER_BLOCK_STATE_DONE) {
+            pthread_cond_wait(&mmap_json_reader->cond,
+                              &mmap_json_reader->mutex);
+        }
+        tlog_mmap_json_reader_block_start(mmap_json_reader, block);
+        if (mmap_json_reader->entry_idx < block->entry_num) {
+            break;
+        }
+
+        /* Report a failure to parse the rest of the block */
+        if (block->grc != TLOG_RC_OK) {
+            grc = block->grc;
+            block->grc = TLOG_RC_OK;
+            pthread_mutex_unlock(&mmap_json_reader->mutex);
+            return grc;
+        }
+    }
+
+    /* Hand over the next message, keeping its buffer */
+    entry = &block->entry_list[mmap_json_reader->entry_idx++];
+    *msg = entry->msg;
+    grc = entry->grc;
+    tlog_json_msg_init(&entry->msg, NULL);
+    mmap_json_reader->line = mmap_json_reader->line_base + entry->line;
+
+    pthread_mutex_unlock(&mmap_json_reader->mutex);
+    return grc;
+}
+
+static tlog_grc
+tlog_mmap_json_reader_read_msg(struct tlog_json_reader *reader,
+                               const struct tlog_json_msg_filter *filter,
+                               struct tlog_json_msg *msg)
+{
+    struct tlog_mmap_json_reader *mmap_json_reader =
+                                (struct tlog_mmap_json_reader*)reader;
+    tlog_grc grc;
+    const char *start;
+    const char *end;
+    size_t line;
+
+    if (mmap_json_reader->thread_num > 0) {
+        return tlog_mmap_json_reader_read_msg_par(mmap_json_reader,
+                                                  filter, msg);
+    }
+
+    /* Find the next line which could match the filter */
+    do {
+        grc = tlog_mmap_json_reader_revalidate(mmap_json_reader);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+        line = tlog_mmap_json_reader_index_skip(mmap_json_reader, filter);
+        if (line != 0) {
+            mmap_json_reader->line = line;
+        }
+        grc = tlog_mmap_json_reader_next_line(mmap_json_reader,
+                                              &start, &end);
+        if (grc != TLOG_RC_OK || start == NULL) {
+            return grc;
+        }
+    } while (filter != NULL &&
+             !tlog_json_msg_filter_prematch(filter, start,
+                                            (size_t)(end - start)));
+
+    return tlog_mmap_json_reader_parse_msg(mmap_json_reader->tok,
+                                           &mmap_json_reader->buf,
+                                           start, end, msg);
+}
+
+static tlog_grc
+tlog_mmap_json_reader_init(struct tlog_json_reader *reader, va_list ap)
+{
+    struct tlog_mmap_json_reader *mmap_json_reader =
+                                (struct tlog_mmap_json_reader*)reader;
+    int fd = va_arg(ap, int);
+    bool fd_owned = (bool)va_arg(ap, int);
+    unsigned int thread_num = va_arg(ap, unsigned int);
+    const struct tlog_index *index = va_arg(ap, const struct tlog_index *);
+    uint64_t pos_min = va_arg(ap, uint64_t);
+    struct tlog_mmap_json_reader_worker *worker;
+    tlog_grc grc;
+    unsigned int i;
+    int err;
+    sigset_t all_set;
+    sigset_t orig_set;
+
+    assert(fd >= 0);
+
+    mmap_json_reader->fd = fd;
+    mmap_json_reader->line = 1;
+    mmap_json_reader->index = index;
+    mmap_json_reader->pos_min = pos_min;
+
+    mmap_json_reader->tok = json_tokener_new();
+    if (mmap_json_reader->tok == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    grc = tlog_mmap_json_reader_remap(mmap_json_reader);
+    if (grc != TLOG_RC_OK) {
+        goto error;
+    }
+
+    /* Start the workers, if parsing in parallel */
+    if (thread_num > 1) {
+        mmap_json_reader->block_num =
+            thread_num * TLOG_MMAP_JSON_READER_THREAD_BLOCK_NUM;
+        mmap_json_reader->block_list =
+            calloc(mmap_json_reader->block_num,
+                   sizeof(*mmap_json_reader->block_list));
+        if (mmap_json_reader->block_list == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto error;
+        }
+        mmap_json_reader->worker_list =
+            calloc(thread_num, sizeof(*mmap_json_reader->worker_list));
+        if (mmap_json_reader->worker_list == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto error;
+        }
+        mmap_json_reader->thread_num = thread_num;
+
+        err = pthread_mutex_init(&mmap_json_reader->mutex, NULL);
+        if (err != 0) {
+            grc = TLOG_GRC_FROM(errno, err);
+            goto error;
+        }
+        err = pthread_cond_init(&mmap_json_reader->cond, NULL);
+        if (err != 0) {
+            pthread_mutex_destroy(&mmap_json_reader->mutex);
+            grc = TLOG_GRC_FROM(errno, err);
+            goto error;
+        }
+        mmap_json_reader->sync_init = true;
+
+        for (i = 0; i < thread_num; i++) {
+            worker = &mmap_json_reader->worker_list[i];
+            worker->reader = mmap_json_reader;
+            worker->tok = json_tokener_new();
+            if (worker->tok == NULL) {
+                grc = TLOG_GRC_ERRNO;
+                goto error;
+            }
+            /* Start with signals blocked, to leave them to the caller */
+            sigfillset(&all_set);
+            pthread_sigmask(SIG_SETMASK, &all_set, &orig_set);
+            err = pthread_create(&worker->thread, NULL,
+                                 tlog_mmap_json_reader_worker, worker);
+            pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+            if (err != 0) {
+                grc = TLOG_GRC_FROM(errno, err);
+                goto error;
+            }
+            worker->init = true;
+        }
+    }
+
+    /* Take over the FD only on success */
+    mmap_json_reader->fd_owned = fd_owned;
+    return TLOG_RC_OK;
+
+error:
+    tlog_mmap_json_reader_cleanup(reader);
+    return grc;
+}
+
+const struct tlog_json_reader_type tlog_mmap_json_reader_type = {
+    .size       = sizeof(struct tlog_mmap_json_reader),
+    .init       = tlog_mmap_json_reader_init,
+    .is_valid   = tlog_mmap_json_reader_is_valid,
+    .loc_get    = tlog_mmap_json_reader_loc_get,
+    .loc_fmt    = tlog_mmap_json_reader_loc_fmt,
+    .read       = tlog_mmap_json_reader_read,
+    .read_msg   = tlog_mmap_json_reader_read_msg,
+    .cleanup    = tlog_mmap_json_reader_cleanup,
+};
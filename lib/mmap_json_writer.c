@@ -0,0 +1,214 @@
+/*
+ * Memory-mapped file JSON message writer.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <tlog/rc.h>
+#include <tlog/misc.h>
+#include <tlog/mmap_json_writer.h>
+
+/** Memory-mapped file writer data */
+struct tlog_mmap_json_writer {
+    struct tlog_json_writer     writer;     /**< Abstract writer instance */
+    int                         fd;         /**< Log file FD */
+    size_t                      extent;     /**< Extent size, page-aligned,
+                                                 bytes */
+    off_t                       end;        /**< Offset past the last
+                                                 message */
+    off_t                       alloc;      /**< Allocated file size */
+    uint8_t                    *map;        /**< Mapped window, or NULL */
+    off_t                       map_off;    /**< Window file offset */
+    size_t                      map_size;   /**< Window size */
+};
+
+/**
+ * Map a window over the file's tail, able to hold a message of the
+ * specified length at the end, allocating the file space as necessary.
+ *
+ * @param mmap_json_writer  The writer to map the window for.
+ * @param len               The length of the message to fit.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_mmap_json_writer_map(struct tlog_mmap_json_writer *mmap_json_writer,
+                          size_t len)
+{
+    off_t off;
+    size_t size;
+    int rc;
+
+    off = mmap_json_writer->end -
+          mmap_json_writer->end % (off_t)sysconf(_SC_PAGESIZE);
+    size = TLOG_ROUND_UP((size_t)(mmap_json_writer->end - off) + len,
+                         mmap_json_writer->extent);
+
+    if (mmap_json_writer->map != NULL) {
+        munmap(mmap_json_writer->map, mmap_json_writer->map_size);
+        mmap_json_writer->map = NULL;
+    }
+
+    /* Allocate the space for real, so running out of it is not a SIGBUS */
+    if (off + (off_t)size > mmap_json_writer->alloc) {
+        rc = posix_fallocate(mmap_json_writer->fd, mmap_json_writer->alloc,
+                             off + (off_t)size - mmap_json_writer->alloc);
+        if (rc != 0) {
+            return TLOG_GRC_FROM(errno, rc);
+        }
+        mmap_json_writer->alloc = off + (off_t)size;
+    }
+
+    mmap_json_writer->map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED, mmap_json_writer->fd, off);
+    if (mmap_json_writer->map == MAP_FAILED) {
+        mmap_json_writer->map = NULL;
+        return TLOG_GRC_ERRNO;
+    }
+    /* Don't let forked children hold the file, and so the lock, open */
+    madvise(mmap_json_writer->map, size, MADV_DONTFORK);
+    mmap_json_writer->map_off = off;
+    mmap_json_writer->map_size = size;
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+tlog_mmap_json_writer_write(struct tlog_json_writer *writer,
+                            const uint8_t *buf,
+                            size_t len)
+{
+    struct tlog_mmap_json_writer *mmap_json_writer =
+                                (struct tlog_mmap_json_writer*)writer;
+    tlog_grc grc;
+
+    if (mmap_json_writer->map == NULL ||
+        mmap_json_writer->end + (off_t)len >
+            mmap_json_writer->map_off + (off_t)mmap_json_writer->map_size) {
+        grc = tlog_mmap_json_writer_map(mmap_json_writer, len);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+    }
+
+    memcpy(mmap_json_writer->map +
+                (mmap_json_writer->end - mmap_json_writer->map_off),
+           buf, len);
+    mmap_json_writer->end += len;
+    return TLOG_RC_OK;
+}
+
+static void
+tlog_mmap_json_writer_cleanup(struct tlog_json_writer *writer)
+{
+    struct tlog_mmap_json_writer *mmap_json_writer =
+                                (struct tlog_mmap_json_writer*)writer;
+    struct stat st;
+
+    if (mmap_json_writer->map != NULL) {
+        munmap(mmap_json_writer->map, mmap_json_writer->map_size);
+        mmap_json_writer->map = NULL;
+    }
+    if (mmap_json_writer->fd >= 0) {
+        /*
+         * Drop the unused tail, or leave it to be dropped on next open,
+         * unless somebody ignoring the lock changed the file meanwhile.
+         */
+        if (mmap_json_writer->alloc > mmap_json_writer->end &&
+            fstat(mmap_json_writer->fd, &st) == 0 &&
+            st.st_size == mmap_json_writer->alloc &&
+            ftruncate(mmap_json_writer->fd, mmap_json_writer->end) == 0) {
+            mmap_json_writer->alloc = mmap_json_writer->end;
+        }
+        close(mmap_json_writer->fd);
+        mmap_json_writer->fd = -1;
+    }
+}
+
+static tlog_grc
+tlog_mmap_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    struct tlog_mmap_json_writer *mmap_json_writer =
+                                (struct tlog_mmap_json_writer*)writer;
+    const char *path = va_arg(ap, const char *);
+    size_t extent = va_arg(ap, size_t);
+    struct stat st;
+    tlog_grc grc;
+
+    mmap_json_writer->extent = TLOG_ROUND_UP(extent,
+                                             (size_t)sysconf(_SC_PAGESIZE));
+
+    /* Open and lock the log file */
+    mmap_json_writer->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC,
+                                S_IRUSR | S_IWUSR);
+    if (mmap_json_writer->fd < 0) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    /*
+     * Don't wait for the file, so the caller can fall back to another one,
+     * instead of blocking, while the holder is recording.
+     */
+    if (flock(mmap_json_writer->fd, LOCK_EX | LOCK_NB) < 0) {
+        grc = errno == EWOULDBLOCK ? TLOG_RC_MMAP_JSON_WRITER_LOCKED
+                                   : TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    /* Find the end of the messages, dropping what's left after a crash */
+    if (fstat(mmap_json_writer->fd, &st) < 0) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    grc = tlog_find_zero_tail(mmap_json_writer->fd, 0, st.st_size,
+                              &mmap_json_writer->end);
+    if (grc != TLOG_RC_OK) {
+        goto error;
+    }
+    mmap_json_writer->alloc = st.st_size;
+
+    return TLOG_RC_OK;
+
+error:
+    tlog_mmap_json_writer_cleanup(writer);
+    return grc;
+}
+
+static bool
+tlog_mmap_json_writer_is_valid(const struct tlog_json_writer *writer)
+{
+    struct tlog_mmap_json_writer *mmap_json_writer =
+                                (struct tlog_mmap_json_writer*)writer;
+    return mmap_json_writer->fd >= 0 &&
+           mmap_json_writer->end <= mmap_json_writer->alloc;
+}
+
+const struct tlog_json_writer_type tlog_mmap_json_writer_type = {
+    .size       = sizeof(struct tlog_mmap_json_writer),
+    .init       = tlog_mmap_json_writer_init,
+    .is_valid   = tlog_mmap_json_writer_is_valid,
+    .write      = tlog_mmap_json_writer_write,
+    .cleanup    = tlog_mmap_json_writer_cleanup,
+};
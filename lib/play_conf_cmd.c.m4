@@ -41,7 +41,8 @@ m4_generated_warning(` * ')m4_dnl
 
 static const char *tlog_play_conf_cmd_help_fmt =
     "Usage: %1$s [OPTION...]\n"
-    "Play back a terminal I/O recording done by tlog-rec.\n"
+    "   or: %1$s --export=MODE [OPTION...] [LOG_FILE...]\n"
+    "Play back, or export a terminal I/O recording done by tlog-rec.\n"
 M4_CONF_CMD_HELP_OPTS()m4_dnl
     "";
 
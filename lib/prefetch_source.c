@@ -0,0 +1,334 @@
+/*
+ * Prefetching source.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <tlog/rc.h>
+#include <tlog/misc.h>
+#include <tlog/prefetch_source.h>
+
+/** Prefetched packet slot */
+struct tlog_prefetch_source_slot {
+    tlog_grc        grc;    /**< Return code of reading the packet */
+    size_t          loc;    /**< Source location before the packet */
+    struct tlog_pkt pkt;    /**< The packet, void at the end of stream,
+                                 or on error, I/O data in the buffer */
+    uint8_t        *buf;    /**< I/O data buffer */
+    size_t          size;   /**< I/O data buffer size */
+};
+
+/** Prefetching source instance */
+struct tlog_prefetch_source {
+    struct tlog_source          source;     /**< Abstract source instance */
+    struct tlog_source         *inner;      /**< Source being read ahead */
+    bool                        inner_owned;/**< True if inner source is
+                                                 owned */
+    struct tlog_prefetch_source_slot
+                               *slot_list;  /**< Ring of packet slots */
+    size_t                      slot_num;   /**< Number of slots */
+    bool                        thread_init;/**< True if thread started */
+    pthread_t                   thread;     /**< Reading thread */
+
+    /* Data shared with the reading thread under the mutex */
+    bool                        sync_init;  /**< True if the mutex and the
+                                                 condition are initialized */
+    pthread_mutex_t             mutex;      /**< Shared data mutex */
+    pthread_cond_t              cond;       /**< Shared data change
+                                                 condition */
+    bool                        stop;       /**< True if the reading thread
+                                                 should exit */
+    bool                        paused;     /**< True if reading stopped at
+                                                 the end of stream, or an
+                                                 error, until the next packet
+                                                 is requested after it */
+    size_t                      slot_head;  /**< Index of the next slot to
+                                                 deliver */
+    size_t                      slot_count; /**< Number of filled slots */
+    bool                        slot_held;  /**< True if the slot before
+                                                 the head was delivered and
+                                                 can still be in use */
+    size_t                      loc;        /**< Source location after the
+                                                 last packet read */
+};
+
+/**
+ * Reading thread function: read packets into free slots, until stopped.
+ *
+ * @param arg   The prefetching source.
+ *
+ * @return NULL.
+ */
+static void *
+tlog_prefetch_source_thread(void *arg)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)arg;
+    struct tlog_prefetch_source_slot *slot;
+    struct tlog_pkt pkt = TLOG_PKT_VOID;
+    uint8_t *buf;
+    size_t loc;
+
+    pthread_mutex_lock(&prefetch_source->mutex);
+    while (!prefetch_source->stop) {
+        if (prefetch_source->paused ||
+            prefetch_source->slot_count + prefetch_source->slot_held >=
+                prefetch_source->slot_num) {
+            pthread_cond_wait(&prefetch_source->cond,
+                              &prefetch_source->mutex);
+            continue;
+        }
+        slot = &prefetch_source->slot_list[
+                    (prefetch_source->slot_head +
+                     prefetch_source->slot_count) %
+                    prefetch_source->slot_num];
+        pthread_mutex_unlock(&prefetch_source->mutex);
+
+        /* Read the packet into the free slot */
+        slot->loc = tlog_source_loc_get(prefetch_source->inner);
+        slot->pkt = TLOG_PKT_VOID;
+        slot->grc = tlog_source_read(prefetch_source->inner, &pkt);
+        if (slot->grc == TLOG_RC_OK && pkt.type == TLOG_PKT_TYPE_IO) {
+            if (pkt.data.io.len > slot->size) {
+                buf = realloc(slot->buf, pkt.data.io.len);
+                if (buf == NULL) {
+                    slot->grc = TLOG_GRC_ERRNO;
+                } else {
+                    slot->buf = buf;
+                    slot->size = pkt.data.io.len;
+                }
+            }
+            if (slot->grc == TLOG_RC_OK) {
+                memcpy(slot->buf, pkt.data.io.buf, pkt.data.io.len);
+                tlog_pkt_init_io(&slot->pkt, &pkt.timestamp,
+                                 pkt.data.io.output, slot->buf, false,
+                                 pkt.data.io.len);
+            }
+        } else if (slot->grc == TLOG_RC_OK) {
+            slot->pkt = pkt;
+        }
+        tlog_pkt_cleanup(&pkt);
+        loc = tlog_source_loc_get(prefetch_source->inner);
+
+        /* Deliver it, pausing after the end of stream, or an error */
+        pthread_mutex_lock(&prefetch_source->mutex);
+        prefetch_source->slot_count++;
+        prefetch_source->loc = loc;
+        if (slot->grc != TLOG_RC_OK || tlog_pkt_is_void(&slot->pkt)) {
+            prefetch_source->paused = true;
+        }
+        pthread_cond_broadcast(&prefetch_source->cond);
+    }
+    pthread_mutex_unlock(&prefetch_source->mutex);
+
+    return NULL;
+}
+
+static void
+tlog_prefetch_source_cleanup(struct tlog_source *source)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)source;
+    size_t i;
+
+    assert(prefetch_source != NULL);
+
+    /* Stop the reading thread */
+    if (prefetch_source->sync_init) {
+        pthread_mutex_lock(&prefetch_source->mutex);
+        prefetch_source->stop = true;
+        pthread_cond_broadcast(&prefetch_source->cond);
+        pthread_mutex_unlock(&prefetch_source->mutex);
+    }
+    if (prefetch_source->thread_init) {
+        pthread_join(prefetch_source->thread, NULL);
+        prefetch_source->thread_init = false;
+    }
+    if (prefetch_source->sync_init) {
+        pthread_cond_destroy(&prefetch_source->cond);
+        pthread_mutex_destroy(&prefetch_source->mutex);
+        prefetch_source->sync_init = false;
+    }
+
+    if (prefetch_source->slot_list != NULL) {
+        for (i = 0; i < prefetch_source->slot_num; i++) {
+            free(prefetch_source->slot_list[i].buf);
+        }
+        free(prefetch_source->slot_list);
+        prefetch_source->slot_list = NULL;
+    }
+
+    if (prefetch_source->inner_owned) {
+        tlog_source_destroy(prefetch_source->inner);
+        prefetch_source->inner_owned = false;
+    }
+}
+
+static tlog_grc
+tlog_prefetch_source_init(struct tlog_source *source, va_list ap)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)source;
+    struct tlog_source *inner = va_arg(ap, struct tlog_source *);
+    bool inner_owned = (bool)va_arg(ap, int);
+    size_t size = va_arg(ap, size_t);
+    sigset_t all_set;
+    sigset_t orig_set;
+    tlog_grc grc;
+    int err;
+
+    assert(tlog_source_is_valid(inner));
+    assert(size > 0);
+
+    prefetch_source->inner = inner;
+    prefetch_source->loc = tlog_source_loc_get(inner);
+
+    prefetch_source->slot_list = calloc(size,
+                                        sizeof(*prefetch_source->slot_list));
+    if (prefetch_source->slot_list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    prefetch_source->slot_num = size;
+
+    err = pthread_mutex_init(&prefetch_source->mutex, NULL);
+    if (err != 0) {
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    err = pthread_cond_init(&prefetch_source->cond, NULL);
+    if (err != 0) {
+        pthread_mutex_destroy(&prefetch_source->mutex);
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    prefetch_source->sync_init = true;
+
+    /* Start the thread with signals blocked, to leave them to the caller */
+    sigfillset(&all_set);
+    pthread_sigmask(SIG_SETMASK, &all_set, &orig_set);
+    err = pthread_create(&prefetch_source->thread, NULL,
+                         tlog_prefetch_source_thread, prefetch_source);
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+    if (err != 0) {
+        grc = TLOG_GRC_FROM(errno, err);
+        goto error;
+    }
+    prefetch_source->thread_init = true;
+
+    /* Take over the source only on success */
+    prefetch_source->inner_owned = inner_owned;
+    return TLOG_RC_OK;
+
+error:
+    tlog_prefetch_source_cleanup(source);
+    return grc;
+}
+
+static bool
+tlog_prefetch_source_is_valid(const struct tlog_source *source)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)source;
+    return prefetch_source != NULL &&
+           tlog_source_is_valid(prefetch_source->inner) &&
+           prefetch_source->slot_list != NULL &&
+           prefetch_source->slot_num > 0 &&
+           prefetch_source->thread_init;
+}
+
+static size_t
+tlog_prefetch_source_loc_get(const struct tlog_source *source)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)source;
+    size_t loc;
+
+    /* Return the location of the next packet to deliver */
+    pthread_mutex_lock(&prefetch_source->mutex);
+    if (prefetch_source->slot_count > 0) {
+        loc = prefetch_source->slot_list[prefetch_source->slot_head].loc;
+    } else {
+        loc = prefetch_source->loc;
+    }
+    pthread_mutex_unlock(&prefetch_source->mutex);
+    return loc;
+}
+
+static char *
+tlog_prefetch_source_loc_fmt(const struct tlog_source *source, size_t loc)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)source;
+    return tlog_source_loc_fmt(prefetch_source->inner, loc);
+}
+
+static tlog_grc
+tlog_prefetch_source_read(struct tlog_source *source, struct tlog_pkt *pkt)
+{
+    struct tlog_prefetch_source *prefetch_source =
+                                (struct tlog_prefetch_source *)source;
+    struct tlog_prefetch_source_slot *slot;
+    tlog_grc grc;
+
+    pthread_mutex_lock(&prefetch_source->mutex);
+
+    /* Release the slot delivered last */
+    if (prefetch_source->slot_held) {
+        prefetch_source->slot_held = false;
+        pthread_cond_broadcast(&prefetch_source->cond);
+    }
+
+    /* Wait for a packet, resuming reading after the end or an error */
+    while (prefetch_source->slot_count == 0) {
+        if (prefetch_source->paused) {
+            prefetch_source->paused = false;
+            pthread_cond_broadcast(&prefetch_source->cond);
+        }
+        pthread_cond_wait(&prefetch_source->cond, &prefetch_source->mutex);
+    }
+
+    /* Deliver the packet, keeping the slot until the next read */
+    slot = &prefetch_source->slot_list[prefetch_source->slot_head];
+    prefetch_source->slot_head = (prefetch_source->slot_head + 1) %
+                                 prefetch_source->slot_num;
+    prefetch_source->slot_count--;
+    prefetch_source->slot_held = true;
+    grc = slot->grc;
+    *pkt = slot->pkt;
+
+    pthread_mutex_unlock(&prefetch_source->mutex);
+    return grc;
+}
+
+const struct tlog_source_type tlog_prefetch_source_type = {
+    .size       = sizeof(struct tlog_prefetch_source),
+    .init       = tlog_prefetch_source_init,
+    .is_valid   = tlog_prefetch_source_is_valid,
+    .loc_get    = tlog_prefetch_source_loc_get,
+    .loc_fmt    = tlog_prefetch_source_loc_fmt,
+    .read       = tlog_prefetch_source_read,
+    .cleanup    = tlog_prefetch_source_cleanup,
+};
@@ -47,6 +47,8 @@ static const char *tlog_rc_desc_list[TLOG_RC_MAX_PLUS_ONE - TLOG_RC_MIN] = {
         "Message has invalid \"in_txt\" or \"out_txt\" field value",
     [TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_BIN] =
         "Message has invalid \"in_bin\" or \"out_bin\" field value",
+    [TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED] =
+        "Message layout is unexpected",
     [TLOG_RC_FD_JSON_READER_INCOMPLETE_LINE] =
         "Incomplete message object line encountered",
     [TLOG_RC_JSON_SOURCE_MSG_ID_OUT_OF_ORDER] =
@@ -61,6 +63,33 @@ static const char *tlog_rc_desc_list[TLOG_RC_MAX_PLUS_ONE - TLOG_RC_MIN] = {
         "Invalid reply received from HTTP server",
     [TLOG_RC_MEM_JSON_READER_INCOMPLETE_LINE] =
         "Incomplete message object line encountered",
+    [TLOG_RC_ES_JSON_WRITER_CURL_INIT_FAILED] =
+        "Curl handle creation failed",
+    [TLOG_RC_ES_JSON_WRITER_COMPRESSION_FAILED] =
+        "Failed compressing a bulk request",
+    [TLOG_RC_ES_JSON_WRITER_HTTP_ERROR] =
+        "HTTP server replied with an error status",
+    [TLOG_RC_ES_JSON_WRITER_REPLY_INVALID] =
+        "Invalid bulk reply received from HTTP server",
+    [TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED] =
+        "ElasticSearch rejected some of the bulk messages",
+    [TLOG_RC_ES_JSON_WRITER_ITEMS_HELD] =
+        "ElasticSearch didn't accept some of the bulk messages in time, "
+        "kept for retrying",
+    [TLOG_RC_SPOOL_JSON_WRITER_LOCKED] =
+        "Spool file is in use by another process",
+    [TLOG_RC_SPOOL_JSON_WRITER_FULL] =
+        "Spool is full",
+    [TLOG_RC_MMAP_JSON_WRITER_LOCKED] =
+        "Log file is in use by another process",
+    [TLOG_RC_INDEX_INVALID] =
+        "Index file is invalid",
+    [TLOG_RC_INDEX_LOG_TRUNCATED] =
+        "Log file is shorter than indexed, remove the index to rebuild it",
+    [TLOG_RC_SESSION_LIST_CURL_INIT_FAILED] =
+        "Curl handle creation failed",
+    [TLOG_RC_SESSION_LIST_REPLY_INVALID] =
+        "Invalid aggregation reply received from HTTP server",
 };
 
 const char *
@@ -28,9 +28,23 @@
 #include <tlog/json_misc.h>
 #include <tlog/rc.h>
 #include <tlog/misc.h>
+#include <tlog/syslog_misc.h>
+#include <tlog/fd_json_writer.h>
+#include <tlog/syslog_json_writer.h>
+#include <tlog/es_json_writer.h>
+#include <tlog/collector_json_writer.h>
+#include <tlog/spool_json_writer.h>
+#include <tlog/fanout_json_writer.h>
+#include <tlog/mmap_json_writer.h>
+#include <sys/stat.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <assert.h>
 
 static tlog_grc
@@ -185,6 +199,35 @@ cleanup:
     return grc;
 }
 
+tlog_grc
+tlog_rec_conf_load_default(struct tlog_errs **perrs,
+                           struct json_object **pconf,
+                           const char *prog_path)
+{
+    tlog_grc grc;
+    char *path = NULL;
+
+    assert(pconf != NULL);
+    assert(prog_path != NULL);
+
+    grc = tlog_build_or_inst_path(&path, prog_path,
+                                  TLOG_REC_CONF_DEFAULT_BUILD_PATH,
+                                  TLOG_REC_CONF_DEFAULT_INST_PATH);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed finding default configuration");
+        goto cleanup;
+    }
+    grc = tlog_rec_conf_file_load(perrs, pconf, path);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed loading default configuration");
+        goto cleanup;
+    }
+cleanup:
+    free(path);
+    return grc;
+}
+
 tlog_grc
 tlog_rec_conf_load(struct tlog_errs **perrs,
                    char **pcmd_help, struct json_object **pconf,
@@ -210,21 +253,10 @@ tlog_rec_conf_load(struct tlog_errs **perrs,
     }
 
     /* Overlay with default config */
-    grc = tlog_build_or_inst_path(&path, argv[0],
-                                  TLOG_REC_CONF_DEFAULT_BUILD_PATH,
-                                  TLOG_REC_CONF_DEFAULT_INST_PATH);
+    grc = tlog_rec_conf_load_default(perrs, &overlay, argv[0]);
     if (grc != TLOG_RC_OK) {
-        tlog_errs_pushc(perrs, grc);
-        tlog_errs_pushs(perrs, "Failed finding default configuration");
-        goto cleanup;
-    }
-    grc = tlog_rec_conf_file_load(perrs, &overlay, path);
-    if (grc != TLOG_RC_OK) {
-        tlog_errs_pushs(perrs, "Failed loading default configuration");
         goto cleanup;
     }
-    free(path);
-    path = NULL;
     grc = tlog_json_overlay(&conf, conf, overlay);
     if (grc != TLOG_RC_OK) {
         tlog_errs_pushc(perrs, grc);
@@ -435,3 +467,572 @@ cleanup:
     free(buf);
     return grc;
 }
+
+/**
+ * Create a memory-mapped file log writer, according to a loaded tlog-rec
+ * configuration file writer JSON object.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param conf_file Tlog-rec configuration file writer JSON object.
+ * @param path      The log file path.
+ * @param pwriter   Location for the created writer pointer.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_rec_conf_get_mmap_writer(struct tlog_errs **perrs,
+                              struct json_object *conf_file,
+                              const char *path,
+                              struct tlog_json_writer **pwriter)
+{
+    tlog_grc grc;
+    struct json_object *obj;
+    int64_t extent;
+    int64_t slots;
+    int64_t slot;
+    char *slot_path = NULL;
+
+    assert(path != NULL);
+    assert(pwriter != NULL);
+
+    /* Get the extent size */
+    if (!json_object_object_get_ex(conf_file, "extent", &obj)) {
+        tlog_errs_pushs(perrs, "Log file extent size is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    extent = json_object_get_int64(obj);
+
+    /* Get the number of slots */
+    if (!json_object_object_get_ex(conf_file, "slots", &obj)) {
+        tlog_errs_pushs(perrs, "Log file slot number is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    slots = json_object_get_int64(obj);
+
+    /* Open the first log file not used by another process */
+    grc = TLOG_RC_MMAP_JSON_WRITER_LOCKED;
+    for (slot = 0; slot < slots; slot++) {
+        free(slot_path);
+        slot_path = NULL;
+        if (slot == 0) {
+            slot_path = strdup(path);
+        } else if (asprintf(&slot_path, "%s.%" PRId64, path, slot) < 0) {
+            slot_path = NULL;
+        }
+        if (slot_path == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed formatting log file path");
+            goto cleanup;
+        }
+        grc = tlog_mmap_json_writer_create(pwriter, slot_path,
+                                           (size_t)extent);
+        if (grc != TLOG_RC_MMAP_JSON_WRITER_LOCKED) {
+            break;
+        }
+    }
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed opening log file \"%s\"",
+                        slot_path);
+        goto cleanup;
+    }
+
+cleanup:
+    free(slot_path);
+    return grc;
+}
+
+bool
+tlog_rec_conf_list_has(const char *list, const char *item)
+{
+    size_t len = strlen(item);
+    const char *end;
+
+    while (true) {
+        end = strchrnul(list, ',');
+        if ((size_t)(end - list) == len && strncmp(list, item, len) == 0) {
+            return true;
+        }
+        if (*end == '\0') {
+            return false;
+        }
+        list = end + 1;
+    }
+}
+
+/**
+ * Create a fan-out log writer, according to a loaded tlog-rec configuration
+ * JSON object.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param conf      Tlog-rec configuration JSON object.
+ * @param pwriter   Location for the created writer pointer.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_rec_conf_get_fanout_writer(struct tlog_errs **perrs,
+                                struct json_object *conf,
+                                struct tlog_json_writer **pwriter)
+{
+    tlog_grc grc;
+    struct json_object *conf_fanout;
+    struct json_object *obj;
+    const char *required = "";
+    int64_t queue;
+    char *list = NULL;
+    char *saveptr = NULL;
+    const char *type;
+    struct tlog_fanout_json_writer_child *child_list = NULL;
+    size_t child_num = 0;
+    size_t i;
+
+    assert(pwriter != NULL);
+
+    /* Get fan-out writer conf container */
+    if (!json_object_object_get_ex(conf, "fanout", &conf_fanout)) {
+        tlog_errs_pushs(perrs, "Fan-out writer parameters are not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /* Get the writer list */
+    if (!json_object_object_get_ex(conf_fanout, "writers", &obj)) {
+        tlog_errs_pushs(perrs, "Fan-out writer list is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    list = strdup(json_object_get_string(obj));
+    if (list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        goto cleanup;
+    }
+
+    /* Get the required writer list */
+    if (json_object_object_get_ex(conf_fanout, "required", &obj)) {
+        required = json_object_get_string(obj);
+    }
+
+    /* Get the queue size */
+    if (!json_object_object_get_ex(conf_fanout, "queue", &obj)) {
+        tlog_errs_pushs(perrs, "Fan-out writer queue size is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    queue = json_object_get_int64(obj);
+
+    /* Allocate a child for each list item, at most */
+    child_list = calloc(strlen(list) / 2 + 1, sizeof(*child_list));
+    if (child_list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        goto cleanup;
+    }
+
+    /* Create the children */
+    for (type = strtok_r(list, ",", &saveptr); type != NULL;
+         type = strtok_r(NULL, ",", &saveptr)) {
+        if (strcmp(type, "fanout") == 0) {
+            tlog_errs_pushs(perrs, "Fan-out writer cannot write to itself");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        grc = tlog_rec_conf_get_writer(perrs, conf, type,
+                                       &child_list[child_num].writer);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        child_list[child_num].owned = true;
+        child_list[child_num].required =
+            tlog_rec_conf_list_has(required, type);
+        child_list[child_num].queue = (size_t)queue;
+        child_num++;
+    }
+    if (child_num == 0) {
+        tlog_errs_pushs(perrs, "Fan-out writer list is empty");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /* Create the writer, letting it take over the children */
+    grc = tlog_fanout_json_writer_create(pwriter, child_list, child_num);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed creating fan-out writer");
+        goto cleanup;
+    }
+    child_num = 0;
+
+cleanup:
+
+    for (i = 0; i < child_num; i++) {
+        tlog_json_writer_destroy(child_list[i].writer);
+    }
+    free(child_list);
+    free(list);
+    return grc;
+}
+
+tlog_grc
+tlog_rec_conf_get_writer(struct tlog_errs **perrs,
+                         struct json_object *conf,
+                         const char *type,
+                         struct tlog_json_writer **pwriter)
+{
+    tlog_grc grc;
+    struct json_object *obj;
+    const char *str;
+    struct tlog_json_writer *writer = NULL;
+    int fd = -1;
+    int rc;
+
+    assert(type != NULL);
+    assert(pwriter != NULL);
+
+    if (strcmp(type, "file") == 0) {
+        struct json_object *conf_file;
+
+        /* Get file writer conf container */
+        if (!json_object_object_get_ex(conf, "file", &conf_file)) {
+            tlog_errs_pushs(perrs, "File writer parameters are not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get the file path */
+        if (!json_object_object_get_ex(conf_file, "path", &obj)) {
+            tlog_errs_pushs(perrs, "Log file path is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        str = json_object_get_string(obj);
+
+        /* Append through a memory mapping, if requested */
+        if (json_object_object_get_ex(conf_file, "mmap", &obj) &&
+            json_object_get_boolean(obj)) {
+            grc = tlog_rec_conf_get_mmap_writer(perrs, conf_file, str,
+                                                &writer);
+            if (grc != TLOG_RC_OK) {
+                goto cleanup;
+            }
+        } else {
+            /* Open the file */
+            fd = open(str, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+            if (fd < 0) {
+                grc = TLOG_GRC_ERRNO;
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushf(perrs, "Failed opening log file \"%s\"", str);
+                goto cleanup;
+            }
+            /* Get file flags */
+            rc = fcntl(fd, F_GETFD);
+            if (rc < 0) {
+                grc = TLOG_GRC_ERRNO;
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushf(perrs,
+                                "Failed getting log file descriptor flags");
+                goto cleanup;
+            }
+            /* Add FD_CLOEXEC to file flags */
+            rc = fcntl(fd, F_SETFD, rc | FD_CLOEXEC);
+            if (rc < 0) {
+                grc = TLOG_GRC_ERRNO;
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushf(perrs,
+                                "Failed setting log file descriptor flags");
+                goto cleanup;
+            }
+
+            /* Create the writer, letting it take over the FD */
+            grc = tlog_fd_json_writer_create(&writer, fd, true);
+            if (grc != TLOG_RC_OK) {
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushs(perrs, "Failed creating file writer");
+                goto cleanup;
+            }
+            fd = -1;
+        }
+    } else if (strcmp(type, "syslog") == 0) {
+        struct json_object *conf_syslog;
+        int facility;
+        int priority;
+
+        /* Get syslog writer conf container */
+        if (!json_object_object_get_ex(conf, "syslog", &conf_syslog)) {
+            tlog_errs_pushs(perrs, "Syslog writer parameters are not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get facility */
+        if (!json_object_object_get_ex(conf_syslog, "facility", &obj)) {
+            tlog_errs_pushs(perrs, "Syslog facility is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        str = json_object_get_string(obj);
+        facility = tlog_syslog_facility_from_str(str);
+        if (facility < 0) {
+            tlog_errs_pushf(perrs, "Unknown syslog facility: %s", str);
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get priority */
+        if (!json_object_object_get_ex(conf_syslog, "priority", &obj)) {
+            tlog_errs_pushs(perrs, "Syslog priority is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        str = json_object_get_string(obj);
+        priority = tlog_syslog_priority_from_str(str);
+        if (priority < 0) {
+            tlog_errs_pushf(perrs, "Unknown syslog priority: %s", str);
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Create the writer */
+        openlog("tlog", LOG_NDELAY, facility);
+        grc = tlog_syslog_json_writer_create(&writer, priority);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating syslog writer");
+            goto cleanup;
+        }
+    } else if (strcmp(type, "es") == 0) {
+        struct json_object *conf_es;
+        const char *baseurl;
+        int64_t batch;
+        int64_t age;
+        int64_t retries;
+        int64_t connect_timeout;
+        int64_t timeout;
+        bool gzip;
+
+        /* Get ElasticSearch writer conf container */
+        if (!json_object_object_get_ex(conf, "es", &conf_es)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch writer parameters "
+                            "are not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get the base URL */
+        if (!json_object_object_get_ex(conf_es, "baseurl", &obj)) {
+            tlog_errs_pushs(perrs, "ElasticSearch base URL is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        baseurl = json_object_get_string(obj);
+
+        /* Check base URL validity */
+        if (!tlog_es_json_writer_base_url_is_valid(baseurl)) {
+            tlog_errs_pushf(perrs,
+                            "Invalid ElasticSearch base URL: %s", baseurl);
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get the batch size */
+        if (!json_object_object_get_ex(conf_es, "batch", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch batch size is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        batch = json_object_get_int64(obj);
+
+        /* Get the maximum batch age */
+        if (!json_object_object_get_ex(conf_es, "age", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch batch age is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        age = json_object_get_int64(obj);
+
+        /* Get the number of retries */
+        if (!json_object_object_get_ex(conf_es, "retries", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch request retries are not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        retries = json_object_get_int64(obj);
+
+        /* Get the connection timeout */
+        if (!json_object_object_get_ex(conf_es, "conntimeout", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch connection timeout "
+                            "is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        connect_timeout = json_object_get_int64(obj);
+
+        /* Get the request timeout */
+        if (!json_object_object_get_ex(conf_es, "timeout", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch request timeout is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        timeout = json_object_get_int64(obj);
+
+        /* Get the compression flag */
+        gzip = json_object_object_get_ex(conf_es, "gzip", &obj) &&
+               json_object_get_boolean(obj);
+
+        /* Create the writer */
+        grc = tlog_es_json_writer_create(&writer, baseurl, (size_t)batch,
+                                         (unsigned int)age,
+                                         (unsigned int)retries,
+                                         (unsigned int)connect_timeout,
+                                         (unsigned int)timeout, gzip);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating ElasticSearch writer");
+            goto cleanup;
+        }
+    } else if (strcmp(type, "collector") == 0) {
+        struct json_object *conf_collector;
+
+        /* Get collector writer conf container */
+        if (!json_object_object_get_ex(conf, "collector", &conf_collector)) {
+            tlog_errs_pushs(perrs,
+                            "Collector writer parameters are not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get the socket path */
+        if (!json_object_object_get_ex(conf_collector, "socket", &obj)) {
+            tlog_errs_pushs(perrs, "Collector socket path is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        str = json_object_get_string(obj);
+
+        /* Create the writer, connecting to the collector */
+        grc = tlog_collector_json_writer_create(&writer, str);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushf(perrs, "Failed connecting to collector at \"%s\"",
+                            str);
+            goto cleanup;
+        }
+    } else if (strcmp(type, "fanout") == 0) {
+        grc = tlog_rec_conf_get_fanout_writer(perrs, conf, &writer);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+    } else {
+        tlog_errs_pushf(perrs, "Unknown writer type: %s", type);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    *pwriter = writer;
+    writer = NULL;
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    tlog_json_writer_destroy(writer);
+    return grc;
+}
+
+tlog_grc
+tlog_rec_conf_get_spool(struct tlog_errs **perrs,
+                        struct json_object *conf,
+                        struct tlog_json_writer **pwriter)
+{
+    tlog_grc grc;
+    struct json_object *conf_spool;
+    struct json_object *obj;
+    const char *path;
+    int64_t size;
+    int64_t retry;
+    int64_t slots;
+    int64_t slot;
+    char *slot_path = NULL;
+    struct tlog_json_writer *writer = NULL;
+
+    assert(pwriter != NULL);
+    assert(tlog_json_writer_is_valid(*pwriter));
+
+    /* Do nothing, unless the spool path is specified */
+    if (!json_object_object_get_ex(conf, "spool", &conf_spool) ||
+        !json_object_object_get_ex(conf_spool, "path", &obj)) {
+        return TLOG_RC_OK;
+    }
+    path = json_object_get_string(obj);
+
+    /* Get the ring size */
+    if (!json_object_object_get_ex(conf_spool, "size", &obj)) {
+        tlog_errs_pushs(perrs, "Spool size is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    size = json_object_get_int64(obj);
+
+    /* Get the retry delay */
+    if (!json_object_object_get_ex(conf_spool, "retry", &obj)) {
+        tlog_errs_pushs(perrs, "Spool retry delay is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    retry = json_object_get_int64(obj);
+
+    /* Get the number of slots */
+    if (!json_object_object_get_ex(conf_spool, "slots", &obj)) {
+        tlog_errs_pushs(perrs, "Spool slot number is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    slots = json_object_get_int64(obj);
+
+    /* Open the first spool file not used by another process */
+    for (slot = 0; slot < slots; slot++) {
+        free(slot_path);
+        slot_path = NULL;
+        if (slot == 0) {
+            slot_path = strdup(path);
+        } else if (asprintf(&slot_path, "%s.%" PRId64, path, slot) < 0) {
+            slot_path = NULL;
+        }
+        if (slot_path == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed formatting spool path");
+            goto cleanup;
+        }
+        grc = tlog_spool_json_writer_create(&writer, *pwriter, true,
+                                            slot_path, (size_t)size,
+                                            (unsigned int)retry);
+        if (grc != TLOG_RC_SPOOL_JSON_WRITER_LOCKED) {
+            break;
+        }
+    }
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed opening spool \"%s\"", slot_path);
+        goto cleanup;
+    }
+
+    *pwriter = writer;
+    grc = TLOG_RC_OK;
+
+cleanup:
+    free(slot_path);
+    return grc;
+}
@@ -0,0 +1,1517 @@
+/*
+ * Terminal screen model.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include <tlog/screen.h>
+#include <tlog/misc.h>
+#include <tlog/rc.h>
+
+/** Tab stop interval */
+#define TLOG_SCREEN_TAB_WIDTH   8
+
+/** Replacement character for invalid UTF-8 */
+#define TLOG_SCREEN_CH_INVALID  0xFFFD
+
+/** Maximum control sequence parameter value kept */
+#define TLOG_SCREEN_PARAM_VAL_MAX   65535
+
+/** DEC special graphics characters for 0x5f-0x7e */
+static const uint32_t tlog_screen_graph_list[] = {
+    0x00A0, 0x25C6, 0x2592, 0x2409, 0x240C, 0x240D, 0x240A, 0x00B0,
+    0x00B1, 0x2424, 0x240B, 0x2518, 0x2510, 0x250C, 0x2514, 0x253C,
+    0x23BA, 0x23BB, 0x2500, 0x23BC, 0x23BD, 0x251C, 0x2524, 0x2534,
+    0x252C, 0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00B7,
+};
+
+/** Default attributes */
+static const struct tlog_screen_attr tlog_screen_attr_default = {
+    .fg     = TLOG_SCREEN_COLOR_DEFAULT,
+    .bg     = TLOG_SCREEN_COLOR_DEFAULT,
+    .flags  = 0,
+};
+
+/**
+ * Check if two attribute sets are equal.
+ *
+ * @param a     The first attribute set.
+ * @param b     The second attribute set.
+ *
+ * @return True if the sets are equal, false otherwise.
+ */
+static bool
+tlog_screen_attr_eq(const struct tlog_screen_attr *a,
+                    const struct tlog_screen_attr *b)
+{
+    return a->fg == b->fg && a->bg == b->bg && a->flags == b->flags;
+}
+
+/**
+ * Get a cell of the shown screen.
+ *
+ * @param screen    The screen to get the cell of.
+ * @param x         The cell column.
+ * @param y         The cell row.
+ *
+ * @return The cell pointer.
+ */
+static struct tlog_screen_cell *
+tlog_screen_cell(struct tlog_screen *screen,
+                 unsigned int x, unsigned int y)
+{
+    assert(x < screen->width);
+    assert(y < screen->height);
+    return &screen->cells[screen->alt][y * screen->width + x];
+}
+
+/**
+ * Blank a range of cells on a row of the shown screen, with the current
+ * background color.
+ *
+ * @param screen    The screen to blank the cells on.
+ * @param y         The row to blank the cells on.
+ * @param start     The first column to blank.
+ * @param end       The column to stop blanking at.
+ */
+static void
+tlog_screen_blank(struct tlog_screen *screen, unsigned int y,
+                  unsigned int start, unsigned int end)
+{
+    struct tlog_screen_cell *cell;
+    struct tlog_screen_cell blank = {
+        .ch = ' ',
+        .attr = {
+            .fg = TLOG_SCREEN_COLOR_DEFAULT,
+            .bg = screen->cursor.attr.bg,
+            .flags = 0
+        }
+    };
+
+    end = TLOG_MIN(end, screen->width);
+    if (start >= end) {
+        return;
+    }
+    for (cell = tlog_screen_cell(screen, start, y);
+         start < end; start++, cell++) {
+        *cell = blank;
+    }
+}
+
+/**
+ * Scroll a range of rows of the shown screen up, blanking the rows
+ * appearing at the bottom.
+ *
+ * @param screen    The screen to scroll.
+ * @param top       The top row of the range.
+ * @param bottom    The bottom row of the range.
+ * @param n         Number of rows to scroll by.
+ */
+static void
+tlog_screen_scroll_up(struct tlog_screen *screen,
+                      unsigned int top, unsigned int bottom, unsigned int n)
+{
+    unsigned int y;
+
+    if (top > bottom) {
+        return;
+    }
+    n = TLOG_MIN(n, bottom - top + 1);
+    memmove(tlog_screen_cell(screen, 0, top),
+            tlog_screen_cell(screen, 0, top + n),
+            sizeof(struct tlog_screen_cell) *
+                screen->width * (bottom - top + 1 - n));
+    for (y = bottom + 1 - n; y <= bottom; y++) {
+        tlog_screen_blank(screen, y, 0, screen->width);
+    }
+}
+
+/**
+ * Scroll a range of rows of the shown screen down, blanking the rows
+ * appearing at the top.
+ *
+ * @param screen    The screen to scroll.
+ * @param top       The top row of the range.
+ * @param bottom    The bottom row of the range.
+ * @param n         Number of rows to scroll by.
+ */
+static void
+tlog_screen_scroll_down(struct tlog_screen *screen,
+                        unsigned int top, unsigned int bottom, unsigned int n)
+{
+    unsigned int y;
+
+    if (top > bottom) {
+        return;
+    }
+    n = TLOG_MIN(n, bottom - top + 1);
+    memmove(tlog_screen_cell(screen, 0, top + n),
+            tlog_screen_cell(screen, 0, top),
+            sizeof(struct tlog_screen_cell) *
+                screen->width * (bottom - top + 1 - n));
+    for (y = top; y < top + n; y++) {
+        tlog_screen_blank(screen, y, 0, screen->width);
+    }
+}
+
+/**
+ * Move the cursor down a row, scrolling the scrolling region, if at its
+ * bottom.
+ *
+ * @param screen    The screen to move the cursor on.
+ */
+static void
+tlog_screen_index(struct tlog_screen *screen)
+{
+    screen->cursor.wrapnext = false;
+    if (screen->cursor.y == screen->bottom) {
+        tlog_screen_scroll_up(screen, screen->top, screen->bottom, 1);
+    } else if (screen->cursor.y + 1 < screen->height) {
+        screen->cursor.y++;
+    }
+}
+
+/**
+ * Move the cursor up a row, scrolling the scrolling region, if at its top.
+ *
+ * @param screen    The screen to move the cursor on.
+ */
+static void
+tlog_screen_reverse_index(struct tlog_screen *screen)
+{
+    screen->cursor.wrapnext = false;
+    if (screen->cursor.y == screen->top) {
+        tlog_screen_scroll_down(screen, screen->top, screen->bottom, 1);
+    } else if (screen->cursor.y > 0) {
+        screen->cursor.y--;
+    }
+}
+
+/**
+ * Move the cursor to a position, limited to the screen, or to the
+ * scrolling region in the origin mode.
+ *
+ * @param screen    The screen to move the cursor on.
+ * @param x         The column to move to.
+ * @param y         The row to move to, relative to the scrolling region
+ *                  top in the origin mode.
+ */
+static void
+tlog_screen_move(struct tlog_screen *screen, int x, int y)
+{
+    int top = 0;
+    int bottom = screen->height - 1;
+
+    if (screen->cursor.origin) {
+        top = screen->top;
+        bottom = screen->bottom;
+        y += top;
+    }
+    screen->cursor.x = TLOG_MAX(0, TLOG_MIN(x, screen->width - 1));
+    screen->cursor.y = TLOG_MAX(top, TLOG_MIN(y, bottom));
+    screen->cursor.wrapnext = false;
+}
+
+/**
+ * Move the cursor vertically, stopping at the scrolling region margins,
+ * if inside it.
+ *
+ * @param screen    The screen to move the cursor on.
+ * @param n         Number of rows to move by, negative to move up.
+ */
+static void
+tlog_screen_move_rows(struct tlog_screen *screen, int n)
+{
+    int y = screen->cursor.y + n;
+    int top = screen->cursor.y >= screen->top ? screen->top : 0;
+    int bottom = screen->cursor.y <= screen->bottom
+                    ? screen->bottom : screen->height - 1;
+
+    screen->cursor.y = TLOG_MAX(top, TLOG_MIN(y, bottom));
+    screen->cursor.wrapnext = false;
+}
+
+/**
+ * Reset the tab stops to every TLOG_SCREEN_TAB_WIDTH columns.
+ *
+ * @param screen    The screen to reset the tab stops of.
+ */
+static void
+tlog_screen_tabs_reset(struct tlog_screen *screen)
+{
+    unsigned int x;
+
+    for (x = 0; x < screen->width; x++) {
+        screen->tabs[x] = x % TLOG_SCREEN_TAB_WIDTH == 0 && x != 0;
+    }
+}
+
+/**
+ * Reset the state of a screen, except the size and the tab stops.
+ *
+ * @param screen    The screen to reset.
+ */
+static void
+tlog_screen_reset_state(struct tlog_screen *screen)
+{
+    memset(&screen->cursor, 0, sizeof(screen->cursor));
+    screen->cursor.attr = tlog_screen_attr_default;
+    screen->saved[0] = screen->cursor;
+    screen->saved[1] = screen->cursor;
+    screen->top = 0;
+    screen->bottom = screen->height - 1;
+    screen->autowrap = true;
+    screen->insert = false;
+    screen->visible = true;
+    screen->last_ch = ' ';
+    screen->state = TLOG_SCREEN_STATE_GROUND;
+    screen->utf8_left = 0;
+}
+
+/**
+ * Reset a screen to the initial state.
+ *
+ * @param screen    The screen to reset.
+ */
+static void
+tlog_screen_reset(struct tlog_screen *screen)
+{
+    size_t i;
+    size_t j;
+
+    tlog_screen_reset_state(screen);
+    screen->alt = false;
+    for (i = 0; i < TLOG_ARRAY_SIZE(screen->cells); i++) {
+        for (j = 0; j < (size_t)screen->width * screen->height; j++) {
+            screen->cells[i][j] = (struct tlog_screen_cell){
+                .ch = ' ',
+                .attr = tlog_screen_attr_default
+            };
+        }
+    }
+    tlog_screen_tabs_reset(screen);
+}
+
+bool
+tlog_screen_is_valid(const struct tlog_screen *screen)
+{
+    return screen != NULL &&
+           screen->width > 0 && screen->height > 0 &&
+           screen->cells[0] != NULL && screen->cells[1] != NULL &&
+           screen->tabs != NULL &&
+           screen->cursor.x < screen->width &&
+           screen->cursor.y < screen->height &&
+           screen->top <= screen->bottom &&
+           screen->bottom < screen->height &&
+           screen->param_num <= TLOG_SCREEN_PARAM_MAX;
+}
+
+tlog_grc
+tlog_screen_create(struct tlog_screen **pscreen,
+                   unsigned short int width,
+                   unsigned short int height)
+{
+    tlog_grc grc;
+    struct tlog_screen *screen;
+    size_t i;
+
+    assert(pscreen != NULL);
+    assert(width > 0);
+    assert(height > 0);
+
+    screen = calloc(1, sizeof(*screen));
+    if (screen == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    screen->width = width;
+    screen->height = height;
+    for (i = 0; i < TLOG_ARRAY_SIZE(screen->cells); i++) {
+        screen->cells[i] = malloc(sizeof(struct tlog_screen_cell) *
+                                  width * height);
+        if (screen->cells[i] == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto error;
+        }
+    }
+    screen->tabs = malloc(sizeof(*screen->tabs) * width);
+    if (screen->tabs == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    tlog_screen_reset(screen);
+
+    assert(tlog_screen_is_valid(screen));
+    *pscreen = screen;
+    return TLOG_RC_OK;
+
+error:
+    tlog_screen_destroy(screen);
+    *pscreen = NULL;
+    return grc;
+}
+
+tlog_grc
+tlog_screen_copy(struct tlog_screen **pscreen,
+                 const struct tlog_screen *orig)
+{
+    tlog_grc grc;
+    struct tlog_screen *screen;
+    size_t i;
+
+    assert(pscreen != NULL);
+    assert(tlog_screen_is_valid(orig));
+
+    grc = tlog_screen_create(&screen, orig->width, orig->height);
+    if (grc != TLOG_RC_OK) {
+        *pscreen = NULL;
+        return grc;
+    }
+
+    for (i = 0; i < TLOG_ARRAY_SIZE(screen->cells); i++) {
+        memcpy(screen->cells[i], orig->cells[i],
+               sizeof(struct tlog_screen_cell) *
+                    orig->width * orig->height);
+    }
+    memcpy(screen->tabs, orig->tabs, sizeof(*orig->tabs) * orig->width);
+    screen->alt = orig->alt;
+    screen->cursor = orig->cursor;
+    memcpy(screen->saved, orig->saved, sizeof(orig->saved));
+    screen->top = orig->top;
+    screen->bottom = orig->bottom;
+    screen->autowrap = orig->autowrap;
+    screen->insert = orig->insert;
+    screen->visible = orig->visible;
+    screen->last_ch = orig->last_ch;
+    screen->state = orig->state;
+    screen->utf8_ch = orig->utf8_ch;
+    screen->utf8_left = orig->utf8_left;
+    memcpy(screen->params, orig->params, sizeof(orig->params));
+    screen->param_num = orig->param_num;
+    screen->marker = orig->marker;
+    screen->inter = orig->inter;
+    screen->charset_g = orig->charset_g;
+
+    assert(tlog_screen_is_valid(screen));
+    *pscreen = screen;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Limit a cursor to a screen size.
+ *
+ * @param cursor    The cursor to limit.
+ * @param width     The screen width.
+ * @param height    The screen height.
+ */
+static void
+tlog_screen_cursor_limit(struct tlog_screen_cursor *cursor,
+                         unsigned short int width,
+                         unsigned short int height)
+{
+    if (cursor->x >= width) {
+        cursor->x = width - 1;
+        cursor->wrapnext = false;
+    }
+    if (cursor->y >= height) {
+        cursor->y = height - 1;
+    }
+}
+
+tlog_grc
+tlog_screen_resize(struct tlog_screen *screen,
+                   unsigned short int width,
+                   unsigned short int height)
+{
+    struct tlog_screen_cell *cells[2] = {NULL, NULL};
+    bool *tabs;
+    size_t i;
+    unsigned int shift;
+    unsigned int x;
+    unsigned int y;
+
+    assert(tlog_screen_is_valid(screen));
+    assert(width > 0);
+    assert(height > 0);
+
+    if (width == screen->width && height == screen->height) {
+        return TLOG_RC_OK;
+    }
+
+    for (i = 0; i < TLOG_ARRAY_SIZE(cells); i++) {
+        cells[i] = malloc(sizeof(struct tlog_screen_cell) * width * height);
+        if (cells[i] == NULL) {
+            free(cells[0]);
+            return TLOG_GRC_ERRNO;
+        }
+    }
+    tabs = realloc(screen->tabs, sizeof(*tabs) * width);
+    if (tabs == NULL) {
+        free(cells[0]);
+        free(cells[1]);
+        return TLOG_GRC_ERRNO;
+    }
+    screen->tabs = tabs;
+    for (x = screen->width; x < width; x++) {
+        tabs[x] = x % TLOG_SCREEN_TAB_WIDTH == 0;
+    }
+
+    /* Shift the contents up, if the cursor would go off the screen */
+    shift = screen->cursor.y >= height ? screen->cursor.y + 1 - height : 0;
+
+    /* Copy the overlapping contents, blanking the rest */
+    for (i = 0; i < TLOG_ARRAY_SIZE(cells); i++) {
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+                if (x < screen->width && y + shift < screen->height) {
+                    cells[i][y * width + x] =
+                        screen->cells[i][(y + shift) * screen->width + x];
+                } else {
+                    cells[i][y * width + x] = (struct tlog_screen_cell){
+                        .ch = ' ',
+                        .attr = tlog_screen_attr_default
+                    };
+                }
+            }
+        }
+        free(screen->cells[i]);
+        screen->cells[i] = cells[i];
+    }
+
+    screen->width = width;
+    screen->height = height;
+    screen->cursor.y -= shift;
+    tlog_screen_cursor_limit(&screen->cursor, width, height);
+    for (i = 0; i < TLOG_ARRAY_SIZE(screen->saved); i++) {
+        tlog_screen_cursor_limit(&screen->saved[i], width, height);
+    }
+    screen->top = 0;
+    screen->bottom = height - 1;
+
+    assert(tlog_screen_is_valid(screen));
+    return TLOG_RC_OK;
+}
+
+/**
+ * Output a character to a screen.
+ *
+ * @param screen    The screen to output to.
+ * @param ch        The character code point.
+ */
+static void
+tlog_screen_put(struct tlog_screen *screen, uint32_t ch)
+{
+    struct tlog_screen_cursor *cursor = &screen->cursor;
+    struct tlog_screen_cell *cell;
+    unsigned int width;
+    int rc;
+
+    /* Translate DEC special graphics */
+    if (cursor->g_graph[cursor->gl] && ch >= 0x5f && ch <= 0x7e) {
+        ch = tlog_screen_graph_list[ch - 0x5f];
+    }
+
+    rc = wcwidth((wchar_t)ch);
+    if (rc == 0) {
+        return;
+    }
+    width = (rc == 2 && screen->width > 1) ? 2 : 1;
+
+    /* Wrap to the next line, if due */
+    if (cursor->wrapnext ||
+        (width == 2 && cursor->x + 1 == screen->width)) {
+        if (screen->autowrap) {
+            cursor->x = 0;
+            tlog_screen_index(screen);
+        } else {
+            cursor->x = screen->width - width;
+        }
+        cursor->wrapnext = false;
+    }
+
+    /* Shift the rest of the line, if inserting */
+    if (screen->insert) {
+        cell = tlog_screen_cell(screen, cursor->x, cursor->y);
+        memmove(cell + width, cell,
+                sizeof(*cell) * (screen->width - cursor->x - width));
+    }
+
+    /* Blank the halves of wide characters being overwritten */
+    cell = tlog_screen_cell(screen, cursor->x, cursor->y);
+    if (cell->ch == 0 && cursor->x > 0) {
+        cell[-1].ch = ' ';
+    }
+    if (cursor->x + width < screen->width && cell[width].ch == 0) {
+        cell[width].ch = ' ';
+    }
+
+    cell->ch = ch;
+    cell->attr = cursor->attr;
+    if (width == 2) {
+        cell[1].ch = 0;
+        cell[1].attr = cursor->attr;
+    }
+    screen->last_ch = ch;
+
+    if (cursor->x + width >= screen->width) {
+        cursor->x = screen->width - 1;
+        cursor->wrapnext = screen->autowrap;
+    } else {
+        cursor->x += width;
+    }
+}
+
+/**
+ * Execute a C0 control character.
+ *
+ * @param screen    The screen to execute the character on.
+ * @param c         The character.
+ */
+static void
+tlog_screen_control(struct tlog_screen *screen, uint8_t c)
+{
+    struct tlog_screen_cursor *cursor = &screen->cursor;
+
+    switch (c) {
+    case '\b':
+        if (cursor->x > 0) {
+            cursor->x--;
+        }
+        cursor->wrapnext = false;
+        break;
+    case '\t':
+        while (cursor->x + 1 < screen->width &&
+               !screen->tabs[++cursor->x]);
+        break;
+    case '\n':
+    case '\v':
+    case '\f':
+        tlog_screen_index(screen);
+        break;
+    case '\r':
+        cursor->x = 0;
+        cursor->wrapnext = false;
+        break;
+    case 0x0e:  /* SO */
+        cursor->gl = 1;
+        break;
+    case 0x0f:  /* SI */
+        cursor->gl = 0;
+        break;
+    case 0x18:  /* CAN */
+    case 0x1a:  /* SUB */
+        screen->state = TLOG_SCREEN_STATE_GROUND;
+        break;
+    case 0x1b:  /* ESC */
+        screen->state = TLOG_SCREEN_STATE_ESC;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Get a control sequence parameter, or its default value.
+ *
+ * @param screen    The screen parsing the sequence.
+ * @param i         The parameter index.
+ * @param def       The default value, used for missing and zero values.
+ *
+ * @return The parameter value.
+ */
+static unsigned int
+tlog_screen_param(const struct tlog_screen *screen, size_t i,
+                  unsigned int def)
+{
+    return (i < screen->param_num && screen->params[i] != 0)
+                ? screen->params[i] : def;
+}
+
+/**
+ * Switch between the main and the alternate screen.
+ *
+ * @param screen    The screen to switch.
+ * @param alt       True to switch to the alternate screen, false to the
+ *                  main screen.
+ * @param save      True to save the cursor before switching to the
+ *                  alternate screen, and restore it after switching back.
+ * @param clear     True to clear the alternate screen when switching.
+ */
+static void
+tlog_screen_switch(struct tlog_screen *screen, bool alt,
+                   bool save, bool clear)
+{
+    unsigned int y;
+
+    if (alt == screen->alt) {
+        return;
+    }
+    if (alt && save) {
+        screen->saved[0] = screen->cursor;
+    }
+    if (!alt && clear) {
+        for (y = 0; y < screen->height; y++) {
+            tlog_screen_blank(screen, y, 0, screen->width);
+        }
+    }
+    screen->alt = alt;
+    if (alt && clear) {
+        for (y = 0; y < screen->height; y++) {
+            tlog_screen_blank(screen, y, 0, screen->width);
+        }
+    }
+    if (!alt && save) {
+        screen->cursor = screen->saved[0];
+    }
+}
+
+/**
+ * Set or reset DEC private modes, according to the control sequence
+ * parameters.
+ *
+ * @param screen    The screen to set the modes of.
+ * @param set       True to set the modes, false to reset.
+ */
+static void
+tlog_screen_dec_mode(struct tlog_screen *screen, bool set)
+{
+    size_t i;
+
+    for (i = 0; i < screen->param_num; i++) {
+        switch (screen->params[i]) {
+        case 6:
+            screen->cursor.origin = set;
+            tlog_screen_move(screen, 0, 0);
+            break;
+        case 7:
+            screen->autowrap = set;
+            break;
+        case 25:
+            screen->visible = set;
+            break;
+        case 47:
+        case 1047:
+            tlog_screen_switch(screen, set, false, screen->params[i] == 1047);
+            break;
+        case 1048:
+            if (set) {
+                screen->saved[screen->alt] = screen->cursor;
+            } else {
+                screen->cursor = screen->saved[screen->alt];
+            }
+            break;
+        case 1049:
+            tlog_screen_switch(screen, set, true, true);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Parse an extended (256-color or direct) color from SGR parameters.
+ *
+ * @param screen    The screen parsing the sequence.
+ * @param pi        Location of the index of the parameter preceding the
+ *                  color, advanced past it.
+ * @param pcolor    Location for the color.
+ */
+static void
+tlog_screen_sgr_color(const struct tlog_screen *screen,
+                      size_t *pi, uint32_t *pcolor)
+{
+    size_t i = *pi;
+
+    if (i + 2 < screen->param_num && screen->params[i + 1] == 5) {
+        *pcolor = TLOG_SCREEN_COLOR_INDEX | (screen->params[i + 2] & 0xff);
+        *pi = i + 2;
+    } else if (i + 4 < screen->param_num && screen->params[i + 1] == 2) {
+        *pcolor = TLOG_SCREEN_COLOR_RGB |
+                  (screen->params[i + 2] & 0xff) << 16 |
+                  (screen->params[i + 3] & 0xff) << 8 |
+                  (screen->params[i + 4] & 0xff);
+        *pi = i + 4;
+    } else {
+        *pi = screen->param_num;
+    }
+}
+
+/**
+ * Set character attributes, according to SGR control sequence parameters.
+ *
+ * @param screen    The screen to set the attributes of.
+ */
+static void
+tlog_screen_sgr(struct tlog_screen *screen)
+{
+    struct tlog_screen_attr *attr = &screen->cursor.attr;
+    unsigned int p;
+    size_t i;
+
+    if (screen->param_num == 0) {
+        *attr = tlog_screen_attr_default;
+        return;
+    }
+
+    for (i = 0; i < screen->param_num; i++) {
+        p = screen->params[i];
+        switch (p) {
+        case 0:
+            *attr = tlog_screen_attr_default;
+            break;
+        case 1:
+            attr->flags |= TLOG_SCREEN_ATTR_BOLD;
+            break;
+        case 2:
+            attr->flags |= TLOG_SCREEN_ATTR_DIM;
+            break;
+        case 3:
+            attr->flags |= TLOG_SCREEN_ATTR_ITALIC;
+            break;
+        case 4:
+            attr->flags |= TLOG_SCREEN_ATTR_UNDERLINE;
+            break;
+        case 5:
+        case 6:
+            attr->flags |= TLOG_SCREEN_ATTR_BLINK;
+            break;
+        case 7:
+            attr->flags |= TLOG_SCREEN_ATTR_REVERSE;
+            break;
+        case 8:
+            attr->flags |= TLOG_SCREEN_ATTR_HIDDEN;
+            break;
+        case 9:
+            attr->flags |= TLOG_SCREEN_ATTR_STRIKE;
+            break;
+        case 21:
+        case 22:
+            attr->flags &= ~(TLOG_SCREEN_ATTR_BOLD | TLOG_SCREEN_ATTR_DIM);
+            break;
+        case 23:
+            attr->flags &= ~TLOG_SCREEN_ATTR_ITALIC;
+            break;
+        case 24:
+            attr->flags &= ~TLOG_SCREEN_ATTR_UNDERLINE;
+            break;
+        case 25:
+            attr->flags &= ~TLOG_SCREEN_ATTR_BLINK;
+            break;
+        case 27:
+            attr->flags &= ~TLOG_SCREEN_ATTR_REVERSE;
+            break;
+        case 28:
+            attr->flags &= ~TLOG_SCREEN_ATTR_HIDDEN;
+            break;
+        case 29:
+            attr->flags &= ~TLOG_SCREEN_ATTR_STRIKE;
+            break;
+        case 38:
+            tlog_screen_sgr_color(screen, &i, &attr->fg);
+            break;
+        case 39:
+            attr->fg = TLOG_SCREEN_COLOR_DEFAULT;
+            break;
+        case 48:
+            tlog_screen_sgr_color(screen, &i, &attr->bg);
+            break;
+        case 49:
+            attr->bg = TLOG_SCREEN_COLOR_DEFAULT;
+            break;
+        default:
+            if (p >= 30 && p <= 37) {
+                attr->fg = TLOG_SCREEN_COLOR_INDEX | (p - 30);
+            } else if (p >= 40 && p <= 47) {
+                attr->bg = TLOG_SCREEN_COLOR_INDEX | (p - 40);
+            } else if (p >= 90 && p <= 97) {
+                attr->fg = TLOG_SCREEN_COLOR_INDEX | (p - 90 + 8);
+            } else if (p >= 100 && p <= 107) {
+                attr->bg = TLOG_SCREEN_COLOR_INDEX | (p - 100 + 8);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Execute a control sequence.
+ *
+ * @param screen    The screen to execute the sequence on.
+ * @param final     The sequence final byte.
+ */
+static void
+tlog_screen_csi(struct tlog_screen *screen, uint8_t final)
+{
+    struct tlog_screen_cursor *cursor = &screen->cursor;
+    struct tlog_screen_cell *cell;
+    unsigned int n = tlog_screen_param(screen, 0, 1);
+    unsigned int x = cursor->x;
+    unsigned int y = cursor->y;
+    unsigned int i;
+
+    /* Handle DEC private modes, ignore other private sequences */
+    if (screen->marker == '?' && screen->inter == 0) {
+        if (final == 'h' || final == 'l') {
+            tlog_screen_dec_mode(screen, final == 'h');
+        }
+        return;
+    }
+    if (screen->marker != 0 || screen->inter != 0) {
+        return;
+    }
+
+    switch (final) {
+    case 'A':   /* CUU */
+        tlog_screen_move_rows(screen, -(int)n);
+        break;
+    case 'B':   /* CUD */
+    case 'e':   /* VPR */
+        tlog_screen_move_rows(screen, (int)n);
+        break;
+    case 'C':   /* CUF */
+    case 'a':   /* HPR */
+        cursor->x = TLOG_MIN(x + n, screen->width - 1u);
+        cursor->wrapnext = false;
+        break;
+    case 'D':   /* CUB */
+        cursor->x = x > n ? x - n : 0;
+        cursor->wrapnext = false;
+        break;
+    case 'E':   /* CNL */
+        tlog_screen_move_rows(screen, (int)n);
+        cursor->x = 0;
+        break;
+    case 'F':   /* CPL */
+        tlog_screen_move_rows(screen, -(int)n);
+        cursor->x = 0;
+        break;
+    case 'G':   /* CHA */
+    case '`':   /* HPA */
+        cursor->x = TLOG_MIN(n, screen->width) - 1;
+        cursor->wrapnext = false;
+        break;
+    case 'H':   /* CUP */
+    case 'f':   /* HVP */
+        tlog_screen_move(screen, (int)tlog_screen_param(screen, 1, 1) - 1,
+                         (int)n - 1);
+        break;
+    case 'd':   /* VPA */
+        tlog_screen_move(screen, (int)x, (int)n - 1);
+        break;
+    case 'I':   /* CHT */
+        for (i = 0; i < n; i++) {
+            tlog_screen_control(screen, '\t');
+        }
+        break;
+    case 'Z':   /* CBT */
+        for (i = 0; i < n && cursor->x > 0; i++) {
+            while (--cursor->x > 0 && !screen->tabs[cursor->x]);
+        }
+        cursor->wrapnext = false;
+        break;
+    case 'J':   /* ED */
+        switch (tlog_screen_param(screen, 0, 0)) {
+        case 0:
+            tlog_screen_blank(screen, y, x, screen->width);
+            for (i = y + 1; i < screen->height; i++) {
+                tlog_screen_blank(screen, i, 0, screen->width);
+            }
+            break;
+        case 1:
+            for (i = 0; i < y; i++) {
+                tlog_screen_blank(screen, i, 0, screen->width);
+            }
+            tlog_screen_blank(screen, y, 0, x + 1);
+            break;
+        case 2:
+        case 3:
+            for (i = 0; i < screen->height; i++) {
+                tlog_screen_blank(screen, i, 0, screen->width);
+            }
+            break;
+        }
+        cursor->wrapnext = false;
+        break;
+    case 'K':   /* EL */
+        switch (tlog_screen_param(screen, 0, 0)) {
+        case 0:
+            tlog_screen_blank(screen, y, x, screen->width);
+            break;
+        case 1:
+            tlog_screen_blank(screen, y, 0, x + 1);
+            break;
+        case 2:
+            tlog_screen_blank(screen, y, 0, screen->width);
+            break;
+        }
+        cursor->wrapnext = false;
+        break;
+    case 'X':   /* ECH */
+        tlog_screen_blank(screen, y, x, x + n);
+        cursor->wrapnext = false;
+        break;
+    case 'L':   /* IL */
+        if (y >= screen->top && y <= screen->bottom) {
+            tlog_screen_scroll_down(screen, y, screen->bottom, n);
+            cursor->x = 0;
+            cursor->wrapnext = false;
+        }
+        break;
+    case 'M':   /* DL */
+        if (y >= screen->top && y <= screen->bottom) {
+            tlog_screen_scroll_up(screen, y, screen->bottom, n);
+            cursor->x = 0;
+            cursor->wrapnext = false;
+        }
+        break;
+    case '@':   /* ICH */
+        n = TLOG_MIN(n, screen->width - x);
+        cell = tlog_screen_cell(screen, x, y);
+        memmove(cell + n, cell, sizeof(*cell) * (screen->width - x - n));
+        tlog_screen_blank(screen, y, x, x + n);
+        cursor->wrapnext = false;
+        break;
+    case 'P':   /* DCH */
+        n = TLOG_MIN(n, screen->width - x);
+        cell = tlog_screen_cell(screen, x, y);
+        memmove(cell, cell + n, sizeof(*cell) * (screen->width - x - n));
+        tlog_screen_blank(screen, y, screen->width - n, screen->width);
+        cursor->wrapnext = false;
+        break;
+    case 'S':   /* SU */
+        tlog_screen_scroll_up(screen, screen->top, screen->bottom, n);
+        break;
+    case 'T':   /* SD */
+        tlog_screen_scroll_down(screen, screen->top, screen->bottom, n);
+        break;
+    case 'b':   /* REP */
+        for (i = 0; i < TLOG_MIN(n, (unsigned int)screen->width *
+                                    screen->height); i++) {
+            tlog_screen_put(screen, screen->last_ch);
+        }
+        break;
+    case 'g':   /* TBC */
+        switch (tlog_screen_param(screen, 0, 0)) {
+        case 0:
+            screen->tabs[x] = false;
+            break;
+        case 3:
+            memset(screen->tabs, 0, sizeof(*screen->tabs) * screen->width);
+            break;
+        }
+        break;
+    case 'h':   /* SM */
+    case 'l':   /* RM */
+        for (i = 0; i < screen->param_num; i++) {
+            if (screen->params[i] == 4) {
+                screen->insert = final == 'h';
+            }
+        }
+        break;
+    case 'm':   /* SGR */
+        tlog_screen_sgr(screen);
+        break;
+    case 'r':   /* DECSTBM */
+        n = tlog_screen_param(screen, 0, 1);
+        i = tlog_screen_param(screen, 1, screen->height);
+        if (n < i && i <= screen->height) {
+            screen->top = n - 1;
+            screen->bottom = i - 1;
+            tlog_screen_move(screen, 0, 0);
+        }
+        break;
+    case 's':   /* SCOSC */
+        screen->saved[screen->alt] = *cursor;
+        break;
+    case 'u':   /* SCORC */
+        *cursor = screen->saved[screen->alt];
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Execute an escape sequence, without intermediate bytes.
+ *
+ * @param screen    The screen to execute the sequence on.
+ * @param final     The sequence final byte.
+ */
+static void
+tlog_screen_esc(struct tlog_screen *screen, uint8_t final)
+{
+    screen->state = TLOG_SCREEN_STATE_GROUND;
+
+    switch (final) {
+    case '[':
+        screen->state = TLOG_SCREEN_STATE_CSI;
+        screen->param_num = 0;
+        screen->marker = 0;
+        screen->inter = 0;
+        break;
+    case ']':
+    case 'P':
+    case 'X':
+    case '^':
+    case '_':
+        screen->state = TLOG_SCREEN_STATE_STR;
+        break;
+    case '(':
+    case ')':
+        screen->state = TLOG_SCREEN_STATE_CHARSET;
+        screen->charset_g = final == ')';
+        break;
+    case '7':   /* DECSC */
+        screen->saved[screen->alt] = screen->cursor;
+        break;
+    case '8':   /* DECRC */
+        screen->cursor = screen->saved[screen->alt];
+        break;
+    case 'D':   /* IND */
+        tlog_screen_index(screen);
+        break;
+    case 'E':   /* NEL */
+        screen->cursor.x = 0;
+        tlog_screen_index(screen);
+        break;
+    case 'M':   /* RI */
+        tlog_screen_reverse_index(screen);
+        break;
+    case 'H':   /* HTS */
+        screen->tabs[screen->cursor.x] = true;
+        break;
+    case 'c':   /* RIS */
+        tlog_screen_reset(screen);
+        break;
+    default:
+        /* Skip the final byte of sequences with intermediates */
+        if (final >= 0x20 && final <= 0x2f) {
+            screen->state = TLOG_SCREEN_STATE_ESC_INTER;
+        }
+        break;
+    }
+}
+
+/**
+ * Process a byte of a control sequence.
+ *
+ * @param screen    The screen parsing the sequence.
+ * @param c         The byte.
+ */
+static void
+tlog_screen_csi_byte(struct tlog_screen *screen, uint8_t c)
+{
+    unsigned int *param;
+
+    if (c >= '0' && c <= '9') {
+        if (screen->param_num == 0) {
+            screen->params[0] = 0;
+            screen->param_num = 1;
+        }
+        param = &screen->params[screen->param_num - 1];
+        *param = TLOG_MIN(*param * 10 + (c - '0'),
+                          TLOG_SCREEN_PARAM_VAL_MAX);
+    } else if (c == ';' || c == ':') {
+        if (screen->param_num == 0) {
+            screen->params[0] = 0;
+            screen->param_num = 1;
+        }
+        if (screen->param_num < TLOG_SCREEN_PARAM_MAX) {
+            screen->params[screen->param_num++] = 0;
+        }
+    } else if (c >= 0x3c && c <= 0x3f) {
+        screen->marker = c;
+    } else if (c >= 0x20 && c <= 0x2f) {
+        screen->inter = c;
+    } else if (c >= 0x40 && c <= 0x7e) {
+        screen->state = TLOG_SCREEN_STATE_GROUND;
+        tlog_screen_csi(screen, c);
+    } else if (c < 0x20) {
+        tlog_screen_control(screen, c);
+    }
+}
+
+void
+tlog_screen_write(struct tlog_screen *screen,
+                  const uint8_t *buf, size_t len)
+{
+    uint8_t c;
+
+    assert(tlog_screen_is_valid(screen));
+    assert(buf != NULL || len == 0);
+
+    for (; len > 0; buf++, len--) {
+        c = *buf;
+
+        /* Finish, or abort decoding a UTF-8 character */
+        if (screen->utf8_left > 0) {
+            if ((c & 0xc0) == 0x80) {
+                screen->utf8_ch = (screen->utf8_ch << 6) | (c & 0x3f);
+                if (--screen->utf8_left == 0) {
+                    tlog_screen_put(screen, screen->utf8_ch);
+                }
+                continue;
+            }
+            screen->utf8_left = 0;
+            tlog_screen_put(screen, TLOG_SCREEN_CH_INVALID);
+        }
+
+        switch (screen->state) {
+        case TLOG_SCREEN_STATE_GROUND:
+            if (c < 0x20) {
+                tlog_screen_control(screen, c);
+            } else if (c < 0x7f) {
+                tlog_screen_put(screen, c);
+            } else if (c >= 0xc2 && c <= 0xf4) {
+                screen->utf8_left = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+                screen->utf8_ch = c & (0x3f >> screen->utf8_left);
+            } else if (c != 0x7f) {
+                tlog_screen_put(screen, TLOG_SCREEN_CH_INVALID);
+            }
+            break;
+        case TLOG_SCREEN_STATE_ESC:
+            if (c < 0x20) {
+                tlog_screen_control(screen, c);
+            } else {
+                tlog_screen_esc(screen, c);
+            }
+            break;
+        case TLOG_SCREEN_STATE_ESC_INTER:
+            if (c < 0x20) {
+                tlog_screen_control(screen, c);
+            } else if (c > 0x2f) {
+                screen->state = TLOG_SCREEN_STATE_GROUND;
+            }
+            break;
+        case TLOG_SCREEN_STATE_CHARSET:
+            screen->cursor.g_graph[screen->charset_g] = c == '0';
+            screen->state = TLOG_SCREEN_STATE_GROUND;
+            break;
+        case TLOG_SCREEN_STATE_CSI:
+            tlog_screen_csi_byte(screen, c);
+            break;
+        case TLOG_SCREEN_STATE_STR:
+            /* Strings end with BEL, or ST, the rest of which is ignored */
+            if (c == 0x07 || c == 0x18 || c == 0x1a) {
+                screen->state = TLOG_SCREEN_STATE_GROUND;
+            } else if (c == 0x1b) {
+                screen->state = TLOG_SCREEN_STATE_ESC;
+            }
+            break;
+        }
+    }
+}
+
+/** Output buffer for rendering */
+struct tlog_screen_out {
+    char   *ptr;        /**< Buffer */
+    size_t  len;        /**< Data length */
+    size_t  size;       /**< Buffer size */
+    bool    failed;     /**< True if failed to allocate */
+};
+
+/**
+ * Append formatted text to a rendering output buffer.
+ *
+ * @param out   The buffer to append to.
+ * @param fmt   The format string.
+ * @param ...   The format arguments.
+ */
+static void __attribute__((format(printf, 2, 3)))
+tlog_screen_out_printf(struct tlog_screen_out *out, const char *fmt, ...)
+{
+    va_list ap;
+    int rc;
+    size_t size;
+    char *ptr;
+
+    while (!out->failed) {
+        va_start(ap, fmt);
+        rc = vsnprintf(out->ptr + out->len, out->size - out->len, fmt, ap);
+        va_end(ap);
+        if (rc < 0) {
+            out->failed = true;
+        } else if ((size_t)rc < out->size - out->len) {
+            out->len += (size_t)rc;
+            break;
+        } else {
+            size = TLOG_MAX(out->size * 2, out->len + (size_t)rc + 1);
+            ptr = realloc(out->ptr, size);
+            if (ptr == NULL) {
+                out->failed = true;
+            } else {
+                out->ptr = ptr;
+                out->size = size;
+            }
+        }
+    }
+}
+
+/**
+ * Append a character to a rendering output buffer, encoded in UTF-8.
+ *
+ * @param out   The buffer to append to.
+ * @param ch    The character code point.
+ */
+static void
+tlog_screen_out_char(struct tlog_screen_out *out, uint32_t ch)
+{
+    if (ch < 0x80) {
+        tlog_screen_out_printf(out, "%c", (char)ch);
+    } else if (ch < 0x800) {
+        tlog_screen_out_printf(out, "%c%c",
+                               (char)(0xc0 | ch >> 6),
+                               (char)(0x80 | (ch & 0x3f)));
+    } else if (ch < 0x10000) {
+        tlog_screen_out_printf(out, "%c%c%c",
+                               (char)(0xe0 | ch >> 12),
+                               (char)(0x80 | (ch >> 6 & 0x3f)),
+                               (char)(0x80 | (ch & 0x3f)));
+    } else {
+        tlog_screen_out_printf(out, "%c%c%c%c",
+                               (char)(0xf0 | ch >> 18),
+                               (char)(0x80 | (ch >> 12 & 0x3f)),
+                               (char)(0x80 | (ch >> 6 & 0x3f)),
+                               (char)(0x80 | (ch & 0x3f)));
+    }
+}
+
+/**
+ * Append an SGR parameter for a color to a rendering output buffer.
+ *
+ * @param out   The buffer to append to.
+ * @param color The color to append.
+ * @param base  The base of the SGR parameters: 30 for foreground, 40 for
+ *              background.
+ */
+static void
+tlog_screen_out_color(struct tlog_screen_out *out,
+                      uint32_t color, unsigned int base)
+{
+    unsigned int val = color & 0xffffff;
+
+    if (color & TLOG_SCREEN_COLOR_RGB) {
+        tlog_screen_out_printf(out, ";%u;2;%u;%u;%u", base + 8,
+                               val >> 16, val >> 8 & 0xff, val & 0xff);
+    } else if (color & TLOG_SCREEN_COLOR_INDEX) {
+        if (val < 8) {
+            tlog_screen_out_printf(out, ";%u", base + val);
+        } else if (val < 16) {
+            tlog_screen_out_printf(out, ";%u", base + 60 + val - 8);
+        } else {
+            tlog_screen_out_printf(out, ";%u;5;%u", base + 8, val);
+        }
+    }
+}
+
+/**
+ * Append an SGR sequence setting attributes to a rendering output buffer.
+ *
+ * @param out   The buffer to append to.
+ * @param attr  The attributes to set.
+ */
+static void
+tlog_screen_out_attr(struct tlog_screen_out *out,
+                     const struct tlog_screen_attr *attr)
+{
+    static const unsigned int flag_param_list[] = {1, 2, 3, 4, 5, 7, 8, 9};
+    size_t i;
+
+    tlog_screen_out_printf(out, "\033[0");
+    for (i = 0; i < TLOG_ARRAY_SIZE(flag_param_list); i++) {
+        if (attr->flags & (1 << i)) {
+            tlog_screen_out_printf(out, ";%u", flag_param_list[i]);
+        }
+    }
+    tlog_screen_out_color(out, attr->fg, 30);
+    tlog_screen_out_color(out, attr->bg, 40);
+    tlog_screen_out_printf(out, "m");
+}
+
+/**
+ * Append the rendering of the cells of the main or the alternate screen to
+ * a rendering output buffer, assuming the terminal screen is blank, and
+ * the attributes are default.
+ *
+ * @param out       The buffer to append to.
+ * @param screen    The screen to render the cells of.
+ * @param alt       True to render the alternate screen cells, false to
+ *                  render the main screen cells.
+ */
+static void
+tlog_screen_out_cells(struct tlog_screen_out *out,
+                      const struct tlog_screen *screen, bool alt)
+{
+    const struct tlog_screen_cell *row;
+    struct tlog_screen_attr attr = tlog_screen_attr_default;
+    unsigned int x;
+    unsigned int y;
+    unsigned int end;
+
+    for (y = 0; y < screen->height; y++) {
+        row = screen->cells[alt] + y * screen->width;
+        /* Skip the trailing blanks, as the screen was cleared */
+        for (end = screen->width; end > 0; end--) {
+            if (row[end - 1].ch != ' ' ||
+                !tlog_screen_attr_eq(&row[end - 1].attr,
+                                     &tlog_screen_attr_default)) {
+                break;
+            }
+        }
+        if (end == 0) {
+            continue;
+        }
+        tlog_screen_out_printf(out, "\033[%u;1H", y + 1);
+        for (x = 0; x < end; x++) {
+            if (row[x].ch == 0) {
+                continue;
+            }
+            if (!tlog_screen_attr_eq(&row[x].attr, &attr)) {
+                attr = row[x].attr;
+                tlog_screen_out_attr(out, &attr);
+            }
+            tlog_screen_out_char(out, row[x].ch);
+        }
+        if (!tlog_screen_attr_eq(&attr, &tlog_screen_attr_default)) {
+            attr = tlog_screen_attr_default;
+            tlog_screen_out_printf(out, "\033[0m");
+        }
+    }
+}
+
+tlog_grc
+tlog_screen_render(const struct tlog_screen *screen,
+                   char **pbuf, size_t *plen)
+{
+    struct tlog_screen_out out = {.ptr = NULL};
+    const struct tlog_screen_cursor *cursor = &screen->cursor;
+
+    assert(tlog_screen_is_valid(screen));
+    assert(pbuf != NULL);
+    assert(plen != NULL);
+
+    /* Return to the main screen, reset the state and clear */
+    tlog_screen_out_printf(&out,
+                           "\033[?1049l\033(B\033)B\017\033[r\033[?6l"
+                           "\033[?7h\033[4l\033[0m\033[H\033[2J");
+    tlog_screen_out_cells(&out, screen, false);
+
+    /* Switch to the alternate screen saving the cursor, if shown */
+    if (screen->alt) {
+        tlog_screen_out_printf(&out, "\033[%u;%uH\033[?1049h\033[H\033[2J",
+                               screen->saved[0].y + 1,
+                               screen->saved[0].x + 1);
+        tlog_screen_out_cells(&out, screen, true);
+    }
+
+    /* Restore the scrolling region, the cursor and the modes */
+    if (screen->top != 0 || screen->bottom + 1 != screen->height) {
+        tlog_screen_out_printf(&out, "\033[%u;%ur",
+                               screen->top + 1, screen->bottom + 1);
+    }
+    tlog_screen_out_printf(&out, "\033[%u;%uH",
+                           cursor->y + 1, cursor->x + 1);
+    tlog_screen_out_attr(&out, &cursor->attr);
+    if (cursor->g_graph[0]) {
+        tlog_screen_out_printf(&out, "\033(0");
+    }
+    if (cursor->g_graph[1]) {
+        tlog_screen_out_printf(&out, "\033)0");
+    }
+    if (cursor->gl == 1) {
+        tlog_screen_out_printf(&out, "\016");
+    }
+    if (!screen->autowrap) {
+        tlog_screen_out_printf(&out, "\033[?7l");
+    }
+    if (screen->insert) {
+        tlog_screen_out_printf(&out, "\033[4h");
+    }
+    tlog_screen_out_printf(&out, "\033[?25%c", screen->visible ? 'h' : 'l');
+
+    if (out.failed) {
+        free(out.ptr);
+        return TLOG_GRC_FROM(errno, ENOMEM);
+    }
+    *pbuf = out.ptr;
+    *plen = out.len;
+    return TLOG_RC_OK;
+}
+
+tlog_grc
+tlog_screen_text(const struct tlog_screen *screen,
+                 char **pbuf, size_t *plen)
+{
+    struct tlog_screen_out out = {.ptr = NULL};
+    const struct tlog_screen_cell *row;
+    unsigned int x;
+    unsigned int y;
+    unsigned int end;
+    size_t len = 0;
+
+    assert(tlog_screen_is_valid(screen));
+    assert(pbuf != NULL);
+    assert(plen != NULL);
+
+    for (y = 0; y < screen->height; y++) {
+        row = screen->cells[screen->alt] + y * screen->width;
+        for (end = screen->width; end > 0 && row[end - 1].ch == ' '; end--);
+        for (x = 0; x < end; x++) {
+            if (row[x].ch != 0) {
+                tlog_screen_out_char(&out, row[x].ch);
+            }
+        }
+        tlog_screen_out_printf(&out, "\n");
+        /* Remember the end of the last non-empty line */
+        if (end > 0) {
+            len = out.len;
+        }
+    }
+
+    if (out.failed) {
+        free(out.ptr);
+        return TLOG_GRC_FROM(errno, ENOMEM);
+    }
+    *pbuf = out.ptr;
+    *plen = len;
+    return TLOG_RC_OK;
+}
+
+void
+tlog_screen_destroy(struct tlog_screen *screen)
+{
+    size_t i;
+
+    if (screen == NULL) {
+        return;
+    }
+    for (i = 0; i < TLOG_ARRAY_SIZE(screen->cells); i++) {
+        free(screen->cells[i]);
+    }
+    free(screen->tabs);
+    free(screen);
+}
@@ -0,0 +1,696 @@
+/*
+ * Recorded session list.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <json_tokener.h>
+#include <curl/curl.h>
+#include <tlog/session_list.h>
+#include <tlog/es_json_reader.h>
+#include <tlog/json_msg.h>
+#include <tlog/rc.h>
+#include <tlog/misc.h>
+
+/** Reply body being collected */
+struct tlog_session_list_reply {
+    char       *buf;    /**< Body buffer */
+    size_t      size;   /**< Buffer size */
+    size_t      len;    /**< Body length */
+};
+
+bool
+tlog_session_list_is_valid(const struct tlog_session_list *list)
+{
+    return list != NULL &&
+           (list->info_list != NULL || list->info_num == 0);
+}
+
+void
+tlog_session_list_destroy(struct tlog_session_list *list)
+{
+    size_t i;
+
+    if (list == NULL) {
+        return;
+    }
+    for (i = 0; i < list->info_num; i++) {
+        free(list->info_list[i].host);
+        free(list->info_list[i].user);
+    }
+    free(list->info_list);
+    free(list);
+}
+
+/**
+ * Compare two sessions by host name and session ID, and then by the
+ * position of the first message - a qsort comparison function.
+ *
+ * @param a     The first session.
+ * @param b     The second session.
+ *
+ * @return Negative, zero, or positive number, if the first session is
+ *         less than, equal to, or greater than the second one.
+ */
+static int
+tlog_session_list_info_cmp(const void *a, const void *b)
+{
+    const struct tlog_session_info *ia = (const struct tlog_session_info *)a;
+    const struct tlog_session_info *ib = (const struct tlog_session_info *)b;
+    int rc;
+
+    rc = strcmp(ia->host, ib->host);
+    if (rc != 0) {
+        return rc;
+    }
+    if (ia->session != ib->session) {
+        return ia->session < ib->session ? -1 : 1;
+    }
+    if (ia->first_pos != ib->first_pos) {
+        return ia->first_pos < ib->first_pos ? -1 : 1;
+    }
+    return 0;
+}
+
+tlog_grc
+tlog_session_list_create_index(struct tlog_session_list **plist,
+                               const struct tlog_index *index)
+{
+    tlog_grc grc;
+    struct tlog_session_list *list;
+    struct tlog_session_info *info_list = NULL;
+    struct tlog_session_info *info;
+    const struct tlog_index_run *run;
+    size_t num = 0;
+    size_t i;
+
+    assert(plist != NULL);
+    assert(tlog_index_is_valid(index));
+
+    list = calloc(1, sizeof(*list));
+    if (list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    if (index->run_num == 0) {
+        *plist = list;
+        return TLOG_RC_OK;
+    }
+
+    /* Summarize each run, referencing the index strings */
+    info_list = calloc(index->run_num, sizeof(*info_list));
+    if (info_list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    for (i = 0; i < index->run_num; i++) {
+        run = &index->run_list[i];
+        info = &info_list[i];
+        info->host = index->str_list[run->host];
+        info->user = index->str_list[run->user];
+        info->session = run->session;
+        info->first_pos = run->first_pos;
+        info->last_pos = run->last_pos;
+        info->end_pos = run->end_pos;
+        info->num = run->num;
+        info->bytes = run->end - run->start;
+    }
+
+    /* Merge the runs of each session */
+    qsort(info_list, index->run_num, sizeof(*info_list),
+          tlog_session_list_info_cmp);
+    for (i = 0; i < index->run_num; i++) {
+        info = &info_list[i];
+        if (num > 0 &&
+            strcmp(info_list[num - 1].host, info->host) == 0 &&
+            info_list[num - 1].session == info->session) {
+            info = &info_list[num - 1];
+            if (info_list[i].last_pos > info->last_pos) {
+                info->last_pos = info_list[i].last_pos;
+            }
+            if (info_list[i].end_pos > info->end_pos) {
+                info->end_pos = info_list[i].end_pos;
+            }
+            info->num += info_list[i].num;
+            info->bytes += info_list[i].bytes;
+        } else {
+            info_list[num++] = *info;
+        }
+    }
+
+    /* Take over the list, copying the strings */
+    list->info_list = info_list;
+    for (i = 0; i < num; i++) {
+        info = &info_list[i];
+        info->host = strdup(info->host);
+        info->user = info->host == NULL ? NULL : strdup(info->user);
+        list->info_num = i + 1;
+        if (info->user == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            goto error;
+        }
+    }
+
+    assert(tlog_session_list_is_valid(list));
+    *plist = list;
+    return TLOG_RC_OK;
+
+error:
+    if (list == NULL || list->info_list == NULL) {
+        free(info_list);
+    }
+    tlog_session_list_destroy(list);
+    *plist = NULL;
+    return grc;
+}
+
+/**
+ * Format an ElasticSearch aggregation request body, retrieving the sessions
+ * of the messages matching a query.
+ *
+ * @param pbody     Location for the dynamically-allocated body.
+ * @param query     The query string selecting the messages.
+ * @param size      Maximum number of hosts, and sessions per host, to
+ *                  retrieve.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_session_list_format_body(char **pbody, const char *query, size_t size)
+{
+    tlog_grc grc;
+    struct json_object *str;
+
+    assert(pbody != NULL);
+    assert(query != NULL);
+    assert(size >= TLOG_SESSION_LIST_SIZE_MIN);
+
+    /* Let json-c escape the query */
+    str = json_object_new_string(query);
+    if (str == NULL) {
+        return TLOG_GRC_FROM(errno, ENOMEM);
+    }
+
+    /* Request no hits, only the aggregations */
+    if (asprintf(pbody,
+                 "{\"query\":{\"query_string\":{\"query\":%s}},"
+                 "\"size\":0,"
+                 "\"aggs\":{\"host\":{"
+                    "\"terms\":{\"field\":\"host.raw\",\"size\":%zu},"
+                    "\"aggs\":{\"session\":{"
+                        "\"terms\":{\"field\":\"session\",\"size\":%zu},"
+                        "\"aggs\":{"
+                            "\"user\":{\"terms\":{\"field\":\"user.raw\","
+                                                 "\"size\":1}},"
+                            "\"first_pos\":{\"min\":{\"field\":\"pos\"}},"
+                            "\"last_pos\":{\"max\":{\"field\":\"pos\"}},"
+                            "\"last\":{\"top_hits\":{"
+                                "\"size\":1,"
+                                "\"sort\":[{\"pos\":\"desc\"}],"
+                                "\"_source\":[\"timing\"]}}"
+                 "}}}}}}",
+                 json_object_to_json_string(str), size, size) < 0) {
+        grc = TLOG_GRC_FROM(errno, ENOMEM);
+    } else {
+        grc = TLOG_RC_OK;
+    }
+
+    json_object_put(str);
+    return grc;
+}
+
+/**
+ * Collect an HTTP reply body - to be supplied to curl_easy_setopt with
+ * CURLOPT_WRITEFUNCTION and called by curl_easy_perform.
+ *
+ * @param ptr       Pointer to the retrieved piece of the body.
+ * @param size      Size of each retrieved data chunk.
+ * @param nmemb     Number of retrieved data chunks.
+ * @param userdata  The reply, as supplied with CURLOPT_WRITEDATA.
+ *
+ * @return Number of bytes processed, signals error if different from
+ *         size*nmemb.
+ */
+static size_t
+tlog_session_list_reply_func(char *ptr, size_t size, size_t nmemb,
+                             void *userdata)
+{
+    struct tlog_session_list_reply *reply =
+                    (struct tlog_session_list_reply *)userdata;
+    size_t len = size * nmemb;
+    size_t new_size;
+    char *new_buf;
+
+    assert(ptr != NULL || len == 0);
+    assert(reply != NULL);
+
+    if (reply->len + len > reply->size) {
+        new_size = reply->size == 0 ? 4096 : reply->size;
+        while (new_size < reply->len + len) {
+            new_size *= 2;
+        }
+        new_buf = realloc(reply->buf, new_size);
+        if (new_buf == NULL) {
+            return !len;
+        }
+        reply->buf = new_buf;
+        reply->size = new_size;
+    }
+
+    memcpy(reply->buf + reply->len, ptr, len);
+    reply->len += len;
+    return len;
+}
+
+/**
+ * Retrieve a bucket list of an aggregation in an ElasticSearch reply,
+ * noting if any buckets were left out.
+ *
+ * @param obj       The object containing the aggregation.
+ * @param name      The aggregation name.
+ * @param pbuckets  Location for the bucket array, or NULL, if there were
+ *                  no buckets, as filtering drops empty arrays.
+ * @param ppartial  Location of the flag to set, if buckets were left out,
+ *                  or NULL to not check.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_session_list_get_buckets(struct json_object *obj, const char *name,
+                              struct json_object **pbuckets, bool *ppartial)
+{
+    struct json_object *agg;
+    struct json_object *field;
+
+    *pbuckets = NULL;
+    if (!json_object_object_get_ex(obj, name, &agg)) {
+        return TLOG_RC_OK;
+    }
+    if (json_object_get_type(agg) != json_type_object) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    if (ppartial != NULL &&
+        json_object_object_get_ex(agg, "sum_other_doc_count", &field) &&
+        json_object_get_int64(field) > 0) {
+        *ppartial = true;
+    }
+    if (!json_object_object_get_ex(agg, "buckets", pbuckets)) {
+        return TLOG_RC_OK;
+    }
+    if (json_object_get_type(*pbuckets) != json_type_array) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    return TLOG_RC_OK;
+}
+
+/**
+ * Retrieve the value of a "min" or "max" aggregation of message positions
+ * in an ElasticSearch reply bucket.
+ *
+ * @param bucket    The bucket containing the aggregation.
+ * @param name      The aggregation name.
+ * @param ppos      Location for the position.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_session_list_get_pos(struct json_object *bucket, const char *name,
+                          uint64_t *ppos)
+{
+    struct json_object *agg;
+    struct json_object *value;
+    double pos;
+
+    if (!json_object_object_get_ex(bucket, name, &agg) ||
+        !json_object_object_get_ex(agg, "value", &value)) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    switch (json_object_get_type(value)) {
+    case json_type_int:
+    case json_type_double:
+        pos = json_object_get_double(value);
+        break;
+    default:
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    if (pos < 0 || pos >= (double)UINT64_MAX) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    *ppos = (uint64_t)pos;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Retrieve the end position of the last message of a session from the
+ * "top_hits" aggregation in an ElasticSearch reply bucket, adding the span
+ * of its timing to its position.
+ *
+ * @param bucket    The session bucket containing the aggregation.
+ * @param last_pos  Position of the last message, ms.
+ * @param pend_pos  Location for the end position, ms, set to the last
+ *                  message position, if there's no message to take the
+ *                  timing of.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_session_list_get_end_pos(struct json_object *bucket, uint64_t last_pos,
+                              uint64_t *pend_pos)
+{
+    struct json_object *obj;
+
+    *pend_pos = last_pos;
+    if (!json_object_object_get_ex(bucket, "last", &obj) ||
+        !json_object_object_get_ex(obj, "hits", &obj) ||
+        !json_object_object_get_ex(obj, "hits", &obj) ||
+        json_object_get_type(obj) != json_type_array ||
+        json_object_array_length(obj) == 0) {
+        return TLOG_RC_OK;
+    }
+    if (!json_object_object_get_ex(json_object_array_get_idx(obj, 0),
+                                   "_source", &obj) ||
+        !json_object_object_get_ex(obj, "timing", &obj) ||
+        json_object_get_type(obj) != json_type_string) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    *pend_pos += tlog_json_msg_timing_get_span(json_object_get_string(obj));
+    return TLOG_RC_OK;
+}
+
+/**
+ * Parse an ElasticSearch aggregation reply into a session list.
+ *
+ * @param list  The (empty) list to fill in.
+ * @param reply The reply to parse.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+tlog_session_list_parse(struct tlog_session_list *list,
+                        struct json_object *reply)
+{
+    tlog_grc grc;
+    struct json_object *aggs;
+    struct json_object *host_buckets;
+    struct json_object *host_bucket;
+    struct json_object *session_buckets;
+    struct json_object *session_bucket;
+    struct json_object *user_buckets;
+    struct json_object *field;
+    struct json_object *host;
+    struct tlog_session_info *info;
+    struct tlog_session_info *info_list;
+    size_t info_size = 0;
+    size_t i;
+    size_t j;
+    int64_t session;
+    int64_t num;
+
+    assert(list->info_num == 0);
+
+    if (json_object_get_type(reply) != json_type_object) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    if (!json_object_object_get_ex(reply, "aggregations", &aggs)) {
+        return TLOG_RC_OK;
+    }
+    if (json_object_get_type(aggs) != json_type_object) {
+        return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+    }
+    grc = tlog_session_list_get_buckets(aggs, "host", &host_buckets,
+                                        &list->partial);
+    if (grc != TLOG_RC_OK || host_buckets == NULL) {
+        return grc;
+    }
+
+    for (i = 0; i < (size_t)json_object_array_length(host_buckets); i++) {
+        host_bucket = json_object_array_get_idx(host_buckets, i);
+        if (json_object_get_type(host_bucket) != json_type_object ||
+            !json_object_object_get_ex(host_bucket, "key", &host) ||
+            json_object_get_type(host) != json_type_string) {
+            return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+        }
+        grc = tlog_session_list_get_buckets(host_bucket, "session",
+                                            &session_buckets,
+                                            &list->partial);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+        if (session_buckets == NULL) {
+            continue;
+        }
+
+        for (j = 0; j < (size_t)json_object_array_length(session_buckets);
+             j++) {
+            session_bucket = json_object_array_get_idx(session_buckets, j);
+            if (json_object_get_type(session_bucket) != json_type_object ||
+                !json_object_object_get_ex(session_bucket, "key", &field) ||
+                json_object_get_type(field) != json_type_int) {
+                return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+            }
+            session = json_object_get_int64(field);
+            if (!json_object_object_get_ex(session_bucket, "doc_count",
+                                           &field) ||
+                json_object_get_type(field) != json_type_int) {
+                return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+            }
+            num = json_object_get_int64(field);
+            if (session < 0 || session > UINT_MAX || num < 0) {
+                return TLOG_RC_SESSION_LIST_REPLY_INVALID;
+            }
+
+            /* Grow the list */
+            if (list->info_num >= info_size) {
+                info_size = info_size == 0 ? 16 : info_size * 2;
+                info_list = realloc(list->info_list,
+                                    info_size * sizeof(*info_list));
+                if (info_list == NULL) {
+                    return TLOG_GRC_ERRNO;
+                }
+                list->info_list = info_list;
+            }
+            info = &list->info_list[list->info_num];
+            memset(info, 0, sizeof(*info));
+            list->info_num++;
+
+            info->session = (unsigned int)session;
+            info->num = (size_t)num;
+            info->bytes = TLOG_SESSION_LIST_BYTES_UNKNOWN;
+            grc = tlog_session_list_get_pos(session_bucket, "first_pos",
+                                            &info->first_pos);
+            if (grc == TLOG_RC_OK) {
+                grc = tlog_session_list_get_pos(session_bucket, "last_pos",
+                                                &info->last_pos);
+            }
+            if (grc == TLOG_RC_OK) {
+                grc = tlog_session_list_get_end_pos(session_bucket,
+                                                    info->last_pos,
+                                                    &info->end_pos);
+            }
+            if (grc != TLOG_RC_OK) {
+                return grc;
+            }
+
+            /* Take the (first) user name of the session, if any */
+            grc = tlog_session_list_get_buckets(session_bucket, "user",
+                                                &user_buckets, NULL);
+            if (grc != TLOG_RC_OK) {
+                return grc;
+            }
+            if (user_buckets != NULL &&
+                json_object_array_length(user_buckets) > 0 &&
+                json_object_object_get_ex(
+                    json_object_array_get_idx(user_buckets, 0),
+                    "key", &field) &&
+                json_object_get_type(field) == json_type_string) {
+                info->user = strdup(json_object_get_string(field));
+            } else {
+                info->user = strdup("");
+            }
+            info->host = strdup(json_object_get_string(host));
+            if (info->user == NULL || info->host == NULL) {
+                return TLOG_GRC_ERRNO;
+            }
+        }
+    }
+
+    if (list->info_num > 0) {
+        qsort(list->info_list, list->info_num, sizeof(*list->info_list),
+              tlog_session_list_info_cmp);
+    }
+    return TLOG_RC_OK;
+}
+
+tlog_grc
+tlog_session_list_create_es(struct tlog_session_list **plist,
+                            const char *base_url,
+                            const char *query,
+                            size_t size,
+                            unsigned int connect_timeout,
+                            unsigned int timeout)
+{
+    static const char *header_list[] = {
+        "Content-Type: application/json",
+        /* Don't wait for "100 Continue" before sending the body */
+        "Expect:",
+    };
+    tlog_grc grc;
+    struct tlog_session_list *list = NULL;
+    struct tlog_session_list_reply reply = {NULL, 0, 0};
+    struct curl_slist *headers = NULL;
+    struct curl_slist *new_headers;
+    struct json_tokener *tok = NULL;
+    struct json_object *obj = NULL;
+    CURL *curl = NULL;
+    char *url = NULL;
+    char *body = NULL;
+    long status;
+    CURLcode rc;
+    size_t i;
+
+    assert(plist != NULL);
+    assert(tlog_es_json_reader_base_url_is_valid(base_url));
+    assert(query != NULL);
+    assert(size >= TLOG_SESSION_LIST_SIZE_MIN);
+
+    list = calloc(1, sizeof(*list));
+    if (list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto cleanup;
+    }
+
+    /* Build the request header list */
+    for (i = 0; i < TLOG_ARRAY_SIZE(header_list); i++) {
+        new_headers = curl_slist_append(headers, header_list[i]);
+        if (new_headers == NULL) {
+            grc = TLOG_GRC_FROM(errno, ENOMEM);
+            goto cleanup;
+        }
+        headers = new_headers;
+    }
+
+    grc = tlog_session_list_format_body(&body, query, size);
+    if (grc != TLOG_RC_OK) {
+        goto cleanup;
+    }
+
+    /* Have only the aggregations returned */
+    if (asprintf(&url, "%s?filter_path=aggregations", base_url) < 0) {
+        url = NULL;
+        grc = TLOG_GRC_FROM(errno, ENOMEM);
+        goto cleanup;
+    }
+
+    curl = curl_easy_init();
+    if (curl == NULL) {
+        grc = TLOG_RC_SESSION_LIST_CURL_INIT_FAILED;
+        goto cleanup;
+    }
+
+#define SETOPT(_opt, _val) \
+    do {                                            \
+        rc = curl_easy_setopt(curl, _opt, _val);    \
+        if (rc != CURLE_OK) {                       \
+            grc = TLOG_GRC_FROM(curl, rc);          \
+            goto cleanup;                           \
+        }                                           \
+    } while (0)
+
+    SETOPT(CURLOPT_URL, url);
+    SETOPT(CURLOPT_POST, 1L);
+    SETOPT(CURLOPT_HTTPHEADER, headers);
+    SETOPT(CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)strlen(body));
+    SETOPT(CURLOPT_POSTFIELDS, body);
+    SETOPT(CURLOPT_WRITEFUNCTION, tlog_session_list_reply_func);
+    SETOPT(CURLOPT_WRITEDATA, &reply);
+    SETOPT(CURLOPT_NOSIGNAL, 1L);
+    SETOPT(CURLOPT_CONNECTTIMEOUT, (long)connect_timeout);
+    SETOPT(CURLOPT_TIMEOUT, (long)timeout);
+    /* Accept any compression supported by libcurl */
+#if LIBCURL_VERSION_NUM >= 0x071506
+    SETOPT(CURLOPT_ACCEPT_ENCODING, "");
+#else
+    SETOPT(CURLOPT_ENCODING, "");
+#endif
+
+#undef SETOPT
+
+    rc = curl_easy_perform(curl);
+    if (rc != CURLE_OK) {
+        grc = TLOG_GRC_FROM(curl, rc);
+        goto cleanup;
+    }
+    rc = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    if (rc != CURLE_OK) {
+        grc = TLOG_GRC_FROM(curl, rc);
+        goto cleanup;
+    }
+    if (status != 0 && (status < 200 || status >= 300)) {
+        grc = TLOG_RC_SESSION_LIST_REPLY_INVALID;
+        goto cleanup;
+    }
+
+    /* Parse the reply, if json-c can take it at once */
+    if (reply.len > INT_MAX) {
+        grc = TLOG_GRC_FROM(json, json_tokener_error_size);
+        goto cleanup;
+    }
+    tok = json_tokener_new();
+    if (tok == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        goto cleanup;
+    }
+    obj = reply.len == 0 ? NULL
+                         : json_tokener_parse_ex(tok, reply.buf,
+                                                 (int)reply.len);
+    if (obj == NULL) {
+        grc = TLOG_RC_SESSION_LIST_REPLY_INVALID;
+        goto cleanup;
+    }
+    grc = tlog_session_list_parse(list, obj);
+
+cleanup:
+
+    if (obj != NULL) {
+        json_object_put(obj);
+    }
+    if (tok != NULL) {
+        json_tokener_free(tok);
+    }
+    if (curl != NULL) {
+        curl_easy_cleanup(curl);
+    }
+    curl_slist_free_all(headers);
+    free(url);
+    free(body);
+    free(reply.buf);
+    if (grc != TLOG_RC_OK) {
+        tlog_session_list_destroy(list);
+        list = NULL;
+    }
+    *plist = list;
+    return grc;
+}
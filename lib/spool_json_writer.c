@@ -0,0 +1,476 @@
+/*
+ * Spool JSON log message writer.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <zlib.h>
+#include <tlog/rc.h>
+#include <tlog/misc.h>
+#include <tlog/timespec.h>
+#include <tlog/spool_json_writer.h>
+
+/** Spool file magic signature */
+#define TLOG_SPOOL_JSON_WRITER_MAGIC    "TLOGSPL"
+
+/** Spool file format version */
+#define TLOG_SPOOL_JSON_WRITER_VERSION  1
+
+/** Record length marking the rest of the ring as unused */
+#define TLOG_SPOOL_JSON_WRITER_WRAP     UINT32_MAX
+
+/** Spool file header */
+struct tlog_spool_json_writer_hdr {
+    char        magic[8];   /**< Magic signature */
+    uint32_t    version;    /**< Format version */
+    uint32_t    reserved;   /**< Reserved, zero */
+    uint64_t    size;       /**< Ring size, bytes */
+    uint64_t    head;       /**< Logical offset past the last record */
+    uint64_t    tail;       /**< Logical offset of the first record
+                                 not flushed by the forwarding writer */
+};
+
+/** Ring record header, followed by the message, aligned to 8 bytes */
+struct tlog_spool_json_writer_rec {
+    uint32_t    len;        /**< Message length, or
+                                 TLOG_SPOOL_JSON_WRITER_WRAP */
+    uint32_t    crc;        /**< CRC32 of the length and the message */
+};
+
+/** Size of the spool file header, keeping the ring aligned */
+#define TLOG_SPOOL_JSON_WRITER_HDR_SIZE \
+    TLOG_ROUND_UP(sizeof(struct tlog_spool_json_writer_hdr), 8)
+
+/** Spool writer data */
+struct tlog_spool_json_writer {
+    struct tlog_json_writer             writer;         /**< Abstract writer
+                                                             instance */
+    struct tlog_json_writer            *fwd_writer;     /**< Forwarding
+                                                             writer */
+    bool                                fwd_writer_owned;
+                                                        /**< True if the
+                                                             forwarding writer
+                                                             is owned */
+    unsigned int                        retry;          /**< Retry delay,
+                                                             seconds */
+    int                                 fd;             /**< Spool file FD */
+    uint8_t                            *map;            /**< Mapped file */
+    size_t                              map_size;       /**< Mapping size */
+    struct tlog_spool_json_writer_hdr  *hdr;            /**< Mapped header */
+    uint8_t                            *ring;           /**< Mapped ring */
+    uint64_t                            fwd;            /**< Logical offset
+                                                             of the first
+                                                             record not
+                                                             forwarded yet */
+    bool                                failed;         /**< True if the
+                                                             forwarding writer
+                                                             failed and
+                                                             retry_ts is
+                                                             pending */
+    struct timespec                     retry_ts;       /**< Time to retry
+                                                             forwarding at */
+};
+
+/**
+ * Calculate the CRC of a record.
+ *
+ * @param len   Message length.
+ * @param buf   Message buffer.
+ *
+ * @return The record CRC.
+ */
+static uint32_t
+tlog_spool_json_writer_crc(uint32_t len, const uint8_t *buf)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef *)&len, sizeof(len));
+    crc = crc32(crc, (const Bytef *)buf, len);
+    return (uint32_t)crc;
+}
+
+/**
+ * Locate the record at a logical offset, skipping a wrap marker, and check
+ * it is complete and intact.
+ *
+ * @param spool_json_writer The writer to look in.
+ * @param ppos              Location of the logical offset of the record,
+ *                          advanced past a wrap marker.
+ * @param pbuf              Location for the message pointer.
+ * @param plen              Location for the message length.
+ *
+ * @return True if the record is valid, false otherwise.
+ */
+static bool
+tlog_spool_json_writer_rec_get(struct tlog_spool_json_writer *spool_json_writer,
+                               uint64_t *ppos,
+                               const uint8_t **pbuf,
+                               size_t *plen)
+{
+    uint64_t size = spool_json_writer->hdr->size;
+    uint64_t head = spool_json_writer->hdr->head;
+    uint64_t pos = *ppos;
+    uint64_t off;
+    struct tlog_spool_json_writer_rec *rec;
+
+    off = pos % size;
+    rec = (struct tlog_spool_json_writer_rec *)
+                (spool_json_writer->ring + off);
+    if (rec->len == TLOG_SPOOL_JSON_WRITER_WRAP) {
+        pos += size - off;
+        off = 0;
+        rec = (struct tlog_spool_json_writer_rec *)spool_json_writer->ring;
+    }
+    if (pos + sizeof(*rec) > head ||
+        rec->len > size - off - sizeof(*rec) ||
+        pos + sizeof(*rec) + rec->len > head ||
+        tlog_spool_json_writer_crc(rec->len, (const uint8_t *)(rec + 1)) !=
+            rec->crc) {
+        return false;
+    }
+
+    *ppos = pos;
+    *pbuf = (const uint8_t *)(rec + 1);
+    *plen = rec->len;
+    return true;
+}
+
+/** Calculate the ring space taken by a record with a message of len bytes */
+#define TLOG_SPOOL_JSON_WRITER_REC_SIZE(_len) \
+    TLOG_ROUND_UP(sizeof(struct tlog_spool_json_writer_rec) + (_len), 8)
+
+/**
+ * Note a failure of the forwarding writer: rewind forwarding to the first
+ * unflushed record and schedule a retry.
+ *
+ * @param spool_json_writer The writer to mark.
+ */
+static void
+tlog_spool_json_writer_fail(struct tlog_spool_json_writer *spool_json_writer)
+{
+    spool_json_writer->fwd = spool_json_writer->hdr->tail;
+    spool_json_writer->failed = true;
+    clock_gettime(CLOCK_MONOTONIC, &spool_json_writer->retry_ts);
+    spool_json_writer->retry_ts.tv_sec += spool_json_writer->retry;
+}
+
+/**
+ * Check if forwarding should be attempted, i.e. it didn't fail, or the
+ * retry time has come.
+ *
+ * @param spool_json_writer The writer to check.
+ *
+ * @return True if forwarding can be attempted.
+ */
+static bool
+tlog_spool_json_writer_can_fwd(struct tlog_spool_json_writer *spool_json_writer)
+{
+    struct timespec now;
+
+    if (!spool_json_writer->failed) {
+        return true;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (tlog_timespec_cmp(&now, &spool_json_writer->retry_ts) < 0) {
+        return false;
+    }
+    spool_json_writer->failed = false;
+    return true;
+}
+
+/**
+ * Forward the records not forwarded yet to the forwarding writer.
+ *
+ * @param spool_json_writer The writer to forward records of.
+ */
+static void
+tlog_spool_json_writer_fwd(struct tlog_spool_json_writer *spool_json_writer)
+{
+    uint64_t pos;
+    const uint8_t *buf;
+    size_t len;
+    bool valid;
+    tlog_grc grc;
+
+    if (!tlog_spool_json_writer_can_fwd(spool_json_writer)) {
+        return;
+    }
+
+    for (pos = spool_json_writer->fwd;
+         pos < spool_json_writer->hdr->head;
+         pos += TLOG_SPOOL_JSON_WRITER_REC_SIZE(len)) {
+        valid = tlog_spool_json_writer_rec_get(spool_json_writer,
+                                               &pos, &buf, &len);
+        /* Records were validated on opening, and written by us since */
+        assert(valid);
+        (void)valid;
+        grc = tlog_json_writer_write(spool_json_writer->fwd_writer,
+                                     buf, len);
+        if (grc != TLOG_RC_OK) {
+            tlog_spool_json_writer_fail(spool_json_writer);
+            return;
+        }
+        spool_json_writer->fwd = pos + TLOG_SPOOL_JSON_WRITER_REC_SIZE(len);
+    }
+}
+
+static tlog_grc
+tlog_spool_json_writer_flush(struct tlog_json_writer *writer)
+{
+    struct tlog_spool_json_writer *spool_json_writer =
+                                (struct tlog_spool_json_writer*)writer;
+    tlog_grc grc;
+
+    tlog_spool_json_writer_fwd(spool_json_writer);
+    if (spool_json_writer->failed) {
+        return TLOG_RC_OK;
+    }
+
+    grc = tlog_json_writer_flush(spool_json_writer->fwd_writer);
+    if (grc != TLOG_RC_OK) {
+        tlog_spool_json_writer_fail(spool_json_writer);
+        return TLOG_RC_OK;
+    }
+
+    /* Everything forwarded is delivered, release it */
+    spool_json_writer->hdr->tail = spool_json_writer->fwd;
+
+    /* Schedule writing the ring to disk */
+    msync(spool_json_writer->map, spool_json_writer->map_size, MS_ASYNC);
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+tlog_spool_json_writer_write(struct tlog_json_writer *writer,
+                             const uint8_t *buf,
+                             size_t len)
+{
+    struct tlog_spool_json_writer *spool_json_writer =
+                                (struct tlog_spool_json_writer*)writer;
+    struct tlog_spool_json_writer_hdr *hdr = spool_json_writer->hdr;
+    struct tlog_spool_json_writer_rec *rec;
+    uint64_t rec_size = TLOG_SPOOL_JSON_WRITER_REC_SIZE(len);
+    uint64_t off;
+    uint64_t rem;
+    uint64_t need;
+
+    if (len >= TLOG_SPOOL_JSON_WRITER_WRAP || rec_size > hdr->size) {
+        return TLOG_RC_SPOOL_JSON_WRITER_FULL;
+    }
+
+    /* Calculate the space needed, including skipping the ring end */
+    off = hdr->head % hdr->size;
+    rem = hdr->size - off;
+    need = rec_size > rem ? rem + rec_size : rec_size;
+
+    /* Try to free up space, if there's not enough */
+    if (hdr->size - (hdr->head - hdr->tail) < need) {
+        tlog_spool_json_writer_flush(writer);
+        if (hdr->size - (hdr->head - hdr->tail) < need) {
+            return TLOG_RC_SPOOL_JSON_WRITER_FULL;
+        }
+    }
+
+    /* Skip the end of the ring, if the record doesn't fit */
+    if (rec_size > rem) {
+        rec = (struct tlog_spool_json_writer_rec *)
+                    (spool_json_writer->ring + off);
+        rec->len = TLOG_SPOOL_JSON_WRITER_WRAP;
+        rec->crc = 0;
+        hdr->head += rem;
+        off = 0;
+    }
+
+    /* Store the record, then publish it */
+    rec = (struct tlog_spool_json_writer_rec *)(spool_json_writer->ring + off);
+    rec->len = (uint32_t)len;
+    memcpy(rec + 1, buf, len);
+    rec->crc = tlog_spool_json_writer_crc(rec->len, buf);
+    hdr->head += rec_size;
+
+    /* Pass it on, if we can */
+    tlog_spool_json_writer_fwd(spool_json_writer);
+    return TLOG_RC_OK;
+}
+
+/**
+ * Check if a mapped spool file header is valid for a file of the
+ * specified size.
+ *
+ * @param hdr       The header to check.
+ * @param file_size The size of the spool file.
+ *
+ * @return True if the header is valid, false otherwise.
+ */
+static bool
+tlog_spool_json_writer_hdr_is_valid(
+                            const struct tlog_spool_json_writer_hdr *hdr,
+                            off_t file_size)
+{
+    return memcmp(hdr->magic, TLOG_SPOOL_JSON_WRITER_MAGIC,
+                  sizeof(hdr->magic)) == 0 &&
+           hdr->version == TLOG_SPOOL_JSON_WRITER_VERSION &&
+           hdr->size >= TLOG_SPOOL_JSON_WRITER_SIZE_MIN &&
+           hdr->size % 8 == 0 &&
+           (uint64_t)file_size ==
+                TLOG_SPOOL_JSON_WRITER_HDR_SIZE + hdr->size &&
+           hdr->tail % 8 == 0 &&
+           hdr->head >= hdr->tail &&
+           hdr->head - hdr->tail <= hdr->size;
+}
+
+static void
+tlog_spool_json_writer_cleanup(struct tlog_json_writer *writer)
+{
+    struct tlog_spool_json_writer *spool_json_writer =
+                                (struct tlog_spool_json_writer*)writer;
+
+    if (spool_json_writer->map != NULL) {
+        /* Deliver what we can, the rest stays for the next time */
+        tlog_spool_json_writer_flush(writer);
+        munmap(spool_json_writer->map, spool_json_writer->map_size);
+        spool_json_writer->map = NULL;
+    }
+    if (spool_json_writer->fd >= 0) {
+        close(spool_json_writer->fd);
+        spool_json_writer->fd = -1;
+    }
+    if (spool_json_writer->fwd_writer_owned) {
+        tlog_json_writer_destroy(spool_json_writer->fwd_writer);
+        spool_json_writer->fwd_writer_owned = false;
+    }
+}
+
+static tlog_grc
+tlog_spool_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    struct tlog_spool_json_writer *spool_json_writer =
+                                (struct tlog_spool_json_writer*)writer;
+    struct tlog_json_writer *fwd_writer = va_arg(ap, struct tlog_json_writer *);
+    bool fwd_writer_owned = (bool)va_arg(ap, int);
+    const char *path = va_arg(ap, const char *);
+    size_t size = va_arg(ap, size_t);
+    unsigned int retry = va_arg(ap, unsigned int);
+    struct tlog_spool_json_writer_hdr hdr;
+    struct stat st;
+    ssize_t rc;
+    uint64_t pos;
+    const uint8_t *buf;
+    size_t len;
+    tlog_grc grc;
+
+    spool_json_writer->fwd_writer = fwd_writer;
+    spool_json_writer->retry = retry;
+    spool_json_writer->fd = -1;
+
+    /* Open and lock the spool file */
+    spool_json_writer->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC,
+                                 S_IRUSR | S_IWUSR);
+    if (spool_json_writer->fd < 0) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    if (flock(spool_json_writer->fd, LOCK_EX | LOCK_NB) < 0) {
+        grc = errno == EWOULDBLOCK ? TLOG_RC_SPOOL_JSON_WRITER_LOCKED
+                                   : TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    /* Check the existing spool, if any */
+    if (fstat(spool_json_writer->fd, &st) < 0) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    rc = pread(spool_json_writer->fd, &hdr, sizeof(hdr), 0);
+    if (rc < 0) {
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+
+    /* (Re)create the spool, if it's missing, or not ours */
+    if ((size_t)rc != sizeof(hdr) ||
+        !tlog_spool_json_writer_hdr_is_valid(&hdr, st.st_size)) {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, TLOG_SPOOL_JSON_WRITER_MAGIC, sizeof(hdr.magic));
+        hdr.version = TLOG_SPOOL_JSON_WRITER_VERSION;
+        hdr.size = TLOG_ROUND_UP(size, 8);
+        if (ftruncate(spool_json_writer->fd, 0) < 0 ||
+            ftruncate(spool_json_writer->fd,
+                      TLOG_SPOOL_JSON_WRITER_HDR_SIZE + hdr.size) < 0 ||
+            pwrite(spool_json_writer->fd, &hdr, sizeof(hdr), 0) !=
+                (ssize_t)sizeof(hdr)) {
+            grc = TLOG_GRC_ERRNO;
+            goto error;
+        }
+    }
+
+    /* Map the spool */
+    spool_json_writer->map_size = TLOG_SPOOL_JSON_WRITER_HDR_SIZE + hdr.size;
+    spool_json_writer->map = mmap(NULL, spool_json_writer->map_size,
+                                  PROT_READ | PROT_WRITE, MAP_SHARED,
+                                  spool_json_writer->fd, 0);
+    if (spool_json_writer->map == MAP_FAILED) {
+        spool_json_writer->map = NULL;
+        grc = TLOG_GRC_ERRNO;
+        goto error;
+    }
+    spool_json_writer->hdr =
+        (struct tlog_spool_json_writer_hdr *)spool_json_writer->map;
+    spool_json_writer->ring =
+        spool_json_writer->map + TLOG_SPOOL_JSON_WRITER_HDR_SIZE;
+
+    /* Drop the records following a damaged one, if any */
+    for (pos = spool_json_writer->hdr->tail;
+         pos < spool_json_writer->hdr->head;
+         pos += TLOG_SPOOL_JSON_WRITER_REC_SIZE(len)) {
+        if (!tlog_spool_json_writer_rec_get(spool_json_writer,
+                                            &pos, &buf, &len)) {
+            spool_json_writer->hdr->head = pos;
+            break;
+        }
+    }
+
+    /* Replay the records left in the spool */
+    spool_json_writer->fwd = spool_json_writer->hdr->tail;
+    tlog_spool_json_writer_flush(writer);
+
+    /* Take over the forwarding writer only on success */
+    spool_json_writer->fwd_writer_owned = fwd_writer_owned;
+    return TLOG_RC_OK;
+
+error:
+    tlog_spool_json_writer_cleanup(writer);
+    return grc;
+}
+
+const struct tlog_json_writer_type tlog_spool_json_writer_type = {
+    .size       = sizeof(struct tlog_spool_json_writer),
+    .init       = tlog_spool_json_writer_init,
+    .write      = tlog_spool_json_writer_write,
+    .flush      = tlog_spool_json_writer_flush,
+    .cleanup    = tlog_spool_json_writer_cleanup,
+};
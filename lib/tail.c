@@ -0,0 +1,171 @@
+/*
+ * Followed log file.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <tlog/tail.h>
+#include <tlog/rc.h>
+#include <tlog/misc.h>
+
+/**
+ * Read the head of a followed log file, and compare it to the one seen
+ * before, remembering more of it, as it's written.
+ *
+ * @param tail  The log state to check the file head for.
+ *
+ * @return True if the head matches the one seen, or can't be read, false
+ *         if it differs.
+ */
+static bool
+tlog_tail_check_head(struct tlog_tail *tail)
+{
+    char head[TLOG_TAIL_HEAD_SIZE];
+    ssize_t rc;
+    size_t len;
+    int fd;
+
+    fd = open(tail->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return true;
+    }
+    rc = pread(fd, head, sizeof(head), 0);
+    close(fd);
+    if (rc < 0) {
+        return true;
+    }
+    len = strnlen(head, (size_t)rc);
+
+    if (len < tail->head_len ||
+        memcmp(head, tail->head, tail->head_len) != 0) {
+        return false;
+    }
+    memcpy(tail->head, head, len);
+    tail->head_len = len;
+    return true;
+}
+
+void
+tlog_tail_init(struct tlog_tail *tail, const char *path)
+{
+    struct stat st;
+    char *dir;
+    char *slash;
+
+    memset(tail, 0, sizeof(*tail));
+    tail->fd = -1;
+    tail->delay = TLOG_TAIL_POLL_DELAY_MIN;
+
+    if (path == NULL || stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    tail->path = path;
+    tail->dev = st.st_dev;
+    tail->ino = st.st_ino;
+    tlog_tail_check_head(tail);
+
+    /* Watch the file for writes, and its directory for replacements */
+    tail->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (tail->fd < 0) {
+        return;
+    }
+    dir = strdup(tail->path);
+    if (dir != NULL) {
+        slash = strrchr(dir, '/');
+        if (slash == NULL) {
+            strcpy(dir, ".");
+        } else {
+            /* Cut off the name, but keep the root directory slash */
+            slash[slash == dir] = '\0';
+        }
+    }
+    if (dir == NULL ||
+        inotify_add_watch(tail->fd, tail->path,
+                          IN_MODIFY | IN_ATTRIB |
+                          IN_MOVE_SELF | IN_DELETE_SELF) < 0 ||
+        inotify_add_watch(tail->fd, dir, IN_CREATE | IN_MOVED_TO) < 0) {
+        close(tail->fd);
+        tail->fd = -1;
+    }
+    free(dir);
+}
+
+tlog_grc
+tlog_tail_wait(struct tlog_tail *tail)
+{
+    char buf[4096]
+            __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd;
+    struct timespec ts;
+    struct stat st;
+    off_t size = 0;
+
+    /* Remember the size read up to */
+    if (tail->path != NULL && stat(tail->path, &st) == 0) {
+        size = st.st_size;
+    }
+
+    if (tail->fd >= 0) {
+        /* Wait for any event, and drain them */
+        pfd.fd = tail->fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, TLOG_TAIL_WATCH_PERIOD) < 0) {
+            return TLOG_GRC_ERRNO;
+        }
+        while (read(tail->fd, buf, sizeof(buf)) > 0);
+    } else {
+        /* Poll with exponential backoff */
+        ts.tv_sec = tail->delay / 1000;
+        ts.tv_nsec = tail->delay % 1000 * 1000000;
+        if (nanosleep(&ts, NULL) < 0) {
+            return TLOG_GRC_ERRNO;
+        }
+        tail->delay = TLOG_MIN(tail->delay * 2, TLOG_TAIL_POLL_DELAY_MAX);
+    }
+
+    /* Check if the log file was replaced or truncated */
+    if (tail->path != NULL && stat(tail->path, &st) == 0) {
+        if (st.st_dev != tail->dev || st.st_ino != tail->ino) {
+            tail->rotated = true;
+        } else if (st.st_size < size || !tlog_tail_check_head(tail)) {
+            tail->truncated = true;
+        }
+    }
+
+    return TLOG_RC_OK;
+}
+
+void
+tlog_tail_cleanup(struct tlog_tail *tail)
+{
+    if (tail->fd >= 0) {
+        close(tail->fd);
+        tail->fd = -1;
+    }
+}
@@ -0,0 +1,507 @@
+/*
+ * Test HTTP server.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <tlog/test_http_server.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <zlib.h>
+#include <assert.h>
+
+/** Connection input buffer */
+struct tlog_test_http_server_buf {
+    char   *ptr;    /**< Buffer data */
+    size_t  size;   /**< Buffer size */
+    size_t  len;    /**< Buffered data length */
+};
+
+/**
+ * Read more data from a connection into a buffer, unless the server is
+ * being stopped.
+ *
+ * @param server    The server reading.
+ * @param fd        The connection socket.
+ * @param buf       The buffer to read into.
+ *
+ * @return True if data was read, false on EOF, error or stop.
+ */
+static bool
+tlog_test_http_server_fill(struct tlog_test_http_server *server,
+                           int fd, struct tlog_test_http_server_buf *buf)
+{
+    struct pollfd pollfd_list[2] = {
+        {.fd = fd, .events = POLLIN},
+        {.fd = server->stop_fd[0], .events = POLLIN},
+    };
+    ssize_t rc;
+
+    if (buf->len == buf->size) {
+        size_t new_size = buf->size == 0 ? 4096 : buf->size * 2;
+        char *new_ptr = realloc(buf->ptr, new_size);
+        if (new_ptr == NULL) {
+            return false;
+        }
+        buf->ptr = new_ptr;
+        buf->size = new_size;
+    }
+
+    if (poll(pollfd_list, 2, -1) < 0 || pollfd_list[1].revents != 0) {
+        return false;
+    }
+    rc = read(fd, buf->ptr + buf->len, buf->size - buf->len);
+    if (rc <= 0) {
+        return false;
+    }
+    buf->len += (size_t)rc;
+    return true;
+}
+
+/**
+ * Decompress a gzip-encoded body.
+ *
+ * @param pbody     Location of the body pointer, replaced with the
+ *                  decompressed body.
+ * @param plen      Location of the body length.
+ *
+ * @return True if decompressed successfully, false otherwise.
+ */
+static bool
+tlog_test_http_server_gunzip(uint8_t **pbody, size_t *plen)
+{
+    z_stream zstream;
+    uint8_t *out = NULL;
+    size_t size = 4096;
+    int rc;
+
+    memset(&zstream, 0, sizeof(zstream));
+    if (inflateInit2(&zstream, MAX_WBITS + 16) != Z_OK) {
+        return false;
+    }
+    zstream.next_in = *pbody;
+    zstream.avail_in = *plen;
+    do {
+        uint8_t *new_out = realloc(out, size *= 2);
+        if (new_out == NULL) {
+            rc = Z_MEM_ERROR;
+            break;
+        }
+        out = new_out;
+        zstream.next_out = out + zstream.total_out;
+        zstream.avail_out = size - zstream.total_out;
+        rc = inflate(&zstream, Z_NO_FLUSH);
+    } while (rc == Z_OK);
+    inflateEnd(&zstream);
+
+    if (rc != Z_STREAM_END) {
+        free(out);
+        return false;
+    }
+    free(*pbody);
+    *pbody = out;
+    *plen = zstream.total_out;
+    return true;
+}
+
+/**
+ * Compress a body with gzip.
+ *
+ * @param body      The body to compress.
+ * @param len       The body length.
+ * @param pout      Location for the dynamically-allocated compressed body.
+ * @param pout_len  Location for the compressed body length.
+ *
+ * @return True if compressed successfully, false otherwise.
+ */
+static bool
+tlog_test_http_server_gzip(const char *body, size_t len,
+                           uint8_t **pout, size_t *pout_len)
+{
+    z_stream zstream;
+    uint8_t *out;
+    size_t size;
+    int rc;
+
+    memset(&zstream, 0, sizeof(zstream));
+    if (deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    /* Leave room for the gzip header and trailer */
+    size = deflateBound(&zstream, len) + 32;
+    out = malloc(size);
+    if (out == NULL) {
+        deflateEnd(&zstream);
+        return false;
+    }
+    zstream.next_in = (uint8_t *)body;
+    zstream.avail_in = len;
+    zstream.next_out = out;
+    zstream.avail_out = size;
+    rc = deflate(&zstream, Z_FINISH);
+    deflateEnd(&zstream);
+
+    if (rc != Z_STREAM_END) {
+        free(out);
+        return false;
+    }
+    *pout = out;
+    *pout_len = zstream.total_out;
+    return true;
+}
+
+/**
+ * Find a header in a CRLF-separated header block and return its value.
+ *
+ * @param headers   The header block.
+ * @param name      The header name to look for.
+ *
+ * @return The pointer to the value in the header block, or NULL if not
+ *         found.
+ */
+static const char *
+tlog_test_http_server_header(const char *headers, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *p;
+
+    for (p = headers; *p != '\0'; p = strstr(p, "\r\n") + 2) {
+        if (strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            for (p += name_len + 1; *p == ' '; p++);
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Receive a request from a connection and record it.
+ *
+ * @param server    The server receiving.
+ * @param fd        The connection socket.
+ * @param buf       The connection input buffer.
+ * @param req       The request to fill in.
+ *
+ * @return True if a request was received, false otherwise.
+ */
+static bool
+tlog_test_http_server_recv(struct tlog_test_http_server *server,
+                           int fd, struct tlog_test_http_server_buf *buf,
+                           struct tlog_test_http_server_req *req)
+{
+    char *head_end;
+    char *line_end;
+    size_t head_len;
+    size_t body_len = 0;
+    const char *value;
+
+    /* Receive the request line and headers */
+    while ((head_end = (buf->len > 0
+                            ? memmem(buf->ptr, buf->len, "\r\n\r\n", 4)
+                            : NULL)) == NULL) {
+        if (!tlog_test_http_server_fill(server, fd, buf)) {
+            return false;
+        }
+    }
+    head_len = head_end + 4 - buf->ptr;
+    line_end = memmem(buf->ptr, head_len, "\r\n", 2);
+    req->line = strndup(buf->ptr, line_end - buf->ptr);
+    req->headers = strndup(line_end + 2, head_end + 2 - (line_end + 2));
+    if (req->line == NULL || req->headers == NULL) {
+        return false;
+    }
+
+    /* Receive the body */
+    value = tlog_test_http_server_header(req->headers, "Content-Length");
+    if (value != NULL) {
+        body_len = strtoul(value, NULL, 10);
+    }
+    while (buf->len - head_len < body_len) {
+        if (!tlog_test_http_server_fill(server, fd, buf)) {
+            return false;
+        }
+    }
+    req->body = malloc(body_len + 1);
+    if (req->body == NULL) {
+        return false;
+    }
+    memcpy(req->body, buf->ptr + head_len, body_len);
+    req->body_len = body_len;
+    value = tlog_test_http_server_header(req->headers, "Content-Encoding");
+    if (value != NULL && strncmp(value, "gzip", 4) == 0 &&
+        !tlog_test_http_server_gunzip(&req->body, &req->body_len)) {
+        return false;
+    }
+
+    /* Remove the request from the buffer */
+    memmove(buf->ptr, buf->ptr + head_len + body_len,
+            buf->len - head_len - body_len);
+    buf->len -= head_len + body_len;
+    return true;
+}
+
+/**
+ * Send the next scripted response to a connection, compressing the body
+ * with gzip if the request accepts that.
+ *
+ * @param server    The server sending.
+ * @param fd        The connection socket.
+ * @param req       The request to respond to, gets the transferred
+ *                  response body length recorded.
+ *
+ * @return True if the response was sent, false otherwise.
+ */
+static bool
+tlog_test_http_server_send(struct tlog_test_http_server *server, int fd,
+                           struct tlog_test_http_server_req *req)
+{
+    const struct tlog_test_http_server_rsp *rsp = server->rsp_list;
+    const struct tlog_test_http_server_rsp rsp_end = {500, "{}"};
+    const char *value;
+    bool gzip;
+    uint8_t *body = NULL;
+    size_t body_len;
+    size_t i;
+    char *str;
+    int len;
+    bool result;
+
+    for (i = 0; rsp->status != 0 && i + 1 < server->req_num; i++, rsp++);
+    if (rsp->status == 0) {
+        rsp = &rsp_end;
+    }
+
+    /*
+     * Stall, until stopped, or the client gives up, and drop the
+     * connection, if requested
+     */
+    if (rsp->status < 0) {
+        struct pollfd pollfd_list[2] = {
+            {.fd = fd, .events = POLLIN},
+            {.fd = server->stop_fd[0], .events = POLLIN},
+        };
+        poll(pollfd_list, 2, -rsp->status * 1000);
+        return false;
+    }
+
+    value = tlog_test_http_server_header(req->headers, "Accept-Encoding");
+    gzip = value != NULL && strstr(value, "gzip") != NULL;
+    if (gzip) {
+        if (!tlog_test_http_server_gzip(rsp->body, strlen(rsp->body),
+                                        &body, &body_len)) {
+            return false;
+        }
+    } else {
+        body_len = strlen(rsp->body);
+    }
+
+    len = asprintf(&str,
+                   "HTTP/1.1 %d Scripted\r\n"
+                   "Content-Type: application/json\r\n"
+                   "%s"
+                   "Content-Length: %zu\r\n"
+                   "\r\n",
+                   rsp->status,
+                   gzip ? "Content-Encoding: gzip\r\n" : "",
+                   body_len);
+    if (len < 0) {
+        free(body);
+        return false;
+    }
+    result = write(fd, str, len) == len &&
+             write(fd, gzip ? (const void *)body : (const void *)rsp->body,
+                   body_len) == (ssize_t)body_len;
+    req->rsp_len = body_len;
+    free(str);
+    free(body);
+    return result;
+}
+
+/**
+ * Test HTTP server thread function.
+ *
+ * @param arg   The server.
+ *
+ * @return NULL.
+ */
+static void *
+tlog_test_http_server_thread(void *arg)
+{
+    struct tlog_test_http_server *server =
+                        (struct tlog_test_http_server *)arg;
+    struct tlog_test_http_server_buf buf = {.ptr = NULL};
+    struct tlog_test_http_server_req *req;
+    struct pollfd pollfd_list[2] = {
+        {.fd = server->listen_fd, .events = POLLIN},
+        {.fd = server->stop_fd[0], .events = POLLIN},
+    };
+    int fd;
+
+    while (poll(pollfd_list, 2, -1) >= 0 && pollfd_list[1].revents == 0) {
+        fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        buf.len = 0;
+        while (server->req_num < TLOG_TEST_HTTP_SERVER_REQ_MAX) {
+            req = &server->req_list[server->req_num];
+            req->conn = server->conn_num;
+            if (!tlog_test_http_server_recv(server, fd, &buf, req)) {
+                free(req->line);
+                free(req->headers);
+                free(req->body);
+                memset(req, 0, sizeof(*req));
+                break;
+            }
+            pthread_mutex_lock(&server->mutex);
+            server->req_num++;
+            pthread_cond_broadcast(&server->cond);
+            pthread_mutex_unlock(&server->mutex);
+            if (!tlog_test_http_server_send(server, fd, req)) {
+                break;
+            }
+        }
+        close(fd);
+        server->conn_num++;
+    }
+
+    free(buf.ptr);
+    return NULL;
+}
+
+bool
+tlog_test_http_server_start(struct tlog_test_http_server *server,
+                            const struct tlog_test_http_server_rsp *rsp_list)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int orig_errno;
+
+    assert(server != NULL);
+    assert(rsp_list != NULL);
+
+    memset(server, 0, sizeof(*server));
+    server->rsp_list = rsp_list;
+    server->stop_fd[0] = -1;
+    server->stop_fd[1] = -1;
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        goto error;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server->listen_fd, (struct sockaddr *)&addr, addr_len) < 0 ||
+        listen(server->listen_fd, 16) < 0 ||
+        getsockname(server->listen_fd,
+                    (struct sockaddr *)&addr, &addr_len) < 0) {
+        goto error;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    if (pipe(server->stop_fd) < 0) {
+        goto error;
+    }
+    errno = pthread_mutex_init(&server->mutex, NULL);
+    if (errno != 0) {
+        goto error;
+    }
+    errno = pthread_cond_init(&server->cond, NULL);
+    if (errno != 0) {
+        pthread_mutex_destroy(&server->mutex);
+        goto error;
+    }
+    errno = pthread_create(&server->thread, NULL,
+                           tlog_test_http_server_thread, server);
+    if (errno != 0) {
+        pthread_cond_destroy(&server->cond);
+        pthread_mutex_destroy(&server->mutex);
+        goto error;
+    }
+    return true;
+
+error:
+    orig_errno = errno;
+    if (server->stop_fd[0] >= 0) {
+        close(server->stop_fd[0]);
+        close(server->stop_fd[1]);
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    errno = orig_errno;
+    return false;
+}
+
+void
+tlog_test_http_server_wait(struct tlog_test_http_server *server,
+                           size_t req_num)
+{
+    assert(server != NULL);
+
+    pthread_mutex_lock(&server->mutex);
+    while (server->req_num < req_num) {
+        pthread_cond_wait(&server->cond, &server->mutex);
+    }
+    pthread_mutex_unlock(&server->mutex);
+}
+
+void
+tlog_test_http_server_stop(struct tlog_test_http_server *server)
+{
+    const char byte = 0;
+
+    assert(server != NULL);
+
+    if (write(server->stop_fd[1], &byte, sizeof(byte)) == sizeof(byte)) {
+        pthread_join(server->thread, NULL);
+    }
+    close(server->stop_fd[0]);
+    close(server->stop_fd[1]);
+    close(server->listen_fd);
+    pthread_cond_destroy(&server->cond);
+    pthread_mutex_destroy(&server->mutex);
+}
+
+void
+tlog_test_http_server_cleanup(struct tlog_test_http_server *server)
+{
+    size_t i;
+
+    assert(server != NULL);
+
+    for (i = 0; i < server->req_num; i++) {
+        free(server->req_list[i].line);
+        free(server->req_list[i].headers);
+        free(server->req_list[i].body);
+    }
+    memset(server->req_list, 0, sizeof(server->req_list));
+    server->req_num = 0;
+}
@@ -20,7 +20,77 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <limits.h>
+#include <stdint.h>
 #include <tlog/timespec.h>
 
 /* NOTE: Not using the macro from the header to workaround a gcc 4.8 bug */
 const struct timespec tlog_timespec_zero = {0, 0};
+
+void
+tlog_timespec_fp_mul(const struct timespec *a, double b,
+                     struct timespec *res)
+{
+    double ns;
+    int64_t n;
+
+    /* Exact for up to 2^53 ns (over 100 days), precise enough beyond */
+    ns = ((double)a->tv_sec * 1000000000 + (double)a->tv_nsec) * b + 0.5;
+    n = ns >= (double)INT64_MAX ? INT64_MAX : (int64_t)ns;
+    res->tv_sec = (time_t)(n / 1000000000);
+    res->tv_nsec = (long)(n % 1000000000);
+}
+
+bool
+tlog_timespec_parse(const char *str, struct timespec *res)
+{
+    const char *p = str;
+    long sec = 0;
+    long val;
+    long nsec = 0;
+    long mul;
+    size_t field;
+
+    /* Parse up to three colon-separated fields */
+    for (field = 0; ; field++) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        for (val = 0; *p >= '0' && *p <= '9'; p++) {
+            if (val > (LONG_MAX - (*p - '0')) / 10) {
+                return false;
+            }
+            val = val * 10 + (*p - '0');
+        }
+        if (field > 0 && val >= 60) {
+            return false;
+        }
+        if (sec > (LONG_MAX - val) / 60) {
+            return false;
+        }
+        sec = sec * 60 + val;
+        if (*p != ':' || field >= 2) {
+            break;
+        }
+        p++;
+    }
+
+    /* Parse the fraction, up to nanoseconds */
+    if (*p == '.') {
+        p++;
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        for (mul = 100000000; *p >= '0' && *p <= '9'; p++, mul /= 10) {
+            nsec += (*p - '0') * mul;
+        }
+    }
+
+    if (*p != '\0') {
+        return false;
+    }
+
+    res->tv_sec = sec;
+    res->tv_nsec = nsec;
+    return true;
+}
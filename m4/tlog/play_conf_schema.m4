@@ -90,7 +90,93 @@ M4_PARAM(`', `follow', `opts',
          `M4_TYPE_BOOL(false)', true,
          `f', `', `Wait for and play back new messages',
          `M4_LINES(`If true, then when the end of the recorded session is reached, wait',
-                   `for new messages to be added and play them back when they appear.')')m4_dnl
+                   `for new messages to be added and play them back when they appear.',
+                   `A followed log file is watched for changes, and is reopened once read',
+                   `out, if it was replaced (rotated), or read over, if it was truncated.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `goto', `opts',
+         `M4_TYPE_STRING()', false,
+         `g', `=POS', `Skip to POS time position, [[HH:]MM:]SS[.FRACTION]',
+         `M4_LINES(`The time position in the recording to start playing back from,',
+                   `in [[HH:]MM:]SS[.FRACTION] format. Only the messages ending at,',
+                   `or after it are read: the "es" reader doesn't retrieve the',
+                   `earlier ones, and an indexed log file is read from the first',
+                   `run reaching it. The output of the message covering it, before',
+                   `it, is applied to the screen model, which is then painted at',
+                   `once, if keyframes are kept, or is written to the terminal at',
+                   `once, without delays, otherwise. The screen is not reproduced',
+                   `from the output before that message.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `end', `opts',
+         `M4_TYPE_STRING()', false,
+         `', `=POS', `Stop at POS time position, [[HH:]MM:]SS[.FRACTION]',
+         `M4_LINES(`The time position in the recording to stop playing back at, in',
+                   `[[HH:]MM:]SS[.FRACTION] format, not before the "goto" position.',
+                   `The playback stops there, even if following. The "es" reader',
+                   `doesn't retrieve the messages starting after it.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `speed', `file',
+         `M4_TYPE_STRING(`1')', true,
+         `s', `=NUMBER', `Play back at NUMBER times the recorded speed',
+         `M4_LINES(`The speed multiplier to play back with, a positive',
+                   `floating-point number, e.g. 2 to play back twice as fast,',
+                   `or 0.5 to play back twice as slow.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `maxdelay', `file',
+         `M4_TYPE_STRING()', false,
+         `m', `=TIME', `Limit delays to TIME, [[HH:]MM:]SS[.FRACTION]',
+         `M4_LINES(`The maximum time to wait between output packets, after',
+                   `applying the speed multiplier, in [[HH:]MM:]SS[.FRACTION]',
+                   `format. Longer idle gaps are compressed to it.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `keyframe', `file',
+         `M4_TYPE_STRING(`60')', true,
+         `', `=TIME', `Keep screen keyframes every TIME of recording',
+         `M4_LINES(`The interval of recording time to keep snapshots of the screen',
+                   `(keyframes) at, for jumping between them, in [[HH:]MM:]SS[.FRACTION]',
+                   `format, starting from the position played back from. The screen',
+                   `is modeled by interpreting the output, and is painted at once',
+                   `after seeking. Zero disables the screen model and the keyframes.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `frame', `file',
+         `M4_TYPE_STRING(`0.016')', true,
+         `', `=TIME', `Merge output due within TIME, [[HH:]MM:]SS[.FRACTION]',
+         `M4_LINES(`The interval of time to merge the output packets due within into',
+                   `a single write, after applying the speed multiplier, in',
+                   `[[HH:]MM:]SS[.FRACTION] format. Larger values reduce the',
+                   `overhead, but output packets earlier. Zero outputs each',
+                   `packet at its time.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `prefetch', `file',
+         `M4_TYPE_INT(256, 0)', true,
+         `', `=NUMBER', `Read up to NUMBER packets ahead in background',
+         `M4_LINES(`The maximum number of packets to read and decode ahead, in a',
+                   `separate thread, while the earlier ones are being played back,',
+                   `hiding the reading delays behind the recorded ones. Zero reads',
+                   `each packet when it is due.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `stats', `opts',
+         `M4_TYPE_BOOL(false)', true,
+         `', `', `Output playback statistics on exit',
+         `M4_LINES(`If true, then output the statistics of the playback to',
+                   `standard error on exit: the number of packets and writes, the',
+                   `packets merged into frames, how late the output was written',
+                   `after it was due, how much the playback was stretched by',
+                   `packets arriving overdue, and how long reading packets took.')')m4_dnl
+m4_dnl
+M4_PARAM(`', `export', `opts',
+         `M4_TYPE_CHOICE(`', `output', `screen')', false,
+         `', `=MODE', `Export without timing in MODE (output/screen)',
+         `M4_LINES(`Export the recordings to standard output at once, without timing,',
+                   `and without setting up the terminal, instead of playing them back.',
+                   `Mode "output" writes the recorded output, starting from the',
+                   `"goto" position, if any, up to the "end" position, if any. Mode',
+                   `"screen" writes the text of the screen at the end of the',
+                   `recording, or at the "end" position, or else at the "goto"',
+                   `position.',
+                   `Log file paths given as positional arguments are exported one',
+                   `after another with the "file" reader, each preceded by a header',
+                   `line, if there are more than one.')')m4_dnl
 m4_dnl
 M4_PARAM(`', `reader', `file',
          `M4_TYPE_CHOICE(`file', `file', `es')', true,
@@ -107,6 +193,34 @@ M4_PARAM(`/file', `path', `file',
          `', `=FILE', `Read log from FILE file',
          `M4_LINES(`The "file" reader log file path.')')m4_dnl
 m4_dnl
+M4_PARAM(`/file', `threads', `file',
+         `M4_TYPE_INT(1, 1)', true,
+         `', `=NUMBER', `Parse messages with NUMBER threads',
+         `M4_LINES(`Number of threads to parse log messages with. With more',
+                   `than one, messages are parsed ahead in parallel, and',
+                   `delivered in the original order.')')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `index', `file',
+         `M4_TYPE_STRING()', false,
+         `', `=FILE', `Skip other sessions using index FILE',
+         `M4_LINES(`Path to the index of the log file, created with tlog-index(8).',
+                   `If specified along with the session ID, the indexed',
+                   `messages of other sessions are skipped without reading them,',
+                   `and so are the indexed messages of the session preceding the',
+                   `"goto" position, when they are not needed for the screen.')')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `host', `file',
+         `M4_TYPE_STRING()', false,
+         `', `=STRING', `Play back messages from host STRING only',
+         `M4_LINES(`The host name to play back the messages of.',
+                   `If not specified, messages from any host are played back.')')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `session', `file',
+         `M4_TYPE_INT(0, 0)', true,
+         `', `=NUMBER', `Play back messages of session NUMBER only',
+         `M4_LINES(`The audit session ID to play back the messages of.',
+                   `If zero, messages of any session are played back.')')m4_dnl
+m4_dnl
 m4_dnl
 m4_dnl
 M4_CONTAINER(`', `/es', `ElasticSearch reader')m4_dnl
@@ -122,3 +236,31 @@ M4_PARAM(`/es', `query', `file',
          `', `=STRING', `ElasticSearch query',
          `M4_LINES(`The query string to send to ElasticSearch')')m4_dnl
 m4_dnl
+M4_PARAM(`/es', `page', `file',
+         `M4_TYPE_INT(100, 1)', true,
+         `', `=NUMBER', `Request messages in pages of NUMBER',
+         `M4_LINES(`Number of messages to request from ElasticSearch at once.',
+                   `The next page is requested in the background, while the',
+                   `current one is being played back.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `span', `file',
+         `M4_TYPE_INT(10, 0)', true,
+         `', `=SECONDS', `Expect messages to span up to SECONDS seconds',
+         `M4_LINES(`Maximum number of seconds a message can span, that is the',
+                   `latency the session was recorded with. Messages starting',
+                   `up to this long before the goto position are requested',
+                   `too, as they can cover it.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `conntimeout', `file',
+         `M4_TYPE_INT(10, 0)', true,
+         `', `=SECONDS', `Wait SECONDS seconds for a connection',
+         `M4_LINES(`Maximum number of seconds to wait for a connection to',
+                   `ElasticSearch to be established, zero for no limit.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `timeout', `file',
+         `M4_TYPE_INT(60, 0)', true,
+         `', `=SECONDS', `Give up a request after SECONDS seconds',
+         `M4_LINES(`Maximum number of seconds a page request can take,',
+                   `including connecting, before it is failed, zero for no',
+                   `limit.')')m4_dnl
+m4_dnl
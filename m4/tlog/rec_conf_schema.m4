@@ -149,61 +149,21 @@ m4_dnl
 m4_dnl
 m4_dnl
 M4_PARAM(`', `writer', `file',
-         `M4_TYPE_CHOICE(`syslog', `syslog', `file')', true,
-         `w', `=STRING', `Use STRING log writer (syslog/file, default syslog)',
+         `M4_TYPE_CHOICE(`syslog', `syslog', `file', `es', `collector', `fanout')', true,
+         `w', `=STRING', `Use STRING log writer (syslog/file/es/collector/fanout, default syslog)',
          `M4_LINES(`The type of "log writer" to use for logging. The writer needs',
                    `to be configured using its dedicated parameters.')')m4_dnl
 m4_dnl
 m4_dnl
 m4_dnl
-M4_CONTAINER(`', `/file', `File writer')m4_dnl
-m4_dnl
-M4_PARAM(`/file', `path', `file',
-         `M4_TYPE_STRING()', false,
-         `', `=FILE', `Log to FILE file',
-         `M4_LINES(`The "file" writer log file path.')')m4_dnl
-m4_dnl
-m4_dnl
-m4_dnl
-M4_CONTAINER(`', `/syslog', `Syslog writer')m4_dnl
-m4_dnl
-M4_PARAM(`/syslog', `facility', `file',
-         `M4_TYPE_CHOICE(`authpriv',
-                         `auth',
-                         `authpriv',
-                         `cron',
-                         `daemon',
-                         `ftp',
-                         `kern',
-                         `local0',
-                         `local1',
-                         `local2',
-                         `local3',
-                         `local4',
-                         `local5',
-                         `local6',
-                         `local7',
-                         `lpr',
-                         `mail',
-                         `news',
-                         `syslog',
-                         `user',
-                         `uucp')',
-         true,
-         `', `=STRING', `Log with STRING syslog facility',
-         `M4_LINES(`Syslog facility the "syslog" writer should use for the messages.')')m4_dnl
-m4_dnl
-M4_PARAM(`/syslog', `priority', `file',
-         `M4_TYPE_CHOICE(`info',
-                         `emerg',
-                         `alert',
-                         `crit',
-                         `err',
-                         `warning',
-                         `notice',
-                         `info',
-                         `debug')',
-         true,
-         `', `=STRING', `Log with STRING syslog priority',
-         `M4_LINES(`Syslog priority the "syslog" writer should use for the messages.')')m4_dnl
+M4_CONTAINER(`', `/collector', `Collector writer')m4_dnl
+m4_dnl
+M4_PARAM(`/collector', `socket', `file',
+         `M4_TYPE_STRING(M4_COLLECTD_SOCKET_PATH)', true,
+         `', `=PATH', `Send messages to tlog-collectd at PATH socket',
+         `M4_LINES(`The path to the Unix socket tlog-collectd listens on,',
+                   `which the "collector" writer should send messages to.')')m4_dnl
+m4_dnl
+m4_dnl
 m4_dnl
+m4_include(`writer_conf_schema.m4')m4_dnl
@@ -0,0 +1,204 @@
+m4_dnl
+m4_dnl Tlog log writer configuration schema, shared by tlog-rec and
+m4_dnl tlog-collectd
+m4_dnl
+m4_dnl Copyright (C) 2016 Red Hat
+m4_dnl
+m4_dnl This file is part of tlog.
+m4_dnl
+m4_dnl Tlog is free software; you can redistribute it and/or modify
+m4_dnl it under the terms of the GNU General Public License as published by
+m4_dnl the Free Software Foundation; either version 2 of the License, or
+m4_dnl (at your option) any later version.
+m4_dnl
+m4_dnl Tlog is distributed in the hope that it will be useful,
+m4_dnl but WITHOUT ANY WARRANTY; without even the implied warranty of
+m4_dnl MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+m4_dnl GNU General Public License for more details.
+m4_dnl
+m4_dnl You should have received a copy of the GNU General Public License
+m4_dnl along with tlog; if not, write to the Free Software
+m4_dnl Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+m4_dnl
+M4_CONTAINER(`', `/file', `File writer')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `path', `file',
+         `M4_TYPE_STRING()', false,
+         `', `=FILE', `Log to FILE file',
+         `M4_LINES(`The "file" writer log file path.')')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `mmap', `file',
+         `M4_TYPE_BOOL(false)', true,
+         `', `[=BOOL]', `Enable/disable appending through a memory mapping',
+         `M4_LINES(`If specified as true, the log file is grown in extents and',
+                   `messages are copied into its memory-mapped tail, instead of',
+                   `being written with a system call each. The file is locked',
+                   `for exclusive use, and all the writers appending to it',
+                   `need to have this enabled. If the file is used by another',
+                   `process, FILE.1, FILE.2 and so on are tried, up to the',
+                   `number of file slots.')')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `extent', `file',
+         `M4_TYPE_INT(4194304, 4096)', true,
+         `', `=BYTES', `Grow the memory-mapped file by BYTES bytes',
+         `M4_LINES(`Size of the extents to grow the memory-mapped log file by,',
+                   `bytes. The unused part is truncated when the writer is',
+                   `closed.')')m4_dnl
+m4_dnl
+M4_PARAM(`/file', `slots', `file',
+         `M4_TYPE_INT(16, 1)', true,
+         `', `=NUMBER', `Try up to NUMBER memory-mapped files',
+         `M4_LINES(`Maximum number of memory-mapped log files to try in turn,',
+                   `when the previous ones are used by other processes.')')m4_dnl
+m4_dnl
+m4_dnl
+m4_dnl
+M4_CONTAINER(`', `/syslog', `Syslog writer')m4_dnl
+m4_dnl
+M4_PARAM(`/syslog', `facility', `file',
+         `M4_TYPE_CHOICE(`authpriv',
+                         `auth',
+                         `authpriv',
+                         `cron',
+                         `daemon',
+                         `ftp',
+                         `kern',
+                         `local0',
+                         `local1',
+                         `local2',
+                         `local3',
+                         `local4',
+                         `local5',
+                         `local6',
+                         `local7',
+                         `lpr',
+                         `mail',
+                         `news',
+                         `syslog',
+                         `user',
+                         `uucp')',
+         true,
+         `', `=STRING', `Log with STRING syslog facility',
+         `M4_LINES(`Syslog facility the "syslog" writer should use for the messages.')')m4_dnl
+m4_dnl
+M4_PARAM(`/syslog', `priority', `file',
+         `M4_TYPE_CHOICE(`info',
+                         `emerg',
+                         `alert',
+                         `crit',
+                         `err',
+                         `warning',
+                         `notice',
+                         `info',
+                         `debug')',
+         true,
+         `', `=STRING', `Log with STRING syslog priority',
+         `M4_LINES(`Syslog priority the "syslog" writer should use for the messages.')')m4_dnl
+m4_dnl
+m4_dnl
+m4_dnl
+m4_dnl
+M4_CONTAINER(`', `/es', `ElasticSearch writer')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `baseurl', `file',
+         `M4_TYPE_STRING()', false,
+         `', `=STRING', `Send messages to STRING bulk API URL',
+         `M4_LINES(`The ElasticSearch bulk API URL the "es" writer should send',
+                   `messages to, e.g. http://localhost:9200/tlog/tlog/_bulk.',
+                   `Must not contain the query (?...) or fragment (#...) parts.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `batch', `file',
+         `M4_TYPE_INT(1048576, 1)', true,
+         `', `=BYTES', `Send messages in batches of BYTES bytes',
+         `M4_LINES(`Size of a bulk request body, bytes. Messages are accumulated',
+                   `and sent as soon as their total size reaches this number.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `age', `file',
+         `M4_TYPE_INT(10, 0)', true,
+         `', `=SECONDS', `Send a batch once it is SECONDS seconds old',
+         `M4_LINES(`Maximum number of seconds a message can wait in a batch',
+                   `before the batch is sent, zero for no limit.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `retries', `file',
+         `M4_TYPE_INT(3, 0)', true,
+         `', `=NUMBER', `Retry failed requests NUMBER times',
+         `M4_LINES(`Number of times to retry a bulk request failed due to a',
+                   `transport error or a temporary server error, with',
+                   `exponential backoff. Requests are sent in the background,',
+                   `and messages not accepted in the end are kept in memory',
+                   `for the next request, so recording is never held up.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `conntimeout', `file',
+         `M4_TYPE_INT(10, 0)', true,
+         `', `=SECONDS', `Wait SECONDS seconds for a connection',
+         `M4_LINES(`Maximum number of seconds to wait for a connection to',
+                   `ElasticSearch to be established, zero for no limit.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `timeout', `file',
+         `M4_TYPE_INT(60, 0)', true,
+         `', `=SECONDS', `Give up a request after SECONDS seconds',
+         `M4_LINES(`Maximum number of seconds a bulk request can take,',
+                   `including connecting, before it is failed and retried,',
+                   `zero for no limit.')')m4_dnl
+m4_dnl
+M4_PARAM(`/es', `gzip', `file',
+         `M4_TYPE_BOOL(false)', true,
+         `', `[=BOOL]', `Enable/disable compressing requests with gzip',
+         `M4_LINES(`If specified as true, bulk request bodies are compressed',
+                   `with gzip.')')m4_dnl
+m4_dnl
+m4_dnl
+m4_dnl
+M4_CONTAINER(`', `/fanout', `Fan-out writer')m4_dnl
+m4_dnl
+M4_PARAM(`/fanout', `writers', `file',
+         `M4_TYPE_STRING()', false,
+         `', `=LIST', `Write to each writer in LIST comma-separated list',
+         `M4_LINES(`Comma-separated list of writers the "fanout" writer should',
+                   `pass each message to, e.g. file,es. Each of the writers is',
+                   `configured using its dedicated parameters.')')m4_dnl
+m4_dnl
+M4_PARAM(`/fanout', `required', `file',
+         `M4_TYPE_STRING(`')', true,
+         `', `=LIST', `Fail if writers in LIST comma-separated list fail',
+         `M4_LINES(`Comma-separated list of the "fanout" writers, which must',
+                   `receive every message. Failing to deliver to one of them is',
+                   `an error, while the rest of the writers are best-effort.')')m4_dnl
+m4_dnl
+M4_PARAM(`/fanout', `queue', `file',
+         `M4_TYPE_INT(1048576, 0)', true,
+         `', `=BYTES', `Queue up to BYTES bytes of messages per writer',
+         `M4_LINES(`Size of messages to keep for each "fanout" writer, while',
+                   `it is failing, bytes. Once exceeded, a best-effort writer',
+                   `loses the oldest messages, and a required writer fails.')')m4_dnl
+m4_dnl
+m4_dnl
+m4_dnl
+M4_CONTAINER(`', `/spool', `Message spool')m4_dnl
+m4_dnl
+M4_PARAM(`/spool', `path', `file',
+         `M4_TYPE_STRING()', false,
+         `', `=FILE', `Spool messages in FILE file',
+         `M4_LINES(`If specified, messages are stored in a memory-mapped ring in',
+                   `this file before being passed to the writer, and kept there',
+                   `until the writer delivers them. Messages left after a crash or',
+                   `a writer outage are delivered when the spool is opened again.',
+                   `If the file is used by another process, FILE.1, FILE.2 and so',
+                   `on are tried, up to the number of spool slots.')')m4_dnl
+m4_dnl
+M4_PARAM(`/spool', `size', `file',
+         `M4_TYPE_INT(4194304, 4096)', true,
+         `', `=BYTES', `Keep up to BYTES bytes of messages in the spool',
+         `M4_LINES(`Size of the spool ring, bytes. Applies when creating a spool.')')m4_dnl
+m4_dnl
+M4_PARAM(`/spool', `retry', `file',
+         `M4_TYPE_INT(10, 0)', true,
+         `', `=SECONDS', `Retry delivering spooled messages after SECONDS seconds',
+         `M4_LINES(`Number of seconds to wait after the writer fails before',
+                   `trying to deliver the spooled messages again.')')m4_dnl
+m4_dnl
+M4_PARAM(`/spool', `slots', `file',
+         `M4_TYPE_INT(16, 1)', true,
+         `', `=NUMBER', `Try up to NUMBER spool files',
+         `M4_LINES(`Maximum number of spool files to try in turn, when the',
+                   `previous ones are used by other processes.')')m4_dnl
@@ -0,0 +1,66 @@
+m4_include(`man.m4')m4_dnl
+m4_define(`M4_PROG_NAME', `collectd')m4_dnl
+.\" Process this file with
+.\" groff -man -Tascii tlog-collectd.8
+m4_generated_warning(`.\" ')m4_dnl
+.\"
+.\" Copyright (C) 2016 Red Hat
+.\"
+.\" This file is part of tlog.
+.\"
+.\" Tlog is free software; you can redistribute it and/or modify
+.\" it under the terms of the GNU General Public License as published by
+.\" the Free Software Foundation; either version 2 of the License, or
+.\" (at your option) any later version.
+.\"
+.\" Tlog is distributed in the hope that it will be useful,
+.\" but WITHOUT ANY WARRANTY; without even the implied warranty of
+.\" MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+.\" GNU General Public License for more details.
+.\"
+.\" You should have received a copy of the GNU General Public License
+.\" along with tlog; if not, write to the Free Software
+.\" Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+.\"
+.TH tlog-collectd "8" "November 2016" "Tlog"
+.SH NAME
+tlog-collectd \- collect and log messages from many tlog-rec(8) processes
+
+.SH SYNOPSIS
+.B tlog-collectd
+[OPTION...]
+
+.SH DESCRIPTION
+.B Tlog-collectd
+accepts messages from tlog-rec(8) processes using the "collector" writer on
+a Unix socket and logs them with a single writer, in large batches. Messages
+from each recorder are logged in the order they were received.
+
+A recorder sending messages faster than they can be logged is not read from
+until the batch is written, and blocks in turn, without affecting the other
+recorders.
+
+Only processes running as the same user as tlog-collectd, or as root, can
+connect to its socket. Each received line must be a valid tlog message,
+other lines are dropped, with an error logged.
+
+The writers are configured with the same options as the tlog-rec(8) ones,
+with the same defaults.
+
+.SH OPTIONS
+M4_MAN_OPTS()
+
+.SH EXAMPLES
+.TP
+Collect messages into a file:
+.B tlog-collectd -w file --file-path=/var/log/tlog.log
+
+.TP
+Record a session through the collector:
+.B tlog-rec -w collector --collector-socket=/var/run/tlog/collectd.sock
+
+.SH SEE ALSO
+tlog-rec(8), tlog-rec.conf(5)
+
+.SH AUTHOR
+Nikolai Kondrashov <spbnick@gmail.com>
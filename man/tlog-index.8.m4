@@ -0,0 +1,60 @@
+m4_include(`man.m4')m4_dnl
+m4_define(`M4_PROG_NAME', `index')m4_dnl
+.\" Process this file with
+.\" groff -man -Tascii tlog-index.8
+m4_generated_warning(`.\" ')m4_dnl
+.\"
+.\" Copyright (C) 2016 Red Hat
+.\"
+.\" This file is part of tlog.
+.\"
+.\" Tlog is free software; you can redistribute it and/or modify
+.\" it under the terms of the GNU General Public License as published by
+.\" the Free Software Foundation; either version 2 of the License, or
+.\" (at your option) any later version.
+.\"
+.\" Tlog is distributed in the hope that it will be useful,
+.\" but WITHOUT ANY WARRANTY; without even the implied warranty of
+.\" MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+.\" GNU General Public License for more details.
+.\"
+.\" You should have received a copy of the GNU General Public License
+.\" along with tlog; if not, write to the Free Software
+.\" Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+.\"
+.TH tlog-index "8" "November 2016" "Tlog"
+.SH NAME
+tlog-index \- index the sessions in a tlog log file
+
+.SH SYNOPSIS
+.B tlog-index
+[OPTION...] LOG_FILE
+
+.SH DESCRIPTION
+.B Tlog-index
+creates or updates an index of a log file written with the "file" writer,
+recording runs of consecutive messages of each session, with their byte
+offsets, line numbers, and message ID and time position ranges.
+
+Given the index, tlog-play(8) skips the messages of other sessions in a log
+file shared by many sessions, without reading them. Only the messages added
+since the last update are indexed, so the index can be updated periodically,
+or kept up to date with the --follow option.
+
+.SH OPTIONS
+M4_MAN_OPTS()
+
+.SH EXAMPLES
+.TP
+Index a log file:
+.B tlog-index /var/log/tlog.log
+
+.TP
+Play back one session from the indexed log file:
+.B tlog-play -r file --file-path=/var/log/tlog.log --file-index=/var/log/tlog.log.idx --file-session=5
+
+.SH SEE ALSO
+tlog-play(8), tlog-rec(8)
+
+.SH AUTHOR
+Nikolai Kondrashov <spbnick@gmail.com>
@@ -0,0 +1,76 @@
+m4_include(`man.m4')m4_dnl
+m4_define(`M4_PROG_NAME', `ls')m4_dnl
+.\" Process this file with
+.\" groff -man -Tascii tlog-ls.8
+m4_generated_warning(`.\" ')m4_dnl
+.\"
+.\" Copyright (C) 2016 Red Hat
+.\"
+.\" This file is part of tlog.
+.\"
+.\" Tlog is free software; you can redistribute it and/or modify
+.\" it under the terms of the GNU General Public License as published by
+.\" the Free Software Foundation; either version 2 of the License, or
+.\" (at your option) any later version.
+.\"
+.\" Tlog is distributed in the hope that it will be useful,
+.\" but WITHOUT ANY WARRANTY; without even the implied warranty of
+.\" MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+.\" GNU General Public License for more details.
+.\"
+.\" You should have received a copy of the GNU General Public License
+.\" along with tlog; if not, write to the Free Software
+.\" Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+.\"
+.TH tlog-ls "8" "November 2016" "Tlog"
+.SH NAME
+tlog-ls \- list the sessions recorded in a tlog log
+
+.SH SYNOPSIS
+.B tlog-ls
+[OPTION...] LOG_FILE
+.br
+.B tlog-ls
+[OPTION...] --es-baseurl=URL [--es-query=QUERY]
+
+.SH DESCRIPTION
+.B Tlog-ls
+lists the sessions recorded in a log file written with the "file" writer,
+or stored in ElasticSearch, without reading their messages, to help find
+the session to play back with tlog-play(8).
+
+For each session it outputs the host name, the user name, the audit
+session ID, the time position of the first message, the time from it to
+the end of the last message, the number of messages, and the number of
+bytes they take in the log. Sessions are sorted by host name and session
+ID.
+
+A log file is listed using its index (see tlog-index(8)). The messages
+added since the last update are indexed first, and saved to the index
+file, if it is writable. If the index file doesn't exist, the whole log
+file is indexed in memory.
+
+Sessions stored in ElasticSearch are retrieved with a single search
+request for "terms" aggregations over the host names and session IDs,
+with "min" and "max" aggregations over the message positions, and a
+"top_hits" aggregation retrieving the timing of the last message, without
+transferring the other messages. ElasticSearch doesn't store the message
+lengths, so the byte counts are output as "-".
+
+.SH OPTIONS
+M4_MAN_OPTS()
+
+.SH EXAMPLES
+.TP
+List the sessions in a log file:
+.B tlog-ls /var/log/tlog.log
+
+.TP
+List the sessions recorded on host "server" in ElasticSearch:
+.B tlog-ls --es-baseurl=http://localhost:9200/tlog-rsyslog/tlog/_search --es-query='host:server'
+
+.SH SEE ALSO
+tlog-play(8), tlog-index(8), tlog-rec(8)
+
+.SH AUTHOR
+Nikolai Kondrashov <spbnick@gmail.com>
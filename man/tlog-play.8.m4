@@ -29,6 +29,9 @@ tlog-play \- play back terminal I/O recorded by tlog-rec(8)
 .SH SYNOPSIS
 .B tlog-play
 [OPTION...]
+.br
+.B tlog-play
+--export=MODE [OPTION...] [LOG_FILE...]
 
 .SH DESCRIPTION
 .B Tlog-play
@@ -37,6 +40,14 @@ reproduces the recording on the terminal it's run under, and can't change its
 size, so the playback terminal size needs to match the recorded terminal size
 for proper playback.
 
+With the
+.B --export
+option,
+.B tlog-play
+doesn't play the recording back, but writes either its output, or the text of
+its final screen to standard output as fast as it's read, without setting up
+the terminal. The log files given as arguments are exported one after another.
+
 .B Tlog-play
 loads its parameters from the system-wide configuration file M4_CONF_PATH(),
 which can be overridden with command-line options described below.
@@ -44,6 +55,35 @@ which can be overridden with command-line options described below.
 .SH OPTIONS
 M4_MAN_OPTS()
 
+.SH KEYS
+If the standard input is a terminal, the following keys control the
+playback.
+.TP
+.B SPACE
+Pause or resume the playback.
+.TP
+.B +, =
+Play back twice as fast.
+.TP
+.B -, _
+Play back twice as slow.
+.TP
+.B 1
+Play back at the original speed.
+.TP
+.B .
+Skip the delay, outputting the next packet at once. Works while paused, to
+step through the recording.
+.TP
+.B <
+Jump back to the previous keyframe: the screen snapshot kept at the start
+of the current keyframe interval, or of the previous one, if the current
+one has just started.
+.TP
+.B >
+Jump forward to the next keyframe, applying the output up to it to the
+screen at once.
+
 .SH FILES
 .TP
 M4_CONF_PATH()
@@ -54,12 +94,36 @@ The system-wide configuration file
 Play back contents of a file written with tlog-rec's "file" writer:
 .B tlog-play -r file --file-path=recording.log
 
+.TP
+Play back a recording starting from one hour and a half into it:
+.B tlog-play -r file --file-path=recording.log --goto=1:30:00
+
+.TP
+Play back a recording four times faster, waiting no more than two seconds:
+.B tlog-play -r file --file-path=recording.log -s 4 -m 2
+
+.TP
+Play back merging output due within 50ms into single writes, with statistics:
+.B tlog-play -r file --file-path=recording.log --frame=0.05 --stats
+
+.TP
+Save the text of the final screens of several recordings to a file:
+.B tlog-play --export=screen recording1.log recording2.log > screens.txt
+
+.TP
+Play back one session from a shared log file, using its index:
+.B tlog-play -r file --file-path=/var/log/tlog.log --file-index=/var/log/tlog.log.idx --file-session=5
+
 .TP
 Play back a recording from ElasticSearch:
 .B tlog-play -r es --es-baseurl=http://localhost:9200/tlog/tlog/_search --es-query=session:121
 
+.TP
+Play back ten minutes of a recording from ElasticSearch, retrieving only those:
+.B tlog-play -r es --es-baseurl=http://localhost:9200/tlog/tlog/_search --es-query=session:121 --goto=1:30:00 --end=1:40:00
+
 .SH SEE ALSO
-tlog-play.conf(5), tlog-rec(8)
+tlog-play.conf(5), tlog-rec(8), tlog-index(8)
 
 .SH AUTHOR
 Nikolai Kondrashov <spbnick@gmail.com>
@@ -101,6 +101,14 @@ Record everything but user input:
 Ask the recorded shell to execute a command:
 .B tlog-rec -c whoami
 
+.TP
+Send the recorded messages directly to ElasticSearch, compressed:
+.B tlog-rec --writer=es --es-baseurl=http://localhost:9200/tlog/tlog/_bulk --es-gzip
+
+.TP
+Log to a file, and to ElasticSearch on a best-effort basis:
+.B tlog-rec --writer=fanout --fanout-writers=file,es --fanout-required=file --file-path=tlog.log --es-baseurl=http://localhost:9200/tlog/tlog/_bulk
+
 .SH SEE ALSO
 tlog-rec.conf(5), tlog-play(8)
 
@@ -76,6 +76,19 @@ A config specifying logging to a file:
 }
 .fi
 
+.TP
+A config specifying sending to ElasticSearch in 64kB batches:
+.nf
+
+{
+    "writer": "es",
+    "es" : {
+        "baseurl": "http://localhost:9200/tlog/tlog/_bulk",
+        "batch": 65536
+    }
+}
+.fi
+
 .SH SEE ALSO
 tlog-rec(8), http://json.org/
 
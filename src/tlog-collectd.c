@@ -0,0 +1,901 @@
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <poll.h>
+#include <pwd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <curl/curl.h>
+#include <tlog/collectd_conf_cmd.h>
+#include <tlog/rec_conf.h>
+#include <tlog/json_misc.h>
+#include <tlog/json_msg.h>
+#include <tlog/json_writer.h>
+#include <tlog/spool_json_writer.h>
+#include <tlog/mmap_json_writer.h>
+#include <tlog/rc.h>
+#include <tlog/timespec.h>
+#include <tlog/misc.h>
+
+/** Default output batch size, bytes */
+#define BATCH_SIZE_DEF      65536
+
+/** Default output latency, seconds */
+#define LATENCY_DEF         1
+
+/** Size of a client input buffer, i.e. maximum message length, bytes */
+#define CLIENT_BUF_SIZE     65536
+
+/**< Number of the signal causing exit */
+static volatile sig_atomic_t exit_signum  = 0;
+
+static void
+exit_sighandler(int signum)
+{
+    if (exit_signum == 0) {
+        exit_signum = signum;
+    }
+}
+
+/** Output batch */
+struct batch {
+    struct tlog_json_writer    *writer;     /**< Writer to write to */
+    bool                        whole;      /**< True if the writer can take
+                                                 several messages at once */
+    unsigned int                latency;    /**< Maximum time messages can
+                                                 wait in the batch, seconds */
+    size_t                      size;       /**< Length to write out at */
+    uint8_t                    *buf;        /**< Accumulated messages, with
+                                                 room for one more maximum
+                                                 length message past size */
+    size_t                      len;        /**< Accumulated length */
+    struct timespec             deadline;   /**< Time the accumulated
+                                                 messages must be written by */
+};
+
+/**
+ * Write the accumulated messages out and empty the batch.
+ *
+ * @param perrs Location for the error stack. Can be NULL.
+ * @param batch The batch to write.
+ * @param flush True if the writer should be flushed too.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+batch_write(struct tlog_errs **perrs, struct batch *batch, bool flush)
+{
+    tlog_grc grc = TLOG_RC_OK;
+    const uint8_t *p;
+    const uint8_t *end;
+    const uint8_t *next;
+
+    if (batch->len == 0) {
+        /* Nothing to write */
+    } else if (batch->whole) {
+        /* Write everything in one go */
+        grc = tlog_json_writer_write(batch->writer, batch->buf, batch->len);
+    } else {
+        /* Write message by message */
+        end = batch->buf + batch->len;
+        for (p = batch->buf; p < end && grc == TLOG_RC_OK; p = next) {
+            next = (const uint8_t *)memchr(p, '\n', (size_t)(end - p)) + 1;
+            grc = tlog_json_writer_write(batch->writer, p,
+                                         (size_t)(next - p));
+        }
+    }
+    batch->len = 0;
+    if (grc == TLOG_RC_OK && flush) {
+        grc = tlog_json_writer_flush(batch->writer);
+    }
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed writing messages");
+    }
+    return grc;
+}
+
+/**
+ * Add a newline-terminated message to the batch, and write the batch out,
+ * if it reached its size.
+ *
+ * @param perrs Location for the error stack. Can be NULL.
+ * @param batch The batch to add the message to.
+ * @param buf   The message buffer.
+ * @param len   The message length, not more than CLIENT_BUF_SIZE.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+batch_add(struct tlog_errs **perrs, struct batch *batch,
+          const uint8_t *buf, size_t len)
+{
+    assert(len <= CLIENT_BUF_SIZE);
+    assert(batch->len < batch->size);
+
+    if (batch->len == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &batch->deadline);
+        batch->deadline.tv_sec += batch->latency;
+    }
+    memcpy(batch->buf + batch->len, buf, len);
+    batch->len += len;
+
+    return batch->len >= batch->size ? batch_write(perrs, batch, false)
+                                     : TLOG_RC_OK;
+}
+
+/** Received message validator */
+struct validator {
+    struct json_tokener        *tok;    /**< Tokener for the messages which
+                                             can't be parsed directly */
+    struct tlog_json_msg_buf    buf;    /**< Buffer for the strings of the
+                                             directly-parsed messages */
+};
+
+/** Connected recorder */
+struct client {
+    int         fd;     /**< Connection socket FD */
+    pid_t       pid;    /**< Recorder process ID */
+    uid_t       uid;    /**< Recorder user ID */
+    char       *user;   /**< Name of the user the recorder runs as, the
+                             only one it can send messages of, or NULL,
+                             if it can send messages of any user */
+    uint8_t    *buf;    /**< Received incomplete message */
+    size_t      len;    /**< Length of the incomplete message */
+};
+
+/**
+ * Report an error concerning a client, which doesn't stop collecting.
+ *
+ * @param client    The client the error concerns.
+ * @param grc       The global return code of the error, or TLOG_RC_OK.
+ * @param fmt       The message format string.
+ * @param ...       The message format arguments.
+ */
+static void
+client_error(const struct client *client, tlog_grc grc,
+             const char *fmt, ...)
+{
+    struct tlog_errs *errs = NULL;
+    va_list ap;
+
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(&errs, grc);
+    }
+    va_start(ap, fmt);
+    tlog_errs_pushvf(&errs, fmt, ap);
+    va_end(ap);
+    tlog_errs_pushf(&errs, "Recorder PID %ld, UID %lu",
+                    (long)client->pid, (unsigned long)client->uid);
+    tlog_errs_print(stderr, errs);
+    tlog_errs_destroy(&errs);
+}
+
+/**
+ * Initialize a client for an accepted connection, getting the credentials
+ * of the recorder process on the other end.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param client    The client to initialize.
+ * @param fd        The accepted connection socket FD, to be taken over.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+client_init(struct tlog_errs **perrs, struct client *client, int fd)
+{
+    tlog_grc grc;
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    struct passwd pwd;
+    struct passwd *ppwd;
+    char pwd_buf[4096];
+    int rc;
+
+    memset(client, 0, sizeof(*client));
+    client->fd = fd;
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed getting recorder credentials");
+        return grc;
+    }
+    client->pid = cred.pid;
+    client->uid = cred.uid;
+
+    /*
+     * Let root and our own user send messages of any user, and the others
+     * only the messages of the user they run as, so a user can't pass
+     * their sessions off as somebody else's.
+     */
+    if (cred.uid != 0 && cred.uid != geteuid()) {
+        rc = getpwuid_r(cred.uid, &pwd, pwd_buf, sizeof(pwd_buf), &ppwd);
+        if (ppwd == NULL) {
+            grc = rc == 0 ? TLOG_RC_FAILURE : TLOG_GRC_FROM(errno, rc);
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushf(perrs, "Failed looking up recorder user %lu",
+                            (unsigned long)cred.uid);
+            return grc;
+        }
+        client->user = strdup(pwd.pw_name);
+        if (client->user == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed allocating recorder user name");
+            return grc;
+        }
+    }
+
+    client->buf = malloc(CLIENT_BUF_SIZE);
+    if (client->buf == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed allocating client buffer");
+        return grc;
+    }
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Cleanup a client, closing its connection.
+ *
+ * @param client    The client to cleanup.
+ */
+static void
+client_cleanup(struct client *client)
+{
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+    free(client->user);
+    client->user = NULL;
+    free(client->buf);
+    client->buf = NULL;
+}
+
+/**
+ * Check a message received from a client is a valid tlog message, and the
+ * client is allowed to send it, reporting the message as dropped, if not.
+ *
+ * @param validator The validator to parse the message with.
+ * @param client    The client the message was received from.
+ * @param text      The message text, without the terminating newline.
+ * @param len       The message text length.
+ *
+ * @return True if the message can be logged, false otherwise.
+ */
+static bool
+client_check(struct validator *validator, const struct client *client,
+             const uint8_t *text, size_t len)
+{
+    tlog_grc grc;
+    struct tlog_json_msg msg = {NULL, };
+    struct json_object *obj;
+    bool valid = false;
+
+    grc = tlog_json_msg_parse(&msg, &validator->buf,
+                              (const char *)text, len);
+    if (grc == TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED) {
+        json_tokener_reset(validator->tok);
+        obj = len > INT_MAX
+                ? NULL
+                : json_tokener_parse_ex(validator->tok,
+                                        (const char *)text, (int)len);
+        if (obj == NULL) {
+            grc = TLOG_RC_FAILURE;
+        } else {
+            grc = tlog_json_msg_init(&msg, obj);
+            json_object_put(obj);
+        }
+    }
+
+    if (grc != TLOG_RC_OK) {
+        client_error(client, grc == TLOG_RC_FAILURE ? TLOG_RC_OK : grc,
+                     "Dropping an invalid message");
+    } else if (client->user != NULL && strcmp(msg.user, client->user) != 0) {
+        client_error(client, TLOG_RC_OK,
+                     "Dropping a message of user \"%s\" "
+                     "sent by user \"%s\"", msg.user, client->user);
+    } else {
+        valid = true;
+    }
+
+    tlog_json_msg_cleanup(&msg);
+    return valid;
+}
+
+/**
+ * Read what's available from a client and move the complete, valid
+ * messages to the batch, in order.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param validator The validator to check the messages with.
+ * @param client    The client to read from.
+ * @param batch     The batch to add messages to.
+ * @param pclosed   Location for the flag set to true if the client
+ *                  connection should be closed.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+client_read(struct tlog_errs **perrs, struct validator *validator,
+            struct client *client, struct batch *batch, bool *pclosed)
+{
+    tlog_grc grc;
+    ssize_t rc;
+    uint8_t *p;
+    uint8_t *end;
+    uint8_t *next;
+
+    /*
+     * Read only once per wakeup, so a busy recorder can't starve the
+     * others, and the ones we can't keep up with block in their writes.
+     */
+    rc = read(client->fd, client->buf + client->len,
+              CLIENT_BUF_SIZE - client->len);
+    if (rc < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            *pclosed = false;
+            return TLOG_RC_OK;
+        }
+        client_error(client, TLOG_GRC_ERRNO, "Failed reading from recorder");
+        *pclosed = true;
+        return TLOG_RC_OK;
+    } else if (rc == 0) {
+        if (client->len > 0) {
+            client_error(client, TLOG_RC_OK,
+                         "Dropping an incomplete message");
+        }
+        *pclosed = true;
+        return TLOG_RC_OK;
+    }
+    client->len += (size_t)rc;
+
+    /* Move complete, valid messages to the batch */
+    end = client->buf + client->len;
+    for (p = client->buf;
+         (next = memchr(p, '\n', (size_t)(end - p))) != NULL;
+         p = next + 1) {
+        if (!client_check(validator, client, p, (size_t)(next - p))) {
+            continue;
+        }
+        grc = batch_add(perrs, batch, p, (size_t)(next + 1 - p));
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+    }
+    client->len = (size_t)(end - p);
+    memmove(client->buf, p, client->len);
+
+    if (client->len >= CLIENT_BUF_SIZE) {
+        client_error(client, TLOG_RC_OK,
+                     "Disconnecting, message is longer than %u bytes",
+                     CLIENT_BUF_SIZE);
+        *pclosed = true;
+    } else {
+        *pclosed = false;
+    }
+    return TLOG_RC_OK;
+}
+
+/**
+ * Create, bind and start listening on the collector socket.
+ *
+ * @param perrs Location for the error stack. Can be NULL.
+ * @param path  Socket path.
+ * @param pfd   Location for the listening socket FD.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+listen_socket(struct tlog_errs **perrs, const char *path, int *pfd)
+{
+    tlog_grc grc;
+    struct sockaddr_un addr;
+    int fd = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        tlog_errs_pushf(perrs, "Socket path is too long: %s", path);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed creating socket");
+        goto cleanup;
+    }
+
+    /* Remove the socket left by a previous instance */
+    if (unlink(path) < 0 && errno != ENOENT) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed removing old socket %s", path);
+        goto cleanup;
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed binding socket to %s", path);
+        goto cleanup;
+    }
+
+    if (listen(fd, SOMAXCONN) < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed listening on socket");
+        goto cleanup;
+    }
+
+    *pfd = fd;
+    fd = -1;
+    grc = TLOG_RC_OK;
+
+cleanup:
+    if (fd >= 0) {
+        close(fd);
+    }
+    return grc;
+}
+
+/**
+ * Collect messages from recorders and write them out until interrupted.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param listen_fd Listening socket FD.
+ * @param validator Validator to check the received messages with.
+ * @param batch     Output batch.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+collect(struct tlog_errs **perrs, int listen_fd,
+        struct validator *validator, struct batch *batch)
+{
+    tlog_grc grc;
+    struct tlog_errs *client_errs = NULL;
+    struct client *client_list = NULL;
+    size_t client_num = 0;
+    size_t client_size = 0;
+    struct pollfd *pollfd_list = NULL;
+    struct timespec now;
+    struct timespec left;
+    int timeout;
+    bool closed;
+    size_t i;
+    int fd;
+    int rc;
+
+    /* Allocate initial client and poll lists */
+    client_size = 16;
+    client_list = malloc(sizeof(*client_list) * client_size);
+    pollfd_list = malloc(sizeof(*pollfd_list) * (client_size + 1));
+    if (client_list == NULL || pollfd_list == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed allocating client list");
+        goto cleanup;
+    }
+
+    while (exit_signum == 0) {
+        /* Write the batch if it's due */
+        if (batch->len > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (tlog_timespec_cmp(&now, &batch->deadline) >= 0) {
+                grc = batch_write(perrs, batch, true);
+                if (grc != TLOG_RC_OK) {
+                    goto cleanup;
+                }
+            }
+        }
+
+        /* Wait until the batch is due, or indefinitely, if it's empty */
+        if (batch->len > 0) {
+            tlog_timespec_sub(&batch->deadline, &now, &left);
+            timeout = (int)(left.tv_sec * 1000 +
+                            (left.tv_nsec + 999999) / 1000000);
+        } else {
+            timeout = -1;
+        }
+
+        pollfd_list[0].fd = listen_fd;
+        pollfd_list[0].events = POLLIN;
+        for (i = 0; i < client_num; i++) {
+            pollfd_list[i + 1].fd = client_list[i].fd;
+            pollfd_list[i + 1].events = POLLIN;
+        }
+        rc = poll(pollfd_list, client_num + 1, timeout);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed waiting for recorders");
+            goto cleanup;
+        }
+
+        /* Read from clients, in order, dropping the closed ones */
+        for (i = 0; i < client_num;) {
+            if (pollfd_list[i + 1].revents == 0) {
+                i++;
+                continue;
+            }
+            grc = client_read(perrs, validator, &client_list[i], batch,
+                              &closed);
+            if (grc != TLOG_RC_OK) {
+                goto cleanup;
+            }
+            if (closed) {
+                client_cleanup(&client_list[i]);
+                client_num--;
+                memmove(client_list + i, client_list + i + 1,
+                        sizeof(*client_list) * (client_num - i));
+                memmove(pollfd_list + i + 1, pollfd_list + i + 2,
+                        sizeof(*pollfd_list) * (client_num - i));
+            } else {
+                i++;
+            }
+        }
+
+        /* Accept a new client */
+        if (pollfd_list[0].revents != 0) {
+            fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EINTR && errno != EAGAIN &&
+                    errno != ECONNABORTED) {
+                    grc = TLOG_GRC_ERRNO;
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed accepting a recorder");
+                    goto cleanup;
+                }
+                continue;
+            }
+            if (client_num >= client_size) {
+                size_t new_size = client_size * 2;
+                struct client *new_client_list;
+                struct pollfd *new_pollfd_list;
+
+                new_client_list = realloc(client_list,
+                                          sizeof(*client_list) * new_size);
+                if (new_client_list == NULL) {
+                    grc = TLOG_GRC_ERRNO;
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed growing client list");
+                    close(fd);
+                    goto cleanup;
+                }
+                client_list = new_client_list;
+                new_pollfd_list = realloc(pollfd_list,
+                                          sizeof(*pollfd_list) *
+                                          (new_size + 1));
+                if (new_pollfd_list == NULL) {
+                    grc = TLOG_GRC_ERRNO;
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed growing client list");
+                    close(fd);
+                    goto cleanup;
+                }
+                pollfd_list = new_pollfd_list;
+                client_size = new_size;
+            }
+            grc = client_init(&client_errs, &client_list[client_num], fd);
+            if (grc != TLOG_RC_OK) {
+                tlog_errs_pushs(&client_errs, "Rejecting a recorder");
+                tlog_errs_print(stderr, client_errs);
+                tlog_errs_destroy(&client_errs);
+                client_cleanup(&client_list[client_num]);
+                continue;
+            }
+            client_num++;
+        }
+    }
+
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    for (i = 0; i < client_num; i++) {
+        client_cleanup(&client_list[i]);
+    }
+    free(client_list);
+    free(pollfd_list);
+    return grc;
+}
+
+/**
+ * Run the daemon with the loaded configuration.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param prog_path Path to the program (argv[0]).
+ * @param cmd_help  Command-line usage help message.
+ * @param conf      Tlog-collectd configuration JSON object.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+run(struct tlog_errs **perrs, const char *prog_path,
+    const char *cmd_help, struct json_object *conf)
+{
+    const int exit_sig[] = {SIGINT, SIGTERM, SIGHUP};
+    tlog_grc grc;
+    struct sigaction sa;
+    size_t i;
+    size_t j;
+    bool curl_initialized = false;
+    int listen_fd = -1;
+    struct json_object *obj;
+    struct json_object *writer_conf = NULL;
+    const char *socket_path = TLOG_COLLECTD_SOCKET_PATH;
+    const char *writer = "syslog";
+    int64_t batch_size = BATCH_SIZE_DEF;
+    int64_t latency = LATENCY_DEF;
+    struct validator validator;
+    struct batch batch;
+
+    memset(&validator, 0, sizeof(validator));
+    memset(&batch, 0, sizeof(batch));
+
+    /* Check for the help flag */
+    if (json_object_object_get_ex(conf, "help", &obj)) {
+        if (json_object_get_boolean(obj)) {
+            fprintf(stdout, "%s\n", cmd_help);
+            grc = TLOG_RC_OK;
+            goto cleanup;
+        }
+    }
+
+    /* Check for the version flag */
+    if (json_object_object_get_ex(conf, "version", &obj)) {
+        if (json_object_get_boolean(obj)) {
+            printf("%s", tlog_version);
+            grc = TLOG_RC_OK;
+            goto cleanup;
+        }
+    }
+
+    /* Check for positional arguments */
+    if (json_object_object_get_ex(conf, "args", &obj) &&
+        json_object_array_length(obj) > 0) {
+        tlog_errs_pushf(perrs, "Positional arguments are not accepted\n%s",
+                        cmd_help);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /* Get the general parameters */
+    if (json_object_object_get_ex(conf, "socket", &obj)) {
+        socket_path = json_object_get_string(obj);
+    }
+    if (json_object_object_get_ex(conf, "writer", &obj)) {
+        writer = json_object_get_string(obj);
+    }
+    if (json_object_object_get_ex(conf, "batch", &obj)) {
+        batch_size = json_object_get_int64(obj);
+    }
+    if (json_object_object_get_ex(conf, "latency", &obj)) {
+        latency = json_object_get_int64(obj);
+    }
+    if (batch_size > INT_MAX) {
+        tlog_errs_pushf(perrs, "Invalid batch size: %" PRId64, batch_size);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    if (latency > INT_MAX) {
+        tlog_errs_pushf(perrs, "Invalid latency: %" PRId64, latency);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /*
+     * Take the writer parameters not specified on the command line from
+     * the default tlog-rec configuration, the writers are the same.
+     */
+    grc = tlog_rec_conf_load_default(perrs, &writer_conf, prog_path);
+    if (grc != TLOG_RC_OK) {
+        goto cleanup;
+    }
+    grc = tlog_json_overlay(&writer_conf, writer_conf, conf);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed overlaying writer configuration");
+        goto cleanup;
+    }
+
+    /* Don't loop messages back to ourselves */
+    if (strcmp(writer, "fanout") == 0 &&
+        json_object_object_get_ex(writer_conf, "fanout", &obj) &&
+        json_object_object_get_ex(obj, "writers", &obj) &&
+        tlog_rec_conf_list_has(json_object_get_string(obj), "collector")) {
+        tlog_errs_pushs(perrs, "The collector writer cannot be used "
+                               "by the collector");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /* Create the message validator */
+    validator.tok = json_tokener_new();
+    if (validator.tok == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed creating JSON tokener");
+        goto cleanup;
+    }
+
+    /* Initialize libcurl */
+    grc = TLOG_GRC_FROM(curl, curl_global_init(CURL_GLOBAL_NOTHING));
+    if (grc != TLOG_GRC_FROM(curl, CURLE_OK)) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed initializing libcurl");
+        goto cleanup;
+    }
+    curl_initialized = true;
+
+    /* Create the writer */
+    grc = tlog_rec_conf_get_writer(perrs, writer_conf, writer, &batch.writer);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed creating log writer");
+        goto cleanup;
+    }
+    grc = tlog_rec_conf_get_spool(perrs, writer_conf, &batch.writer);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed creating log spool");
+        goto cleanup;
+    }
+    /*
+     * Only the plain file writer can take a whole batch at once. A spool
+     * stores each write as one record, so a batch would have to fit the
+     * spool in one piece, give it the messages one by one instead.
+     */
+    batch.whole = strcmp(writer, "file") == 0 &&
+                  !(json_object_object_get_ex(writer_conf, "spool", &obj) &&
+                    json_object_object_get_ex(obj, "path", NULL));
+    batch.latency = (unsigned int)latency;
+    batch.size = (size_t)batch_size;
+    batch.buf = malloc(batch.size + CLIENT_BUF_SIZE);
+    if (batch.buf == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed allocating batch buffer");
+        goto cleanup;
+    }
+
+    /* Start listening */
+    grc = listen_socket(perrs, socket_path, &listen_fd);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed setting up collector socket");
+        goto cleanup;
+    }
+
+    /* Setup signal handlers to terminate gracefully */
+    for (i = 0; i < TLOG_ARRAY_SIZE(exit_sig); i++) {
+        sigaction(exit_sig[i], NULL, &sa);
+        if (sa.sa_handler != SIG_IGN) {
+            sa.sa_handler = exit_sighandler;
+            sigemptyset(&sa.sa_mask);
+            for (j = 0; j < TLOG_ARRAY_SIZE(exit_sig); j++) {
+                sigaddset(&sa.sa_mask, exit_sig[j]);
+            }
+            /* NOTE: no SA_RESTART on purpose */
+            sa.sa_flags = 0;
+            sigaction(exit_sig[i], &sa, NULL);
+        }
+    }
+
+    /* Collect until interrupted */
+    grc = collect(perrs, listen_fd, &validator, &batch);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed collecting messages");
+    }
+
+    /* Write whatever is left */
+    if (batch.len > 0) {
+        tlog_grc write_grc = batch_write(perrs, &batch, true);
+        if (grc == TLOG_RC_OK) {
+            grc = write_grc;
+        }
+    }
+
+cleanup:
+
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    free(batch.buf);
+    tlog_json_writer_destroy(batch.writer);
+    tlog_json_msg_buf_cleanup(&validator.buf);
+    if (validator.tok != NULL) {
+        json_tokener_free(validator.tok);
+    }
+    json_object_put(writer_conf);
+    if (curl_initialized) {
+        curl_global_cleanup();
+    }
+
+    /* Restore signal handlers */
+    for (i = 0; i < TLOG_ARRAY_SIZE(exit_sig); i++) {
+        sigaction(exit_sig[i], NULL, &sa);
+        if (sa.sa_handler != SIG_IGN) {
+            signal(exit_sig[i], SIG_DFL);
+        }
+    }
+
+    return grc;
+}
+
+int
+main(int argc, char **argv)
+{
+    tlog_grc grc;
+    struct tlog_errs *errs = NULL;
+    struct json_object *conf = NULL;
+    char *cmd_help = NULL;
+
+    /* Read command-line options and usage message */
+    grc = tlog_collectd_conf_cmd_load(&errs, &cmd_help, &conf, argc, argv);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(&errs, "Failed retrieving configuration");
+        goto cleanup;
+    }
+
+    /* Run */
+    grc = run(&errs, argv[0], cmd_help, conf);
+
+cleanup:
+
+    /* Print error stack, if any */
+    tlog_errs_print(stderr, errs);
+
+    json_object_put(conf);
+    free(cmd_help);
+    tlog_errs_destroy(&errs);
+
+    /* Reproduce the exit signal to get proper exit status */
+    if (exit_signum != 0) {
+        raise(exit_signum);
+    }
+
+    return grc != TLOG_RC_OK;
+}
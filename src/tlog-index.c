@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <tlog/errs.h>
+#include <tlog/index.h>
+#include <tlog/index_conf_cmd.h>
+#include <tlog/rc.h>
+#include <tlog/tail.h>
+#include <tlog/misc.h>
+
+/**< Number of the signal causing exit */
+static volatile sig_atomic_t exit_signum  = 0;
+
+static void
+exit_sighandler(int signum)
+{
+    if (exit_signum == 0) {
+        exit_signum = signum;
+    }
+}
+
+static tlog_grc
+run(struct tlog_errs **perrs, const char *cmd_help, struct json_object *conf)
+{
+    const int exit_sig[] = {SIGINT, SIGTERM, SIGHUP};
+    tlog_grc grc;
+    struct sigaction sa;
+    struct json_object *obj;
+    size_t i;
+    size_t j;
+    const char *log_path;
+    char *index_path = NULL;
+    bool follow = false;
+    struct tlog_tail tail = {.fd = -1};
+    int log_fd = -1;
+    int index_fd = -1;
+    struct tlog_index *index = NULL;
+    size_t end;
+    size_t line;
+
+    /* Check for the help flag */
+    if (json_object_object_get_ex(conf, "help", &obj)) {
+        if (json_object_get_boolean(obj)) {
+            fprintf(stdout, "%s\n", cmd_help);
+            grc = TLOG_RC_OK;
+            goto cleanup;
+        }
+    }
+
+    /* Check for the version flag */
+    if (json_object_object_get_ex(conf, "version", &obj)) {
+        if (json_object_get_boolean(obj)) {
+            printf("%s", tlog_version);
+            grc = TLOG_RC_OK;
+            goto cleanup;
+        }
+    }
+
+    /* Get the log file path */
+    if (!json_object_object_get_ex(conf, "args", &obj) ||
+        json_object_array_length(obj) != 1) {
+        tlog_errs_pushf(perrs, "A single log file path is expected\n%s",
+                        cmd_help);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    log_path = json_object_get_string(json_object_array_get_idx(obj, 0));
+
+    /* Get the index file path, defaulting to one next to the log file */
+    if (json_object_object_get_ex(conf, "index", &obj)) {
+        index_path = strdup(json_object_get_string(obj));
+    } else if (asprintf(&index_path, "%s" TLOG_INDEX_PATH_SUFFIX, log_path) < 0) {
+        index_path = NULL;
+    }
+    if (index_path == NULL) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed formatting index file path");
+        goto cleanup;
+    }
+
+    /* Check if we're following the log */
+    if (json_object_object_get_ex(conf, "follow", &obj)) {
+        follow = json_object_get_boolean(obj);
+    }
+
+    /* Open the log file */
+    log_fd = open(log_path, O_RDONLY);
+    if (log_fd < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed opening log file \"%s\"", log_path);
+        goto cleanup;
+    }
+
+    /* Open and load the index file, creating it, if it doesn't exist */
+    index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+    if (index_fd < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed opening index file \"%s\"",
+                        index_path);
+        goto cleanup;
+    }
+    grc = tlog_index_create(&index, index_fd);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed loading index file \"%s\"",
+                        index_path);
+        goto cleanup;
+    }
+    if (follow) {
+        tlog_tail_init(&tail, log_path);
+    }
+
+    /* Setup signal handlers to terminate gracefully */
+    for (i = 0; i < TLOG_ARRAY_SIZE(exit_sig); i++) {
+        sigaction(exit_sig[i], NULL, &sa);
+        if (sa.sa_handler != SIG_IGN) {
+            sa.sa_handler = exit_sighandler;
+            sigemptyset(&sa.sa_mask);
+            for (j = 0; j < TLOG_ARRAY_SIZE(exit_sig); j++) {
+                sigaddset(&sa.sa_mask, exit_sig[j]);
+            }
+            /* NOTE: no SA_RESTART on purpose */
+            sa.sa_flags = 0;
+            sigaction(exit_sig[i], &sa, NULL);
+        }
+    }
+
+    /* Index the new messages, repeatedly, if following */
+    while (true) {
+        end = tlog_index_get_end(index, &line);
+        grc = tlog_index_update_log(index, index_fd, log_fd);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed updating the index");
+            goto cleanup;
+        }
+        if (tlog_index_get_end(index, &line) != end) {
+            tlog_tail_reset(&tail);
+        }
+        /* Stop, unless following, or once the rotated file is read out */
+        if (!follow || exit_signum != 0 || tail.rotated) {
+            break;
+        }
+        grc = tlog_tail_wait(&tail);
+        if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+            break;
+        } else if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed waiting for new messages");
+            goto cleanup;
+        }
+        if (tail.truncated) {
+            grc = TLOG_RC_INDEX_LOG_TRUNCATED;
+            tlog_errs_pushc(perrs, grc);
+            goto cleanup;
+        }
+    }
+
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    tlog_tail_cleanup(&tail);
+    tlog_index_destroy(index);
+    if (index_fd >= 0) {
+        close(index_fd);
+    }
+    if (log_fd >= 0) {
+        close(log_fd);
+    }
+    free(index_path);
+
+    /* Restore signal handlers */
+    for (i = 0; i < TLOG_ARRAY_SIZE(exit_sig); i++) {
+        sigaction(exit_sig[i], NULL, &sa);
+        if (sa.sa_handler != SIG_IGN) {
+            signal(exit_sig[i], SIG_DFL);
+        }
+    }
+
+    return grc;
+}
+
+int
+main(int argc, char **argv)
+{
+    tlog_grc grc;
+    struct tlog_errs *errs = NULL;
+    struct json_object *conf = NULL;
+    char *cmd_help = NULL;
+
+    /* Read command-line options and usage message */
+    grc = tlog_index_conf_cmd_load(&errs, &cmd_help, &conf, argc, argv);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(&errs, "Failed retrieving configuration");
+        goto cleanup;
+    }
+
+    /* Run */
+    grc = run(&errs, cmd_help, conf);
+
+cleanup:
+
+    /* Print error stack, if any */
+    tlog_errs_print(stderr, errs);
+
+    json_object_put(conf);
+    free(cmd_help);
+    tlog_errs_destroy(&errs);
+
+    /* Reproduce the exit signal to get proper exit status */
+    if (exit_signum != 0) {
+        raise(exit_signum);
+    }
+
+    return grc != TLOG_RC_OK;
+}
@@ -0,0 +1,369 @@
+/*
+ * Tlog-ls program.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <curl/curl.h>
+#include <tlog/errs.h>
+#include <tlog/index.h>
+#include <tlog/ls_conf_cmd.h>
+#include <tlog/session_list.h>
+#include <tlog/es_json_reader.h>
+#include <tlog/rc.h>
+#include <tlog/misc.h>
+
+/** Default maximum number of hosts and sessions to list from ElasticSearch */
+#define SIZE_DEFAULT            1000
+
+/** Default time to wait for a connection to ElasticSearch, seconds */
+#define CONNECT_TIMEOUT_DEFAULT 10
+
+/** Default time the ElasticSearch request can take, seconds */
+#define TIMEOUT_DEFAULT         60
+
+/**
+ * Load the index of a log file, indexing the messages added since its
+ * last update, and saving them, if the index file is writable. Index the
+ * whole log file in memory, if the index file doesn't exist.
+ *
+ * @param perrs         Location for the error stack. Can be NULL.
+ * @param pindex        Location for the loaded index pointer.
+ * @param log_path      Path to the log file.
+ * @param index_path    Path to the index file.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+load_index(struct tlog_errs **perrs, struct tlog_index **pindex,
+           const char *log_path, const char *index_path)
+{
+    tlog_grc grc;
+    int log_fd = -1;
+    int index_fd = -1;
+    bool index_writable = true;
+    struct tlog_index *index = NULL;
+
+    log_fd = open(log_path, O_RDONLY);
+    if (log_fd < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed opening log file \"%s\"", log_path);
+        goto cleanup;
+    }
+
+    index_fd = open(index_path, O_RDWR);
+    if (index_fd < 0 && (errno == EACCES || errno == EROFS)) {
+        index_fd = open(index_path, O_RDONLY);
+        index_writable = false;
+    }
+    if (index_fd < 0 && errno != ENOENT) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed opening index file \"%s\"",
+                        index_path);
+        goto cleanup;
+    }
+    grc = tlog_index_create(&index, index_fd);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushf(perrs, "Failed loading index file \"%s\"",
+                        index_path);
+        goto cleanup;
+    }
+
+    /* Index the messages following the indexed part */
+    grc = tlog_index_update_log(index, index_writable ? index_fd : -1,
+                                log_fd);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed updating the index");
+        goto cleanup;
+    }
+
+    *pindex = index;
+    index = NULL;
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    tlog_index_destroy(index);
+    if (index_fd >= 0) {
+        close(index_fd);
+    }
+    if (log_fd >= 0) {
+        close(log_fd);
+    }
+    return grc;
+}
+
+/**
+ * Format a time position or duration as hours, minutes, seconds and
+ * milliseconds.
+ *
+ * @param buf   The buffer to format into.
+ * @param size  The buffer size.
+ * @param ms    The time to format, ms.
+ */
+static void
+format_time(char *buf, size_t size, uint64_t ms)
+{
+    snprintf(buf, size, "%" PRIu64 ":%02u:%02u.%03u",
+             ms / 3600000,
+             (unsigned int)(ms / 60000 % 60),
+             (unsigned int)(ms / 1000 % 60),
+             (unsigned int)(ms % 1000));
+}
+
+/**
+ * Output a session list as a table.
+ *
+ * @param list  The list to output.
+ */
+static void
+output(const struct tlog_session_list *list)
+{
+    const struct tlog_session_info *info;
+    int host_width = (int)strlen("HOST");
+    int user_width = (int)strlen("USER");
+    char start[32];
+    char duration[32];
+    char bytes[32];
+    size_t i;
+
+    for (i = 0; i < list->info_num; i++) {
+        info = &list->info_list[i];
+        if ((int)strlen(info->host) > host_width) {
+            host_width = (int)strlen(info->host);
+        }
+        if ((int)strlen(info->user) > user_width) {
+            user_width = (int)strlen(info->user);
+        }
+    }
+
+    printf("%-*s  %-*s  %10s  %14s  %14s  %8s  %12s\n",
+           host_width, "HOST", user_width, "USER", "SESSION",
+           "START", "DURATION", "MESSAGES", "BYTES");
+    for (i = 0; i < list->info_num; i++) {
+        info = &list->info_list[i];
+        format_time(start, sizeof(start), info->first_pos);
+        format_time(duration, sizeof(duration),
+                    info->end_pos - info->first_pos);
+        if (info->bytes == TLOG_SESSION_LIST_BYTES_UNKNOWN) {
+            snprintf(bytes, sizeof(bytes), "-");
+        } else {
+            snprintf(bytes, sizeof(bytes), "%zu", info->bytes);
+        }
+        printf("%-*s  %-*s  %10u  %14s  %14s  %8zu  %12s\n",
+               host_width, info->host, user_width, info->user,
+               info->session, start, duration, info->num, bytes);
+    }
+}
+
+static tlog_grc
+run(struct tlog_errs **perrs, const char *cmd_help, struct json_object *conf)
+{
+    tlog_grc grc;
+    struct json_object *obj;
+    struct json_object *es = NULL;
+    struct json_object *args;
+    const char *es_baseurl = NULL;
+    const char *es_query = "*";
+    int64_t size = SIZE_DEFAULT;
+    int64_t connect_timeout = CONNECT_TIMEOUT_DEFAULT;
+    int64_t timeout = TIMEOUT_DEFAULT;
+    const char *log_path;
+    char *index_path = NULL;
+    bool curl_init = false;
+    struct tlog_index *index = NULL;
+    struct tlog_session_list *list = NULL;
+
+    /* Check for the help flag */
+    if (json_object_object_get_ex(conf, "help", &obj)) {
+        if (json_object_get_boolean(obj)) {
+            fprintf(stdout, "%s\n", cmd_help);
+            grc = TLOG_RC_OK;
+            goto cleanup;
+        }
+    }
+
+    /* Check for the version flag */
+    if (json_object_object_get_ex(conf, "version", &obj)) {
+        if (json_object_get_boolean(obj)) {
+            printf("%s", tlog_version);
+            grc = TLOG_RC_OK;
+            goto cleanup;
+        }
+    }
+
+    /* Get the ElasticSearch parameters */
+    if (json_object_object_get_ex(conf, "es", &es)) {
+        if (json_object_object_get_ex(es, "baseurl", &obj)) {
+            es_baseurl = json_object_get_string(obj);
+        }
+        if (json_object_object_get_ex(es, "query", &obj)) {
+            es_query = json_object_get_string(obj);
+        }
+        if (json_object_object_get_ex(es, "conntimeout", &obj)) {
+            connect_timeout = json_object_get_int64(obj);
+        }
+        if (json_object_object_get_ex(es, "timeout", &obj)) {
+            timeout = json_object_get_int64(obj);
+        }
+    }
+    if (json_object_object_get_ex(conf, "size", &obj)) {
+        size = json_object_get_int64(obj);
+    }
+    if (size > INT_MAX) {
+        tlog_errs_pushf(perrs, "Invalid size: %" PRId64, size);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    if (connect_timeout > UINT_MAX || timeout > UINT_MAX) {
+        tlog_errs_pushs(perrs, "ElasticSearch timeout is too large");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    json_object_object_get_ex(conf, "args", &args);
+
+    if (es_baseurl != NULL) {
+        if (!tlog_es_json_reader_base_url_is_valid(es_baseurl)) {
+            tlog_errs_pushs(perrs, "Base URL cannot contain '?' or '#'");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        if (json_object_array_length(args) != 0 ||
+            json_object_object_get_ex(conf, "index", NULL)) {
+            tlog_errs_pushf(perrs, "A log file cannot be listed "
+                                   "together with ElasticSearch\n%s",
+                            cmd_help);
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        grc = TLOG_GRC_FROM(curl, curl_global_init(CURL_GLOBAL_NOTHING));
+        if (grc != TLOG_GRC_FROM(curl, CURLE_OK)) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed initializing libcurl");
+            goto cleanup;
+        }
+        curl_init = true;
+        grc = tlog_session_list_create_es(&list, es_baseurl, es_query,
+                                          (size_t)size,
+                                          (unsigned int)connect_timeout,
+                                          (unsigned int)timeout);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed listing sessions "
+                                   "from ElasticSearch");
+            goto cleanup;
+        }
+    } else {
+        if (json_object_array_length(args) != 1) {
+            tlog_errs_pushf(perrs, "A single log file path is expected\n%s",
+                            cmd_help);
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        log_path = json_object_get_string(json_object_array_get_idx(args, 0));
+
+        /* Get the index file path, defaulting to one next to the log file */
+        if (json_object_object_get_ex(conf, "index", &obj)) {
+            index_path = strdup(json_object_get_string(obj));
+        } else if (asprintf(&index_path, "%s" TLOG_INDEX_PATH_SUFFIX,
+                            log_path) < 0) {
+            index_path = NULL;
+        }
+        if (index_path == NULL) {
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed formatting index file path");
+            goto cleanup;
+        }
+
+        grc = load_index(perrs, &index, log_path, index_path);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        grc = tlog_session_list_create_index(&list, index);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed listing sessions of the index");
+            goto cleanup;
+        }
+    }
+
+    output(list);
+    if (list->partial) {
+        fprintf(stderr, "Some sessions were left out, "
+                        "increase the size to list them\n");
+    }
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    tlog_session_list_destroy(list);
+    tlog_index_destroy(index);
+    free(index_path);
+    if (curl_init) {
+        curl_global_cleanup();
+    }
+    return grc;
+}
+
+int
+main(int argc, char **argv)
+{
+    tlog_grc grc;
+    struct tlog_errs *errs = NULL;
+    struct json_object *conf = NULL;
+    char *cmd_help = NULL;
+
+    /* Read command-line options and usage message */
+    grc = tlog_ls_conf_cmd_load(&errs, &cmd_help, &conf, argc, argv);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(&errs, "Failed retrieving configuration");
+        goto cleanup;
+    }
+
+    /* Run */
+    grc = run(&errs, cmd_help, conf);
+
+cleanup:
+
+    /* Print error stack, if any */
+    tlog_errs_print(stderr, errs);
+
+    json_object_put(conf);
+    free(cmd_help);
+    tlog_errs_destroy(&errs);
+
+    return grc != TLOG_RC_OK;
+}
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <config.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <termios.h>
@@ -29,19 +30,44 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <curl/curl.h>
 #include <locale.h>
 #include <langinfo.h>
 #include <tlog/play_conf.h>
 #include <tlog/play_conf_cmd.h>
 #include <tlog/fd_json_reader.h>
+#include <tlog/mmap_json_reader.h>
+#include <tlog/index.h>
 #include <tlog/es_json_reader.h>
 #include <tlog/json_source.h>
+#include <tlog/prefetch_source.h>
 #include <tlog/rc.h>
+#include <tlog/screen.h>
+#include <tlog/tail.h>
 #include <tlog/timespec.h>
 #include <tlog/misc.h>
 
-#define POLL_PERIOD 1
+/** Screen width to assume until the recording specifies it */
+#define SCREEN_WIDTH    80
+
+/** Screen height to assume until the recording specifies it */
+#define SCREEN_HEIGHT   24
+
+/** Time after a keyframe to jump back to the previous one from, ms */
+#define JUMP_BACK_MARGIN    2000
+
+/** Length of buffered output to write without waiting for the frame end */
+#define FRAME_SIZE_MAX  65536
+
+/** Length of buffered output to write at once when exporting */
+#define EXPORT_SIZE_MAX (1024 * 1024)
+
+/** Maximum speed multiplier reachable with the control keys */
+#define SPEED_MAX   64
+
+/** Minimum speed multiplier reachable with the control keys */
+#define SPEED_MIN   (1.0 / 64)
 
 /**< Number of the signal causing exit */
 static volatile sig_atomic_t exit_signum  = 0;
@@ -54,26 +80,50 @@ exit_sighandler(int signum)
     }
 }
 
+/**
+ * Convert a timespec to milliseconds.
+ *
+ * @param ts    The timespec to convert.
+ *
+ * @return Number of milliseconds.
+ */
+static uint64_t
+timespec_to_ms(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000 + (uint64_t)ts->tv_nsec / 1000000;
+}
+
 /**
  * Create the log source according to configuration.
  *
  * @param perrs Location for the error stack. Can be NULL.
  * @param psink Location for the created source pointer.
+ * @param pindex    Location for the pointer to the loaded log file index,
+ *                  to be destroyed after the source, set to NULL if none.
  * @param conf  Configuration JSON object.
+ * @param pos   Time position to start playing back from.
+ * @param end   Time position to stop playing back at, or NULL for none.
  *
  * @return Global return code.
  */
 static tlog_grc
 create_log_source(struct tlog_errs **perrs,
                   struct tlog_source **psource,
-                  struct json_object *conf)
+                  struct tlog_index **pindex,
+                  struct json_object *conf,
+                  const struct timespec *pos,
+                  const struct timespec *end)
 {
     tlog_grc grc;
     struct json_object *obj;
     const char *str;
     int fd = -1;
+    struct tlog_index *index = NULL;
+    const char *host = NULL;
+    unsigned int session = 0;
     struct tlog_json_reader *reader = NULL;
     struct tlog_source *source = NULL;
+    struct tlog_source *prefetch_source = NULL;
 
     /*
      * Create the reader
@@ -88,6 +138,10 @@ create_log_source(struct tlog_errs **perrs,
         struct json_object *conf_es;
         const char *baseurl;
         const char *query;
+        size_t page;
+        uint64_t span;
+        unsigned int connect_timeout;
+        unsigned int timeout;
 
         /* Get ElasticSearch reader conf container */
         if (!json_object_object_get_ex(conf, "es", &conf_es)) {
@@ -120,78 +174,924 @@ create_log_source(struct tlog_errs **perrs,
             grc = TLOG_RC_FAILURE;
             goto cleanup;
         }
-        query = json_object_get_string(obj);
+        query = json_object_get_string(obj);
+
+        /* Get the page size */
+        if (!json_object_object_get_ex(conf_es, "page", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch page size is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        page = (size_t)json_object_get_int64(obj);
+
+        /* Get the maximum message span */
+        if (!json_object_object_get_ex(conf_es, "span", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch message span is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        span = (uint64_t)json_object_get_int64(obj) * 1000;
+
+        /* Get the connection timeout */
+        if (!json_object_object_get_ex(conf_es, "conntimeout", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch connection timeout "
+                            "is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        connect_timeout = (unsigned int)json_object_get_int64(obj);
+
+        /* Get the request timeout */
+        if (!json_object_object_get_ex(conf_es, "timeout", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "ElasticSearch request timeout is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        timeout = (unsigned int)json_object_get_int64(obj);
+
+        /* Create the reader, requesting messages between the positions */
+        grc = tlog_es_json_reader_create(&reader, baseurl, query,
+                                         timespec_to_ms(pos),
+                                         (end == NULL ? UINT64_MAX
+                                                      : timespec_to_ms(end)),
+                                         span, page, connect_timeout, timeout);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating the ElasticSearch reader");
+            goto cleanup;
+        }
+    } else if (strcmp(str, "file") == 0) {
+        struct json_object *conf_file;
+        struct json_object *obj_threads;
+        struct stat st;
+
+        /* Get file reader conf container */
+        if (!json_object_object_get_ex(conf, "file", &conf_file)) {
+            tlog_errs_pushs(perrs,
+                            "File reader parameters are not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get the file path */
+        if (!json_object_object_get_ex(conf_file, "path", &obj)) {
+            tlog_errs_pushs(perrs, "Log file path is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        str = json_object_get_string(obj);
+
+        /* Get the number of parsing threads */
+        if (!json_object_object_get_ex(conf_file, "threads", &obj_threads)) {
+            tlog_errs_pushs(perrs, "Log file thread number is not specified");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+
+        /* Get the host and the session to play back */
+        if (json_object_object_get_ex(conf_file, "host", &obj)) {
+            host = json_object_get_string(obj);
+        }
+        if (json_object_object_get_ex(conf_file, "session", &obj)) {
+            session = (unsigned int)json_object_get_int64(obj);
+        }
+
+        /* Load the index, if specified */
+        if (json_object_object_get_ex(conf_file, "index", &obj)) {
+            fd = open(json_object_get_string(obj), O_RDONLY);
+            if (fd < 0) {
+                grc = TLOG_GRC_ERRNO;
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushf(perrs, "Failed opening index file \"%s\"",
+                                json_object_get_string(obj));
+                goto cleanup;
+            }
+            grc = tlog_index_create(&index, fd);
+            if (grc != TLOG_RC_OK) {
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushf(perrs, "Failed loading index file \"%s\"",
+                                json_object_get_string(obj));
+                goto cleanup;
+            }
+            close(fd);
+            fd = -1;
+        }
+
+        /* Open the file */
+        fd = open(str, O_RDONLY);
+        if (fd < 0) {
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushf(perrs, "Failed opening log file \"%s\"", str);
+            goto cleanup;
+        }
+
+        /* Create the reader, letting it take over the FD */
+        if (fstat(fd, &st) < 0) {
+            grc = TLOG_GRC_ERRNO;
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushf(perrs, "Failed getting log file status");
+            goto cleanup;
+        }
+        if (S_ISREG(st.st_mode)) {
+            /* Skip the indexed messages before the position */
+            grc = tlog_mmap_json_reader_create(
+                            &reader, fd, true,
+                            (unsigned int)json_object_get_int64(obj_threads),
+                            index, timespec_to_ms(pos));
+        } else {
+            grc = tlog_fd_json_reader_create(&reader, fd, true, 65536);
+        }
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating file reader");
+            goto cleanup;
+        }
+        fd = -1;
+    } else {
+        tlog_errs_pushf(perrs, "Unknown reader type: %s", str);
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /* Create the source */
+    grc = tlog_json_source_create(&source, reader, true,
+                                  host, NULL, NULL, session, 4096);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed creating the source");
+        goto cleanup;
+    }
+    reader = NULL;
+
+    /* Read the source ahead in background, if requested */
+    if (!json_object_object_get_ex(conf, "prefetch", &obj)) {
+        tlog_errs_pushs(perrs, "Prefetch size is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    if (json_object_get_int64(obj) > 0) {
+        grc = tlog_prefetch_source_create(&prefetch_source, source, true,
+                                          (size_t)json_object_get_int64(obj));
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating the prefetching source");
+            goto cleanup;
+        }
+        source = prefetch_source;
+    }
+
+    *psource = source;
+    source = NULL;
+    *pindex = index;
+    index = NULL;
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    tlog_json_reader_destroy(reader);
+    tlog_source_destroy(source);
+    tlog_index_destroy(index);
+    return grc;
+}
+
+/**
+ * Get the path of the log file to follow, if reading a regular file.
+ *
+ * @param conf  Configuration JSON object.
+ *
+ * @return The log file path, or NULL if not reading a file.
+ */
+static const char *
+get_tail_path(struct json_object *conf)
+{
+    struct json_object *obj;
+
+    if (!json_object_object_get_ex(conf, "reader", &obj) ||
+        strcmp(json_object_get_string(obj), "file") != 0 ||
+        !json_object_object_get_ex(conf, "file", &obj) ||
+        !json_object_object_get_ex(obj, "path", &obj)) {
+        return NULL;
+    }
+    return json_object_get_string(obj);
+}
+
+/** Playback timing control */
+struct ctl {
+    int             fd;         /**< FD to read control keys from, or -1 */
+    double          speed;      /**< Speed multiplier */
+    double          speed_orig; /**< Speed multiplier specified initially */
+    struct timespec maxdelay;   /**< Maximum delay, zero for no limit */
+    bool            paused;     /**< True if paused */
+    struct timespec pause_ts;   /**< Time the playback was paused at */
+    bool            skip;       /**< True if the delay should be skipped */
+    bool            seekable;   /**< True if keyframes can be jumped to */
+    int             jump;       /**< Keyframe to jump to: -1 for previous,
+                                     1 for next, 0 for none */
+    struct timespec due_ts;     /**< Local time the last packet waited for
+                                     was due at */
+    struct timespec stretch_ts; /**< Total time the playback was stretched
+                                     by packets arriving overdue */
+};
+
+/**
+ * Read and handle the available control keys.
+ *
+ * @param ctl               The playback control to handle the keys for.
+ * @param plocal_last_ts    Location of the local time the last packet was
+ *                          output at, shifted by the time spent paused.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+ctl_read(struct ctl *ctl, struct timespec *plocal_last_ts)
+{
+    char buf[16];
+    ssize_t rc;
+    ssize_t i;
+    struct timespec now_ts;
+    struct timespec paused_ts;
+
+    rc = read(ctl->fd, buf, sizeof(buf));
+    if (rc < 0) {
+        return TLOG_GRC_ERRNO;
+    } else if (rc == 0) {
+        /* Stop reading keys, resuming, if paused, as it can't be done */
+        ctl->fd = -1;
+        if (ctl->paused) {
+            buf[rc++] = ' ';
+        }
+    }
+
+    for (i = 0; i < rc; i++) {
+        switch (buf[i]) {
+        case ' ':
+            if (clock_gettime(CLOCK_MONOTONIC, &now_ts) != 0) {
+                return TLOG_GRC_ERRNO;
+            }
+            if (ctl->paused) {
+                tlog_timespec_sub(&now_ts, &ctl->pause_ts, &paused_ts);
+                tlog_timespec_add(plocal_last_ts, &paused_ts,
+                                  plocal_last_ts);
+            } else {
+                ctl->pause_ts = now_ts;
+            }
+            ctl->paused = !ctl->paused;
+            break;
+        case '+':
+        case '=':
+            if (ctl->speed < SPEED_MAX) {
+                ctl->speed *= 2;
+            }
+            break;
+        case '-':
+        case '_':
+            if (ctl->speed > SPEED_MIN) {
+                ctl->speed /= 2;
+            }
+            break;
+        case '1':
+            ctl->speed = ctl->speed_orig;
+            break;
+        case '.':
+            ctl->skip = true;
+            break;
+        case '<':
+        case '>':
+            if (ctl->seekable) {
+                ctl->jump = buf[i] == '<' ? -1 : 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Wait for the time to output a packet, handling the control keys.
+ *
+ * @param ctl               The playback control.
+ * @param plocal_last_ts    Location of the local time the last packet was
+ *                          output at, updated to the time the packet should
+ *                          be output at.
+ * @param pkt_delay_ts      The recorded delay between the last packet and
+ *                          the one to wait for.
+ *
+ * @return Global return code, TLOG_GRC_FROM(errno, EINTR), if interrupted
+ *         by a signal.
+ */
+static tlog_grc
+ctl_wait(struct ctl *ctl, struct timespec *plocal_last_ts,
+         const struct timespec *pkt_delay_ts)
+{
+    tlog_grc grc;
+    struct timespec now_ts;
+    struct timespec delay_ts;
+    struct timespec next_ts;
+    struct timespec timeout_ts;
+    struct pollfd pfd;
+    bool timed_out = false;
+    int rc;
+
+    while (true) {
+        if (clock_gettime(CLOCK_MONOTONIC, &now_ts) != 0) {
+            return TLOG_GRC_ERRNO;
+        }
+
+        if (ctl->skip || ctl->jump != 0) {
+            ctl->skip = false;
+            *plocal_last_ts = ctl->due_ts = now_ts;
+            return TLOG_RC_OK;
+        }
+
+        if (!ctl->paused) {
+            /* Scale and limit the delay */
+            tlog_timespec_fp_mul(pkt_delay_ts, 1 / ctl->speed, &delay_ts);
+            if (!tlog_timespec_is_zero(&ctl->maxdelay) &&
+                tlog_timespec_cmp(&delay_ts, &ctl->maxdelay) > 0) {
+                delay_ts = ctl->maxdelay;
+            }
+            tlog_timespec_add(plocal_last_ts, &delay_ts, &next_ts);
+            /* If the time has come */
+            if (tlog_timespec_cmp(&next_ts, &now_ts) <= 0) {
+                /*
+                 * Continue from the scheduled time, if waited for it, to
+                 * avoid drift, otherwise the packet is overdue, and the
+                 * time is stretched
+                 */
+                ctl->due_ts = next_ts;
+                if (timed_out) {
+                    *plocal_last_ts = next_ts;
+                } else {
+                    *plocal_last_ts = now_ts;
+                    tlog_timespec_sub(&now_ts, &next_ts, &delay_ts);
+                    tlog_timespec_add(&ctl->stretch_ts, &delay_ts,
+                                      &ctl->stretch_ts);
+                }
+                return TLOG_RC_OK;
+            }
+            tlog_timespec_sub(&next_ts, &now_ts, &timeout_ts);
+        }
+
+        /* Wait for the time, or for a key */
+        pfd.fd = ctl->fd;
+        pfd.events = POLLIN;
+        rc = ppoll(&pfd, (ctl->fd >= 0 ? 1 : 0),
+                   (ctl->paused ? NULL : &timeout_ts), NULL);
+        if (rc < 0) {
+            return TLOG_GRC_ERRNO;
+        }
+        timed_out = rc == 0;
+        if (rc > 0) {
+            grc = ctl_read(ctl, plocal_last_ts);
+            if (grc != TLOG_RC_OK) {
+                return grc;
+            }
+        }
+    }
+}
+
+/** Number of histogram buckets holding single values */
+#define HIST_EXACT  16
+
+/** Number of histogram buckets per power of two above them */
+#define HIST_SUB    8
+
+/** Number of histogram buckets */
+#define HIST_SIZE   (HIST_EXACT + (64 - 4) * HIST_SUB)
+
+/**
+ * Histogram of durations, with buckets growing in size along with the
+ * values, keeping them within 12.5% of the value, in constant space.
+ */
+struct hist {
+    size_t      num;                /**< Number of values added */
+    uint64_t    sum;                /**< Sum of the values, us */
+    uint64_t    max;                /**< Maximum value, us */
+    size_t      buckets[HIST_SIZE]; /**< Number of values per bucket */
+};
+
+/**
+ * Add a duration to a histogram.
+ *
+ * @param hist  The histogram to add to.
+ * @param ts    The duration to add, negative counted as zero.
+ */
+static void
+hist_add(struct hist *hist, const struct timespec *ts)
+{
+    uint64_t us;
+    unsigned int exp;
+    size_t i;
+
+    us = ts->tv_sec < 0 ? 0
+                        : (uint64_t)ts->tv_sec * 1000000 +
+                          (uint64_t)ts->tv_nsec / 1000;
+    if (us < HIST_EXACT) {
+        i = (size_t)us;
+    } else {
+        for (exp = 4; us >> (exp + 1) != 0; exp++);
+        i = HIST_EXACT + (exp - 4) * HIST_SUB +
+            ((us >> (exp - 3)) & (HIST_SUB - 1));
+    }
+    hist->buckets[i]++;
+    hist->num++;
+    hist->sum += us;
+    if (us > hist->max) {
+        hist->max = us;
+    }
+}
+
+/**
+ * Get a percentile of the durations in a histogram.
+ *
+ * @param hist      The histogram to get the percentile of.
+ * @param percent   The percentile to get, 0-100.
+ *
+ * @return The upper bound of the bucket holding the percentile, but not
+ *         above the maximum duration, ms.
+ */
+static double
+hist_get(const struct hist *hist, double percent)
+{
+    size_t rank = (size_t)(hist->num * percent / 100);
+    size_t count = 0;
+    uint64_t us = 0;
+    unsigned int exp;
+    size_t i;
+
+    for (i = 0; i < HIST_SIZE; i++) {
+        count += hist->buckets[i];
+        if (count > rank) {
+            break;
+        }
+    }
+    if (i < HIST_EXACT) {
+        us = i;
+    } else if (i < HIST_SIZE) {
+        exp = (unsigned int)((i - HIST_EXACT) / HIST_SUB + 4);
+        us = ((uint64_t)(HIST_SUB + (i - HIST_EXACT) % HIST_SUB + 1) <<
+              (exp - 3)) - 1;
+    }
+    return TLOG_MIN(us, hist->max) / 1000.0;
+}
+
+/** Screen snapshot to seek to */
+struct keyframe {
+    struct timespec     ts;         /**< Recording time of the snapshot */
+    struct tlog_screen *screen;     /**< The screen before the output at
+                                         the time */
+};
+
+/** Keyframe cache */
+struct keyframes {
+    uint64_t            interval;   /**< Interval between keyframes, ms,
+                                         zero if not kept */
+    uint64_t            base;       /**< Recording time of the first
+                                         keyframe, the position played
+                                         back from, ms */
+    struct keyframe    *list;       /**< Keyframes, one per interval */
+    size_t              num;        /**< Number of keyframes */
+    size_t              size;       /**< Allocated number of keyframes */
+};
+
+/**
+ * Add snapshots of a screen as the keyframes due before a recording time.
+ *
+ * @param keyframes The keyframe cache to add to.
+ * @param screen    The screen to snapshot.
+ * @param ts        The recording time of the output to be applied next.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+keyframes_add(struct keyframes *keyframes, const struct tlog_screen *screen,
+              const struct timespec *ts)
+{
+    tlog_grc grc;
+    uint64_t ms = timespec_to_ms(ts);
+    uint64_t kf_ms;
+    struct keyframe *list;
+    size_t size;
+
+    while ((kf_ms = keyframes->base +
+                    keyframes->num * keyframes->interval) <= ms) {
+        if (keyframes->num >= keyframes->size) {
+            size = keyframes->size == 0 ? 64 : keyframes->size * 2;
+            list = realloc(keyframes->list, sizeof(*list) * size);
+            if (list == NULL) {
+                return TLOG_GRC_ERRNO;
+            }
+            keyframes->list = list;
+            keyframes->size = size;
+        }
+        grc = tlog_screen_copy(&keyframes->list[keyframes->num].screen,
+                               screen);
+        if (grc != TLOG_RC_OK) {
+            return grc;
+        }
+        keyframes->list[keyframes->num].ts.tv_sec = kf_ms / 1000;
+        keyframes->list[keyframes->num].ts.tv_nsec = kf_ms % 1000 * 1000000;
+        keyframes->num++;
+    }
+
+    return TLOG_RC_OK;
+}
+
+/**
+ * Cleanup a keyframe cache.
+ *
+ * @param keyframes The keyframe cache to cleanup.
+ */
+static void
+keyframes_cleanup(struct keyframes *keyframes)
+{
+    size_t i;
+
+    for (i = 0; i < keyframes->num; i++) {
+        tlog_screen_destroy(keyframes->list[i].screen);
+    }
+    free(keyframes->list);
+    keyframes->list = NULL;
+    keyframes->num = 0;
+    keyframes->size = 0;
+}
+
+/** Output frame, coalescing packets due within an interval */
+struct frame {
+    struct timespec interval;   /**< Interval to merge packets within, zero
+                                     to output each packet at once */
+    char           *buf;        /**< Buffered output */
+    size_t          len;        /**< Length of the buffered output */
+    size_t          size;       /**< Allocated size of the buffer */
+
+    size_t          pkts;       /**< Number of packets output */
+    size_t          writes;     /**< Number of writes done */
+    size_t          merged;     /**< Number of packets merged into a frame,
+                                     without waiting for them */
+    struct timespec early_max;  /**< Maximum time a packet was output early */
+    struct timespec early_sum;  /**< Total time packets were output early */
+    bool            timed;      /**< True if the output was due at a time,
+                                     not written yet */
+    struct timespec due_ts;     /**< Local time the output was due at,
+                                     if timed */
+    struct hist     late;       /**< Time the timed output was written
+                                     after it was due */
+};
+
+/**
+ * Add a packet output to a frame.
+ *
+ * @param frame The frame to add the output to.
+ * @param buf   The output buffer.
+ * @param len   The output length.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+frame_add(struct frame *frame, const uint8_t *buf, size_t len)
+{
+    size_t size;
+    char *new_buf;
+
+    if (frame->len + len > frame->size) {
+        size = TLOG_MAX(frame->size * 2, frame->len + len);
+        new_buf = realloc(frame->buf, size);
+        if (new_buf == NULL) {
+            return TLOG_GRC_ERRNO;
+        }
+        frame->buf = new_buf;
+        frame->size = size;
+    }
+    memcpy(frame->buf + frame->len, buf, len);
+    frame->len += len;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Add the output reproducing a screen on the terminal to a frame.
+ *
+ * @param frame     The frame to add the output to.
+ * @param screen    The screen to reproduce.
+ *
+ * @return Global return code.
+ */
+static tlog_grc
+frame_add_screen(struct frame *frame, const struct tlog_screen *screen)
+{
+    tlog_grc grc;
+    char *buf;
+    size_t len;
+
+    grc = tlog_screen_render(screen, &buf, &len);
+    if (grc != TLOG_RC_OK) {
+        return grc;
+    }
+    grc = frame_add(frame, (const uint8_t *)buf, len);
+    free(buf);
+    return grc;
+}
+
+/**
+ * Write the buffered output of a frame to stdout.
+ *
+ * @param frame The frame to write out.
+ *
+ * @return Global return code, TLOG_GRC_FROM(errno, EINTR), if interrupted
+ *         by a signal.
+ */
+static tlog_grc
+frame_flush(struct frame *frame)
+{
+    size_t off = 0;
+    ssize_t rc;
+    struct timespec now_ts;
+
+    /* Measure how late the output is written */
+    if (frame->timed && frame->len > 0) {
+        frame->timed = false;
+        if (clock_gettime(CLOCK_MONOTONIC, &now_ts) != 0) {
+            return TLOG_GRC_ERRNO;
+        }
+        tlog_timespec_sub(&now_ts, &frame->due_ts, &now_ts);
+        hist_add(&frame->late, &now_ts);
+    }
+
+    while (off < frame->len) {
+        rc = write(STDOUT_FILENO, frame->buf + off, frame->len - off);
+        if (rc < 0) {
+            return TLOG_GRC_ERRNO;
+        }
+        off += (size_t)rc;
+        frame->writes++;
+    }
+    frame->len = 0;
+    return TLOG_RC_OK;
+}
+
+/**
+ * Export a recording from a log source to stdout, as fast as it's read,
+ * ignoring the timing.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param frame     The frame to buffer the output in.
+ * @param source    The source to read the recording from.
+ * @param text      True to write the text of the screen at the end of the
+ *                  recording, or at a position, false to write the output
+ *                  starting from the position.
+ * @param pos       Time position to start writing the output from, or to
+ *                  stop applying the output to the screen at, if not zero,
+ *                  and no end position is specified.
+ * @param end       Time position to stop at, or NULL for none.
+ *
+ * @return Global return code, TLOG_GRC_FROM(errno, EINTR), if interrupted
+ *         by a signal.
+ */
+static tlog_grc
+export_source(struct tlog_errs **perrs, struct frame *frame,
+              struct tlog_source *source, bool text,
+              const struct timespec *pos, const struct timespec *end)
+{
+    tlog_grc grc;
+    struct tlog_screen *screen = NULL;
+    struct tlog_pkt pkt = TLOG_PKT_VOID;
+    size_t loc_num;
+    char *loc_str = NULL;
+    char *buf = NULL;
+    size_t len;
+
+    if (text) {
+        grc = tlog_screen_create(&screen, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating the screen");
+            goto cleanup;
+        }
+    }
+
+    while (true) {
+        if (exit_signum != 0) {
+            grc = TLOG_GRC_FROM(errno, EINTR);
+            goto cleanup;
+        }
+        tlog_pkt_cleanup(&pkt);
+        loc_num = tlog_source_loc_get(source);
+        grc = tlog_source_read(source, &pkt);
+        if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+            goto cleanup;
+        } else if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            loc_str = tlog_source_loc_fmt(source, loc_num);
+            tlog_errs_pushf(perrs, "Failed reading the source at %s",
+                            loc_str);
+            goto cleanup;
+        }
+        if (tlog_pkt_is_void(&pkt)) {
+            break;
+        }
+        /* Stop past the end position, if any */
+        if (end != NULL && tlog_timespec_cmp(&pkt.timestamp, end) > 0) {
+            break;
+        }
+
+        if (screen != NULL) {
+            /* Stop at the position, if any, and there's no end position */
+            if (end == NULL && !tlog_timespec_is_zero(pos) &&
+                tlog_timespec_cmp(&pkt.timestamp, pos) >= 0) {
+                break;
+            }
+            if (pkt.type == TLOG_PKT_TYPE_WINDOW &&
+                pkt.data.window.width > 0 && pkt.data.window.height > 0) {
+                grc = tlog_screen_resize(screen, pkt.data.window.width,
+                                         pkt.data.window.height);
+                if (grc != TLOG_RC_OK) {
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed resizing the screen");
+                    goto cleanup;
+                }
+            } else if (pkt.type == TLOG_PKT_TYPE_IO && pkt.data.io.output) {
+                tlog_screen_write(screen, pkt.data.io.buf, pkt.data.io.len);
+            }
+        } else if (pkt.type == TLOG_PKT_TYPE_IO && pkt.data.io.output &&
+                   tlog_timespec_cmp(&pkt.timestamp, pos) >= 0) {
+            frame->pkts++;
+            grc = frame_add(frame, pkt.data.io.buf, pkt.data.io.len);
+            if (grc == TLOG_RC_OK && frame->len >= EXPORT_SIZE_MAX) {
+                grc = frame_flush(frame);
+            }
+            if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+                goto cleanup;
+            } else if (grc != TLOG_RC_OK) {
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushs(perrs, "Failed writing output");
+                goto cleanup;
+            }
+        }
+    }
 
-        /* Create the reader */
-        grc = tlog_es_json_reader_create(&reader, baseurl, query, 10);
+    /* Add the screen text, if requested */
+    if (screen != NULL) {
+        grc = tlog_screen_text(screen, &buf, &len);
+        if (grc == TLOG_RC_OK) {
+            grc = frame_add(frame, (const uint8_t *)buf, len);
+        }
         if (grc != TLOG_RC_OK) {
             tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushs(perrs, "Failed creating the ElasticSearch reader");
+            tlog_errs_pushs(perrs, "Failed rendering the screen text");
             goto cleanup;
         }
-    } else if (strcmp(str, "file") == 0) {
-        struct json_object *conf_file;
+    }
 
-        /* Get file reader conf container */
+    grc = TLOG_RC_OK;
+
+cleanup:
+
+    free(buf);
+    free(loc_str);
+    tlog_pkt_cleanup(&pkt);
+    tlog_screen_destroy(screen);
+    return grc;
+}
+
+/**
+ * Export recordings to stdout, as fast as they're read, ignoring the
+ * timing, either from the configured log source, or from each of the log
+ * files specified, with the "file" reader.
+ *
+ * @param perrs     Location for the error stack. Can be NULL.
+ * @param frame     The frame to buffer the output in.
+ * @param conf      Configuration JSON object.
+ * @param text      True to write the text of the screen at the end of
+ *                  each recording, or at a position, false to write the
+ *                  output starting from the position.
+ * @param pos       Time position to start writing the output from, or to
+ *                  stop applying the output to the screen at, if not zero,
+ *                  and no end position is specified.
+ * @param end       Time position to stop at, or NULL for none.
+ *
+ * @return Global return code, TLOG_GRC_FROM(errno, EINTR), if interrupted
+ *         by a signal.
+ */
+static tlog_grc
+export_logs(struct tlog_errs **perrs, struct frame *frame,
+            struct json_object *conf, bool text, const struct timespec *pos,
+            const struct timespec *end)
+{
+    tlog_grc grc;
+    struct json_object *args;
+    struct json_object *conf_file;
+    struct json_object *obj;
+    size_t num = 0;
+    size_t i;
+    const char *path;
+    struct tlog_source *source = NULL;
+    struct tlog_index *index = NULL;
+    char *header = NULL;
+    int len;
+
+    /* Read the specified log files with the "file" reader, if any */
+    if (json_object_object_get_ex(conf, "args", &args)) {
+        num = (size_t)json_object_array_length(args);
+    }
+    if (num > 0) {
         if (!json_object_object_get_ex(conf, "file", &conf_file)) {
             tlog_errs_pushs(perrs,
                             "File reader parameters are not specified");
             grc = TLOG_RC_FAILURE;
             goto cleanup;
         }
-
-        /* Get the file path */
-        if (!json_object_object_get_ex(conf_file, "path", &obj)) {
-            tlog_errs_pushs(perrs, "Log file path is not specified");
+        /* An index describes a single file */
+        if (num > 1 && json_object_object_get_ex(conf_file, "index", &obj)) {
+            tlog_errs_pushs(perrs,
+                            "A log file index can't be used "
+                            "with multiple log files");
             grc = TLOG_RC_FAILURE;
             goto cleanup;
         }
-        str = json_object_get_string(obj);
-
-        /* Open the file */
-        fd = open(str, O_RDONLY);
-        if (fd < 0) {
+        obj = json_object_new_string("file");
+        if (obj == NULL) {
             grc = TLOG_GRC_ERRNO;
             tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushf(perrs, "Failed opening log file \"%s\"", str);
+            tlog_errs_pushs(perrs, "Failed setting the reader type");
             goto cleanup;
         }
+        json_object_object_add(conf, "reader", obj);
+    }
 
-        /* Create the reader, letting it take over the FD */
-        grc = tlog_fd_json_reader_create(&reader, fd, true, 65536);
+    /* Export each log file, or the configured source once */
+    i = 0;
+    do {
+        if (num > 0) {
+            path = json_object_get_string(json_object_array_get_idx(args,
+                                                                    (int)i));
+            obj = json_object_new_string(path);
+            if (obj == NULL) {
+                grc = TLOG_GRC_ERRNO;
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushs(perrs, "Failed setting the log file path");
+                goto cleanup;
+            }
+            json_object_object_add(conf_file, "path", obj);
+            /* Separate the files, if there are more than one */
+            if (num > 1) {
+                len = asprintf(&header, "%s==> %s <==\n",
+                               (i > 0 ? "\n" : ""), path);
+                if (len < 0) {
+                    header = NULL;
+                    grc = TLOG_GRC_ERRNO;
+                } else {
+                    grc = frame_add(frame, (const uint8_t *)header,
+                                    (size_t)len);
+                }
+                free(header);
+                header = NULL;
+                if (grc != TLOG_RC_OK) {
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed adding the file header");
+                    goto cleanup;
+                }
+            }
+        }
+
+        /* Read the screen text from the start */
+        grc = create_log_source(perrs, &source, &index, conf,
+                                (text ? &tlog_timespec_zero : pos), end);
         if (grc != TLOG_RC_OK) {
-            tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushs(perrs, "Failed creating file reader");
+            tlog_errs_pushs(perrs, "Failed creating log source");
             goto cleanup;
         }
-        fd = -1;
-    } else {
-        tlog_errs_pushf(perrs, "Unknown reader type: %s", str);
-        grc = TLOG_RC_FAILURE;
-        goto cleanup;
-    }
+        grc = export_source(perrs, frame, source, text, pos, end);
+        if (grc != TLOG_RC_OK) {
+            goto cleanup;
+        }
+        tlog_source_destroy(source);
+        source = NULL;
+        tlog_index_destroy(index);
+        index = NULL;
+    } while (++i < num);
 
-    /* Create the source */
-    grc = tlog_json_source_create(&source, reader, true,
-                                  NULL, NULL, NULL, 0, 4096);
-    if (grc != TLOG_RC_OK) {
+    /* Write out the rest */
+    grc = frame_flush(frame);
+    if (grc != TLOG_RC_OK && grc != TLOG_GRC_FROM(errno, EINTR)) {
         tlog_errs_pushc(perrs, grc);
-        tlog_errs_pushs(perrs, "Failed creating the source");
-        goto cleanup;
+        tlog_errs_pushs(perrs, "Failed writing output");
     }
-    reader = NULL;
-
-    *psource = source;
-    source = NULL;
-    grc = TLOG_RC_OK;
 
 cleanup:
 
-    if (fd >= 0) {
-        close(fd);
-    }
-    tlog_json_reader_destroy(reader);
     tlog_source_destroy(source);
+    tlog_index_destroy(index);
     return grc;
 }
 
@@ -203,12 +1103,31 @@ run(struct tlog_errs **perrs,
     const int exit_sig[] = {SIGINT, SIGTERM, SIGHUP};
     tlog_grc grc;
     struct json_object *obj;
+    const char *export = NULL;
     bool follow;
+    bool stats = false;
+    struct tlog_tail tail = {.fd = -1};
+    struct frame frame = {.len = 0};
+    struct timespec goto_ts;
+    struct timespec end_buf;
+    const struct timespec *end_ts = NULL;
+    struct timespec seek_ts;
+    struct timespec keyframe_ts;
+    struct timespec skip_ts = TLOG_TIMESPEC_ZERO;
+    bool paint;
+    struct keyframes keyframes = {.num = 0};
+    struct tlog_screen *screen = NULL;
+    uint64_t ms;
+    size_t k;
     struct timespec local_last_ts;
     struct timespec local_this_ts;
-    struct timespec local_next_ts;
+    struct timespec read_ts;
+    struct hist read_hist = {.num = 0};
+    struct ctl ctl;
+    char *end;
     struct timespec pkt_last_ts;
     struct timespec pkt_delay_ts;
+    struct timespec early_ts;
     ssize_t rc;
     size_t i;
     size_t j;
@@ -217,18 +1136,27 @@ run(struct tlog_errs **perrs,
     struct termios raw_termios;
     struct sigaction sa;
     struct tlog_source *source = NULL;
+    struct tlog_index *index = NULL;
     bool got_pkt = false;
+    bool pkt_again = false;
     struct tlog_pkt pkt = TLOG_PKT_VOID;
     size_t loc_num;
     char *loc_str = NULL;
 
     assert(cmd_help != NULL);
 
-    /* Check if arguments are provided */
-    if (json_object_object_get_ex(conf, "args", &obj) &&
+    /* Get the export mode, if exporting */
+    if (json_object_object_get_ex(conf, "export", &obj)) {
+        export = json_object_get_string(obj);
+    }
+
+    /* Check if arguments are provided, unless exporting log files */
+    if (export == NULL &&
+        json_object_object_get_ex(conf, "args", &obj) &&
         json_object_array_length(obj) > 0) {
         tlog_errs_pushf(perrs,
-                        "Positional arguments are not accepted\n%s",
+                        "Positional arguments are only accepted "
+                        "when exporting\n%s",
                         cmd_help);
         grc = TLOG_RC_FAILURE;
         goto cleanup;
@@ -246,15 +1174,119 @@ run(struct tlog_errs **perrs,
     /* Check for the version flag */
     if (json_object_object_get_ex(conf, "version", &obj)) {
         if (json_object_get_boolean(obj)) {
-            printf("%s", tlog_version);;
+            printf("%s", tlog_version);
             grc = TLOG_RC_OK;
             goto cleanup;
         }
     }
 
+    /* Get the position to start playing back from */
+    if (json_object_object_get_ex(conf, "goto", &obj)) {
+        if (!tlog_timespec_parse(json_object_get_string(obj), &goto_ts)) {
+            tlog_errs_pushf(perrs, "Invalid time position: %s",
+                            json_object_get_string(obj));
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+    } else {
+        goto_ts = TLOG_TIMESPEC_ZERO;
+    }
+
+    /* Get the position to stop playing back at, if any */
+    if (json_object_object_get_ex(conf, "end", &obj)) {
+        if (!tlog_timespec_parse(json_object_get_string(obj), &end_buf)) {
+            tlog_errs_pushf(perrs, "Invalid end time position: %s",
+                            json_object_get_string(obj));
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        if (tlog_timespec_cmp(&end_buf, &goto_ts) < 0) {
+            tlog_errs_pushs(perrs,
+                            "End time position is before the goto position");
+            grc = TLOG_RC_FAILURE;
+            goto cleanup;
+        }
+        end_ts = &end_buf;
+    }
+
+    /* Get the speed multiplier and the maximum delay */
+    memset(&ctl, 0, sizeof(ctl));
+    if (!json_object_object_get_ex(conf, "speed", &obj)) {
+        tlog_errs_pushs(perrs, "Speed is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    ctl.speed = strtod(json_object_get_string(obj), &end);
+    if (*json_object_get_string(obj) == '\0' || *end != '\0' ||
+        !(ctl.speed > 0) || ctl.speed > 1e9) {
+        tlog_errs_pushf(perrs, "Invalid speed: %s",
+                        json_object_get_string(obj));
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    ctl.speed_orig = ctl.speed;
+    if (json_object_object_get_ex(conf, "maxdelay", &obj) &&
+        !tlog_timespec_parse(json_object_get_string(obj), &ctl.maxdelay)) {
+        tlog_errs_pushf(perrs, "Invalid maximum delay: %s",
+                        json_object_get_string(obj));
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    if (!json_object_object_get_ex(conf, "frame", &obj)) {
+        tlog_errs_pushs(perrs, "Frame interval is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    if (!tlog_timespec_parse(json_object_get_string(obj), &frame.interval)) {
+        tlog_errs_pushf(perrs, "Invalid frame interval: %s",
+                        json_object_get_string(obj));
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    /* Get the keyframe interval, and start keeping the screen, if any */
+    if (!json_object_object_get_ex(conf, "keyframe", &obj)) {
+        tlog_errs_pushs(perrs, "Keyframe interval is not specified");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    if (!tlog_timespec_parse(json_object_get_string(obj), &keyframe_ts) ||
+        (!tlog_timespec_is_zero(&keyframe_ts) &&
+         timespec_to_ms(&keyframe_ts) == 0)) {
+        tlog_errs_pushf(perrs, "Invalid keyframe interval: %s",
+                        json_object_get_string(obj));
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+    keyframes.interval = timespec_to_ms(&keyframe_ts);
+    keyframes.base = timespec_to_ms(&goto_ts);
+    if (keyframes.interval != 0) {
+        grc = tlog_screen_create(&screen, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed creating the screen");
+            goto cleanup;
+        }
+    }
+    ctl.seekable = screen != NULL;
+    /* Paint the screen at the position to start from, if kept */
+    seek_ts = goto_ts;
+    paint = screen != NULL && !tlog_timespec_is_zero(&goto_ts);
+
+    /* Read the control keys from the terminal, if any */
+    ctl.fd = isatty(STDIN_FILENO) ? STDIN_FILENO : -1;
+
     /* Get the "follow" flag */
     follow = json_object_object_get_ex(conf, "follow", &obj) &&
              json_object_get_boolean(obj);
+    if (follow && export != NULL) {
+        tlog_errs_pushs(perrs, "Following is not supported when exporting");
+        grc = TLOG_RC_FAILURE;
+        goto cleanup;
+    }
+
+    /* Get the "stats" flag */
+    stats = json_object_object_get_ex(conf, "stats", &obj) &&
+            json_object_get_boolean(obj);
 
     /* Initialize libcurl */
     grc = TLOG_GRC_FROM(curl, curl_global_init(CURL_GLOBAL_NOTHING));
@@ -264,22 +1296,6 @@ run(struct tlog_errs **perrs,
         goto cleanup;
     }
 
-    /* Create log source */
-    grc = create_log_source(perrs, &source, conf);
-    if (grc != TLOG_RC_OK) {
-        tlog_errs_pushs(perrs, "Failed creating log source");
-        goto cleanup;
-    }
-
-    /* Get terminal attributes */
-    rc = tcgetattr(STDOUT_FILENO, &orig_termios);
-    if (rc < 0) {
-        grc = TLOG_GRC_ERRNO;
-        tlog_errs_pushc(perrs, grc);
-        tlog_errs_pushs(perrs, "Failed retrieving TTY attributes");
-        goto cleanup;
-    }
-
     /* Setup signal handlers to terminate gracefully */
     for (i = 0; i < TLOG_ARRAY_SIZE(exit_sig); i++) {
         sigaction(exit_sig[i], NULL, &sa);
@@ -295,6 +1311,38 @@ run(struct tlog_errs **perrs,
         }
     }
 
+    /* Export the recordings without timing, if requested */
+    if (export != NULL) {
+        grc = export_logs(perrs, &frame, conf,
+                          strcmp(export, "screen") == 0, &goto_ts, end_ts);
+        if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+            grc = TLOG_RC_OK;
+        }
+        goto cleanup;
+    }
+
+    /*
+     * Create log source, from the position to start from, keeping the
+     * screen and the keyframes from there, if at all
+     */
+    grc = create_log_source(perrs, &source, &index, conf, &goto_ts, end_ts);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed creating log source");
+        goto cleanup;
+    }
+    if (follow) {
+        tlog_tail_init(&tail, get_tail_path(conf));
+    }
+
+    /* Get terminal attributes */
+    rc = tcgetattr(STDOUT_FILENO, &orig_termios);
+    if (rc < 0) {
+        grc = TLOG_GRC_ERRNO;
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed retrieving TTY attributes");
+        goto cleanup;
+    }
+
     /* Switch the terminal to raw mode, but keep signal generation */
     raw_termios = orig_termios;
     raw_termios.c_lflag &= ~(ICANON | IEXTEN | ECHO);
@@ -316,34 +1364,143 @@ run(struct tlog_errs **perrs,
      * Reproduce the logged output
      */
     while (exit_signum == 0) {
-        /* Read a packet */
-        tlog_pkt_cleanup(&pkt);
-        loc_num = tlog_source_loc_get(source);
-        grc = tlog_source_read(source, &pkt);
-        if (grc == TLOG_GRC_FROM(errno, EINTR)) {
-            break;
-        } else if (grc != TLOG_RC_OK) {
-            tlog_errs_pushc(perrs, grc);
-            loc_str = tlog_source_loc_fmt(source, loc_num);
-            tlog_errs_pushf(perrs, "Failed reading the source at %s", loc_str);
-            goto cleanup;
+        /* Read a packet, unless handling the last one again */
+        if (pkt_again) {
+            pkt_again = false;
+        } else {
+            tlog_pkt_cleanup(&pkt);
+            loc_num = tlog_source_loc_get(source);
+            if (stats && clock_gettime(CLOCK_MONOTONIC, &read_ts) != 0) {
+                grc = TLOG_GRC_ERRNO;
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushs(perrs, "Failed retrieving current time");
+                goto cleanup;
+            }
+            grc = tlog_source_read(source, &pkt);
+            /* Measure the time spent reading, if requested */
+            if (stats && grc == TLOG_RC_OK) {
+                if (clock_gettime(CLOCK_MONOTONIC, &local_this_ts) != 0) {
+                    grc = TLOG_GRC_ERRNO;
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed retrieving current time");
+                    goto cleanup;
+                }
+                tlog_timespec_sub(&local_this_ts, &read_ts, &read_ts);
+                hist_add(&read_hist, &read_ts);
+            }
+            if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+                break;
+            } else if (grc != TLOG_RC_OK) {
+                tlog_errs_pushc(perrs, grc);
+                loc_str = tlog_source_loc_fmt(source, loc_num);
+                tlog_errs_pushf(perrs, "Failed reading the source at %s",
+                                loc_str);
+                goto cleanup;
+            }
+            /* Finish past the end position, if any, even if following */
+            if (end_ts != NULL && !tlog_pkt_is_void(&pkt) &&
+                tlog_timespec_cmp(&pkt.timestamp, end_ts) > 0) {
+                tlog_pkt_cleanup(&pkt);
+                follow = false;
+            }
         }
         /* If hit the end of stream */
         if (tlog_pkt_is_void(&pkt)) {
-            if (follow) {
-                if (sleep(POLL_PERIOD) != 0) {
-                    break;
+            /* Paint the screen, if the position sought to isn't reached */
+            if (paint) {
+                paint = false;
+                grc = frame_add_screen(&frame, screen);
+                if (grc != TLOG_RC_OK) {
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed rendering the screen");
+                    goto cleanup;
                 }
-                continue;
-            } else {
+            }
+            /* Output the last frame, before waiting or exiting */
+            grc = frame_flush(&frame);
+            if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+                break;
+            } else if (grc != TLOG_RC_OK) {
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushs(perrs, "Failed writing output");
+                goto cleanup;
+            }
+            if (!follow) {
                 break;
             }
+            /* Wait, unless the rotated file was read out */
+            if (!tail.rotated) {
+                grc = tlog_tail_wait(&tail);
+                if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+                    break;
+                } else if (grc != TLOG_RC_OK) {
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed waiting for new messages");
+                    goto cleanup;
+                }
+                /* Read new messages, or the rest of a rotated file */
+                if (!tail.truncated) {
+                    continue;
+                }
+            }
+            /* Start over with the new, or the truncated file */
+            tlog_source_destroy(source);
+            source = NULL;
+            tlog_index_destroy(index);
+            index = NULL;
+            /* The index described the previous file contents */
+            if (json_object_object_get_ex(conf, "file", &obj)) {
+                json_object_object_del(obj, "index");
+            }
+            grc = create_log_source(perrs, &source, &index, conf,
+                                    &goto_ts, end_ts);
+            if (grc != TLOG_RC_OK) {
+                tlog_errs_pushs(perrs, "Failed reopening log source");
+                goto cleanup;
+            }
+            tlog_tail_cleanup(&tail);
+            tlog_tail_init(&tail, get_tail_path(conf));
+            continue;
+        }
+        tlog_tail_reset(&tail);
+
+        /* Skip the packets covered by the keyframe resumed from */
+        if (tlog_timespec_cmp(&pkt.timestamp, &skip_ts) < 0) {
+            continue;
+        }
+
+        /* Snapshot the screen, if kept, and resize it */
+        if (screen != NULL) {
+            grc = keyframes_add(&keyframes, screen, &pkt.timestamp);
+            if (grc != TLOG_RC_OK) {
+                tlog_errs_pushc(perrs, grc);
+                tlog_errs_pushs(perrs, "Failed storing a keyframe");
+                goto cleanup;
+            }
+            if (pkt.type == TLOG_PKT_TYPE_WINDOW &&
+                pkt.data.window.width > 0 && pkt.data.window.height > 0) {
+                grc = tlog_screen_resize(screen, pkt.data.window.width,
+                                         pkt.data.window.height);
+                if (grc != TLOG_RC_OK) {
+                    tlog_errs_pushc(perrs, grc);
+                    tlog_errs_pushs(perrs, "Failed resizing the screen");
+                    goto cleanup;
+                }
+            }
         }
+
         /* If it's not the output */
         if (pkt.type != TLOG_PKT_TYPE_IO || !pkt.data.io.output) {
             continue;
         }
 
+        /* Apply the output before the position sought to, to the screen */
+        if (screen != NULL &&
+            tlog_timespec_cmp(&pkt.timestamp, &seek_ts) < 0) {
+            tlog_screen_write(screen, pkt.data.io.buf, pkt.data.io.len);
+            continue;
+        }
+
         /* Get current time */
         if (clock_gettime(CLOCK_MONOTONIC, &local_this_ts) != 0) {
             grc = TLOG_GRC_ERRNO;
@@ -352,47 +1509,121 @@ run(struct tlog_errs **perrs,
             goto cleanup;
         }
 
-        /* If this is the first packet */
-        if (!got_pkt) {
-            got_pkt = true;
-            /* Start the time */
-            local_last_ts = local_this_ts;
-        } else {
-            tlog_timespec_sub(&pkt.timestamp, &pkt_last_ts, &pkt_delay_ts);
-            tlog_timespec_add(&local_last_ts, &pkt_delay_ts, &local_next_ts);
-            /* If we don't need a delay for the next packet (it's overdue) */
-            if (tlog_timespec_cmp(&local_next_ts, &local_this_ts) <= 0) {
-                /* Stretch the time */
+        /* Time the packets from the position to start from, if any */
+        if (tlog_timespec_cmp(&pkt.timestamp, &seek_ts) >= 0) {
+            /* If this is the first packet played back */
+            if (!got_pkt) {
+                got_pkt = true;
+                /* Start the time, from the position sought to, if any */
                 local_last_ts = local_this_ts;
+                pkt_last_ts = tlog_timespec_is_zero(&seek_ts)
+                                ? pkt.timestamp : seek_ts;
+                /* Paint the screen at the position */
+                if (paint) {
+                    paint = false;
+                    grc = frame_add_screen(&frame, screen);
+                    if (grc != TLOG_RC_OK) {
+                        tlog_errs_pushc(perrs, grc);
+                        tlog_errs_pushs(perrs, "Failed rendering the screen");
+                        goto cleanup;
+                    }
+                }
+            }
+            tlog_timespec_sub(&pkt.timestamp, &pkt_last_ts, &pkt_delay_ts);
+            tlog_timespec_fp_mul(&pkt_delay_ts, 1 / ctl.speed, &early_ts);
+            /* Merge the packet into the frame, if it's due within it */
+            if (frame.len > 0 &&
+                tlog_timespec_cmp(&early_ts, &frame.interval) < 0) {
+                frame.merged++;
+                if (tlog_timespec_cmp(&early_ts, &frame.early_max) > 0) {
+                    frame.early_max = early_ts;
+                }
+                tlog_timespec_add(&frame.early_sum, &early_ts,
+                                  &frame.early_sum);
             } else {
-                rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
-                                     &local_next_ts, NULL);
-                if (rc == EINTR) {
+                /* Output the frame and wait for the packet to start next */
+                grc = frame_flush(&frame);
+                if (grc == TLOG_RC_OK) {
+                    grc = ctl_wait(&ctl, &local_last_ts, &pkt_delay_ts);
+                }
+                if (grc == TLOG_GRC_FROM(errno, EINTR)) {
                     break;
-                } else if (rc != 0) {
-                    grc = TLOG_GRC_ERRNO;
+                } else if (grc != TLOG_RC_OK) {
                     tlog_errs_pushc(perrs, grc);
-                    tlog_errs_pushs(perrs, "Failed sleeping");
+                    tlog_errs_pushs(perrs,
+                                    "Failed outputting the frame and "
+                                    "waiting for the next packet");
                     goto cleanup;
                 }
-                local_last_ts = local_next_ts;
+                /* Jump to the requested keyframe, if any */
+                if (ctl.jump != 0) {
+                    ms = TLOG_MAX(timespec_to_ms(&pkt_last_ts),
+                                  keyframes.base) - keyframes.base;
+                    k = ms / keyframes.interval;
+                    if (ctl.jump > 0) {
+                        /* Apply the output up to the next one */
+                        ms = keyframes.base + (k + 1) * keyframes.interval;
+                        seek_ts.tv_sec = ms / 1000;
+                        seek_ts.tv_nsec = ms % 1000 * 1000000;
+                        pkt_again = true;
+                    } else {
+                        /* Resume from the previous one */
+                        if (k > 0 &&
+                            ms - k * keyframes.interval < JUMP_BACK_MARGIN) {
+                            k--;
+                        }
+                        k = TLOG_MIN(k, keyframes.num - 1);
+                        tlog_screen_destroy(screen);
+                        grc = tlog_screen_copy(&screen,
+                                               keyframes.list[k].screen);
+                        if (grc != TLOG_RC_OK) {
+                            tlog_errs_pushc(perrs, grc);
+                            tlog_errs_pushs(perrs,
+                                            "Failed restoring the keyframe");
+                            goto cleanup;
+                        }
+                        seek_ts = skip_ts = keyframes.list[k].ts;
+                        tlog_source_destroy(source);
+                        source = NULL;
+                        tlog_index_destroy(index);
+                        index = NULL;
+                        grc = create_log_source(perrs, &source, &index,
+                                                conf, &seek_ts, end_ts);
+                        if (grc != TLOG_RC_OK) {
+                            tlog_errs_pushs(perrs,
+                                            "Failed reopening log source");
+                            goto cleanup;
+                        }
+                    }
+                    ctl.jump = 0;
+                    got_pkt = false;
+                    paint = true;
+                    continue;
+                }
+                pkt_last_ts = pkt.timestamp;
+                frame.timed = true;
+                frame.due_ts = ctl.due_ts;
             }
         }
 
         /* Output the packet */
-        if (write(STDOUT_FILENO, pkt.data.io.buf, pkt.data.io.len) !=
-                (ssize_t)pkt.data.io.len) {
-            if (errno == EINTR) {
-                break;
-            } else if (rc != 0) {
-                grc = TLOG_GRC_ERRNO;
-                tlog_errs_pushc(perrs, grc);
-                tlog_errs_pushs(perrs, "Failed writing output");
-                goto cleanup;
-            }
+        if (screen != NULL) {
+            tlog_screen_write(screen, pkt.data.io.buf, pkt.data.io.len);
+        }
+        frame.pkts++;
+        grc = frame_add(&frame, pkt.data.io.buf, pkt.data.io.len);
+        if (grc == TLOG_RC_OK &&
+            (tlog_timespec_is_zero(&frame.interval) ||
+             frame.len >= FRAME_SIZE_MAX)) {
+            grc = frame_flush(&frame);
+        }
+        if (grc == TLOG_GRC_FROM(errno, EINTR)) {
+            break;
+        } else if (grc != TLOG_RC_OK) {
+            tlog_errs_pushc(perrs, grc);
+            tlog_errs_pushs(perrs, "Failed writing output");
+            goto cleanup;
         }
-
-        pkt_last_ts = pkt.timestamp;
     }
 
     grc = TLOG_RC_OK;
@@ -401,7 +1632,11 @@ cleanup:
 
     free(loc_str);
     tlog_pkt_cleanup(&pkt);
+    keyframes_cleanup(&keyframes);
+    tlog_screen_destroy(screen);
+    tlog_tail_cleanup(&tail);
     tlog_source_destroy(source);
+    tlog_index_destroy(index);
     curl_global_cleanup();
 
     /* Restore signal handlers */
@@ -432,6 +1667,44 @@ cleanup:
         }
     }
 
+    /* Output the statistics, if requested */
+    if (stats && frame.pkts > 0) {
+        fprintf(stderr,
+                "Packets output:      %zu\n"
+                "Writes:              %zu (%zu saved)\n",
+                frame.pkts, frame.writes,
+                (frame.pkts > frame.writes ? frame.pkts - frame.writes : 0));
+    }
+    if (stats && frame.pkts > 0 && export == NULL) {
+        fprintf(stderr,
+                "Delays merged:       %zu\n"
+                "Output early by:     %.3f ms max, %.3f ms mean\n",
+                frame.merged,
+                frame.early_max.tv_sec * 1000.0 +
+                    frame.early_max.tv_nsec / 1000000.0,
+                (frame.early_sum.tv_sec * 1000.0 +
+                    frame.early_sum.tv_nsec / 1000000.0) / frame.pkts);
+        if (frame.late.num > 0) {
+            fprintf(stderr,
+                    "Output late by:      %.3f ms median, "
+                    "%.3f ms 90th, %.3f ms 99th percentile, %.3f ms max\n",
+                    hist_get(&frame.late, 50), hist_get(&frame.late, 90),
+                    hist_get(&frame.late, 99), frame.late.max / 1000.0);
+        }
+        fprintf(stderr,
+                "Time stretched by:   %.3f ms\n",
+                ctl.stretch_ts.tv_sec * 1000.0 +
+                    ctl.stretch_ts.tv_nsec / 1000000.0);
+        if (read_hist.num > 0) {
+            fprintf(stderr,
+                    "Reading took:        %.3f ms median, "
+                    "%.3f ms 99th percentile, %.3f ms max, %.3f ms total\n",
+                    hist_get(&read_hist, 50), hist_get(&read_hist, 99),
+                    read_hist.max / 1000.0, read_hist.sum / 1000.0);
+        }
+    }
+    free(frame.buf);
+
     return grc;
 }
 
@@ -42,16 +42,13 @@
 #include <poll.h>
 #include <libgen.h>
 #include <stdio.h>
-#include <syslog.h>
 #include <time.h>
 #include <locale.h>
 #include <langinfo.h>
-#include <tlog/syslog_json_writer.h>
-#include <tlog/fd_json_writer.h>
+#include <curl/curl.h>
 #include <tlog/tty_source.h>
 #include <tlog/json_sink.h>
 #include <tlog/tty_sink.h>
-#include <tlog/syslog_misc.h>
 #include <tlog/timespec.h>
 #include <tlog/delay.h>
 #include <tlog/rc.h>
@@ -392,8 +389,6 @@ create_log_sink(struct tlog_errs **perrs,
     struct json_object *obj;
     struct tlog_sink *sink = NULL;
     struct tlog_json_writer *writer = NULL;
-    int fd = -1;
-    int rc;
     char *fqdn = NULL;
     struct passwd *passwd;
     const char *term;
@@ -407,108 +402,16 @@ create_log_sink(struct tlog_errs **perrs,
         goto cleanup;
     }
     str = json_object_get_string(obj);
-    if (strcmp(str, "file") == 0) {
-        struct json_object *conf_file;
-
-        /* Get file writer conf container */
-        if (!json_object_object_get_ex(conf, "file", &conf_file)) {
-            tlog_errs_pushs(perrs, "File writer parameters are not specified");
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
-
-        /* Get the file path */
-        if (!json_object_object_get_ex(conf_file, "path", &obj)) {
-            tlog_errs_pushs(perrs, "Log file path is not specified");
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
-        str = json_object_get_string(obj);
-
-        /* Open the file */
-        fd = open(str, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
-        if (fd < 0) {
-            grc = TLOG_GRC_ERRNO;
-            tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushf(perrs, "Failed opening log file \"%s\"", str);
-            goto cleanup;
-        }
-        /* Get file flags */
-        rc = fcntl(fd, F_GETFD);
-        if (rc < 0) {
-            grc = TLOG_GRC_ERRNO;
-            tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushf(perrs, "Failed getting log file descriptor flags");
-            goto cleanup;
-        }
-        /* Add FD_CLOEXEC to file flags */
-        rc = fcntl(fd, F_SETFD, rc | FD_CLOEXEC);
-        if (rc < 0) {
-            grc = TLOG_GRC_ERRNO;
-            tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushf(perrs, "Failed setting log file descriptor flags");
-            goto cleanup;
-        }
-
-        /* Create the writer, letting it take over the FD */
-        grc = tlog_fd_json_writer_create(&writer, fd, true);
-        if (grc != TLOG_RC_OK) {
-            tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushs(perrs, "Failed creating file writer");
-            goto cleanup;
-        }
-        fd = -1;
-    } else if (strcmp(str, "syslog") == 0) {
-        struct json_object *conf_syslog;
-        int facility;
-        int priority;
-
-        /* Get syslog writer conf container */
-        if (!json_object_object_get_ex(conf, "syslog", &conf_syslog)) {
-            tlog_errs_pushs(perrs, "Syslog writer parameters are not specified");
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
-
-        /* Get facility */
-        if (!json_object_object_get_ex(conf_syslog, "facility", &obj)) {
-            tlog_errs_pushs(perrs, "Syslog facility is not specified");
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
-        str = json_object_get_string(obj);
-        facility = tlog_syslog_facility_from_str(str);
-        if (facility < 0) {
-            tlog_errs_pushf(perrs, "Unknown syslog facility: %s", str);
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
-
-        /* Get priority */
-        if (!json_object_object_get_ex(conf_syslog, "priority", &obj)) {
-            tlog_errs_pushs(perrs, "Syslog priority is not specified");
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
-        str = json_object_get_string(obj);
-        priority = tlog_syslog_priority_from_str(str);
-        if (priority < 0) {
-            tlog_errs_pushf(perrs, "Unknown syslog priority: %s", str);
-            grc = TLOG_RC_FAILURE;
-            goto cleanup;
-        }
+    grc = tlog_rec_conf_get_writer(perrs, conf, str, &writer);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed creating log writer");
+        goto cleanup;
+    }
 
-        /* Create the writer */
-        openlog("tlog", LOG_NDELAY, facility);
-        grc = tlog_syslog_json_writer_create(&writer, priority);
-        if (grc != TLOG_RC_OK) {
-            tlog_errs_pushc(perrs, grc);
-            tlog_errs_pushs(perrs, "Failed creating syslog writer");
-            goto cleanup;
-        }
-    } else {
-        tlog_errs_pushf(perrs, "Unknown writer type: %s", str);
-        grc = TLOG_RC_FAILURE;
+    /* Put the spool in front of it, if requested */
+    grc = tlog_rec_conf_get_spool(perrs, conf, &writer);
+    if (grc != TLOG_RC_OK) {
+        tlog_errs_pushs(perrs, "Failed creating log spool");
         goto cleanup;
     }
 
@@ -586,9 +489,6 @@ create_log_sink(struct tlog_errs **perrs,
     grc = TLOG_RC_OK;
 cleanup:
 
-    if (fd >= 0) {
-        close(fd);
-    }
     tlog_json_writer_destroy(writer);
     free(fqdn);
     tlog_sink_destroy(sink);
@@ -1367,6 +1267,7 @@ run(struct tlog_errs **perrs, uid_t euid, gid_t egid,
     int64_t num;
     unsigned int latency;
     unsigned int log_mask;
+    bool curl_initialized = false;
     struct tlog_sink *log_sink = NULL;
     struct tap tap = TAP_VOID;
 
@@ -1438,6 +1339,15 @@ run(struct tlog_errs **perrs, uid_t euid, gid_t egid,
         goto cleanup;
     }
 
+    /* Initialize libcurl */
+    grc = TLOG_GRC_FROM(curl, curl_global_init(CURL_GLOBAL_NOTHING));
+    if (grc != TLOG_GRC_FROM(curl, CURLE_OK)) {
+        tlog_errs_pushc(perrs, grc);
+        tlog_errs_pushs(perrs, "Failed initializing libcurl");
+        goto cleanup;
+    }
+    curl_initialized = true;
+
     /* Create the log sink */
     grc = create_log_sink(perrs, &log_sink, conf, session_id);
     if (grc != TLOG_RC_OK) {
@@ -1474,6 +1384,9 @@ cleanup:
 
     tap_teardown(perrs, &tap, (grc == TLOG_RC_OK ? pstatus : NULL));
     tlog_sink_destroy(log_sink);
+    if (curl_initialized) {
+        curl_global_cleanup();
+    }
     if (lock_acquired) {
         session_unlock(perrs, session_id, euid, egid);
     }
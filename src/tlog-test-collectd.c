@@ -0,0 +1,299 @@
+/*
+ * Tlog-collectd test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <tlog/rc.h>
+#include <tlog/collector_json_writer.h>
+#include <tlog/misc.h>
+#include <tlog/test_misc.h>
+
+/** Path to the daemon under test */
+#define COLLECTD_PATH   "./tlog-collectd"
+
+/** Path of the collector socket to test with */
+#define SOCKET_PATH     "tlog-test-collectd.sock"
+
+/** Path of the log file to test with */
+#define LOG_PATH        "tlog-test-collectd.log"
+
+/** Path of the spool file to test with */
+#define SPOOL_PATH      "tlog-test-collectd.spool"
+
+/** A hundred bytes of a message */
+#define X100 "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx" \
+             "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+
+/** A thousand bytes of a message */
+#define X1000 X100 X100 X100 X100 X100 X100 X100 X100 X100 X100
+
+/** A valid message with specified ID and output text */
+#define MSG(_id, _out_txt) \
+    "{\"ver\":1,\"host\":\"localhost\",\"user\":\"user\","      \
+    "\"term\":\"xterm\",\"session\":1,\"id\":" #_id ",\"pos\":0,"   \
+    "\"timing\":\">1\",\"in_txt\":\"\",\"in_bin\":[],"              \
+    "\"out_txt\":\"" _out_txt "\",\"out_bin\":[]}"
+
+/** Time to wait for the daemon to start or to log, tenths of a second */
+#define WAIT_TENTHS     100
+
+struct test {
+    const char     *arg_list[8];    /**< Extra daemon arguments */
+    const char     *msg_list[8];    /**< Messages to send, one connection
+                                         each, in order */
+    bool            exp_fail;       /**< True if the daemon is expected to
+                                         refuse to start */
+    const char     *exp_log;        /**< Expected log file contents */
+};
+
+/** Sleep for a tenth of a second */
+static void
+nap(void)
+{
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000000};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Read a file into a buffer, as a zero-terminated string.
+ *
+ * @param path  Path to the file to read.
+ * @param buf   The buffer to read into.
+ * @param size  The buffer size.
+ *
+ * @return Length of the read text, zero if the file doesn't exist.
+ */
+static size_t
+read_file(const char *path, char *buf, size_t size)
+{
+    int fd;
+    ssize_t rc;
+    size_t len = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        while ((rc = read(fd, buf + len, size - 1 - len)) > 0) {
+            len += (size_t)rc;
+        }
+        close(fd);
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    const char *argv[16] = {COLLECTD_PATH,
+                            "--socket=" SOCKET_PATH,
+                            "--latency=1"};
+    size_t argc = 3;
+    const char * const *parg;
+    const char * const *pmsg;
+    struct tlog_json_writer *writer = NULL;
+    size_t exp_len = strlen(t.exp_log);
+    char buf[16384];
+    size_t len;
+    pid_t pid;
+    int status = 0;
+    unsigned int i;
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+    unlink(SOCKET_PATH);
+    unlink(LOG_PATH);
+    unlink(SPOOL_PATH);
+    for (parg = t.arg_list; *parg != NULL; parg++) {
+        argv[argc++] = *parg;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Failed forking: %s\n", strerror(errno));
+        exit(1);
+    } else if (pid == 0) {
+        execv(COLLECTD_PATH, (char **)argv);
+        fprintf(stderr, "Failed executing " COLLECTD_PATH ": %s\n",
+                strerror(errno));
+        _exit(127);
+    }
+
+    /* Wait for the daemon to start listening, or to exit */
+    for (i = 0; i < WAIT_TENTHS; i++) {
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            pid = -1;
+            break;
+        }
+        if (access(SOCKET_PATH, F_OK) == 0) {
+            break;
+        }
+        nap();
+    }
+
+    if (t.exp_fail) {
+        if (pid >= 0) {
+            FAIL("daemon started, but expected to fail");
+            kill(pid, SIGTERM);
+            waitpid(pid, &status, 0);
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 1) {
+            FAIL("daemon failed with unexpected status 0x%x", status);
+        }
+        goto cleanup;
+    } else if (pid < 0) {
+        FAIL("daemon exited prematurely with status 0x%x", status);
+        goto cleanup;
+    } else if (i >= WAIT_TENTHS) {
+        FAIL("daemon didn't start listening");
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        goto cleanup;
+    }
+
+    /* Send the messages */
+    for (pmsg = t.msg_list; *pmsg != NULL; pmsg++) {
+        grc = tlog_collector_json_writer_create(&writer, SOCKET_PATH);
+        if (grc != TLOG_RC_OK) {
+            FAIL("failed connecting to the daemon: %s",
+                 tlog_grc_strerror(grc));
+            break;
+        }
+        grc = tlog_json_writer_write(writer, (const uint8_t *)*pmsg,
+                                     strlen(*pmsg));
+        if (grc != TLOG_RC_OK) {
+            FAIL("failed sending message #%zd: %s",
+                 pmsg - t.msg_list + 1, tlog_grc_strerror(grc));
+        }
+        tlog_json_writer_destroy(writer);
+    }
+
+    /* Let the latency expire and the messages get logged */
+    for (i = 0; i < WAIT_TENTHS; i++) {
+        if (read_file(LOG_PATH, buf, sizeof(buf)) >= exp_len) {
+            break;
+        }
+        nap();
+    }
+
+    /* Stop the daemon */
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+    if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGTERM) {
+        FAIL("daemon terminated with unexpected status 0x%x", status);
+    }
+    if (access(SOCKET_PATH, F_OK) == 0) {
+        FAIL("daemon didn't remove its socket");
+    }
+
+    len = read_file(LOG_PATH, buf, sizeof(buf));
+    if (len != exp_len || memcmp(buf, t.exp_log, len) != 0) {
+        FAIL("log mismatch");
+        tlog_test_diff(stderr, (const uint8_t *)buf, len,
+                       (const uint8_t *)t.exp_log, exp_len);
+    }
+
+cleanup:
+    unlink(SOCKET_PATH);
+    unlink(LOG_PATH);
+    unlink(SPOOL_PATH);
+#undef FAIL
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+    TEST(nothing,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH},
+         .exp_log = "");
+
+    TEST(one,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH},
+         .msg_list = {MSG(1, "a")},
+         .exp_log = MSG(1, "a") "\n");
+
+    TEST(several,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH},
+         .msg_list = {MSG(1, "a") "\n", MSG(2, "b"), MSG(3, "c") "\n"},
+         .exp_log = MSG(1, "a") "\n" MSG(2, "b") "\n" MSG(3, "c") "\n");
+
+    TEST(invalid,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH},
+         .msg_list = {MSG(1, "a"), "{\"a\":1}", "xxx",
+                      "{\"ver\":1,\"host\":", MSG(2, "b")},
+         .exp_log = MSG(1, "a") "\n" MSG(2, "b") "\n");
+
+    TEST(small_batch,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH,
+                      "--batch=1"},
+         .msg_list = {MSG(1, "a"), MSG(2, "b")},
+         .exp_log = MSG(1, "a") "\n" MSG(2, "b") "\n");
+
+    TEST(spool_smaller_than_batch,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH,
+                      "--batch=4096",
+                      "--spool-path=" SPOOL_PATH, "--spool-size=4096"},
+         .msg_list = {MSG(1, X1000), MSG(2, X1000), MSG(3, X1000),
+                      MSG(4, X1000), MSG(5, X1000)},
+         .exp_log = MSG(1, X1000) "\n" MSG(2, X1000) "\n"
+                    MSG(3, X1000) "\n" MSG(4, X1000) "\n"
+                    MSG(5, X1000) "\n");
+
+    TEST(positional,
+         .arg_list = {"--writer=file", "--file-path=" LOG_PATH, "arg"},
+         .exp_fail = true,
+         .exp_log = "");
+
+    TEST(loop,
+         .arg_list = {"--writer=collector"},
+         .exp_fail = true,
+         .exp_log = "");
+
+    TEST(fanout_loop,
+         .arg_list = {"--writer=fanout", "--fanout-writers=file,collector",
+                      "--file-path=" LOG_PATH},
+         .exp_fail = true,
+         .exp_log = "");
+
+    fprintf(stderr, "%s\n", (passed ? "PASS" : "FAIL"));
+    return !passed;
+}
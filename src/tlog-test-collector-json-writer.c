@@ -0,0 +1,257 @@
+/*
+ * Tlog tlog_collector_json_writer test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <tlog/rc.h>
+#include <tlog/collector_json_writer.h>
+#include <tlog/misc.h>
+#include <tlog/test_misc.h>
+
+/** Path of the collector socket to test with */
+#define SOCKET_PATH "tlog-test-collector-json-writer.sock"
+
+enum op_type {
+    OP_TYPE_NONE,
+    OP_TYPE_WRITE,
+    OP_TYPE_CLOSE,
+    OP_TYPE_NUM
+};
+
+static const char*
+op_type_to_str(enum op_type t)
+{
+    switch (t) {
+    case OP_TYPE_NONE:
+        return "none";
+    case OP_TYPE_WRITE:
+        return "write";
+    case OP_TYPE_CLOSE:
+        return "close";
+    default:
+        return "<unknown>";
+    }
+}
+
+struct op {
+    enum op_type    type;
+    const char     *msg;        /**< Message to write */
+    tlog_grc        exp_grc;    /**< Expected return code */
+};
+
+struct test {
+    struct op       op_list[8];
+    const char     *exp_recv;   /**< Expected received text */
+};
+
+/**
+ * Receive text from a socket.
+ *
+ * @param fd    The socket to receive from.
+ * @param wait  True if should wait for the peer to close the socket,
+ *              false if should only receive what's already available.
+ * @param buf   The buffer to append the received text to.
+ * @param plen  Location of the buffer text length.
+ * @param size  The buffer size.
+ */
+static void
+recv_text(int fd, bool wait, char *buf, size_t *plen, size_t size)
+{
+    ssize_t rc;
+
+    while ((rc = recv(fd, buf + *plen, size - 1 - *plen,
+                      wait ? 0 : MSG_DONTWAIT)) > 0) {
+        *plen += (size_t)rc;
+    }
+    if (rc < 0 && (wait || (errno != EAGAIN && errno != EWOULDBLOCK))) {
+        fprintf(stderr, "Failed reading the socket: %s\n", strerror(errno));
+        exit(1);
+    }
+    buf[*plen] = '\0';
+}
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    struct sockaddr_un addr;
+    int listen_fd;
+    int fd;
+    struct tlog_json_writer *writer = NULL;
+    const struct op *op;
+    char buf[4096];
+    size_t len = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+    unlink(SOCKET_PATH);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, 1) < 0) {
+        fprintf(stderr, "Failed listening on the socket: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+
+    grc = tlog_collector_json_writer_create(&writer, SOCKET_PATH);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating collector writer: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        fprintf(stderr, "Failed accepting the writer: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    close(listen_fd);
+    unlink(SOCKET_PATH);
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+#define FAIL_OP(_fmt, _args...) \
+    FAIL("op #%zd (%s): " _fmt,                                 \
+         op - t.op_list + 1, op_type_to_str(op->type), ##_args)
+
+    for (op = t.op_list; op->type != OP_TYPE_NONE; op++) {
+        switch (op->type) {
+        case OP_TYPE_WRITE:
+            grc = tlog_json_writer_write(writer, (const uint8_t *)op->msg,
+                                         strlen(op->msg));
+            if (grc != op->exp_grc) {
+                const char *res_str = tlog_grc_strerror(grc);
+                const char *exp_str = tlog_grc_strerror(op->exp_grc);
+                FAIL_OP("grc: %s (%d) != %s (%d)",
+                        res_str, grc, exp_str, op->exp_grc);
+            }
+            break;
+        case OP_TYPE_CLOSE:
+            /* Receive what was sent so far and go away */
+            recv_text(fd, false, buf, &len, sizeof(buf));
+            close(fd);
+            fd = -1;
+            break;
+        default:
+            fprintf(stderr, "Unknown operation type: %d\n", op->type);
+            exit(1);
+        }
+    }
+
+    tlog_json_writer_destroy(writer);
+    if (fd >= 0) {
+        recv_text(fd, true, buf, &len, sizeof(buf));
+        close(fd);
+    }
+
+    if (strcmp(buf, t.exp_recv) != 0) {
+        FAIL("received text mismatch");
+        tlog_test_diff(stderr, (const uint8_t *)buf, len,
+                       (const uint8_t *)t.exp_recv, strlen(t.exp_recv));
+    }
+
+#undef FAIL_OP
+#undef FAIL
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+    struct tlog_json_writer *writer;
+    char long_path[sizeof(((struct sockaddr_un *)NULL)->sun_path) + 1];
+    tlog_grc grc;
+
+#define OP_WRITE(_msg, _exp_grc) \
+    {.type = OP_TYPE_WRITE, .msg = _msg, .exp_grc = _exp_grc}
+
+#define OP_CLOSE \
+    {.type = OP_TYPE_CLOSE}
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+    TEST(nothing,
+         .exp_recv = "");
+
+    TEST(terminated,
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK)},
+         .exp_recv = "{\"a\":1}\n{\"a\":2}\n");
+
+    TEST(unterminated,
+         .op_list = {OP_WRITE("{\"a\":1}", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}", TLOG_RC_OK)},
+         .exp_recv = "{\"a\":1}\n{\"a\":2}\n{\"a\":3}\n");
+
+    TEST(empty,
+         .op_list = {OP_WRITE("", TLOG_RC_OK)},
+         .exp_recv = "\n");
+
+    TEST(collector_gone,
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_CLOSE,
+                     OP_WRITE("{\"a\":2}\n", TLOG_GRC_FROM(errno, EPIPE))},
+         .exp_recv = "{\"a\":1}\n");
+
+    /* Check connecting to a missing collector fails */
+    unlink(SOCKET_PATH);
+    grc = tlog_collector_json_writer_create(&writer, SOCKET_PATH);
+    if (grc != TLOG_GRC_FROM(errno, ENOENT)) {
+        fprintf(stderr, "missing: grc: %s (%d) != %s (%d)\n",
+                tlog_grc_strerror(grc), grc,
+                tlog_grc_strerror(TLOG_GRC_FROM(errno, ENOENT)),
+                TLOG_GRC_FROM(errno, ENOENT));
+        passed = false;
+    }
+
+    /* Check a path too long for a socket is refused */
+    memset(long_path, 'x', sizeof(long_path) - 1);
+    long_path[sizeof(long_path) - 1] = '\0';
+    grc = tlog_collector_json_writer_create(&writer, long_path);
+    if (grc != TLOG_GRC_FROM(errno, ENAMETOOLONG)) {
+        fprintf(stderr, "long_path: grc: %s (%d) != %s (%d)\n",
+                tlog_grc_strerror(grc), grc,
+                tlog_grc_strerror(TLOG_GRC_FROM(errno, ENAMETOOLONG)),
+                TLOG_GRC_FROM(errno, ENAMETOOLONG));
+        passed = false;
+    }
+
+    fprintf(stderr, "%s\n", (passed ? "PASS" : "FAIL"));
+    return !passed;
+}
@@ -0,0 +1,414 @@
+/*
+ * Tlog tlog_es_json_reader test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <curl/curl.h>
+#include <tlog/rc.h>
+#include <tlog/es_json_reader.h>
+#include <tlog/test_misc.h>
+#include <tlog/test_http_server.h>
+
+/** Request line */
+#define LINE "POST /tlog/tlog/_search?filter_path=hits.hits._source HTTP/1.1"
+
+/** Request body query */
+#define BODY_QUERY \
+    "{\"query\":{\"query_string\":{\"query\":\"session:1\"}},"
+
+/** Request body query, for messages within position range _range */
+#define BODY_QUERY_RANGE(_range) \
+    "{\"query\":{\"bool\":{"                                      \
+        "\"must\":{\"query_string\":{\"query\":\"session:1\"}},"  \
+        "\"filter\":{\"range\":{\"pos\":{" _range "}}}}},"
+
+/** Request body query, for messages starting at position _pos */
+#define BODY_QUERY_POS(_pos) \
+    BODY_QUERY_RANGE("\"gte\":" #_pos)
+
+/** Request body tail, following the query, for pages of two messages */
+#define BODY_TAIL \
+    "\"sort\":[{\"id\":\"asc\"},{\"session\":\"asc\"},"               \
+              "{\"host.raw\":\"asc\"}],\"size\":2,"                 \
+    "\"_source\":[\"ver\",\"host\",\"user\",\"term\","             \
+                 "\"session\",\"id\",\"pos\",\"timing\","           \
+                 "\"in_txt\",\"in_bin\",\"out_txt\",\"out_bin\"]"
+
+/** Request body prefix, for pages of two messages */
+#define BODY_PFX BODY_QUERY BODY_TAIL
+
+/** Request body for the first page */
+#define BODY_FIRST BODY_PFX "}"
+
+/** Sort values of message _id, for requesting the messages following it */
+#define AFTER(_id) ",\"search_after\":[" #_id ",1,\"h\"]}"
+
+/** Request body for the page following message _id */
+#define BODY_AFTER(_id) BODY_PFX AFTER(_id)
+
+/** Reply listing the specified hits */
+#define REPLY(_hits...) "{\"hits\":{\"hits\":[" _hits "]}}"
+
+/** Hit of a message with the specified ID */
+#define HIT(_id) "{\"_source\":{\"host\":\"h\",\"session\":1,\"id\":" #_id "}}"
+
+/** Hit of a message with the specified ID and session ID */
+#define HIT_SESSION(_id, _session) \
+    "{\"_source\":{\"host\":\"h\",\"session\":" #_session ","           \
+    "\"id\":" #_id "}}"
+
+/** Hit of a message with the specified ID and 128 bytes of output */
+#define HIT_OUT(_id) \
+    "{\"_source\":{\"host\":\"h\",\"session\":1,\"id\":" #_id ","    \
+    "\"timing\":\">128\","                                            \
+    "\"out_txt\":\""                                                  \
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef" \
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef" \
+    "\"}}"
+
+struct op {
+    tlog_grc        exp_grc;    /**< Expected return code */
+    int             exp_id;     /**< Expected message ID, -1 for EOF,
+                                     zero terminates the list */
+    size_t          wait_req;   /**< Number of requests to wait for the
+                                     server to receive instead of reading,
+                                     zero to read */
+};
+
+struct test {
+    struct tlog_test_http_server_rsp        rsp_list[8];
+    struct op                               op_list[16];
+    const char                             *exp_body_list[8];
+    size_t                                  max_rsp_len;
+    uint64_t                                pos_min;
+    uint64_t                                pos_max;    /**< Zero for
+                                                             no limit */
+    uint64_t                                span_max;
+    unsigned int                            timeout;    /**< Zero for
+                                                             no limit */
+};
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    struct tlog_test_http_server server;
+    struct tlog_json_reader *reader = NULL;
+    struct json_object *object;
+    struct json_object *field;
+    char url[64];
+    const struct op *op;
+    int id;
+    size_t i;
+    size_t exp_req_num;
+    size_t rsp_len = 0;
+
+    if (!tlog_test_http_server_start(&server, t.rsp_list)) {
+        fprintf(stderr, "Failed starting HTTP server: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/tlog/tlog/_search",
+             (unsigned int)server.port);
+    grc = tlog_es_json_reader_create(&reader, url, "session:1",
+                                     t.pos_min,
+                                     (t.pos_max == 0 ? UINT64_MAX
+                                                     : t.pos_max),
+                                     t.span_max, 2, 0, t.timeout);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating ES reader: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+#define FAIL_OP(_fmt, _args...) \
+    FAIL("op #%zd: " _fmt, op - t.op_list + 1, ##_args)
+
+    for (op = t.op_list; op->exp_id != 0; op++) {
+        if (op->wait_req != 0) {
+            tlog_test_http_server_wait(&server, op->wait_req);
+            continue;
+        }
+        grc = tlog_json_reader_read(reader, &object);
+        if (grc != op->exp_grc) {
+            FAIL_OP("grc: %s (%d) != %s (%d)",
+                    tlog_grc_strerror(grc), grc,
+                    tlog_grc_strerror(op->exp_grc), op->exp_grc);
+        }
+        if (object == NULL) {
+            id = -1;
+        } else if (json_object_object_get_ex(object, "id", &field)) {
+            id = json_object_get_int(field);
+        } else {
+            id = 0;
+        }
+        if (grc == TLOG_RC_OK && id != op->exp_id) {
+            FAIL_OP("id: %d != %d", id, op->exp_id);
+        }
+        if (object != NULL) {
+            json_object_put(object);
+        }
+    }
+
+#undef FAIL_OP
+
+    tlog_json_reader_destroy(reader);
+    tlog_test_http_server_stop(&server);
+
+    for (exp_req_num = 0; t.exp_body_list[exp_req_num] != NULL;
+         exp_req_num++);
+    if (server.req_num != exp_req_num) {
+        FAIL("request number: %zu != %zu", server.req_num, exp_req_num);
+    }
+    for (i = 0; i < server.req_num && i < exp_req_num; i++) {
+        const struct tlog_test_http_server_req *req = &server.req_list[i];
+        const char *exp_body = t.exp_body_list[i];
+        if (strcmp(req->line, LINE) != 0) {
+            FAIL("request #%zu line mismatch: %s", i + 1, req->line);
+        }
+        if (req->conn != 0) {
+            FAIL("request #%zu came through connection #%zu",
+                 i + 1, req->conn + 1);
+        }
+        rsp_len += req->rsp_len;
+        if (req->body_len != strlen(exp_body) ||
+            memcmp(req->body, exp_body, req->body_len) != 0) {
+            FAIL("request #%zu body mismatch:", i + 1);
+            tlog_test_diff(stderr, req->body, req->body_len,
+                           (const uint8_t *)exp_body, strlen(exp_body));
+        }
+    }
+    if (t.max_rsp_len != 0 && rsp_len > t.max_rsp_len) {
+        FAIL("transferred response length: %zu > %zu",
+             rsp_len, t.max_rsp_len);
+    }
+
+#undef FAIL
+
+    tlog_test_http_server_cleanup(&server);
+
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+    curl_global_init(CURL_GLOBAL_NOTHING);
+
+#define RSP(_status, _body) {.status = _status, .body = _body}
+
+#define OP_READ(_exp_id) {.exp_grc = TLOG_RC_OK, .exp_id = _exp_id}
+
+#define OP_READ_ERR(_exp_grc) {.exp_grc = _exp_grc, .exp_id = -1}
+
+#define OP_WAIT(_req_num) {.exp_id = -1, .wait_req = _req_num}
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+    TEST(empty,
+         .rsp_list = {RSP(200, REPLY())},
+         .op_list = {OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST});
+
+    TEST(empty_filtered,
+         .rsp_list = {RSP(200, "{}")},
+         .op_list = {OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST});
+
+    TEST(compressed,
+         .rsp_list = {RSP(200, REPLY(HIT_OUT(1) "," HIT_OUT(2))),
+                      RSP(200, REPLY(HIT_OUT(3) "," HIT_OUT(4))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(2), OP_READ(3), OP_READ(4),
+                     OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(2), BODY_AFTER(4)},
+         /* Less than the two uncompressed pages of output alone */
+         .max_rsp_len = 512);
+
+    TEST(short_page,
+         .rsp_list = {RSP(200, REPLY(HIT(1))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(1)});
+
+    TEST(prefetch,
+         .rsp_list = {RSP(200, REPLY(HIT(1) "," HIT(2))),
+                      RSP(200, REPLY(HIT(3))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(2), OP_READ(3), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(2), BODY_AFTER(3)});
+
+    TEST(prefetch_unread,
+         .rsp_list = {RSP(200, REPLY(HIT(1) "," HIT(2))),
+                      RSP(200, REPLY(HIT(3)))},
+         .op_list = {OP_READ(1), OP_WAIT(2)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(2)});
+
+    TEST(follow,
+         .rsp_list = {RSP(200, REPLY(HIT(1))),
+                      RSP(200, REPLY()),
+                      RSP(200, REPLY(HIT(2))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(-1), OP_READ(2), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(1),
+                           BODY_AFTER(1), BODY_AFTER(2)});
+
+    TEST(shared_id,
+         .rsp_list = {RSP(200, REPLY(HIT_SESSION(1, 1) ","
+                                     HIT_SESSION(1, 2))),
+                      RSP(200, REPLY(HIT_SESSION(2, 1))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(1), OP_READ(2), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST,
+                           BODY_PFX ",\"search_after\":[1,2,\"h\"]}",
+                           BODY_AFTER(2)});
+
+    TEST(gap_in_page,
+         .rsp_list = {RSP(200, REPLY(HIT(1) "," HIT(3))),
+                      RSP(200, REPLY(HIT(4))),
+                      RSP(200, REPLY(HIT(2) "," HIT(3))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_WAIT(2), OP_READ(-1),
+                     OP_READ(2), OP_READ(3), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(3),
+                           BODY_AFTER(1), BODY_AFTER(3)});
+
+    TEST(gap_across_pages,
+         .rsp_list = {RSP(200, REPLY(HIT(1) "," HIT(2))),
+                      RSP(200, REPLY(HIT(4))),
+                      RSP(200, REPLY(HIT(3) "," HIT(4))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(2), OP_READ(-1),
+                     OP_READ(3), OP_READ(4), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(2),
+                           BODY_AFTER(2), BODY_AFTER(4)});
+
+    TEST(reply_invalid,
+         .rsp_list = {RSP(200, "{\"hits\":{}}"),
+                      RSP(200, REPLY(HIT(1)))},
+         .op_list = {OP_READ_ERR(TLOG_RC_ES_JSON_READER_REPLY_INVALID),
+                     OP_READ(1)},
+         .exp_body_list = {BODY_FIRST, BODY_FIRST});
+
+    TEST(hit_invalid,
+         .rsp_list = {RSP(200, REPLY("{}," HIT(1))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ_ERR(TLOG_RC_ES_JSON_READER_REPLY_INVALID),
+                     OP_READ(1), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(1)});
+
+    TEST(hit_nested,
+         .rsp_list = {RSP(200, REPLY("{\"_source\":{\"host\":\"h\","
+                                     "\"session\":1,\"id\":1,"
+                                     "\"hits\":{\"hits\":[\"]}\\\"{[\"]}}},"
+                                     HIT(2))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(2), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST, BODY_AFTER(2)});
+
+    TEST(hit_scalar,
+         .rsp_list = {RSP(200, REPLY(HIT(1) ",1")),
+                      RSP(200, REPLY(HIT(1)))},
+         .op_list = {OP_READ(1),
+                     OP_READ_ERR(TLOG_RC_ES_JSON_READER_REPLY_INVALID)},
+         .exp_body_list = {BODY_FIRST});
+
+    TEST(reply_truncated,
+         .rsp_list = {RSP(200, "{\"hits\":{\"hits\":[" HIT(1) "," HIT(2))},
+         .op_list = {OP_READ(1), OP_READ(2),
+                     OP_READ_ERR(TLOG_RC_ES_JSON_READER_REPLY_INVALID)},
+         .exp_body_list = {BODY_FIRST});
+
+    TEST(timeout,
+         .timeout = 1,
+         .rsp_list = {RSP(-5, "")},
+         .op_list = {OP_READ_ERR(TLOG_GRC_FROM(curl,
+                                               CURLE_OPERATION_TIMEDOUT))},
+         .exp_body_list = {BODY_FIRST});
+
+    TEST(pos_min,
+         .pos_min = 90000,
+         .rsp_list = {RSP(200, REPLY(HIT(5) "," HIT(6))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(5), OP_READ(6), OP_READ(-1)},
+         .exp_body_list = {BODY_QUERY_POS(90000) BODY_TAIL "}",
+                           BODY_QUERY_POS(90000) BODY_TAIL
+                                AFTER(6)});
+
+    TEST(pos_min_span,
+         .pos_min = 90000,
+         .span_max = 10000,
+         .rsp_list = {RSP(200, REPLY(HIT(4) "," HIT(5))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(4), OP_READ(5), OP_READ(-1)},
+         .exp_body_list = {BODY_QUERY_POS(80000) BODY_TAIL "}",
+                           BODY_QUERY_POS(80000) BODY_TAIL
+                                AFTER(5)});
+
+    TEST(pos_min_within_span,
+         .pos_min = 5000,
+         .span_max = 10000,
+         .rsp_list = {RSP(200, REPLY(HIT(1))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(-1)},
+         .exp_body_list = {BODY_FIRST,
+                           BODY_AFTER(1)});
+
+    TEST(pos_max,
+         .pos_max = 30000,
+         .rsp_list = {RSP(200, REPLY(HIT(1) "," HIT(2))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(1), OP_READ(2), OP_READ(-1)},
+         .exp_body_list = {BODY_QUERY_RANGE("\"lte\":30000") BODY_TAIL "}",
+                           BODY_QUERY_RANGE("\"lte\":30000") BODY_TAIL
+                                AFTER(2)});
+
+    TEST(pos_range,
+         .pos_min = 90000,
+         .pos_max = 120000,
+         .rsp_list = {RSP(200, REPLY(HIT(5))),
+                      RSP(200, REPLY())},
+         .op_list = {OP_READ(5), OP_READ(-1)},
+         .exp_body_list = {BODY_QUERY_RANGE("\"gte\":90000,"
+                                            "\"lte\":120000")
+                                BODY_TAIL "}",
+                           BODY_QUERY_RANGE("\"gte\":90000,"
+                                            "\"lte\":120000")
+                                BODY_TAIL AFTER(5)});
+
+    curl_global_cleanup();
+
+    return !passed;
+}
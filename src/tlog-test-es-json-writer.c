@@ -0,0 +1,464 @@
+/*
+ * Tlog tlog_es_json_writer test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <curl/curl.h>
+#include <tlog/rc.h>
+#include <tlog/es_json_writer.h>
+#include <tlog/timespec.h>
+#include <tlog/misc.h>
+#include <tlog/test_misc.h>
+#include <tlog/test_http_server.h>
+
+/** Bulk reply accepting all items */
+#define REPLY_OK "{\"took\":1,\"errors\":false,\"items\":[]}"
+
+/** Action line prefix of each bulk item */
+#define ACTION "{\"index\":{}}\n"
+
+enum op_type {
+    OP_TYPE_NONE,
+    OP_TYPE_WRITE,
+    OP_TYPE_FLUSH,
+    OP_TYPE_SLEEP,
+    OP_TYPE_NUM
+};
+
+static const char*
+op_type_to_str(enum op_type t)
+{
+    switch (t) {
+    case OP_TYPE_NONE:
+        return "none";
+    case OP_TYPE_WRITE:
+        return "write";
+    case OP_TYPE_FLUSH:
+        return "flush";
+    case OP_TYPE_SLEEP:
+        return "sleep";
+    default:
+        return "<unknown>";
+    }
+}
+
+struct op {
+    enum op_type    type;
+    const char     *msg;        /**< Message to write */
+    unsigned int    sec;        /**< Seconds to sleep */
+    tlog_grc        exp_grc;    /**< Expected return code */
+};
+
+struct test {
+    size_t                                  batch_size;
+    unsigned int                            batch_age;
+    unsigned int                            retries;
+    unsigned int                            timeout;
+    bool                                    gzip;
+    struct tlog_test_http_server_rsp        rsp_list[8];
+    struct op                               op_list[16];
+    const char                             *exp_body_list[8];
+    size_t                                  exp_conn_num;
+};
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    struct tlog_test_http_server server;
+    struct tlog_json_writer *writer = NULL;
+    char url[64];
+    const struct op *op;
+    size_t i;
+    size_t exp_req_num;
+    struct timespec start;
+    struct timespec end;
+
+    if (!tlog_test_http_server_start(&server, t.rsp_list)) {
+        fprintf(stderr, "Failed starting HTTP server: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/tlog/tlog/_bulk",
+             (unsigned int)server.port);
+    grc = tlog_es_json_writer_create(&writer, url,
+                                     t.batch_size, t.batch_age,
+                                     t.retries, 0, t.timeout, t.gzip);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating ES writer: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+#define FAIL_OP(_fmt, _args...) \
+    FAIL("op #%zd (%s): " _fmt,                                 \
+         op - t.op_list + 1, op_type_to_str(op->type), ##_args)
+
+    for (op = t.op_list; op->type != OP_TYPE_NONE; op++) {
+        switch (op->type) {
+        case OP_TYPE_WRITE:
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            grc = tlog_json_writer_write(writer, (const uint8_t *)op->msg,
+                                         strlen(op->msg));
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            tlog_timespec_sub(&end, &start, &start);
+            if (start.tv_sec > 0) {
+                FAIL_OP("blocked for %lld seconds",
+                        (long long)start.tv_sec);
+            }
+            break;
+        case OP_TYPE_FLUSH:
+            grc = tlog_json_writer_flush(writer);
+            if (grc == TLOG_RC_OK) {
+                grc = tlog_es_json_writer_drain(writer);
+            }
+            break;
+        case OP_TYPE_SLEEP:
+            sleep(op->sec);
+            grc = TLOG_RC_OK;
+            break;
+        default:
+            fprintf(stderr, "Unknown operation type: %d\n", op->type);
+            exit(1);
+        }
+        if (grc != op->exp_grc) {
+            FAIL_OP("grc: %s (%d) != %s (%d)",
+                    tlog_grc_strerror(grc), grc,
+                    tlog_grc_strerror(op->exp_grc), op->exp_grc);
+        }
+    }
+
+#undef FAIL_OP
+
+    tlog_json_writer_destroy(writer);
+    tlog_test_http_server_stop(&server);
+
+    for (exp_req_num = 0; t.exp_body_list[exp_req_num] != NULL;
+         exp_req_num++);
+    if (server.req_num != exp_req_num) {
+        FAIL("request number: %zu != %zu", server.req_num, exp_req_num);
+    }
+    for (i = 0; i < server.req_num && i < exp_req_num; i++) {
+        const struct tlog_test_http_server_req *req = &server.req_list[i];
+        const char *exp_body = t.exp_body_list[i];
+        if (req->body_len != strlen(exp_body) ||
+            memcmp(req->body, exp_body, req->body_len) != 0) {
+            FAIL("request #%zu body mismatch:", i + 1);
+            tlog_test_diff(stderr, req->body, req->body_len,
+                           (const uint8_t *)exp_body, strlen(exp_body));
+        }
+        if ((strstr(req->headers, "Content-Encoding: gzip") != NULL) !=
+                t.gzip) {
+            FAIL("request #%zu compression mismatch", i + 1);
+        }
+    }
+    if (server.conn_num != t.exp_conn_num) {
+        FAIL("connection number: %zu != %zu",
+             server.conn_num, t.exp_conn_num);
+    }
+
+#undef FAIL
+
+    tlog_test_http_server_cleanup(&server);
+
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+    curl_global_init(CURL_GLOBAL_NOTHING);
+
+#define RSP(_status, _body) {.status = _status, .body = _body}
+
+#define OP_WRITE(_msg, _exp_grc) \
+    {.type = OP_TYPE_WRITE, .msg = _msg, .exp_grc = _exp_grc}
+
+#define OP_FLUSH(_exp_grc) \
+    {.type = OP_TYPE_FLUSH, .exp_grc = _exp_grc}
+
+#define OP_SLEEP(_sec) \
+    {.type = OP_TYPE_SLEEP, .sec = _sec, .exp_grc = TLOG_RC_OK}
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+    TEST(nothing,
+         .batch_size = 1024,
+         .exp_conn_num = 0);
+
+    TEST(empty_flush,
+         .batch_size = 1024,
+         .op_list = {OP_FLUSH(TLOG_RC_OK)},
+         .exp_conn_num = 0);
+
+    TEST(one_flush,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    TEST(no_newline,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    TEST(cleanup_sends,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    TEST(batch_two,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(size_reached,
+         .batch_size = 42,
+         .rsp_list = {RSP(200, REPLY_OK), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n",
+                           ACTION "{\"a\":3}\n"},
+         .exp_conn_num = 1);
+
+    TEST(size_exceeded,
+         .batch_size = 30,
+         .rsp_list = {RSP(200, REPLY_OK), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(age_reached,
+         .batch_size = 1024,
+         .batch_age = 1,
+         .rsp_list = {RSP(200, REPLY_OK), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_SLEEP(1),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n",
+                           ACTION "{\"a\":3}\n"},
+         .exp_conn_num = 1);
+
+    TEST(gzip,
+         .batch_size = 1024,
+         .gzip = true,
+         .rsp_list = {RSP(200, REPLY_OK), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n",
+                           ACTION "{\"a\":3}\n"},
+         .exp_conn_num = 1);
+
+    TEST(keep_alive,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, REPLY_OK), RSP(200, REPLY_OK),
+                      RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":2}\n",
+                           ACTION "{\"a\":3}\n"},
+         .exp_conn_num = 1);
+
+    TEST(retry_status,
+         .batch_size = 1024,
+         .retries = 1,
+         .rsp_list = {RSP(503, "{}"), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    TEST(retry_exhausted,
+         .batch_size = 1024,
+         .retries = 1,
+         .rsp_list = {RSP(429, "{}"), RSP(503, "{}"), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_HTTP_ERROR),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    TEST(no_retry,
+         .batch_size = 1024,
+         .rsp_list = {RSP(503, "{}"), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_HTTP_ERROR),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(permanent_status,
+         .batch_size = 1024,
+         .retries = 3,
+         .rsp_list = {RSP(400, "{}"), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_HTTP_ERROR),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(item_retry,
+         .batch_size = 1024,
+         .retries = 1,
+         .rsp_list = {RSP(200, "{\"took\":1,\"errors\":true,\"items\":["
+                                 "{\"index\":{\"status\":201}},"
+                                 "{\"index\":{\"status\":429}},"
+                                 "{\"index\":{\"status\":201}}]}"),
+                      RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n"
+                           ACTION "{\"a\":2}\n"
+                           ACTION "{\"a\":3}\n",
+                           ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(item_rejected,
+         .batch_size = 1024,
+         .retries = 1,
+         .rsp_list = {RSP(200, "{\"took\":1,\"errors\":true,\"items\":["
+                                 "{\"index\":{\"status\":400}},"
+                                 "{\"index\":{\"status\":201}}]}"),
+                      RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(item_held,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, "{\"took\":1,\"errors\":true,\"items\":["
+                                 "{\"index\":{\"status\":429}},"
+                                 "{\"index\":{\"status\":201}}]}"),
+                      RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_ITEMS_HELD),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n" ACTION "{\"a\":2}\n",
+                           ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    TEST(timeout,
+         .batch_size = 1024,
+         .timeout = 1,
+         .rsp_list = {RSP(-5, ""), RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_GRC_FROM(curl, CURLE_OPERATION_TIMEDOUT)),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 2);
+
+    TEST(rejected_continues,
+         .batch_size = 1,
+         .rsp_list = {RSP(200, "{\"took\":1,\"errors\":true,\"items\":["
+                                 "{\"index\":{\"status\":400}}]}"),
+                      RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_ITEMS_REJECTED),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":2}\n"},
+         .exp_conn_num = 1);
+
+    TEST(stalled,
+         .batch_size = 1,
+         .timeout = 1,
+         .retries = 3,
+         .rsp_list = {RSP(-3, ""), RSP(200, REPLY_OK), RSP(200, REPLY_OK),
+                      RSP(200, REPLY_OK)},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":2}\n", TLOG_RC_OK),
+                     OP_WRITE("{\"a\":3}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":2}\n",
+                           ACTION "{\"a\":3}\n"},
+         .exp_conn_num = 2);
+
+    TEST(reply_invalid,
+         .batch_size = 1024,
+         .rsp_list = {RSP(200, "[")},
+         .op_list = {OP_WRITE("{\"a\":1}\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_ES_JSON_WRITER_REPLY_INVALID)},
+         .exp_body_list = {ACTION "{\"a\":1}\n",
+                           ACTION "{\"a\":1}\n"},
+         .exp_conn_num = 1);
+
+    curl_global_cleanup();
+
+    return !passed;
+}
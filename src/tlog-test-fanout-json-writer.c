@@ -0,0 +1,336 @@
+/*
+ * Tlog tlog_fanout_json_writer test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tlog/rc.h>
+#include <tlog/fanout_json_writer.h>
+#include <tlog/misc.h>
+#include <tlog/test_misc.h>
+
+/** Number of children in each test */
+#define CHILD_NUM   2
+
+/*
+ * Child writer accumulating written messages, and able to fail on request.
+ */
+
+/** Child test writer state */
+struct child {
+    bool    fail;           /**< True if writes and flushes should fail */
+    char    written[4096];  /**< Messages written */
+    size_t  written_len;    /**< Length of written messages */
+};
+
+struct child_json_writer {
+    struct tlog_json_writer writer;
+    struct child           *child;
+};
+
+static tlog_grc
+child_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    ((struct child_json_writer *)writer)->child = va_arg(ap, struct child *);
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+child_json_writer_write(struct tlog_json_writer *writer,
+                        const uint8_t *buf, size_t len)
+{
+    struct child *child = ((struct child_json_writer *)writer)->child;
+    if (child->fail) {
+        return TLOG_RC_FAILURE;
+    }
+    assert(child->written_len + len <= sizeof(child->written));
+    memcpy(child->written + child->written_len, buf, len);
+    child->written_len += len;
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+child_json_writer_flush(struct tlog_json_writer *writer)
+{
+    struct child *child = ((struct child_json_writer *)writer)->child;
+    return child->fail ? TLOG_RC_FAILURE : TLOG_RC_OK;
+}
+
+static const struct tlog_json_writer_type child_json_writer_type = {
+    .size   = sizeof(struct child_json_writer),
+    .init   = child_json_writer_init,
+    .write  = child_json_writer_write,
+    .flush  = child_json_writer_flush,
+};
+
+enum op_type {
+    OP_TYPE_NONE,
+    OP_TYPE_WRITE,
+    OP_TYPE_FLUSH,
+    OP_TYPE_FAIL,
+    OP_TYPE_CHECK,
+    OP_TYPE_NUM
+};
+
+static const char*
+op_type_to_str(enum op_type t)
+{
+    switch (t) {
+    case OP_TYPE_NONE:
+        return "none";
+    case OP_TYPE_WRITE:
+        return "write";
+    case OP_TYPE_FLUSH:
+        return "flush";
+    case OP_TYPE_FAIL:
+        return "fail";
+    case OP_TYPE_CHECK:
+        return "check";
+    default:
+        return "<unknown>";
+    }
+}
+
+struct op {
+    enum op_type    type;
+    size_t          child;      /**< Child index to fail or check */
+    const char     *msg;        /**< Message to write, or expected
+                                     written messages to check */
+    bool            fail;       /**< True if the child should fail */
+    tlog_grc        exp_grc;    /**< Expected return code */
+};
+
+struct test {
+    bool            required[CHILD_NUM];    /**< Child requirement flags */
+    size_t          queue[CHILD_NUM];       /**< Child queue sizes */
+    struct op       op_list[16];            /**< Operations */
+    const char     *exp_written[CHILD_NUM]; /**< Expected messages
+                                                 written to children */
+};
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    struct child child_list[CHILD_NUM];
+    struct tlog_fanout_json_writer_child desc_list[CHILD_NUM];
+    struct tlog_json_writer *writer = NULL;
+    const struct op *op;
+    size_t i;
+
+    memset(child_list, 0, sizeof(child_list));
+    memset(desc_list, 0, sizeof(desc_list));
+    for (i = 0; i < CHILD_NUM; i++) {
+        grc = tlog_json_writer_create(&desc_list[i].writer,
+                                      &child_json_writer_type,
+                                      &child_list[i]);
+        if (grc != TLOG_RC_OK) {
+            fprintf(stderr, "Failed creating child writer: %s\n",
+                    tlog_grc_strerror(grc));
+            exit(1);
+        }
+        desc_list[i].owned = true;
+        desc_list[i].required = t.required[i];
+        desc_list[i].queue = t.queue[i];
+    }
+
+    grc = tlog_fanout_json_writer_create(&writer, desc_list, CHILD_NUM);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating fan-out writer: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+#define FAIL_OP(_fmt, _args...) \
+    FAIL("op #%zd (%s): " _fmt,                                 \
+         op - t.op_list + 1, op_type_to_str(op->type), ##_args)
+
+#define CHECK_WRITTEN(_child, _exp, _fail_args...) \
+    do {                                                                \
+        const struct child *_c = &child_list[_child];                   \
+        const char *_e = (_exp) == NULL ? "" : (_exp);                  \
+        if (_c->written_len != strlen(_e) ||                            \
+            memcmp(_c->written, _e, _c->written_len) != 0) {            \
+            _fail_args;                                                 \
+            tlog_test_diff(stderr,                                      \
+                           (const uint8_t *)_c->written,                \
+                           _c->written_len,                             \
+                           (const uint8_t *)_e, strlen(_e));            \
+        }                                                               \
+    } while (0)
+
+    for (op = t.op_list; op->type != OP_TYPE_NONE; op++) {
+        grc = TLOG_RC_OK;
+        switch (op->type) {
+        case OP_TYPE_WRITE:
+            grc = tlog_json_writer_write(writer, (const uint8_t *)op->msg,
+                                         strlen(op->msg));
+            break;
+        case OP_TYPE_FLUSH:
+            grc = tlog_json_writer_flush(writer);
+            break;
+        case OP_TYPE_FAIL:
+            child_list[op->child].fail = op->fail;
+            break;
+        case OP_TYPE_CHECK:
+            CHECK_WRITTEN(op->child, op->msg,
+                          FAIL_OP("child #%zu written mismatch:",
+                                  op->child));
+            break;
+        default:
+            fprintf(stderr, "Unknown operation type: %d\n", op->type);
+            exit(1);
+        }
+        if (grc != op->exp_grc) {
+            FAIL_OP("grc: %s (%d) != %s (%d)",
+                    tlog_grc_strerror(grc), grc,
+                    tlog_grc_strerror(op->exp_grc), op->exp_grc);
+        }
+    }
+
+#undef FAIL_OP
+
+    tlog_json_writer_destroy(writer);
+
+    for (i = 0; i < CHILD_NUM; i++) {
+        CHECK_WRITTEN(i, t.exp_written[i],
+                      FAIL("child #%zu written mismatch:", i));
+    }
+
+#undef CHECK_WRITTEN
+#undef FAIL
+
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define OP_WRITE(_msg, _exp_grc) \
+    {.type = OP_TYPE_WRITE, .msg = _msg, .exp_grc = _exp_grc}
+
+#define OP_FLUSH(_exp_grc) \
+    {.type = OP_TYPE_FLUSH, .exp_grc = _exp_grc}
+
+#define OP_FAIL(_child, _fail) \
+    {.type = OP_TYPE_FAIL, .child = _child, .fail = _fail, \
+     .exp_grc = TLOG_RC_OK}
+
+#define OP_CHECK(_child, _msg) \
+    {.type = OP_TYPE_CHECK, .child = _child, .msg = _msg, \
+     .exp_grc = TLOG_RC_OK}
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+/* Size a queue of _num messages of _len bytes */
+#define QUEUE(_num, _len) ((_num) * (sizeof(size_t) + (_len)))
+
+    TEST(nothing,
+         .exp_written = {"", ""});
+
+    TEST(both,
+         .op_list = {OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_written = {"a\nb\n", "a\nb\n"});
+
+    TEST(best_effort_outage,
+         .queue = {QUEUE(4, 2), QUEUE(4, 2)},
+         .op_list = {OP_FAIL(1, true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_CHECK(0, "a\nb\n"),
+                     OP_CHECK(1, ""),
+                     OP_FAIL(1, false),
+                     OP_WRITE("c\n", TLOG_RC_OK),
+                     OP_CHECK(1, "a\nb\nc\n")},
+         .exp_written = {"a\nb\nc\n", "a\nb\nc\n"});
+
+    TEST(best_effort_overflow,
+         .queue = {QUEUE(2, 2), QUEUE(2, 2)},
+         .op_list = {OP_FAIL(1, true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_WRITE("c\n", TLOG_RC_OK),
+                     OP_FAIL(1, false),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_CHECK(1, "b\nc\n")},
+         .exp_written = {"a\nb\nc\n", "b\nc\n"});
+
+    TEST(best_effort_no_queue,
+         .op_list = {OP_FAIL(0, true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_FAIL(0, false),
+                     OP_WRITE("b\n", TLOG_RC_OK)},
+         .exp_written = {"b\n", "a\nb\n"});
+
+    TEST(required_outage,
+         .required = {true, false},
+         .queue = {QUEUE(2, 2), QUEUE(2, 2)},
+         .op_list = {OP_FAIL(0, true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_WRITE("c\n", TLOG_RC_FAILURE),
+                     OP_FLUSH(TLOG_RC_FAILURE),
+                     OP_CHECK(1, "a\nb\nc\n"),
+                     OP_FAIL(0, false),
+                     OP_FLUSH(TLOG_RC_OK),
+                     OP_CHECK(0, "a\nb\n")},
+         .exp_written = {"a\nb\n", "a\nb\nc\n"});
+
+    TEST(required_no_queue,
+         .required = {true, false},
+         .op_list = {OP_FAIL(0, true),
+                     OP_WRITE("a\n", TLOG_RC_FAILURE),
+                     OP_FAIL(0, false),
+                     OP_WRITE("b\n", TLOG_RC_OK)},
+         .exp_written = {"b\n", "a\nb\n"});
+
+    TEST(best_effort_flush,
+         .op_list = {OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FAIL(1, true),
+                     OP_FLUSH(TLOG_RC_OK)},
+         .exp_written = {"a\n", "a\n"});
+
+    TEST(flushed_on_close,
+         .queue = {QUEUE(2, 2), QUEUE(2, 2)},
+         .op_list = {OP_FAIL(0, true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FAIL(0, false)},
+         .exp_written = {"a\n", "a\n"});
+
+    return !passed;
+}
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <tlog/rc.h>
 #include <tlog/fd_json_reader.h>
+#include <tlog/mmap_json_reader.h>
 #include <tlog/misc.h>
 #include <tlog/test_misc.h>
 
@@ -77,7 +78,7 @@ struct test {
 };
 
 static bool
-test(const char *n, const struct test t)
+test(const char *n, bool mmap, const struct test t)
 {
     bool passed = true;
     int fd = -1;
@@ -113,17 +114,22 @@ test(const char *n, const struct test t)
                 strerror(errno));
         exit(1);
     }
-    grc = tlog_fd_json_reader_create(&reader, fd, false, BUF_SIZE);
+    if (mmap) {
+        grc = tlog_mmap_json_reader_create(&reader, fd, false, 0, NULL, 0);
+    } else {
+        grc = tlog_fd_json_reader_create(&reader, fd, false, BUF_SIZE);
+    }
     if (grc != TLOG_RC_OK) {
-        fprintf(stderr, "Failed creating FD reader: %s\n",
-                tlog_grc_strerror(grc));
+        fprintf(stderr, "Failed creating %s reader: %s\n",
+                (mmap ? "mmap" : "FD"), tlog_grc_strerror(grc));
         exit(1);
     }
 
 #define FAIL(_fmt, _args...) \
-    do {                                                \
-        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
-        passed = false;                                 \
+    do {                                                    \
+        fprintf(stderr, "%s%s: " _fmt "\n",                 \
+                n, (mmap ? " (mmap)" : ""), ##_args);       \
+        passed = false;                                     \
     } while (0)
 
 #define FAIL_OP(_fmt, _args...) \
@@ -192,7 +198,8 @@ test(const char *n, const struct test t)
 #undef FAIL_OP
 #undef FAIL
 
-    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    fprintf(stderr, "%s%s: %s\n",
+            n, (mmap ? " (mmap)" : ""), (passed ? "PASS" : "FAIL"));
 
     tlog_json_reader_destroy(reader);
     if (fd >= 0) {
@@ -218,12 +225,14 @@ main(void)
      .data = {.loc_get = {.exp_loc = _exp_loc}}}
 
 #define TEST(_name_token, _input, _op_list_init_args...) \
-    passed = test(#_name_token,                                 \
-                  (struct test){                                \
-                    .input = _input,                            \
-                    .op_list = {_op_list_init_args, OP_NONE}    \
-                  }                                             \
-                 ) && passed
+    do {                                                            \
+        const struct test _t = {                                    \
+            .input = _input,                                        \
+            .op_list = {_op_list_init_args, OP_NONE}                \
+        };                                                          \
+        passed = test(#_name_token, false, _t) && passed;           \
+        passed = test(#_name_token, true, _t) && passed;            \
+    } while (0)
 
 
     TEST(null,
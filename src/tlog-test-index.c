@@ -0,0 +1,577 @@
+/*
+ * Tlog log file index test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tlog/rc.h>
+#include <tlog/index.h>
+#include <tlog/mmap_json_reader.h>
+
+/** Number of lines in the generated log */
+#define LINE_NUM    6000
+
+/** Number of consecutive lines of each session */
+#define RUN_LINES   37
+
+/** Position to start reading from, within a run of session 2 */
+#define POS_MIN     (82 * RUN_LINES * 10 + 100)
+
+/** Number of distinct hosts in the generated many-host log */
+#define HOST_NUM    1000
+
+/** Position to start reading from, in the middle of the first message */
+#define SPAN_POS    500
+
+/** Result of reading a message */
+struct res {
+    size_t      id;         /**< Message ID */
+    size_t      loc;        /**< Location after reading */
+};
+
+/**
+ * Open an unlinked temporary file, exiting on failure.
+ *
+ * @return The file descriptor.
+ */
+static int
+tmp_open(void)
+{
+    char filename[] = "tlog-test-index.XXXXXX";
+    int fd;
+
+    fd = mkstemp(filename);
+    if (fd < 0 || unlink(filename) < 0) {
+        fprintf(stderr, "Failed creating a temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    return fd;
+}
+
+/**
+ * Write a generated log to a file: runs of three interleaved sessions on
+ * two hosts, with blank and invalid lines, and a partial last line.
+ *
+ * @param fd    The file descriptor to write to.
+ * @param start Number of the first line to write.
+ * @param end   Number of the line to stop before.
+ */
+static void
+write_log(int fd, size_t start, size_t end)
+{
+    char buf[256];
+    size_t i;
+    size_t run;
+    size_t len;
+
+    for (i = start; i < end; i++) {
+        run = i / RUN_LINES;
+        if (i % 113 == 0) {
+            snprintf(buf, sizeof(buf), "\n{\"ver\":1,\"host\":\n");
+        } else {
+            snprintf(buf, sizeof(buf),
+                     "{\"ver\":1,\"host\":\"%s\",\"user\":\"user\","
+                     "\"term\":\"xterm\",\"session\":%zu,\"id\":%zu,"
+                     "\"pos\":%zu,\"timing\":\">5\",\"in_txt\":\"\","
+                     "\"in_bin\":[],\"out_txt\":\"hello\",\"out_bin\":[]}\n",
+                     (run % 5 == 4 ? "otherhost" : "localhost"),
+                     run % 3 + 1, i + 1, i * 10);
+        }
+        len = strlen(buf);
+        if (write(fd, buf, len) != (ssize_t)len) {
+            fprintf(stderr, "Failed writing the temporary file: %s\n",
+                    strerror(errno));
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Write a log with a session message spanning a second, followed by a
+ * message of another session, and then by one more of the first session.
+ *
+ * @param fd    The file descriptor to write to.
+ */
+static void
+write_span_log(int fd)
+{
+    static const char log[] =
+        "{\"ver\":1,\"host\":\"localhost\",\"user\":\"user\","
+        "\"term\":\"xterm\",\"session\":1,\"id\":1,\"pos\":0,"
+        "\"timing\":\">1+1000>1\",\"in_txt\":\"\",\"in_bin\":[],"
+        "\"out_txt\":\"ab\",\"out_bin\":[]}\n"
+        "{\"ver\":1,\"host\":\"localhost\",\"user\":\"user\","
+        "\"term\":\"xterm\",\"session\":2,\"id\":1,\"pos\":100,"
+        "\"timing\":\">1\",\"in_txt\":\"\",\"in_bin\":[],"
+        "\"out_txt\":\"c\",\"out_bin\":[]}\n"
+        "{\"ver\":1,\"host\":\"localhost\",\"user\":\"user\","
+        "\"term\":\"xterm\",\"session\":1,\"id\":2,\"pos\":2000,"
+        "\"timing\":\">1\",\"in_txt\":\"\",\"in_bin\":[],"
+        "\"out_txt\":\"d\",\"out_bin\":[]}\n";
+
+    if (write(fd, log, sizeof(log) - 1) != (ssize_t)(sizeof(log) - 1)) {
+        fprintf(stderr, "Failed writing the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+}
+
+/**
+ * Update an index from a log file.
+ *
+ * @param index     The index to update.
+ * @param index_fd  The index file descriptor, or -1.
+ * @param log_fd    The log file descriptor.
+ * @param len       Length of the log file part to index.
+ */
+static void
+update(struct tlog_index *index, int index_fd, int log_fd, size_t len)
+{
+    void *map;
+    tlog_grc grc;
+
+    map = mmap(NULL, len, PROT_READ, MAP_SHARED, log_fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed mapping the log: %s\n", strerror(errno));
+        exit(1);
+    }
+    grc = tlog_index_update(index, index_fd, map, len);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed updating the index: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+    munmap(map, len);
+}
+
+/**
+ * Get the size of a file.
+ *
+ * @param fd    The file descriptor.
+ *
+ * @return The file size.
+ */
+static size_t
+get_size(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "Failed getting file status: %s\n", strerror(errno));
+        exit(1);
+    }
+    return (size_t)st.st_size;
+}
+
+/**
+ * Read the valid messages of a session from a log.
+ *
+ * @param log_fd    The log file descriptor.
+ * @param threads   Number of threads to parse messages with.
+ * @param index     The index to skip other sessions with, or NULL.
+ * @param pos_min   Position of the earliest message of interest, ms.
+ * @param filter    The filter to read with.
+ * @param res_list  The result list to fill.
+ *
+ * @return Number of results in the list.
+ */
+static size_t
+read_log(int log_fd, unsigned int threads, const struct tlog_index *index,
+         uint64_t pos_min, const struct tlog_json_msg_filter *filter,
+         struct res *res_list)
+{
+    struct tlog_json_reader *reader = NULL;
+    struct tlog_json_msg msg = {NULL, };
+    size_t res_num = 0;
+    tlog_grc grc;
+
+    grc = tlog_mmap_json_reader_create(&reader, log_fd, false,
+                                       threads, index, pos_min);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating mmap reader: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+    while (true) {
+        grc = tlog_json_reader_read_msg(reader, filter, &msg);
+        if (grc != TLOG_RC_OK) {
+            continue;
+        }
+        if (tlog_json_msg_is_void(&msg)) {
+            break;
+        }
+        if (msg.session == filter->session &&
+            strcmp(msg.host, filter->host) == 0) {
+            res_list[res_num].id = msg.id;
+            res_list[res_num].loc = tlog_json_reader_loc_get(reader);
+            res_num++;
+        }
+        tlog_json_msg_cleanup(&msg);
+    }
+
+    tlog_json_reader_destroy(reader);
+    return res_num;
+}
+
+/**
+ * Write a generated log of single-message runs of a session on each of many
+ * distinct hosts.
+ *
+ * @param fd    The file descriptor to write to.
+ */
+static void
+write_hosts_log(int fd)
+{
+    char buf[256];
+    size_t i;
+    size_t len;
+
+    for (i = 0; i < HOST_NUM; i++) {
+        snprintf(buf, sizeof(buf),
+                 "{\"ver\":1,\"host\":\"host%zu\",\"user\":\"user\","
+                 "\"term\":\"xterm\",\"session\":1,\"id\":1,"
+                 "\"pos\":0,\"timing\":\">5\",\"in_txt\":\"\","
+                 "\"in_bin\":[],\"out_txt\":\"hello\",\"out_bin\":[]}\n",
+                 i % (HOST_NUM / 2));
+        len = strlen(buf);
+        if (write(fd, buf, len) != (ssize_t)len) {
+            fprintf(stderr, "Failed writing the temporary file: %s\n",
+                    strerror(errno));
+            exit(1);
+        }
+    }
+}
+
+/**
+ * Load an index from a file, exiting on failure.
+ *
+ * @param fd    The index file descriptor.
+ *
+ * @return The loaded index.
+ */
+static struct tlog_index *
+load(int fd)
+{
+    struct tlog_index *index = NULL;
+    tlog_grc grc;
+
+    grc = tlog_index_create(&index, fd);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed loading the index: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+    return index;
+}
+
+/**
+ * Check that two indexes have the same runs.
+ *
+ * @param name  Test name.
+ * @param res   The index to check.
+ * @param exp   The expected index.
+ *
+ * @return True if the runs match, false otherwise.
+ */
+static bool
+check_runs(const char *name,
+           const struct tlog_index *res, const struct tlog_index *exp)
+{
+    size_t i;
+    const struct tlog_index_run *r;
+    const struct tlog_index_run *e;
+
+    if (res->run_num != exp->run_num) {
+        fprintf(stderr, "%s: run number: %zu != %zu\n",
+                name, res->run_num, exp->run_num);
+        return false;
+    }
+    for (i = 0; i < res->run_num; i++) {
+        r = &res->run_list[i];
+        e = &exp->run_list[i];
+        if (r->start != e->start || r->end != e->end ||
+            r->line != e->line || r->lines != e->lines ||
+            strcmp(res->str_list[r->host], exp->str_list[e->host]) != 0 ||
+            strcmp(res->str_list[r->user], exp->str_list[e->user]) != 0 ||
+            r->session != e->session || r->num != e->num ||
+            r->first_id != e->first_id || r->last_id != e->last_id ||
+            r->first_pos != e->first_pos || r->last_pos != e->last_pos ||
+            r->end_pos != e->end_pos) {
+            fprintf(stderr, "%s: run #%zu mismatch\n", name, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+main(void)
+{
+    static struct res exp_list[LINE_NUM];
+    static struct res res_list[LINE_NUM];
+    const struct tlog_json_msg_filter filter = {"localhost", NULL, 2};
+    const struct tlog_json_msg_filter span_filter = {"localhost", NULL, 1};
+    bool passed = true;
+    int log_fd;
+    int index_fd;
+    int stale_fd;
+    int hosts_fd;
+    int span_fd;
+    struct tlog_index *whole = NULL;
+    struct tlog_index *stale;
+    struct tlog_index *index = NULL;
+    struct tlog_index *loaded = NULL;
+    const struct tlog_index_run *run;
+    size_t exp_num;
+    size_t res_num;
+    size_t i;
+    unsigned int threads;
+    tlog_grc grc;
+
+    log_fd = tmp_open();
+    index_fd = tmp_open();
+
+    /* Index the whole log at once, in memory */
+    write_log(log_fd, 0, LINE_NUM);
+    if (write(log_fd, "{\"ver\"", 6) != 6) {
+        fprintf(stderr, "Failed writing the temporary file: %s\n",
+                strerror(errno));
+        return 1;
+    }
+    grc = tlog_index_create(&whole, -1);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating an index: %s\n",
+                tlog_grc_strerror(grc));
+        return 1;
+    }
+    update(whole, -1, log_fd, get_size(log_fd));
+
+    /* Index it in steps, saving and reloading the index in between */
+    for (i = 1; i <= 5; i++) {
+        grc = tlog_index_create(&index, index_fd);
+        if (grc != TLOG_RC_OK) {
+            fprintf(stderr, "Failed loading the index: %s\n",
+                    tlog_grc_strerror(grc));
+            return 1;
+        }
+        update(index, index_fd, log_fd,
+               i == 5 ? get_size(log_fd) : get_size(log_fd) * i / 5);
+        tlog_index_destroy(index);
+    }
+    grc = tlog_index_create(&loaded, index_fd);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed loading the index: %s\n",
+                tlog_grc_strerror(grc));
+        return 1;
+    }
+    passed = check_runs("incremental", loaded, whole) && passed;
+
+    /*
+     * Check indexing the log file, read in chunks, matches indexing it at
+     * once, and updating it after truncation is refused
+     */
+    index = load(-1);
+    grc = tlog_index_update_log(index, -1, log_fd);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed updating the index from the log: %s\n",
+                tlog_grc_strerror(grc));
+        return 1;
+    }
+    passed = check_runs("log", index, whole) && passed;
+    stale_fd = tmp_open();
+    write_log(stale_fd, 0, LINE_NUM / 10);
+    stale = load(-1);
+    grc = tlog_index_update_log(stale, -1, stale_fd);
+    if (grc == TLOG_RC_OK && ftruncate(stale_fd, 0) == 0) {
+        grc = tlog_index_update_log(stale, -1, stale_fd);
+    }
+    if (grc != TLOG_RC_INDEX_LOG_TRUNCATED) {
+        fprintf(stderr, "log: truncation not detected: %s\n",
+                tlog_grc_strerror(grc));
+        passed = false;
+    }
+    tlog_index_destroy(stale);
+    tlog_index_destroy(index);
+    close(stale_fd);
+
+    /*
+     * Check updating with indexes loaded before other updates reloads
+     * them, instead of overwriting the other updates
+     */
+    stale_fd = tmp_open();
+    index = load(stale_fd);
+    stale = load(stale_fd);
+    update(index, stale_fd, log_fd, get_size(log_fd) / 3);
+    update(stale, stale_fd, log_fd, get_size(log_fd));
+    update(index, stale_fd, log_fd, get_size(log_fd) / 2);
+    tlog_index_destroy(stale);
+    tlog_index_destroy(index);
+    index = load(stale_fd);
+    passed = check_runs("stale", index, whole) && passed;
+    tlog_index_destroy(index);
+    close(stale_fd);
+
+    /* Check strings are added once, with many of them */
+    hosts_fd = tmp_open();
+    stale_fd = tmp_open();
+    write_hosts_log(hosts_fd);
+    index = load(stale_fd);
+    update(index, stale_fd, hosts_fd, get_size(hosts_fd));
+    if (index->str_num != HOST_NUM / 2 + 1 ||
+        index->run_num != HOST_NUM) {
+        fprintf(stderr, "hosts: strings %zu != %u, runs %zu != %u\n",
+                index->str_num, HOST_NUM / 2 + 1,
+                index->run_num, HOST_NUM);
+        passed = false;
+    }
+    stale = load(stale_fd);
+    passed = check_runs("hosts", stale, index) && passed;
+    if (stale->str_num != index->str_num) {
+        fprintf(stderr, "hosts: loaded strings %zu != %zu\n",
+                stale->str_num, index->str_num);
+        passed = false;
+    }
+    tlog_index_destroy(stale);
+    tlog_index_destroy(index);
+    close(stale_fd);
+    close(hosts_fd);
+
+    /* Check finding runs */
+    run = tlog_index_find(loaded, 0, "localhost", 2, 0);
+    if (run == NULL || run->session != 2 || run->first_id != RUN_LINES + 1) {
+        fprintf(stderr, "find: first run of session 2 not found\n");
+        passed = false;
+    }
+    run = tlog_index_find(loaded, 0, "otherhost", 2, 0);
+    if (run == NULL ||
+        strcmp(loaded->str_list[run->host], "otherhost") != 0) {
+        fprintf(stderr, "find: first run of otherhost not found\n");
+        passed = false;
+    }
+    if (tlog_index_find(loaded, 0, NULL, 4, 0) != NULL) {
+        fprintf(stderr, "find: nonexistent session found\n");
+        passed = false;
+    }
+    run = tlog_index_find(loaded, 0, "localhost", 2, POS_MIN);
+    if (run == NULL || run->session != 2 ||
+        run->first_pos > POS_MIN || run->last_pos < POS_MIN) {
+        fprintf(stderr, "find: run of session 2 at position not found\n");
+        passed = false;
+    }
+
+    /* Check reading with the index matches reading without it */
+    for (threads = 0; threads <= 3; threads += 3) {
+        exp_num = read_log(log_fd, threads, NULL, 0, &filter, exp_list);
+        res_num = read_log(log_fd, threads, loaded, 0, &filter, res_list);
+        if (res_num != exp_num) {
+            fprintf(stderr, "read %u threads: result number: %zu != %zu\n",
+                    threads, res_num, exp_num);
+            passed = false;
+            continue;
+        }
+        for (i = 0; i < res_num; i++) {
+            if (res_list[i].id != exp_list[i].id ||
+                res_list[i].loc != exp_list[i].loc) {
+                fprintf(stderr,
+                        "read %u threads: result #%zu: "
+                        "id %zu, loc %zu != id %zu, loc %zu\n",
+                        threads, i, res_list[i].id, res_list[i].loc,
+                        exp_list[i].id, exp_list[i].loc);
+                passed = false;
+                break;
+            }
+        }
+    }
+
+    /*
+     * Check reading from a position with the index skips exactly the runs
+     * ending before it
+     */
+    for (threads = 0; threads <= 3; threads += 3) {
+        exp_num = read_log(log_fd, threads, NULL, 0, &filter, exp_list);
+        res_num = read_log(log_fd, threads, loaded, POS_MIN,
+                           &filter, res_list);
+        if (res_num == 0 || res_num >= exp_num) {
+            fprintf(stderr, "read %u threads from position: "
+                    "result number: %zu out of %zu\n",
+                    threads, res_num, exp_num);
+            passed = false;
+            continue;
+        }
+        for (i = 0; i < exp_num - res_num; i++) {
+            if ((exp_list[i].id - 1) * 10 >= POS_MIN) {
+                fprintf(stderr, "read %u threads from position: "
+                        "id %zu skipped\n", threads, exp_list[i].id);
+                passed = false;
+                break;
+            }
+        }
+        for (i = 0; i < res_num; i++) {
+            if (res_list[i].id != exp_list[exp_num - res_num + i].id ||
+                res_list[i].loc != exp_list[exp_num - res_num + i].loc) {
+                fprintf(stderr, "read %u threads from position: "
+                        "result #%zu: id %zu != id %zu\n",
+                        threads, i, res_list[i].id,
+                        exp_list[exp_num - res_num + i].id);
+                passed = false;
+                break;
+            }
+        }
+    }
+
+    tlog_index_destroy(loaded);
+    tlog_index_destroy(whole);
+    close(index_fd);
+    close(log_fd);
+
+    /*
+     * Check reading from the middle of a message with the index keeps the
+     * run containing it
+     */
+    span_fd = tmp_open();
+    write_span_log(span_fd);
+    index = load(-1);
+    update(index, -1, span_fd, get_size(span_fd));
+    run = tlog_index_find(index, 0, "localhost", 1, SPAN_POS);
+    if (run == NULL || run->first_id != 1 || run->end_pos != 1000) {
+        fprintf(stderr, "span: run covering the position not found\n");
+        passed = false;
+    }
+    for (threads = 0; threads <= 3; threads += 3) {
+        res_num = read_log(span_fd, threads, index, SPAN_POS,
+                           &span_filter, res_list);
+        if (res_num != 2 || res_list[0].id != 1) {
+            fprintf(stderr, "span %u threads: message covering "
+                    "the position skipped\n", threads);
+            passed = false;
+        }
+    }
+    tlog_index_destroy(index);
+    close(span_fd);
+
+    fprintf(stderr, "%s\n", (passed ? "PASS" : "FAIL"));
+    return !passed;
+}
@@ -0,0 +1,345 @@
+/*
+ * Tlog tlog_json_msg_parse function test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <json_tokener.h>
+#include <tlog/rc.h>
+#include <tlog/pkt.h>
+#include <tlog/json_msg.h>
+
+/**
+ * Compare the messages and the packets read from them.
+ *
+ * @param name  Test name.
+ * @param a     Message parsed directly.
+ * @param b     Message initialized from an object.
+ *
+ * @return True if the messages match, false otherwise.
+ */
+static bool
+test_cmp(const char *name, struct tlog_json_msg *a, struct tlog_json_msg *b)
+{
+    bool passed = true;
+    struct tlog_pkt pkt_a = TLOG_PKT_VOID;
+    struct tlog_pkt pkt_b = TLOG_PKT_VOID;
+    uint8_t buf_a[16];
+    uint8_t buf_b[16];
+    tlog_grc grc_a;
+    tlog_grc grc_b;
+
+#define FAIL(_fmt, _args...) \
+    do {                                                    \
+        fprintf(stderr, "%s: " _fmt "\n", name, ##_args);   \
+        passed = false;                                     \
+    } while (0)
+#define CMP_STR(_field) \
+    do {                                                    \
+        if (strcmp(a->_field, b->_field) != 0) {            \
+            FAIL(#_field ": \"%s\" != \"%s\"",              \
+                 a->_field, b->_field);                     \
+        }                                                   \
+    } while (0)
+#define CMP_NUM(_field, _fmt) \
+    do {                                                    \
+        if (a->_field != b->_field) {                       \
+            FAIL(#_field ": " _fmt " != " _fmt,             \
+                 a->_field, b->_field);                     \
+        }                                                   \
+    } while (0)
+
+    CMP_NUM(ver, "%u");
+    CMP_STR(host);
+    CMP_STR(user);
+    CMP_STR(term);
+    CMP_NUM(session, "%u");
+    CMP_NUM(id, "%zu");
+    CMP_NUM(pos.tv_sec, "%ld");
+    CMP_NUM(pos.tv_nsec, "%ld");
+    CMP_STR(timing_ptr);
+    CMP_NUM(in_txt_len, "%zu");
+    CMP_NUM(out_txt_len, "%zu");
+
+#undef CMP_NUM
+#undef CMP_STR
+
+    while (passed) {
+        grc_a = tlog_json_msg_read(a, &pkt_a, buf_a, sizeof(buf_a));
+        grc_b = tlog_json_msg_read(b, &pkt_b, buf_b, sizeof(buf_b));
+        if (grc_a != grc_b) {
+            FAIL("packet read grc: %s != %s",
+                 tlog_grc_strerror(grc_a), tlog_grc_strerror(grc_b));
+        } else if (!tlog_pkt_is_equal(&pkt_a, &pkt_b)) {
+            FAIL("packet mismatch");
+        } else if (grc_a != TLOG_RC_OK || tlog_pkt_is_void(&pkt_a)) {
+            break;
+        }
+        tlog_pkt_cleanup(&pkt_a);
+        tlog_pkt_cleanup(&pkt_b);
+    }
+    tlog_pkt_cleanup(&pkt_a);
+    tlog_pkt_cleanup(&pkt_b);
+
+#undef FAIL
+    return passed;
+}
+
+/**
+ * Parse a message text directly, and if the layout is expected, compare
+ * the result with the message initialized from the parsed object.
+ *
+ * @param name      Test name.
+ * @param text      Message text.
+ * @param exp_grc   Expected direct parsing return code.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test(const char *name, const char *text, tlog_grc exp_grc)
+{
+    bool passed = true;
+    struct tlog_json_msg_buf buf = {NULL, 0};
+    struct tlog_json_msg res_msg;
+    struct tlog_json_msg exp_msg;
+    struct json_object *obj = NULL;
+    tlog_grc res_grc;
+    tlog_grc obj_grc;
+
+    res_grc = tlog_json_msg_parse(&res_msg, &buf, text, strlen(text));
+    if (res_grc != exp_grc) {
+        fprintf(stderr, "%s: grc: %s != %s\n", name,
+                tlog_grc_strerror(res_grc), tlog_grc_strerror(exp_grc));
+        passed = false;
+    } else if (res_grc != TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED) {
+        obj = json_tokener_parse(text);
+        if (obj == NULL) {
+            fprintf(stderr, "%s: not valid JSON\n", name);
+            passed = false;
+        } else {
+            obj_grc = tlog_json_msg_init(&exp_msg, obj);
+            if (obj_grc != res_grc) {
+                fprintf(stderr, "%s: object grc: %s != %s\n", name,
+                        tlog_grc_strerror(obj_grc),
+                        tlog_grc_strerror(res_grc));
+                passed = false;
+            } else if (res_grc == TLOG_RC_OK) {
+                passed = test_cmp(name, &res_msg, &exp_msg);
+                tlog_json_msg_cleanup(&exp_msg);
+            }
+            json_object_put(obj);
+        }
+    }
+    if (res_grc == TLOG_RC_OK) {
+        tlog_json_msg_cleanup(&res_msg);
+    }
+    tlog_json_msg_buf_cleanup(&buf);
+
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+/**
+ * Prematch a message text against a filter.
+ *
+ * @param name      Test name.
+ * @param filter    The filter to prematch against.
+ * @param text      Message text.
+ * @param exp       Expected prematching result.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_prematch(const char *name, struct tlog_json_msg_filter filter,
+              const char *text, bool exp)
+{
+    bool res = tlog_json_msg_filter_prematch(&filter, text, strlen(text));
+    bool passed = res == exp;
+
+    if (!passed) {
+        fprintf(stderr, "%s: result: %s != %s\n", name,
+                (res ? "true" : "false"), (exp ? "true" : "false"));
+    }
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define FIELDS(_ver, _session, _pos, _timing, \
+               _in_txt, _in_bin, _out_txt, _out_bin)                \
+    "\"ver\":" _ver ",\"host\":\"localhost\",\"user\":\"user\","    \
+    "\"term\":\"xterm\",\"session\":" _session ",\"id\":1,"         \
+    "\"pos\":" _pos ",\"timing\":\"" _timing "\","                  \
+    "\"in_txt\":\"" _in_txt "\",\"in_bin\":[" _in_bin "],"          \
+    "\"out_txt\":\"" _out_txt "\",\"out_bin\":[" _out_bin "]"
+
+#define MSG(_args...) "{" FIELDS(_args) "}"
+
+#define TEST(_name_token, _text, _exp_grc) \
+    do {                                                        \
+        passed = test(#_name_token, _text, _exp_grc) && passed; \
+    } while (0)
+
+#define TEST_OK(_name_token, _text) \
+    TEST(_name_token, _text, TLOG_RC_OK)
+
+#define TEST_UNEXPECTED(_name_token, _text) \
+    TEST(_name_token, _text, TLOG_RC_JSON_MSG_LAYOUT_UNEXPECTED)
+
+    TEST_OK(empty,
+            MSG("1", "1", "0", "", "", "", "", ""));
+    TEST_OK(output,
+            MSG("1", "1", "1234", "=80x24>5+10>3",
+                "", "", "hello", ""));
+    TEST_OK(input_output,
+            MSG("1", "2", "1000", "<2+1>3", "ab", "", "cde", ""));
+    TEST_OK(binary,
+            MSG("1", "1", "0", ">1/2<1/1", "", "255", "A", "0,128"));
+    TEST_OK(escapes,
+            MSG("1", "1", "0", ">9", "", "",
+                "\\\"\\\\\\/\\b\\f\\n\\r\\t\\u0000", ""));
+    TEST_OK(unicode_escapes,
+            MSG("1", "1", "0", ">4", "", "",
+                "\\u0041\\u0410\\u559c\\ud834\\udd1e", ""));
+    TEST_OK(utf8,
+            MSG("1", "1", "0", ">4", "", "",
+                "A\xd0\x90\xe5\x96\x9c\xf0\x9d\x84\x9e", ""));
+    TEST_OK(whitespace,
+            " { \"ver\" : 1 , \"host\" : \"h\" , \"user\" : \"u\" ,"
+            " \"term\" : \"t\" , \"session\" : 3 , \"id\" : 7 ,"
+            " \"pos\" : 5 , \"timing\" : \">1\" , \"in_txt\" : \"\" ,"
+            " \"in_bin\" : [ ] , \"out_txt\" : \"x\" ,"
+            " \"out_bin\" : [ 1 , 2 ] } ");
+    TEST_OK(reordered,
+            "{\"out_bin\":[],\"out_txt\":\"x\",\"in_bin\":[],"
+            "\"in_txt\":\"\",\"timing\":\">1\",\"pos\":0,\"id\":0,"
+            "\"session\":1,\"term\":\"t\",\"user\":\"u\",\"host\":\"h\","
+            "\"ver\":1}");
+    TEST_OK(trailing_text,
+            MSG("1", "1", "0", "", "", "", "", "") "\n{");
+
+    TEST(bad_ver,
+         MSG("2", "1", "0", "", "", "", "", ""),
+         TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_VER);
+    TEST(bad_session,
+         MSG("1", "0", "0", "", "", "", "", ""),
+         TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_SESSION);
+    TEST(bad_pos,
+         MSG("1", "1", "-1", "", "", "", "", ""),
+         TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_POS);
+
+    TEST_UNEXPECTED(not_object, "[]");
+    TEST_UNEXPECTED(truncated, "{\"ver\":1,\"host\":\"h\"");
+    TEST_UNEXPECTED(missing_field,
+                    "{\"ver\":1,\"host\":\"h\",\"user\":\"u\"}");
+    TEST_UNEXPECTED(unknown_field,
+                    "{\"x\":1,"
+                    FIELDS("1", "1", "0", "", "", "", "", "") "}");
+    TEST_UNEXPECTED(repeated_field,
+                    "{\"ver\":1,"
+                    FIELDS("1", "1", "0", "", "", "", "", "") "}");
+    TEST_UNEXPECTED(escaped_name,
+                    "{\"v\\u0065r\":1,"
+                    FIELDS("1", "1", "0", "", "", "", "", "") "}");
+    TEST_UNEXPECTED(float_pos,
+                    MSG("1", "1", "1.5", "", "", "", "", ""));
+    TEST_UNEXPECTED(exponent_pos,
+                    MSG("1", "1", "1e3", "", "", "", "", ""));
+    TEST_UNEXPECTED(leading_zero_pos,
+                    MSG("1", "1", "01", "", "", "", "", ""));
+    TEST_UNEXPECTED(long_pos,
+                    MSG("1", "1", "1234567890123456789",
+                        "", "", "", "", ""));
+    TEST_UNEXPECTED(overflowing_pos,
+                    MSG("1", "1", "99999999999999999999999999999999",
+                        "", "", "", "", ""));
+    TEST_UNEXPECTED(overflowing_bin,
+                    MSG("1", "1", "0", "", "", "", "",
+                        "18446744073709551616"));
+    TEST_UNEXPECTED(string_pos,
+                    MSG("1", "1", "\"1\"", "", "", "", "", ""));
+    TEST_UNEXPECTED(bin_out_of_range,
+                    MSG("1", "1", "0", "", "", "", "", "256"));
+    TEST_UNEXPECTED(bin_negative,
+                    MSG("1", "1", "0", "", "", "", "", "-1"));
+    TEST_UNEXPECTED(raw_control_char,
+                    MSG("1", "1", "0", "", "", "", "\t", ""));
+    TEST_UNEXPECTED(lone_low_surrogate,
+                    MSG("1", "1", "0", "", "", "", "\\udd1e", ""));
+    TEST_UNEXPECTED(lone_high_surrogate,
+                    MSG("1", "1", "0", "", "", "", "\\ud834", ""));
+    TEST_UNEXPECTED(bad_escape,
+                    MSG("1", "1", "0", "", "", "", "\\x", ""));
+
+#define FILTER(_host, _user, _session) \
+    ((struct tlog_json_msg_filter){_host, _user, _session})
+
+#define TEST_PREMATCH(_name_token, _filter, _text, _exp) \
+    do {                                                                \
+        passed = test_prematch("prematch_" #_name_token,                \
+                               _filter, _text, _exp) && passed;         \
+    } while (0)
+
+#define PREMATCH_MSG    MSG("1", "1", "0", "", "", "", "", "")
+
+    TEST_PREMATCH(any, FILTER(NULL, NULL, 0), PREMATCH_MSG, true);
+    TEST_PREMATCH(all_match, FILTER("localhost", "user", 1),
+                  PREMATCH_MSG, true);
+    TEST_PREMATCH(session_mismatch, FILTER(NULL, NULL, 2),
+                  PREMATCH_MSG, false);
+    TEST_PREMATCH(session_prefix, FILTER(NULL, NULL, 10),
+                  PREMATCH_MSG, false);
+    TEST_PREMATCH(host_mismatch, FILTER("otherhost", NULL, 0),
+                  PREMATCH_MSG, false);
+    TEST_PREMATCH(host_prefix, FILTER("local", NULL, 0),
+                  PREMATCH_MSG, false);
+    TEST_PREMATCH(host_longer, FILTER("localhost2", NULL, 0),
+                  PREMATCH_MSG, false);
+    TEST_PREMATCH(user_mismatch, FILTER(NULL, "root", 0),
+                  PREMATCH_MSG, false);
+    TEST_PREMATCH(missing_fields, FILTER("h", "u", 1),
+                  "{\"ver\":1}", true);
+    TEST_PREMATCH(spaced_key, FILTER(NULL, NULL, 2),
+                  "{\"session\" : 1}", true);
+    TEST_PREMATCH(spaced_value, FILTER(NULL, NULL, 2),
+                  "{\"session\": 1}", false);
+    TEST_PREMATCH(escaped_value, FILTER("localhost", NULL, 0),
+                  "{\"host\":\"l\\u006fcalhost\"}", true);
+    TEST_PREMATCH(escaped_after_mismatch, FILTER("otherhost", NULL, 0),
+                  "{\"host\":\"l\\u006fcalhost\"}", false);
+    TEST_PREMATCH(repeated_field, FILTER(NULL, NULL, 1),
+                  "{\"x\":{\"session\":2},\"session\":1}", true);
+    TEST_PREMATCH(float_session, FILTER(NULL, NULL, 2),
+                  "{\"session\":1.0}", true);
+    TEST_PREMATCH(zero_session, FILTER(NULL, NULL, 2),
+                  "{\"session\":0}", true);
+    TEST_PREMATCH(string_session, FILTER(NULL, NULL, 2),
+                  "{\"session\":\"1\"}", true);
+    TEST_PREMATCH(field_in_value, FILTER(NULL, NULL, 1),
+                  "{\"out_txt\":\"\\\"session\\\":2\",\"session\":1}",
+                  true);
+
+    return !passed;
+}
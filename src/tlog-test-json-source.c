@@ -450,6 +450,26 @@ main(void)
          )
     );
 
+#define DELAY_8MS "+1+1+1+1+1+1+1+1"
+#define DELAY_64MS \
+    DELAY_8MS DELAY_8MS DELAY_8MS DELAY_8MS \
+    DELAY_8MS DELAY_8MS DELAY_8MS DELAY_8MS
+    TEST(io_long_timing,
+         INPUT(MSG_DUMMY(1, "1000", DELAY_64MS "+1>1" DELAY_64MS "<1+1=1",
+                         "B", "", "A", "")),
+         OUTPUT(
+            .io_size = 4,
+            .op_list = {
+                OP_READ_OK(PKT_IO_STR(1, 65000000, true, "A")),
+                OP_READ_OK(PKT_IO_STR(1, 129000000, false, "B")),
+                OP_READ(TLOG_RC_JSON_MSG_FIELD_INVALID_VALUE_TIMING,
+                        PKT_VOID),
+            }
+         )
+    );
+#undef DELAY_64MS
+#undef DELAY_8MS
+
     TEST(io_mixed_bin,
          INPUT(MSG_DUMMY(1, "1000", "[0/1]0/1[0/1]0/1",
                          "", "65,67", "", "66,68")),
@@ -743,6 +763,19 @@ main(void)
          )
     );
 
+    TEST(io_out_split_bin,
+         INPUT(MSG_DUMMY(1, "1000", "]0/6>1", "", "", "G",
+                         "65,66,67,68,69,70")),
+         OUTPUT(
+            .io_size = 4,
+            .op_list = {
+                OP_READ_OK(PKT_IO_STR(1, 0, true, "ABCD")),
+                OP_READ_OK(PKT_IO_STR(1, 0, true, "EFG")),
+                OP_READ_OK(PKT_VOID)
+            }
+         )
+    );
+
     TEST(io_in_short_bin,
          INPUT(MSG_DUMMY(1, "1000", "[0/2", "", "48", "", "")),
          OUTPUT(
@@ -0,0 +1,508 @@
+/*
+ * Tlog tlog_mmap_json_reader parallel parsing test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <tlog/rc.h>
+#include <tlog/mmap_json_reader.h>
+
+/** Number of lines in the generated log */
+#define LINE_NUM    20000
+
+/** Size of the zero-filled tail preallocated by a memory-mapped writer */
+#define PAD_SIZE    (4 * 1024 * 1024)
+
+/** Result of reading a message */
+struct res {
+    tlog_grc    grc;        /**< Return code */
+    size_t      id;         /**< Message ID, if read successfully */
+    unsigned int session;   /**< Session ID, if read successfully */
+    size_t      loc;        /**< Location after reading */
+};
+
+/**
+ * Write text to a file, exiting on failure.
+ *
+ * @param fd    The file descriptor to write to.
+ * @param text  The text to write.
+ */
+static void
+write_text(int fd, const char *text)
+{
+    size_t len = strlen(text);
+    if (write(fd, text, len) != (ssize_t)len) {
+        fprintf(stderr, "Failed writing the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+}
+
+/**
+ * Write a generated log to a file: interleaved sessions, with blank
+ * lines, messages needing parsing into objects, and invalid lines.
+ *
+ * @param fd    The file descriptor to write to.
+ * @param start Number of the first line to write.
+ * @param end   Number of the line to stop before.
+ */
+static void
+write_log(int fd, size_t start, size_t end)
+{
+    char buf[256];
+    size_t i;
+
+    for (i = start; i < end; i++) {
+        if (i % 997 == 0) {
+            write_text(fd, " \n\t\n");
+        }
+        if (i % 1009 == 0) {
+            write_text(fd, "{\"ver\":1,\"host\":\n");
+            continue;
+        }
+        snprintf(buf, sizeof(buf),
+                 "{%s\"ver\":1,\"host\":\"localhost\",\"user\":\"user\","
+                 "\"term\":\"xterm\",\"session\":%zu,\"id\":%zu,"
+                 "\"pos\":%zu,\"timing\":\">5\",\"in_txt\":\"\","
+                 "\"in_bin\":[],\"out_txt\":\"hello\",\"out_bin\":[]}\n",
+                 (i % 101 == 0 ? "\"x\":0," : ""),
+                 i % 3 + 1, i / 3 + 1, i);
+        write_text(fd, buf);
+    }
+}
+
+/**
+ * Read a number of messages from a reader.
+ *
+ * @param reader    The reader to read from.
+ * @param filter    The filter to read with, or NULL.
+ * @param res_list  The result list to append to.
+ * @param pres_num  Location of the number of results in the list.
+ * @param num       The maximum number of results to append.
+ */
+static void
+read_some(struct tlog_json_reader *reader,
+          const struct tlog_json_msg_filter *filter,
+          struct res *res_list, size_t *pres_num, size_t num)
+{
+    struct tlog_json_msg msg = {NULL, };
+    struct res *res;
+
+    for (; num > 0; num--) {
+        res = &res_list[*pres_num];
+        res->grc = tlog_json_reader_read_msg(reader, filter, &msg);
+        res->loc = tlog_json_reader_loc_get(reader);
+        if (res->grc == TLOG_RC_OK) {
+            if (tlog_json_msg_is_void(&msg)) {
+                break;
+            }
+            res->id = msg.id;
+            res->session = msg.session;
+            tlog_json_msg_cleanup(&msg);
+        }
+        (*pres_num)++;
+    }
+}
+
+/**
+ * Read all the messages from a reader.
+ *
+ * @param reader    The reader to read from.
+ * @param filter    The filter to read with, or NULL.
+ * @param res_list  The result list to append to.
+ * @param pres_num  Location of the number of results in the list.
+ */
+static void
+read_all(struct tlog_json_reader *reader,
+         const struct tlog_json_msg_filter *filter,
+         struct res *res_list, size_t *pres_num)
+{
+    read_some(reader, filter, res_list, pres_num, SIZE_MAX);
+}
+
+/**
+ * Read a log file, growing it in the middle, and then truncating and
+ * rewriting it, with the specified number of threads.
+ *
+ * @param threads   Number of threads to parse messages with.
+ * @param filter    The filter to read with, or NULL.
+ * @param res_list  The result list to fill.
+ *
+ * @return Number of results in the list.
+ */
+static size_t
+read_log(unsigned int threads,
+         const struct tlog_json_msg_filter *filter,
+         struct res *res_list)
+{
+    char filename[] = "tlog-test-mmap-json-reader.XXXXXX";
+    int fd;
+    tlog_grc grc;
+    struct tlog_json_reader *reader = NULL;
+    size_t res_num = 0;
+
+    fd = mkstemp(filename);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening a temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    if (unlink(filename) < 0) {
+        fprintf(stderr, "Failed unlinking the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    write_log(fd, 0, LINE_NUM / 2);
+
+    grc = tlog_mmap_json_reader_create(&reader, fd, false, threads,
+                                       NULL, 0);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating mmap reader: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+    read_all(reader, filter, res_list, &res_num);
+    write_log(fd, LINE_NUM / 2, LINE_NUM);
+    read_all(reader, filter, res_list, &res_num);
+    if (ftruncate(fd, 0) < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+        fprintf(stderr, "Failed truncating the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    write_log(fd, 0, LINE_NUM / 4);
+    read_all(reader, filter, res_list, &res_num);
+
+    tlog_json_reader_destroy(reader);
+    close(fd);
+    return res_num;
+}
+
+/**
+ * Read a log file being appended by a memory-mapped writer: growing into
+ * a zero-filled tail, with the last line incomplete, with zeros left in
+ * the middle by a crash, and finally with the tail truncated. Then read
+ * the resulting file over, in order.
+ *
+ * @param threads   Number of threads to parse messages with.
+ * @param res_list  The result list to fill.
+ * @param exp_list  The result list to fill with reading the file over.
+ * @param pexp_num  Location for the number of results in exp_list.
+ *
+ * @return Number of results in res_list.
+ */
+static size_t
+read_padded_log(unsigned int threads,
+                struct res *res_list,
+                struct res *exp_list, size_t *pexp_num)
+{
+    char filename[] = "tlog-test-mmap-json-reader.XXXXXX";
+    int fd;
+    off_t end;
+    tlog_grc grc;
+    struct tlog_json_reader *reader = NULL;
+    size_t res_num = 0;
+
+    fd = mkstemp(filename);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening a temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    if (unlink(filename) < 0) {
+        fprintf(stderr, "Failed unlinking the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+
+#define GROW(_size) \
+    do {                                                                \
+        if (ftruncate(fd, (_size)) < 0) {                               \
+            fprintf(stderr, "Failed resizing the temporary file: %s\n", \
+                    strerror(errno));                                   \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+#define CREATE(_preader, _threads) \
+    do {                                                                \
+        grc = tlog_mmap_json_reader_create(_preader, fd, false,         \
+                                           _threads, NULL, 0);          \
+        if (grc != TLOG_RC_OK) {                                        \
+            fprintf(stderr, "Failed creating mmap reader: %s\n",        \
+                    tlog_grc_strerror(grc));                            \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+    write_log(fd, 0, LINE_NUM / 4);
+    GROW(lseek(fd, 0, SEEK_CUR) + PAD_SIZE);
+    CREATE(&reader, threads);
+    read_all(reader, NULL, res_list, &res_num);
+
+    /* Fill some of the tail, leaving the last line incomplete */
+    write_log(fd, LINE_NUM / 4, LINE_NUM / 2);
+    write_text(fd, "{\"ver\":1,");
+    read_all(reader, NULL, res_list, &res_num);
+    write_text(fd, "\"host\":\n");
+    read_all(reader, NULL, res_list, &res_num);
+
+    /* Crash, leaving zeros, and go on after them */
+    end = lseek(fd, 4096, SEEK_CUR);
+    GROW(end + PAD_SIZE);
+    write_log(fd, LINE_NUM / 2, LINE_NUM);
+    read_all(reader, NULL, res_list, &res_num);
+
+    /* Close, truncating the tail */
+    GROW(lseek(fd, 0, SEEK_CUR));
+    read_all(reader, NULL, res_list, &res_num);
+    tlog_json_reader_destroy(reader);
+
+    CREATE(&reader, 0);
+    read_all(reader, NULL, exp_list, pexp_num);
+    tlog_json_reader_destroy(reader);
+
+#undef CREATE
+#undef GROW
+
+    close(fd);
+    return res_num;
+}
+
+/**
+ * Read a log file, truncating it externally in the middle, below the
+ * pages being read, and writing a shorter log into it. Then read the
+ * resulting file over, in order.
+ *
+ * @param threads   Number of threads to parse messages with.
+ * @param res_list  The result list to fill.
+ * @param exp_list  The result list to fill with reading the file over.
+ * @param pexp_num  Location for the number of results in exp_list.
+ *
+ * @return Number of results in res_list.
+ */
+static size_t
+read_truncated_log(unsigned int threads,
+                   struct res *res_list,
+                   struct res *exp_list, size_t *pexp_num)
+{
+    char filename[] = "tlog-test-mmap-json-reader.XXXXXX";
+    int fd;
+    tlog_grc grc;
+    struct tlog_json_reader *reader = NULL;
+    size_t res_num = 0;
+
+    fd = mkstemp(filename);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening a temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    if (unlink(filename) < 0) {
+        fprintf(stderr, "Failed unlinking the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+
+#define CREATE(_preader, _threads) \
+    do {                                                                \
+        grc = tlog_mmap_json_reader_create(_preader, fd, false,         \
+                                           _threads, NULL, 0);          \
+        if (grc != TLOG_RC_OK) {                                        \
+            fprintf(stderr, "Failed creating mmap reader: %s\n",        \
+                    tlog_grc_strerror(grc));                            \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+    write_log(fd, 0, LINE_NUM);
+    CREATE(&reader, threads);
+    read_some(reader, NULL, res_list, &res_num, LINE_NUM / 100);
+
+    /* Truncate below the reading position, not waiting for the end */
+    if (ftruncate(fd, 0) < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+        fprintf(stderr, "Failed truncating the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    write_log(fd, 0, LINE_NUM / 400);
+    read_all(reader, NULL, res_list, &res_num);
+    tlog_json_reader_destroy(reader);
+
+    CREATE(&reader, 0);
+    read_all(reader, NULL, exp_list, pexp_num);
+    tlog_json_reader_destroy(reader);
+
+#undef CREATE
+
+    close(fd);
+    return res_num;
+}
+
+/**
+ * Compare results of reading a log.
+ *
+ * @param name      Test name.
+ * @param res_list  The results of reading.
+ * @param res_num   Number of results.
+ * @param exp_list  The expected results.
+ * @param exp_num   Number of expected results.
+ *
+ * @return True if the results match, false otherwise.
+ */
+static bool
+compare(const char *name,
+        const struct res *res_list, size_t res_num,
+        const struct res *exp_list, size_t exp_num)
+{
+    bool passed = true;
+    size_t i;
+
+    if (res_num != exp_num) {
+        fprintf(stderr, "%s: result number: %zu != %zu\n",
+                name, res_num, exp_num);
+        passed = false;
+    }
+    for (i = 0; passed && i < res_num; i++) {
+        if (res_list[i].grc != exp_list[i].grc ||
+            res_list[i].loc != exp_list[i].loc ||
+            (res_list[i].grc == TLOG_RC_OK &&
+             (res_list[i].id != exp_list[i].id ||
+              res_list[i].session != exp_list[i].session))) {
+            fprintf(stderr,
+                    "%s: result #%zu: "
+                    "%s, id %zu, session %u, loc %zu != "
+                    "%s, id %zu, session %u, loc %zu\n",
+                    name, i,
+                    tlog_grc_strerror(res_list[i].grc), res_list[i].id,
+                    res_list[i].session, res_list[i].loc,
+                    tlog_grc_strerror(exp_list[i].grc), exp_list[i].id,
+                    exp_list[i].session, exp_list[i].loc);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+/**
+ * Compare reading a log in parallel with reading it in order.
+ *
+ * @param name      Test name.
+ * @param threads   Number of threads to parse messages with.
+ * @param filter    The filter to read with, or NULL.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test(const char *name, unsigned int threads,
+     const struct tlog_json_msg_filter *filter)
+{
+    static struct res exp_list[LINE_NUM * 2];
+    static struct res res_list[LINE_NUM * 2];
+    bool passed = true;
+    size_t exp_num;
+    size_t res_num;
+
+    exp_num = read_log(0, filter, exp_list);
+    res_num = read_log(threads, filter, res_list);
+
+    if (exp_num == 0 || exp_list[exp_num - 1].loc >= LINE_NUM / 2) {
+        fprintf(stderr, "%s: truncated log was not read over\n", name);
+        passed = false;
+    }
+    passed = compare(name, res_list, res_num, exp_list, exp_num) && passed;
+
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+/**
+ * Compare reading a log being appended by a memory-mapped writer with
+ * reading it over once it is complete.
+ *
+ * @param name      Test name.
+ * @param threads   Number of threads to parse messages with.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_padded(const char *name, unsigned int threads)
+{
+    static struct res exp_list[LINE_NUM * 2];
+    static struct res res_list[LINE_NUM * 2];
+    bool passed;
+    size_t exp_num = 0;
+    size_t res_num;
+
+    res_num = read_padded_log(threads, res_list, exp_list, &exp_num);
+    passed = compare(name, res_list, res_num, exp_list, exp_num);
+
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+/**
+ * Check that reading a log truncated externally in the middle doesn't
+ * crash, and ends with reading the truncated log over.
+ *
+ * @param name      Test name.
+ * @param threads   Number of threads to parse messages with.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_truncated(const char *name, unsigned int threads)
+{
+    static struct res exp_list[LINE_NUM * 2];
+    static struct res res_list[LINE_NUM * 2];
+    bool passed;
+    size_t exp_num = 0;
+    size_t res_num;
+
+    res_num = read_truncated_log(threads, res_list, exp_list, &exp_num);
+    passed = res_num >= LINE_NUM / 100 + exp_num &&
+             compare(name, res_list + res_num - exp_num, exp_num,
+                     exp_list, exp_num);
+
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+    const struct tlog_json_msg_filter filter = {"localhost", NULL, 2};
+
+    passed = test("one_thread", 1, NULL) && passed;
+    passed = test("two_threads", 2, NULL) && passed;
+    passed = test("seven_threads", 7, NULL) && passed;
+    passed = test("filtered", 4, &filter) && passed;
+    passed = test_padded("padded", 0) && passed;
+    passed = test_padded("padded_threads", 4) && passed;
+    passed = test_truncated("truncated", 0) && passed;
+    passed = test_truncated("truncated_threads", 4) && passed;
+
+    return !passed;
+}
@@ -0,0 +1,347 @@
+/*
+ * Tlog tlog_mmap_json_writer test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <tlog/rc.h>
+#include <tlog/mmap_json_writer.h>
+#include <tlog/misc.h>
+#include <tlog/test_misc.h>
+
+/** A hundred bytes of a message */
+#define X100 "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx" \
+             "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+
+/** A thousand bytes of a message, including the newline */
+#define X1000 X100 X100 X100 X100 X100 X100 X100 X100 X100 \
+              "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx" \
+              "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\n"
+
+enum op_type {
+    OP_TYPE_NONE,
+    OP_TYPE_WRITE,
+    OP_TYPE_REOPEN,
+    OP_TYPE_LOCK,
+    OP_TYPE_CHECK,
+    OP_TYPE_NUM
+};
+
+static const char*
+op_type_to_str(enum op_type t)
+{
+    switch (t) {
+    case OP_TYPE_NONE:
+        return "none";
+    case OP_TYPE_WRITE:
+        return "write";
+    case OP_TYPE_REOPEN:
+        return "reopen";
+    case OP_TYPE_LOCK:
+        return "lock";
+    case OP_TYPE_CHECK:
+        return "check";
+    default:
+        return "<unknown>";
+    }
+}
+
+struct op {
+    enum op_type    type;
+    const char     *msg;        /**< Message to write, or expected
+                                     file contents to check */
+    tlog_grc        exp_grc;    /**< Expected return code */
+};
+
+struct test {
+    size_t          extent;         /**< Extent size */
+    const char     *init;           /**< Initial file contents, or NULL
+                                         for no file */
+    const char     *crash_list[8];  /**< Messages to write before crashing,
+                                         before the operations */
+    struct op       op_list[16];    /**< Operations */
+    const char     *exp_content;    /**< Expected file contents */
+};
+
+/**
+ * Read a whole file into a static buffer.
+ *
+ * @param path  Path to the file to read.
+ * @param plen  Location for the file length.
+ *
+ * @return The file contents.
+ */
+static const char *
+read_file(const char *path, size_t *plen)
+{
+    static char buf[16384];
+    ssize_t rc;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening \"%s\": %s\n",
+                path, strerror(errno));
+        exit(1);
+    }
+    rc = read(fd, buf, sizeof(buf));
+    if (rc < 0 || (size_t)rc == sizeof(buf)) {
+        fprintf(stderr, "Failed reading \"%s\"\n", path);
+        exit(1);
+    }
+    close(fd);
+    *plen = (size_t)rc;
+    return buf;
+}
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    char dir[] = "/tmp/tlog-test-mmap-XXXXXX";
+    char path[64];
+    struct tlog_json_writer *writer = NULL;
+    struct tlog_json_writer *other_writer = NULL;
+    const struct op *op;
+    const char * const *pmsg;
+    const char *content;
+    size_t content_len;
+    pid_t pid;
+    int status;
+    int fd;
+
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Failed creating temporary directory: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "%s/log", dir);
+
+    if (t.init != NULL) {
+        fd = open(path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+        if (fd < 0 ||
+            write(fd, t.init, strlen(t.init)) != (ssize_t)strlen(t.init)) {
+            fprintf(stderr, "Failed creating log file: %s\n",
+                    strerror(errno));
+            exit(1);
+        }
+        close(fd);
+    }
+
+#define CREATE(_pwriter) \
+    do {                                                                \
+        grc = tlog_mmap_json_writer_create(_pwriter, path, t.extent);   \
+        if (grc != TLOG_RC_OK) {                                        \
+            fprintf(stderr, "Failed creating mmap writer: %s\n",        \
+                    tlog_grc_strerror(grc));                            \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+    /* Write messages and exit without cleanup, in a child */
+    if (t.crash_list[0] != NULL) {
+        pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Failed forking: %s\n", strerror(errno));
+            exit(1);
+        } else if (pid == 0) {
+            CREATE(&writer);
+            for (pmsg = t.crash_list; *pmsg != NULL; pmsg++) {
+                tlog_json_writer_write(writer, (const uint8_t *)*pmsg,
+                                       strlen(*pmsg));
+            }
+            _exit(0);
+        }
+        waitpid(pid, &status, 0);
+    }
+
+    CREATE(&writer);
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+#define FAIL_OP(_fmt, _args...) \
+    FAIL("op #%zd (%s): " _fmt,                                 \
+         op - t.op_list + 1, op_type_to_str(op->type), ##_args)
+
+#define CHECK_CONTENT(_exp, _fail_args...) \
+    do {                                                                \
+        content = read_file(path, &content_len);                        \
+        if (content_len != strlen(_exp) ||                              \
+            memcmp(content, _exp, content_len) != 0) {                  \
+            _fail_args;                                                 \
+            tlog_test_diff(stderr,                                      \
+                           (const uint8_t *)content, content_len,       \
+                           (const uint8_t *)_exp, strlen(_exp));        \
+        }                                                               \
+    } while (0)
+
+    for (op = t.op_list; op->type != OP_TYPE_NONE; op++) {
+        grc = TLOG_RC_OK;
+        switch (op->type) {
+        case OP_TYPE_WRITE:
+            grc = tlog_json_writer_write(writer, (const uint8_t *)op->msg,
+                                         strlen(op->msg));
+            break;
+        case OP_TYPE_REOPEN:
+            tlog_json_writer_destroy(writer);
+            CREATE(&writer);
+            break;
+        case OP_TYPE_LOCK:
+            grc = tlog_mmap_json_writer_create(&other_writer, path,
+                                               t.extent);
+            tlog_json_writer_destroy(other_writer);
+            other_writer = NULL;
+            break;
+        case OP_TYPE_CHECK:
+            /* Only check the beginning, the tail is not truncated yet */
+            content = read_file(path, &content_len);
+            if (content_len < strlen(op->msg) ||
+                memcmp(content, op->msg, strlen(op->msg)) != 0) {
+                FAIL_OP("content mismatch:");
+                tlog_test_diff(stderr,
+                               (const uint8_t *)content, content_len,
+                               (const uint8_t *)op->msg, strlen(op->msg));
+            }
+            break;
+        default:
+            fprintf(stderr, "Unknown operation type: %d\n", op->type);
+            exit(1);
+        }
+        if (grc != op->exp_grc) {
+            FAIL_OP("grc: %s (%d) != %s (%d)",
+                    tlog_grc_strerror(grc), grc,
+                    tlog_grc_strerror(op->exp_grc), op->exp_grc);
+        }
+    }
+
+#undef FAIL_OP
+#undef CREATE
+
+    tlog_json_writer_destroy(writer);
+
+    CHECK_CONTENT(t.exp_content, FAIL("content mismatch:"));
+
+#undef CHECK_CONTENT
+#undef FAIL
+
+    unlink(path);
+    rmdir(dir);
+
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define OP_WRITE(_msg) \
+    {.type = OP_TYPE_WRITE, .msg = _msg, .exp_grc = TLOG_RC_OK}
+
+#define OP_REOPEN \
+    {.type = OP_TYPE_REOPEN, .exp_grc = TLOG_RC_OK}
+
+#define OP_LOCK(_exp_grc) \
+    {.type = OP_TYPE_LOCK, .exp_grc = _exp_grc}
+
+#define OP_CHECK(_msg) \
+    {.type = OP_TYPE_CHECK, .msg = _msg, .exp_grc = TLOG_RC_OK}
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+    TEST(nothing,
+         .extent = 4096,
+         .exp_content = "");
+
+    TEST(nothing_existing,
+         .extent = 4096,
+         .init = "a\n",
+         .exp_content = "a\n");
+
+    TEST(one,
+         .extent = 4096,
+         .op_list = {OP_WRITE("a\n"),
+                     OP_CHECK("a\n")},
+         .exp_content = "a\n");
+
+    TEST(append,
+         .extent = 4096,
+         .init = "a\n",
+         .op_list = {OP_WRITE("b\n"),
+                     OP_REOPEN,
+                     OP_WRITE("c\n")},
+         .exp_content = "a\nb\nc\n");
+
+    TEST(extents,
+         .extent = 4096,
+         .op_list = {OP_WRITE("1" X1000),
+                     OP_WRITE("2" X1000),
+                     OP_WRITE("3" X1000),
+                     OP_WRITE("4" X1000),
+                     OP_WRITE("5" X1000),
+                     OP_CHECK("1" X1000 "2" X1000 "3" X1000
+                              "4" X1000 "5" X1000),
+                     OP_REOPEN,
+                     OP_WRITE("6" X1000)},
+         .exp_content = "1" X1000 "2" X1000 "3" X1000
+                        "4" X1000 "5" X1000 "6" X1000);
+
+    TEST(larger_than_extent,
+         .extent = 4096,
+         .init = "a\n",
+         .op_list = {OP_WRITE(X1000 X1000 X1000 X1000 X1000),
+                     OP_WRITE("b\n")},
+         .exp_content = "a\n" X1000 X1000 X1000 X1000 X1000 "b\n");
+
+    TEST(crash,
+         .extent = 4096,
+         .init = "a\n",
+         .crash_list = {"b\n", "c\n"},
+         .op_list = {OP_WRITE("d\n")},
+         .exp_content = "a\nb\nc\nd\n");
+
+    TEST(crash_nothing,
+         .extent = 4096,
+         .crash_list = {"a\n"},
+         .op_list = {OP_REOPEN},
+         .exp_content = "a\n");
+
+    TEST(locked,
+         .extent = 4096,
+         .op_list = {OP_WRITE("a\n"),
+                     OP_LOCK(TLOG_RC_MMAP_JSON_WRITER_LOCKED)},
+         .exp_content = "a\n");
+
+    return !passed;
+}
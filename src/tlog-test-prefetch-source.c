@@ -0,0 +1,266 @@
+/*
+ * Tlog tlog_prefetch_source test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <tlog/rc.h>
+#include <tlog/mmap_json_reader.h>
+#include <tlog/json_source.h>
+#include <tlog/prefetch_source.h>
+
+/** Number of messages in the generated log */
+#define MSG_NUM     2000
+
+/** Maximum number of results read */
+#define RES_MAX     (MSG_NUM * 4)
+
+/** Result of reading a packet */
+struct res {
+    tlog_grc        grc;    /**< Return code */
+    size_t          loc;    /**< Location before reading */
+    struct tlog_pkt pkt;    /**< Copy of the packet, if read successfully */
+};
+
+/**
+ * Write text to a file, exiting on failure.
+ *
+ * @param fd    The file descriptor to write to.
+ * @param text  The text to write.
+ */
+static void
+write_text(int fd, const char *text)
+{
+    size_t len = strlen(text);
+    if (write(fd, text, len) != (ssize_t)len) {
+        fprintf(stderr, "Failed writing the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+}
+
+/**
+ * Write generated messages to a file: window changes and output of
+ * varying length, some needing several packets.
+ *
+ * @param fd    The file descriptor to write to.
+ * @param start Index of the first message to write.
+ * @param end   Index of the message to stop before.
+ */
+static void
+write_log(int fd, size_t start, size_t end)
+{
+    static char text[6000];
+    char buf[sizeof(text) + 256];
+    size_t i;
+    size_t len;
+
+    for (i = start; i < end; i++) {
+        len = (i % 97 == 0) ? sizeof(text) - 1 : i % 50;
+        memset(text, 'a' + i % 26, len);
+        text[len] = '\0';
+        snprintf(buf, sizeof(buf),
+                 "{\"ver\":1,\"host\":\"localhost\",\"user\":\"user\","
+                 "\"term\":\"xterm\",\"session\":1,\"id\":%zu,"
+                 "\"pos\":%zu,\"timing\":\"%s>%zu\",\"in_txt\":\"\","
+                 "\"in_bin\":[],\"out_txt\":\"%s\",\"out_bin\":[]}\n",
+                 i + 1, i * 10, (i % 13 == 0 ? "=80x24" : ""),
+                 len, text);
+        write_text(fd, buf);
+    }
+}
+
+/**
+ * Read packets from a source, until the end of stream or an error.
+ *
+ * @param source    The source to read from.
+ * @param res_list  The result list to append to.
+ * @param pres_num  Location of the number of results in the list.
+ */
+static void
+read_all(struct tlog_source *source, struct res *res_list, size_t *pres_num)
+{
+    struct tlog_pkt pkt = TLOG_PKT_VOID;
+    struct res *res;
+    uint8_t *buf;
+
+    do {
+        if (*pres_num >= RES_MAX) {
+            fprintf(stderr, "Too many packets read\n");
+            exit(1);
+        }
+        res = &res_list[(*pres_num)++];
+        res->loc = tlog_source_loc_get(source);
+        res->grc = tlog_source_read(source, &pkt);
+        res->pkt = TLOG_PKT_VOID;
+        if (res->grc == TLOG_RC_OK && pkt.type == TLOG_PKT_TYPE_IO) {
+            buf = malloc(pkt.data.io.len);
+            if (buf == NULL) {
+                fprintf(stderr, "Failed allocating packet copy\n");
+                exit(1);
+            }
+            memcpy(buf, pkt.data.io.buf, pkt.data.io.len);
+            tlog_pkt_init_io(&res->pkt, &pkt.timestamp, pkt.data.io.output,
+                             buf, true, pkt.data.io.len);
+        } else if (res->grc == TLOG_RC_OK) {
+            res->pkt = pkt;
+        }
+        tlog_pkt_cleanup(&pkt);
+    } while (res->grc == TLOG_RC_OK && !tlog_pkt_is_void(&res->pkt));
+}
+
+/**
+ * Read a log file, growing it after reaching its end, and then appending
+ * an invalid message, optionally reading it ahead.
+ *
+ * @param size      Number of packets to read ahead, zero to read the
+ *                  source directly.
+ * @param res_list  The result list to fill.
+ *
+ * @return Number of results in the list.
+ */
+static size_t
+read_log(size_t size, struct res *res_list)
+{
+    char filename[] = "tlog-test-prefetch-source.XXXXXX";
+    int fd;
+    tlog_grc grc;
+    struct tlog_json_reader *reader = NULL;
+    struct tlog_source *source = NULL;
+    struct tlog_source *prefetch_source = NULL;
+    size_t res_num = 0;
+
+    fd = mkstemp(filename);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening a temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    if (unlink(filename) < 0) {
+        fprintf(stderr, "Failed unlinking the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    write_log(fd, 0, MSG_NUM / 2);
+
+    grc = tlog_mmap_json_reader_create(&reader, fd, false, 1, NULL, 0);
+    if (grc == TLOG_RC_OK) {
+        grc = tlog_json_source_create(&source, reader, true,
+                                      NULL, NULL, NULL, 0, 4096);
+        if (grc != TLOG_RC_OK) {
+            tlog_json_reader_destroy(reader);
+        }
+    }
+    if (grc == TLOG_RC_OK && size > 0) {
+        grc = tlog_prefetch_source_create(&prefetch_source, source,
+                                          true, size);
+        if (grc == TLOG_RC_OK) {
+            source = prefetch_source;
+        } else {
+            tlog_source_destroy(source);
+        }
+    }
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating the source: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+    read_all(source, res_list, &res_num);
+    write_log(fd, MSG_NUM / 2, MSG_NUM);
+    read_all(source, res_list, &res_num);
+    write_text(fd, "{\"ver\":1,\"host\":\n");
+    read_all(source, res_list, &res_num);
+
+    tlog_source_destroy(source);
+    close(fd);
+    return res_num;
+}
+
+/**
+ * Compare reading a log ahead with reading it directly.
+ *
+ * @param name  Test name.
+ * @param size  Number of packets to read ahead.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test(const char *name, size_t size)
+{
+    static struct res exp_list[RES_MAX];
+    static struct res res_list[RES_MAX];
+    bool passed = true;
+    size_t exp_num;
+    size_t res_num;
+    size_t i;
+
+    exp_num = read_log(0, exp_list);
+    res_num = read_log(size, res_list);
+
+    if (exp_num < MSG_NUM / 2 || exp_list[exp_num - 1].grc == TLOG_RC_OK) {
+        fprintf(stderr, "%s: the log was not read to the error\n", name);
+        passed = false;
+    }
+    if (res_num != exp_num) {
+        fprintf(stderr, "%s: result number: %zu != %zu\n",
+                name, res_num, exp_num);
+        passed = false;
+    }
+    for (i = 0; passed && i < res_num; i++) {
+        if (res_list[i].grc != exp_list[i].grc ||
+            res_list[i].loc != exp_list[i].loc ||
+            !tlog_pkt_is_equal(&res_list[i].pkt, &exp_list[i].pkt)) {
+            fprintf(stderr,
+                    "%s: result #%zu: %s, loc %zu != %s, loc %zu, "
+                    "or packets differ\n",
+                    name, i,
+                    tlog_grc_strerror(res_list[i].grc), res_list[i].loc,
+                    tlog_grc_strerror(exp_list[i].grc), exp_list[i].loc);
+            passed = false;
+        }
+    }
+
+    for (i = 0; i < exp_num; i++) {
+        tlog_pkt_cleanup(&exp_list[i].pkt);
+    }
+    for (i = 0; i < res_num; i++) {
+        tlog_pkt_cleanup(&res_list[i].pkt);
+    }
+
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+    passed = test("one", 1) && passed;
+    passed = test("two", 2) && passed;
+    passed = test("seven", 7) && passed;
+    passed = test("many", 256) && passed;
+
+    return !passed;
+}
@@ -0,0 +1,276 @@
+/*
+ * Tlog terminal screen model test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <tlog/rc.h>
+#include <tlog/screen.h>
+
+/**
+ * Create a screen and write output to it, exiting on failure.
+ *
+ * @param width     Screen width.
+ * @param height    Screen height.
+ * @param output    The output to write.
+ *
+ * @return The created screen.
+ */
+static struct tlog_screen *
+create(unsigned short int width, unsigned short int height,
+       const char *output)
+{
+    tlog_grc grc;
+    struct tlog_screen *screen;
+
+    grc = tlog_screen_create(&screen, width, height);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating a screen: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+    tlog_screen_write(screen, (const uint8_t *)output, strlen(output));
+    return screen;
+}
+
+/**
+ * Check the text of a screen after writing output to it.
+ *
+ * @param name      Test name.
+ * @param width     Screen width.
+ * @param height    Screen height.
+ * @param output    The output to write.
+ * @param exp       The expected screen text.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_text(const char *name,
+          unsigned short int width, unsigned short int height,
+          const char *output, const char *exp)
+{
+    tlog_grc grc;
+    struct tlog_screen *screen;
+    char *text = NULL;
+    size_t len;
+    bool passed;
+
+    screen = create(width, height, output);
+    grc = tlog_screen_text(screen, &text, &len);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "%s: failed rendering text: %s\n",
+                name, tlog_grc_strerror(grc));
+        passed = false;
+    } else {
+        passed = len == strlen(exp) && memcmp(text, exp, len) == 0;
+        if (!passed) {
+            fprintf(stderr, "%s: text mismatch:\n%.*s\nexpected:\n%s\n",
+                    name, (int)len, text, exp);
+        }
+    }
+
+    free(text);
+    tlog_screen_destroy(screen);
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+/**
+ * Check if two sets of attributes are equal.
+ *
+ * @param a     The first set.
+ * @param b     The second set.
+ *
+ * @return True if the sets are equal, false otherwise.
+ */
+static bool
+attr_eq(const struct tlog_screen_attr *a, const struct tlog_screen_attr *b)
+{
+    return a->fg == b->fg && a->bg == b->bg && a->flags == b->flags;
+}
+
+/**
+ * Check if the cells of two screens of the same size are equal.
+ *
+ * @param a     The first screen.
+ * @param b     The second screen.
+ * @param alt   True to compare the alternate screen cells, false to compare
+ *              the main screen cells.
+ *
+ * @return True if the cells are equal, false otherwise.
+ */
+static bool
+cells_eq(const struct tlog_screen *a, const struct tlog_screen *b, bool alt)
+{
+    size_t i;
+
+    for (i = 0; i < (size_t)a->width * a->height; i++) {
+        if (a->cells[alt][i].ch != b->cells[alt][i].ch ||
+            !attr_eq(&a->cells[alt][i].attr, &b->cells[alt][i].attr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check that rendering a screen and writing the result to a blank screen
+ * reproduces it.
+ *
+ * @param name      Test name.
+ * @param width     Screen width.
+ * @param height    Screen height.
+ * @param output    The output to write to the original screen.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_render(const char *name,
+            unsigned short int width, unsigned short int height,
+            const char *output)
+{
+    tlog_grc grc;
+    struct tlog_screen *orig;
+    struct tlog_screen *copy;
+    struct tlog_screen *repr;
+    char *buf = NULL;
+    size_t len;
+    bool passed = true;
+
+    orig = create(width, height, output);
+    grc = tlog_screen_copy(&copy, orig);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "%s: failed copying: %s\n",
+                name, tlog_grc_strerror(grc));
+        exit(1);
+    }
+    /* Check that the copy is reproduced, and works on its own */
+    tlog_screen_destroy(orig);
+    grc = tlog_screen_render(copy, &buf, &len);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "%s: failed rendering: %s\n",
+                name, tlog_grc_strerror(grc));
+        exit(1);
+    }
+    repr = create(width, height, "garbage\033[?1049h\033[1;2r\033[7m");
+    tlog_screen_write(repr, (const uint8_t *)buf, len);
+
+    if (!cells_eq(repr, copy, false)) {
+        fprintf(stderr, "%s: main screen mismatch\n", name);
+        passed = false;
+    }
+    if (copy->alt && !cells_eq(repr, copy, true)) {
+        fprintf(stderr, "%s: alternate screen mismatch\n", name);
+        passed = false;
+    }
+    if (repr->alt != copy->alt ||
+        repr->cursor.x != copy->cursor.x ||
+        repr->cursor.y != copy->cursor.y ||
+        !attr_eq(&repr->cursor.attr, &copy->cursor.attr) ||
+        repr->top != copy->top || repr->bottom != copy->bottom ||
+        repr->visible != copy->visible ||
+        repr->cursor.g_graph[0] != copy->cursor.g_graph[0]) {
+        fprintf(stderr, "%s: state mismatch\n", name);
+        passed = false;
+    }
+
+    free(buf);
+    tlog_screen_destroy(repr);
+    tlog_screen_destroy(copy);
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define TEXT(_name, _width, _height, _output, _exp) \
+    passed = test_text(_name, _width, _height, _output, _exp) && passed
+
+    TEXT("empty", 10, 3, "", "");
+    TEXT("lines", 10, 3, "hello\r\nworld", "hello\nworld\n");
+    TEXT("scroll", 10, 3, "a\r\nb\r\nc\r\nd", "b\nc\nd\n");
+    TEXT("wrap", 5, 3, "abcdefg", "abcde\nfg\n");
+    TEXT("wrap_pending", 5, 3, "abcde\r\nf", "abcde\nf\n");
+    TEXT("nowrap", 5, 3, "\033[?7labcdefg", "abcdg\n");
+    TEXT("tab", 20, 1, "a\tb\tc", "a       b       c\n");
+    TEXT("backspace", 10, 1, "abc\b\bX", "aXc\n");
+    TEXT("cup", 10, 3, "\033[2;3Hx\033[3;1Hy\033[Hz", "z\n  x\ny\n");
+    TEXT("cup_limit", 5, 2, "\033[9;9Hx", "\n    x\n");
+    TEXT("moves", 10, 3, "\033[2;5H\033[Aa\033[2Bb\033[3Dc\033[9Cd",
+         "    a\n\n   c b   d\n");
+    TEXT("erase_line", 10, 1, "abcdef\033[3G\033[K", "ab\n");
+    TEXT("erase_line_start", 10, 1, "abcdef\033[3G\033[1K", "   def\n");
+    TEXT("erase_screen", 10, 3, "a\r\nb\r\nc\033[2;1H\033[J", "a\n");
+    TEXT("erase_chars", 10, 1, "abcdef\033[2G\033[2X", "a  def\n");
+    TEXT("insert_chars", 10, 1, "abcdef\033[2G\033[2@", "a  bcdef\n");
+    TEXT("delete_chars", 10, 1, "abcdef\033[2G\033[2P", "adef\n");
+    TEXT("insert_mode", 10, 1, "abc\033[G\033[4hXY", "XYabc\n");
+    TEXT("insert_lines", 5, 3, "a\r\nb\r\nc\033[2H\033[L", "a\n\nb\n");
+    TEXT("delete_lines", 5, 3, "a\r\nb\r\nc\033[1H\033[M", "b\nc\n");
+    TEXT("scroll_region", 5, 4, "a\r\nb\r\nc\r\nd\033[2;3r\033[3Hx\r\ny",
+         "a\nx\ny\nd\n");
+    TEXT("reverse_index", 5, 3, "a\r\nb\033[H\033M", "\na\nb\n");
+    TEXT("scroll_up_down", 5, 3, "a\r\nb\r\nc\033[S\033[2T", "\n\nb\n");
+    TEXT("alt_screen", 10, 2, "main\033[?1049halt", "    alt\n");
+    TEXT("alt_screen_exit", 10, 2, "main\033[?1049halt\033[?1049lx",
+         "mainx\n");
+    TEXT("save_restore", 10, 2, "ab\0337\033[2;5Hx\0338c", "abc\n    x\n");
+    TEXT("repeat", 10, 1, "a\033[3b", "aaaa\n");
+    TEXT("graphics", 5, 1, "\033(0qx\033(Bq", "\xe2\x94\x80\xe2\x94\x82q\n");
+    TEXT("shift_out", 5, 1, "\033)0a\016q\017q", "a\xe2\x94\x80q\n");
+    TEXT("osc", 10, 1, "\033]0;title\007a\033]2;t\033\\b", "ab\n");
+    TEXT("ignored", 10, 1, "\033[>c\033[?1h\033=\033#8a\033[2 qb", "ab\n");
+    TEXT("utf8", 10, 1, "\xc3\xa9t\xc3\xa9", "\xc3\xa9t\xc3\xa9\n");
+    TEXT("utf8_invalid", 10, 1, "a\xc3z\xff", "a\xef\xbf\xbdz\xef\xbf\xbd\n");
+    TEXT("split_sequence", 10, 1, "\033[3", "");
+    TEXT("reset", 10, 2, "abc\033[?1049h\033cd", "d\n");
+
+    /* Check wide characters, if the locale supports them */
+    if (setlocale(LC_CTYPE, "C.UTF-8") != NULL ||
+        setlocale(LC_CTYPE, "en_US.UTF-8") != NULL) {
+        TEXT("wide", 5, 2, "a\xe4\xb8\xad" "b\xe4\xb8\xad",
+             "a\xe4\xb8\xad" "b\n\xe4\xb8\xad\n");
+        TEXT("wide_overwrite", 5, 1, "\xe4\xb8\xad\033[2Gx", " x\n");
+    }
+
+#undef TEXT
+
+    passed = test_render("render_plain", 10, 3, "hello\r\nworld") && passed;
+    passed = test_render("render_attrs", 20, 3,
+                         "\033[1;31mred\033[0m \033[4;44mblue\033[m"
+                         "\033[38;5;100mc\033[48;2;1;2;3md\033[92;103me"
+                         "\033[7;8;9;3;2;5mf") && passed;
+    passed = test_render("render_erase_bg", 10, 2,
+                         "\033[41m\033[2J\033[Hx") && passed;
+    passed = test_render("render_state", 10, 5,
+                         "a\r\nb\033[2;4r\033[3;5H\033[32m\033(0\033[?25l")
+             && passed;
+    passed = test_render("render_alt", 10, 3,
+                         "main\r\ntext\033[?1049h\033[2;2Halt\033[1m")
+             && passed;
+    passed = test_render("render_full", 3, 2, "abcdef") && passed;
+
+    return !passed;
+}
@@ -0,0 +1,418 @@
+/*
+ * Tlog session list test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <curl/curl.h>
+#include <tlog/rc.h>
+#include <tlog/session_list.h>
+#include <tlog/test_misc.h>
+#include <tlog/test_http_server.h>
+
+/** Request line */
+#define LINE "POST /tlog/tlog/_search?filter_path=aggregations HTTP/1.1"
+
+/** Request body, for the "host:a" query and up to two buckets */
+#define BODY \
+    "{\"query\":{\"query_string\":{\"query\":\"host:a\"}},"           \
+    "\"size\":0,"                                                       \
+    "\"aggs\":{\"host\":{"                                              \
+        "\"terms\":{\"field\":\"host.raw\",\"size\":2},"                \
+        "\"aggs\":{\"session\":{"                                       \
+            "\"terms\":{\"field\":\"session\",\"size\":2},"             \
+            "\"aggs\":{"                                                \
+                "\"user\":{\"terms\":{\"field\":\"user.raw\","          \
+                                     "\"size\":1}},"                    \
+                "\"first_pos\":{\"min\":{\"field\":\"pos\"}},"          \
+                "\"last_pos\":{\"max\":{\"field\":\"pos\"}},"           \
+                "\"last\":{\"top_hits\":{"                                 \
+                    "\"size\":1,"                                         \
+                    "\"sort\":[{\"pos\":\"desc\"}],"                       \
+                    "\"_source\":[\"timing\"]}}"                          \
+    "}}}}}}"
+
+/** Reply listing the specified host buckets */
+#define REPLY(_buckets...) \
+    "{\"aggregations\":{\"host\":{\"buckets\":[" _buckets "]}}}"
+
+/** Host bucket with the specified session buckets */
+#define HOST(_key, _buckets...) \
+    "{\"key\":\"" _key "\",\"doc_count\":1,"                \
+    "\"session\":{\"buckets\":[" _buckets "]}}"
+
+/** Session bucket */
+#define SESSION(_key, _num, _user, _first_pos, _last_pos) \
+    "{\"key\":" #_key ",\"doc_count\":" #_num ","                   \
+    "\"user\":{\"buckets\":[{\"key\":\"" _user "\","               \
+                            "\"doc_count\":" #_num "}]},"           \
+    "\"first_pos\":{\"value\":" #_first_pos "},"                   \
+    "\"last_pos\":{\"value\":" #_last_pos "}}"
+
+/** Session bucket with the timing of the last message */
+#define SESSION_LAST(_key, _num, _user, _first_pos, _last_pos, _timing) \
+    "{\"key\":" #_key ",\"doc_count\":" #_num ","                   \
+    "\"user\":{\"buckets\":[{\"key\":\"" _user "\","               \
+                            "\"doc_count\":" #_num "}]},"           \
+    "\"first_pos\":{\"value\":" #_first_pos "},"                   \
+    "\"last_pos\":{\"value\":" #_last_pos "},"                     \
+    "\"last\":{\"hits\":{\"hits\":[{\"_source\":{"                   \
+        "\"timing\":\"" _timing "\"}}]}}}"
+
+/** Message of the specified host, user and session at a position */
+#define MSG(_host, _user, _session, _id, _pos) \
+    MSG_TIMING(_host, _user, _session, _id, _pos, "")
+
+/** Message of the specified host, user, session, position and timing */
+#define MSG_TIMING(_host, _user, _session, _id, _pos, _timing) \
+    "{\"ver\":1,\"host\":\"" _host "\",\"user\":\"" _user "\","     \
+    "\"term\":\"xterm\",\"session\":" #_session ",\"id\":" #_id "," \
+    "\"pos\":" #_pos ",\"timing\":\"" _timing "\",\"in_txt\":\"\","  \
+    "\"in_bin\":[],\"out_txt\":\"\",\"out_bin\":[]}\n"
+
+/** Expected session summary */
+struct exp {
+    const char     *host;       /**< Host name, NULL terminates the list */
+    const char     *user;       /**< User name */
+    unsigned int    session;    /**< Session ID */
+    uint64_t        first_pos;  /**< First message position */
+    uint64_t        last_pos;   /**< Last message position */
+    uint64_t        end_pos;    /**< Last message end position */
+    size_t          num;        /**< Number of messages */
+    size_t          bytes;      /**< Message bytes */
+};
+
+struct test {
+    struct tlog_test_http_server_rsp    rsp_list[2];
+    const char                         *log;
+    tlog_grc                            exp_grc;
+    bool                                exp_partial;
+    struct exp                          exp_list[8];
+    unsigned int                        timeout;
+};
+
+/**
+ * Check a session list against the expected sessions.
+ *
+ * @param n     Test name.
+ * @param list  The list to check.
+ * @param t     The test with the expected sessions.
+ *
+ * @return True if the list matches, false otherwise.
+ */
+static bool
+check_list(const char *n, const struct tlog_session_list *list,
+           const struct test *t)
+{
+    bool passed = true;
+    const struct tlog_session_info *info;
+    const struct exp *exp;
+    size_t exp_num;
+    size_t i;
+
+    for (exp_num = 0; t->exp_list[exp_num].host != NULL; exp_num++);
+    if (list->info_num != exp_num) {
+        fprintf(stderr, "%s: session number: %zu != %zu\n",
+                n, list->info_num, exp_num);
+        return false;
+    }
+    if (list->partial != t->exp_partial) {
+        fprintf(stderr, "%s: partial: %d != %d\n",
+                n, list->partial, t->exp_partial);
+        passed = false;
+    }
+    for (i = 0; i < exp_num; i++) {
+        info = &list->info_list[i];
+        exp = &t->exp_list[i];
+        if (strcmp(info->host, exp->host) != 0 ||
+            strcmp(info->user, exp->user) != 0 ||
+            info->session != exp->session ||
+            info->first_pos != exp->first_pos ||
+            info->last_pos != exp->last_pos ||
+            info->end_pos != exp->end_pos ||
+            info->num != exp->num ||
+            info->bytes != exp->bytes) {
+            fprintf(stderr,
+                    "%s: session #%zu: "
+                    "%s %s %u %" PRIu64 "-%" PRIu64 "-%" PRIu64
+                    " %zu %zu != "
+                    "%s %s %u %" PRIu64 "-%" PRIu64 "-%" PRIu64
+                    " %zu %zu\n",
+                    n, i + 1,
+                    info->host, info->user, info->session,
+                    info->first_pos, info->last_pos, info->end_pos,
+                    info->num, info->bytes,
+                    exp->host, exp->user, exp->session,
+                    exp->first_pos, exp->last_pos, exp->end_pos,
+                    exp->num, exp->bytes);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+/**
+ * Test listing sessions from a test HTTP server.
+ *
+ * @param n     Test name.
+ * @param t     The test.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_es(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    struct tlog_test_http_server server;
+    struct tlog_session_list *list = NULL;
+    const struct tlog_test_http_server_req *req;
+    char url[64];
+
+    if (!tlog_test_http_server_start(&server, t.rsp_list)) {
+        fprintf(stderr, "Failed starting HTTP server: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/tlog/tlog/_search",
+             (unsigned int)server.port);
+    grc = tlog_session_list_create_es(&list, url, "host:a", 2,
+                                      2, t.timeout);
+    tlog_test_http_server_stop(&server);
+
+    if (grc != t.exp_grc) {
+        fprintf(stderr, "%s: grc: %s (%d) != %s (%d)\n", n,
+                tlog_grc_strerror(grc), grc,
+                tlog_grc_strerror(t.exp_grc), t.exp_grc);
+        passed = false;
+    } else if (grc == TLOG_RC_OK) {
+        passed = check_list(n, list, &t) && passed;
+    }
+
+    if (server.req_num != 1) {
+        fprintf(stderr, "%s: request number: %zu != 1\n",
+                n, server.req_num);
+        passed = false;
+    } else {
+        req = &server.req_list[0];
+        if (strcmp(req->line, LINE) != 0) {
+            fprintf(stderr, "%s: request line mismatch: %s\n",
+                    n, req->line);
+            passed = false;
+        }
+        if (req->body_len != strlen(BODY) ||
+            memcmp(req->body, BODY, req->body_len) != 0) {
+            fprintf(stderr, "%s: request body mismatch:\n", n);
+            tlog_test_diff(stderr, req->body, req->body_len,
+                           (const uint8_t *)BODY, strlen(BODY));
+            passed = false;
+        }
+    }
+
+    tlog_session_list_destroy(list);
+    tlog_test_http_server_cleanup(&server);
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+/**
+ * Test listing sessions from an index of a log.
+ *
+ * @param n     Test name.
+ * @param t     The test.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test_index(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    struct tlog_index *index = NULL;
+    struct tlog_session_list *list = NULL;
+
+    grc = tlog_index_create(&index, -1);
+    if (grc == TLOG_RC_OK) {
+        grc = tlog_index_update(index, -1, t.log, strlen(t.log));
+    }
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "%s: failed indexing the log: %s\n",
+                n, tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+    grc = tlog_session_list_create_index(&list, index);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "%s: failed creating the list: %s\n",
+                n, tlog_grc_strerror(grc));
+        passed = false;
+    } else {
+        passed = check_list(n, list, &t);
+    }
+
+    tlog_session_list_destroy(list);
+    tlog_index_destroy(index);
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+    const size_t msg_len = strlen(MSG("a", "u", 1, 1, 0));
+
+    curl_global_init(CURL_GLOBAL_NOTHING);
+
+#define RSP(_status, _body) {.status = _status, .body = _body}
+
+#define EXP(_host, _user, _session, _first_pos, _last_pos, _end_pos, \
+            _num, _bytes) \
+    {.host = _host, .user = _user, .session = _session,                 \
+     .first_pos = _first_pos, .last_pos = _last_pos,                    \
+     .end_pos = _end_pos, .num = _num, .bytes = _bytes}
+
+#define EXP_ES(_host, _user, _session, _first_pos, _last_pos, _end_pos, \
+               _num) \
+    EXP(_host, _user, _session, _first_pos, _last_pos, _end_pos, _num,  \
+        TLOG_SESSION_LIST_BYTES_UNKNOWN)
+
+#define TEST_ES(_name_token, _struct_init_args...) \
+    passed = test_es(#_name_token, (struct test){_struct_init_args}) && \
+             passed
+
+#define TEST_INDEX(_name_token, _struct_init_args...) \
+    passed = test_index(#_name_token, (struct test){_struct_init_args}) && \
+             passed
+
+    TEST_ES(es_empty,
+            .rsp_list = {RSP(200, "{}")},
+            .exp_list = {EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_ES(es_empty_buckets,
+            .rsp_list = {RSP(200, REPLY())},
+            .exp_list = {EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_ES(es_sorted,
+            .rsp_list = {RSP(200,
+                             REPLY(HOST("b", SESSION(7, 3, "x", 0, 900))
+                                   ","
+                                   HOST("a", SESSION(5, 10, "y",
+                                                     1000.0, 62000.0)
+                                             ","
+                                             SESSION(2, 1, "x", 0, 0))))},
+            .exp_list = {EXP_ES("a", "x", 2, 0, 0, 0, 1),
+                         EXP_ES("a", "y", 5, 1000, 62000, 62000, 10),
+                         EXP_ES("b", "x", 7, 0, 900, 900, 3),
+                         EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_ES(es_partial,
+            .rsp_list = {RSP(200,
+                             "{\"aggregations\":{\"host\":{"
+                                "\"sum_other_doc_count\":4,"
+                                "\"buckets\":["
+                                    HOST("a", SESSION(1, 2, "x", 0, 5))
+                             "]}}}")},
+            .exp_partial = true,
+            .exp_list = {EXP_ES("a", "x", 1, 0, 5, 5, 2),
+                         EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_ES(es_no_user,
+            .rsp_list = {RSP(200,
+                             REPLY(HOST("a",
+                                        "{\"key\":1,\"doc_count\":2,"
+                                        "\"first_pos\":{\"value\":0},"
+                                        "\"last_pos\":{\"value\":5}}")))},
+            .exp_list = {EXP_ES("a", "", 1, 0, 5, 5, 2),
+                         EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_ES(es_end,
+            .rsp_list = {RSP(200,
+                             REPLY(HOST("a", SESSION_LAST(1, 2, "x", 0, 500,
+                                                          "+100>5+250<1"))))},
+            .exp_list = {EXP_ES("a", "x", 1, 0, 500, 850, 2),
+                         EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_ES(es_end_missing,
+            .rsp_list = {RSP(200,
+                             REPLY(HOST("a",
+                                        "{\"key\":1,\"doc_count\":2,"
+                                        "\"first_pos\":{\"value\":0},"
+                                        "\"last_pos\":{\"value\":5},"
+                                        "\"last\":{\"hits\":{\"hits\":["
+                                            "{\"_source\":{}}]}}}")))},
+            .exp_grc = TLOG_RC_SESSION_LIST_REPLY_INVALID);
+
+    TEST_ES(es_timeout,
+            .rsp_list = {RSP(-5, "")},
+            .timeout = 1,
+            .exp_grc = TLOG_GRC_FROM(curl, CURLE_OPERATION_TIMEDOUT));
+
+    TEST_ES(es_pos_missing,
+            .rsp_list = {RSP(200,
+                             REPLY(HOST("a",
+                                        "{\"key\":1,\"doc_count\":2}")))},
+            .exp_grc = TLOG_RC_SESSION_LIST_REPLY_INVALID);
+
+    TEST_ES(es_session_invalid,
+            .rsp_list = {RSP(200,
+                             REPLY(HOST("a", SESSION(-1, 2, "x", 0, 5))))},
+            .exp_grc = TLOG_RC_SESSION_LIST_REPLY_INVALID);
+
+    TEST_ES(es_truncated,
+            .rsp_list = {RSP(200, "{\"aggregations\":{\"host\":")},
+            .exp_grc = TLOG_RC_SESSION_LIST_REPLY_INVALID);
+
+    TEST_ES(es_error_status,
+            .rsp_list = {RSP(400, "{\"error\":{}}")},
+            .exp_grc = TLOG_RC_SESSION_LIST_REPLY_INVALID);
+
+    TEST_INDEX(index_empty,
+               .log = "",
+               .exp_list = {EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_INDEX(index_interleaved,
+               .log = MSG("b", "x", 7, 1, 0)
+                      MSG("a", "y", 5, 1, 100)
+                      MSG("a", "y", 5, 2, 200)
+                      MSG("b", "x", 7, 2, 900)
+                      MSG("a", "y", 5, 3, 62000)
+                      MSG("a", "x", 2, 1, 0),
+               .exp_list = {EXP("a", "x", 2, 0, 0, 0, 1, msg_len),
+                            EXP("a", "y", 5, 100, 62000, 62000, 3,
+                                msg_len * 3 + 8),
+                            EXP("b", "x", 7, 0, 900, 900, 2, msg_len * 2 + 2),
+                            EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    TEST_INDEX(index_end,
+               .log = MSG_TIMING("a", "x", 1, 1, 0, "+100>1")
+                      MSG_TIMING("a", "x", 1, 2, 200, "+300>1+50<1"),
+               .exp_list = {EXP("a", "x", 1, 0, 200, 550, 2,
+                                msg_len * 2 + 19),
+                            EXP(NULL, NULL, 0, 0, 0, 0, 0, 0)});
+
+    curl_global_cleanup();
+
+    return !passed;
+}
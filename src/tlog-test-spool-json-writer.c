@@ -0,0 +1,456 @@
+/*
+ * Tlog tlog_spool_json_writer test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <tlog/rc.h>
+#include <tlog/spool_json_writer.h>
+#include <tlog/misc.h>
+#include <tlog/test_misc.h>
+
+/** A hundred bytes of a message */
+#define X100 "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx" \
+             "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+
+/** A thousand bytes of a message, including the newline */
+#define X1000 X100 X100 X100 X100 X100 X100 X100 X100 X100 \
+              "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx" \
+              "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\n"
+
+/*
+ * Forwarding writer buffering written messages until flushed, and able to
+ * fail on request, dropping the buffered messages.
+ */
+
+/** Forwarding test writer state */
+struct fwd {
+    bool    fail;           /**< True if writes and flushes should fail */
+    char    pending[16384]; /**< Messages written, but not flushed */
+    size_t  pending_len;    /**< Length of pending messages */
+    char    flushed[16384]; /**< Messages flushed (delivered) */
+    size_t  flushed_len;    /**< Length of flushed messages */
+};
+
+struct fwd_json_writer {
+    struct tlog_json_writer writer;
+    struct fwd             *fwd;
+};
+
+static tlog_grc
+fwd_json_writer_init(struct tlog_json_writer *writer, va_list ap)
+{
+    ((struct fwd_json_writer *)writer)->fwd = va_arg(ap, struct fwd *);
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+fwd_json_writer_write(struct tlog_json_writer *writer,
+                      const uint8_t *buf, size_t len)
+{
+    struct fwd *fwd = ((struct fwd_json_writer *)writer)->fwd;
+    if (fwd->fail) {
+        fwd->pending_len = 0;
+        return TLOG_RC_FAILURE;
+    }
+    assert(fwd->pending_len + len <= sizeof(fwd->pending));
+    memcpy(fwd->pending + fwd->pending_len, buf, len);
+    fwd->pending_len += len;
+    return TLOG_RC_OK;
+}
+
+static tlog_grc
+fwd_json_writer_flush(struct tlog_json_writer *writer)
+{
+    struct fwd *fwd = ((struct fwd_json_writer *)writer)->fwd;
+    if (fwd->fail) {
+        fwd->pending_len = 0;
+        return TLOG_RC_FAILURE;
+    }
+    assert(fwd->flushed_len + fwd->pending_len <= sizeof(fwd->flushed));
+    memcpy(fwd->flushed + fwd->flushed_len, fwd->pending, fwd->pending_len);
+    fwd->flushed_len += fwd->pending_len;
+    fwd->pending_len = 0;
+    return TLOG_RC_OK;
+}
+
+static const struct tlog_json_writer_type fwd_json_writer_type = {
+    .size   = sizeof(struct fwd_json_writer),
+    .init   = fwd_json_writer_init,
+    .write  = fwd_json_writer_write,
+    .flush  = fwd_json_writer_flush,
+};
+
+enum op_type {
+    OP_TYPE_NONE,
+    OP_TYPE_WRITE,
+    OP_TYPE_FLUSH,
+    OP_TYPE_FAIL,
+    OP_TYPE_REOPEN,
+    OP_TYPE_LOCK,
+    OP_TYPE_CHECK,
+    OP_TYPE_NUM
+};
+
+static const char*
+op_type_to_str(enum op_type t)
+{
+    switch (t) {
+    case OP_TYPE_NONE:
+        return "none";
+    case OP_TYPE_WRITE:
+        return "write";
+    case OP_TYPE_FLUSH:
+        return "flush";
+    case OP_TYPE_FAIL:
+        return "fail";
+    case OP_TYPE_REOPEN:
+        return "reopen";
+    case OP_TYPE_LOCK:
+        return "lock";
+    case OP_TYPE_CHECK:
+        return "check";
+    default:
+        return "<unknown>";
+    }
+}
+
+struct op {
+    enum op_type    type;
+    const char     *msg;        /**< Message to write, or expected
+                                     delivered messages to check */
+    bool            fail;       /**< True if forwarding should fail */
+    tlog_grc        exp_grc;    /**< Expected return code */
+};
+
+struct test {
+    size_t          size;           /**< Spool size */
+    unsigned int    retry;          /**< Retry delay */
+    const char     *crash_list[8];  /**< Messages to write before crashing,
+                                         before the operations */
+    off_t           corrupt_off;    /**< Spool file offset of a byte to
+                                         corrupt after crashing, or zero */
+    struct op       op_list[16];    /**< Operations */
+    const char     *exp_flushed;    /**< Expected delivered messages */
+};
+
+static bool
+test(const char *n, const struct test t)
+{
+    bool passed = true;
+    tlog_grc grc;
+    char dir[] = "/tmp/tlog-test-spool-XXXXXX";
+    char path[64];
+    struct fwd fwd;
+    struct tlog_json_writer *fwd_writer = NULL;
+    struct tlog_json_writer *writer = NULL;
+    struct tlog_json_writer *other_writer = NULL;
+    const struct op *op;
+    const char * const *pmsg;
+    pid_t pid;
+    int status;
+    int fd;
+
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "Failed creating temporary directory: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "%s/spool", dir);
+
+    memset(&fwd, 0, sizeof(fwd));
+    grc = tlog_json_writer_create(&fwd_writer, &fwd_json_writer_type, &fwd);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "Failed creating forwarding writer: %s\n",
+                tlog_grc_strerror(grc));
+        exit(1);
+    }
+
+#define CREATE(_pwriter) \
+    do {                                                                \
+        grc = tlog_spool_json_writer_create(_pwriter, fwd_writer, false,\
+                                            path, t.size, t.retry);     \
+        if (grc != TLOG_RC_OK) {                                        \
+            fprintf(stderr, "Failed creating spool writer: %s\n",       \
+                    tlog_grc_strerror(grc));                            \
+            exit(1);                                                    \
+        }                                                               \
+    } while (0)
+
+    /* Write messages and exit without cleanup, in a child */
+    if (t.crash_list[0] != NULL) {
+        pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Failed forking: %s\n", strerror(errno));
+            exit(1);
+        } else if (pid == 0) {
+            CREATE(&writer);
+            for (pmsg = t.crash_list; *pmsg != NULL; pmsg++) {
+                tlog_json_writer_write(writer, (const uint8_t *)*pmsg,
+                                       strlen(*pmsg));
+            }
+            _exit(0);
+        }
+        waitpid(pid, &status, 0);
+        /* Nothing was flushed by the child, for us */
+        memset(&fwd, 0, sizeof(fwd));
+
+        if (t.corrupt_off != 0) {
+            char c = '!';
+            fd = open(path, O_WRONLY);
+            if (fd < 0 || pwrite(fd, &c, 1, t.corrupt_off) != 1) {
+                fprintf(stderr, "Failed corrupting spool: %s\n",
+                        strerror(errno));
+                exit(1);
+            }
+            close(fd);
+        }
+    }
+
+    CREATE(&writer);
+
+#define FAIL(_fmt, _args...) \
+    do {                                                \
+        fprintf(stderr, "%s: " _fmt "\n", n, ##_args);  \
+        passed = false;                                 \
+    } while (0)
+
+#define FAIL_OP(_fmt, _args...) \
+    FAIL("op #%zd (%s): " _fmt,                                 \
+         op - t.op_list + 1, op_type_to_str(op->type), ##_args)
+
+#define CHECK_FLUSHED(_exp, _fail_args...) \
+    do {                                                                \
+        if (fwd.flushed_len != strlen(_exp) ||                          \
+            memcmp(fwd.flushed, _exp, fwd.flushed_len) != 0) {          \
+            _fail_args;                                                 \
+            tlog_test_diff(stderr,                                      \
+                           (const uint8_t *)fwd.flushed,                \
+                           fwd.flushed_len,                             \
+                           (const uint8_t *)_exp, strlen(_exp));        \
+        }                                                               \
+    } while (0)
+
+    for (op = t.op_list; op->type != OP_TYPE_NONE; op++) {
+        grc = TLOG_RC_OK;
+        switch (op->type) {
+        case OP_TYPE_WRITE:
+            grc = tlog_json_writer_write(writer, (const uint8_t *)op->msg,
+                                         strlen(op->msg));
+            break;
+        case OP_TYPE_FLUSH:
+            grc = tlog_json_writer_flush(writer);
+            break;
+        case OP_TYPE_FAIL:
+            fwd.fail = op->fail;
+            break;
+        case OP_TYPE_REOPEN:
+            tlog_json_writer_destroy(writer);
+            CREATE(&writer);
+            break;
+        case OP_TYPE_LOCK:
+            grc = tlog_spool_json_writer_create(&other_writer, fwd_writer,
+                                                false, path,
+                                                t.size, t.retry);
+            tlog_json_writer_destroy(other_writer);
+            other_writer = NULL;
+            break;
+        case OP_TYPE_CHECK:
+            CHECK_FLUSHED(op->msg, FAIL_OP("delivered mismatch:"));
+            break;
+        default:
+            fprintf(stderr, "Unknown operation type: %d\n", op->type);
+            exit(1);
+        }
+        if (grc != op->exp_grc) {
+            FAIL_OP("grc: %s (%d) != %s (%d)",
+                    tlog_grc_strerror(grc), grc,
+                    tlog_grc_strerror(op->exp_grc), op->exp_grc);
+        }
+    }
+
+#undef FAIL_OP
+#undef CREATE
+
+    tlog_json_writer_destroy(writer);
+    tlog_json_writer_destroy(fwd_writer);
+
+    CHECK_FLUSHED(t.exp_flushed, FAIL("delivered mismatch:"));
+
+#undef CHECK_FLUSHED
+#undef FAIL
+
+    unlink(path);
+    rmdir(dir);
+
+    fprintf(stderr, "%s: %s\n", n, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define OP_WRITE(_msg, _exp_grc) \
+    {.type = OP_TYPE_WRITE, .msg = _msg, .exp_grc = _exp_grc}
+
+#define OP_FLUSH \
+    {.type = OP_TYPE_FLUSH, .exp_grc = TLOG_RC_OK}
+
+#define OP_FAIL(_fail) \
+    {.type = OP_TYPE_FAIL, .fail = _fail, .exp_grc = TLOG_RC_OK}
+
+#define OP_REOPEN \
+    {.type = OP_TYPE_REOPEN, .exp_grc = TLOG_RC_OK}
+
+#define OP_LOCK(_exp_grc) \
+    {.type = OP_TYPE_LOCK, .exp_grc = _exp_grc}
+
+#define OP_CHECK(_msg) \
+    {.type = OP_TYPE_CHECK, .msg = _msg, .exp_grc = TLOG_RC_OK}
+
+#define TEST(_name_token, _struct_init_args...) \
+    passed = test(#_name_token, (struct test){_struct_init_args}) && passed
+
+    TEST(nothing,
+         .size = 4096,
+         .exp_flushed = "");
+
+    TEST(pass_through,
+         .size = 4096,
+         .op_list = {OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_CHECK(""),
+                     OP_FLUSH,
+                     OP_CHECK("a\nb\n")},
+         .exp_flushed = "a\nb\n");
+
+    TEST(flushed_on_close,
+         .size = 4096,
+         .op_list = {OP_WRITE("a\n", TLOG_RC_OK)},
+         .exp_flushed = "a\n");
+
+    TEST(delivered_once,
+         .size = 4096,
+         .op_list = {OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FLUSH,
+                     OP_REOPEN,
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_FLUSH},
+         .exp_flushed = "a\nb\n");
+
+    TEST(write_outage,
+         .size = 4096,
+         .op_list = {OP_FAIL(true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FLUSH,
+                     OP_CHECK(""),
+                     OP_FAIL(false),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_FLUSH,
+                     OP_CHECK("a\nb\n")},
+         .exp_flushed = "a\nb\n");
+
+    TEST(flush_outage,
+         .size = 4096,
+         .op_list = {OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FAIL(true),
+                     OP_FLUSH,
+                     OP_FAIL(false),
+                     OP_FLUSH,
+                     OP_CHECK("a\n")},
+         .exp_flushed = "a\n");
+
+    TEST(retry_delay,
+         .size = 4096,
+         .retry = 60,
+         .op_list = {OP_FAIL(true),
+                     OP_WRITE("a\n", TLOG_RC_OK),
+                     OP_FAIL(false),
+                     OP_WRITE("b\n", TLOG_RC_OK),
+                     OP_FLUSH,
+                     OP_CHECK(""),
+                     OP_REOPEN,
+                     OP_CHECK("a\nb\n")},
+         .exp_flushed = "a\nb\n");
+
+    TEST(crash,
+         .size = 4096,
+         .crash_list = {"a\n", "b\n"},
+         .op_list = {OP_CHECK("a\nb\n"),
+                     OP_WRITE("c\n", TLOG_RC_OK)},
+         .exp_flushed = "a\nb\nc\n");
+
+    TEST(crash_corrupt,
+         .size = 4096,
+         .crash_list = {"a\n", "b\n", "c\n"},
+         /* Header (40 bytes), first record (16 bytes), second header */
+         .corrupt_off = 40 + 16 + 8,
+         .op_list = {OP_CHECK("a\n"),
+                     OP_WRITE("d\n", TLOG_RC_OK)},
+         .exp_flushed = "a\nd\n");
+
+    TEST(wrap,
+         .size = 4096,
+         .op_list = {OP_WRITE("1" X1000, TLOG_RC_OK),
+                     OP_WRITE("2" X1000, TLOG_RC_OK),
+                     OP_WRITE("3" X1000, TLOG_RC_OK),
+                     OP_FLUSH,
+                     OP_FAIL(true),
+                     OP_WRITE("4" X1000, TLOG_RC_OK),
+                     OP_WRITE("5" X1000, TLOG_RC_OK),
+                     OP_FAIL(false),
+                     OP_REOPEN},
+         .exp_flushed = "1" X1000 "2" X1000 "3" X1000
+                        "4" X1000 "5" X1000);
+
+    TEST(full,
+         .size = 4096,
+         .retry = 60,
+         .op_list = {OP_FAIL(true),
+                     OP_WRITE("1" X1000, TLOG_RC_OK),
+                     OP_WRITE("2" X1000, TLOG_RC_OK),
+                     OP_WRITE("3" X1000, TLOG_RC_OK),
+                     OP_WRITE("4" X1000, TLOG_RC_OK),
+                     OP_WRITE("5" X1000, TLOG_RC_SPOOL_JSON_WRITER_FULL),
+                     OP_FAIL(false),
+                     OP_REOPEN},
+         .exp_flushed = "1" X1000 "2" X1000 "3" X1000 "4" X1000);
+
+    TEST(too_large,
+         .size = 4096,
+         .op_list = {OP_WRITE(X1000 X1000 X1000 X1000 X1000,
+                              TLOG_RC_SPOOL_JSON_WRITER_FULL)},
+         .exp_flushed = "");
+
+    TEST(locked,
+         .size = 4096,
+         .op_list = {OP_LOCK(TLOG_RC_SPOOL_JSON_WRITER_LOCKED)},
+         .exp_flushed = "");
+
+    return !passed;
+}
@@ -0,0 +1,144 @@
+/*
+ * Tlog followed log change detection test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <tlog/rc.h>
+#include <tlog/tail.h>
+
+/** Operation on the followed log file */
+struct op {
+    bool        truncate;   /**< True if truncating the file first */
+    off_t       off;        /**< Offset to write the text at, or -1 to
+                                 append it */
+    const char *text;       /**< Text to write, or NULL */
+};
+
+/**
+ * Write a log file, start following it, apply an operation, wait for the
+ * change, and check the flags.
+ *
+ * @param name          Test name.
+ * @param init          Initial text of the log file.
+ * @param pad           Number of zero bytes to pad the initial text with.
+ * @param op            The operation to apply.
+ * @param exp_truncated True if the file is expected to be detected as
+ *                      truncated.
+ *
+ * @return True if the test passed, false otherwise.
+ */
+static bool
+test(const char *name, const char *init, off_t pad,
+     struct op op, bool exp_truncated)
+{
+    char path[] = "tlog-test-tail.XXXXXX";
+    struct tlog_tail tail;
+    bool passed = true;
+    tlog_grc grc;
+    size_t len;
+    int fd;
+
+    fd = mkstemp(path);
+    len = strlen(init);
+    if (fd < 0 || write(fd, init, len) != (ssize_t)len ||
+        ftruncate(fd, (off_t)len + pad) < 0) {
+        fprintf(stderr, "Failed writing a temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+
+    tlog_tail_init(&tail, path);
+
+    if (op.truncate && ftruncate(fd, 0) < 0) {
+        fprintf(stderr, "Failed truncating the temporary file: %s\n",
+                strerror(errno));
+        exit(1);
+    }
+    if (op.text != NULL) {
+        len = strlen(op.text);
+        if ((op.off < 0
+                ? pwrite(fd, op.text, len, lseek(fd, 0, SEEK_END))
+                : pwrite(fd, op.text, len, op.off)) != (ssize_t)len) {
+            fprintf(stderr, "Failed writing the temporary file: %s\n",
+                    strerror(errno));
+            exit(1);
+        }
+    }
+
+    grc = tlog_tail_wait(&tail);
+    if (grc != TLOG_RC_OK) {
+        fprintf(stderr, "%s: failed waiting: %s\n",
+                name, tlog_grc_strerror(grc));
+        passed = false;
+    }
+    if (tail.rotated) {
+        fprintf(stderr, "%s: detected as rotated\n", name);
+        passed = false;
+    }
+    if (tail.truncated != exp_truncated) {
+        fprintf(stderr, "%s: truncated %s != %s\n", name,
+                (tail.truncated ? "true" : "false"),
+                (exp_truncated ? "true" : "false"));
+        passed = false;
+    }
+
+    tlog_tail_cleanup(&tail);
+    close(fd);
+    unlink(path);
+
+    fprintf(stderr, "%s: %s\n", name, (passed ? "PASS" : "FAIL"));
+    return passed;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define OP_APPEND(_text) {.off = -1, .text = _text}
+#define OP_WRITE(_off, _text) {.off = _off, .text = _text}
+#define OP_TRUNCATE(_text) {.truncate = true, .off = -1, .text = _text}
+
+    passed = test("appended", "{\"id\":1}\n", 0,
+                  (struct op)OP_APPEND("{\"id\":2}\n"), false) && passed;
+    passed = test("truncated", "{\"id\":1}\n{\"id\":2}\n", 0,
+                  (struct op)OP_TRUNCATE("{\"id\":3}\n"), true) && passed;
+    passed = test("regrown", "{\"id\":1}\n", 0,
+                  (struct op)OP_TRUNCATE("{\"id\":3}\n{\"id\":4}\n"),
+                  true) && passed;
+    passed = test("zero_tail", "{\"id\":1}\n", 4096,
+                  (struct op)OP_WRITE(9, "{\"id\":2}\n"), false) && passed;
+    passed = test("zero_tail_regrown", "{\"id\":1}\n", 4096,
+                  (struct op)OP_TRUNCATE("{\"id\":3}\n{\"id\":4}\n"),
+                  true) && passed;
+
+#undef OP_TRUNCATE
+#undef OP_WRITE
+#undef OP_APPEND
+
+    return !passed;
+}
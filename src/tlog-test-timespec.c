@@ -0,0 +1,126 @@
+/*
+ * Tlog timespec function test.
+ *
+ * Copyright (C) 2016 Red Hat
+ *
+ * This file is part of tlog.
+ *
+ * Tlog is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tlog is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tlog; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <tlog/timespec.h>
+
+static bool
+test_parse(const char *str, bool exp_valid, time_t exp_sec, long exp_nsec)
+{
+    struct timespec res = {-1, -1};
+    bool valid;
+    bool passed;
+
+    valid = tlog_timespec_parse(str, &res);
+    passed = valid == exp_valid &&
+             (!valid || (res.tv_sec == exp_sec && res.tv_nsec == exp_nsec));
+    if (!passed) {
+        fprintf(stderr, "parse \"%s\": %s %ld.%09ld != %s %ld.%09ld\n",
+                str,
+                valid ? "valid" : "invalid",
+                (long)res.tv_sec, res.tv_nsec,
+                exp_valid ? "valid" : "invalid",
+                (long)exp_sec, exp_nsec);
+    }
+    return passed;
+}
+
+static bool
+test_add(time_t a_sec, long a_nsec, time_t b_sec, long b_nsec,
+         time_t exp_sec, long exp_nsec)
+{
+    struct timespec a = {a_sec, a_nsec};
+    struct timespec b = {b_sec, b_nsec};
+    struct timespec res;
+
+    tlog_timespec_add(&a, &b, &res);
+    if (res.tv_sec != exp_sec || res.tv_nsec != exp_nsec) {
+        fprintf(stderr, "add %ld.%09ld + %ld.%09ld: %ld.%09ld != %ld.%09ld\n",
+                (long)a_sec, a_nsec, (long)b_sec, b_nsec,
+                (long)res.tv_sec, res.tv_nsec, (long)exp_sec, exp_nsec);
+        return false;
+    }
+    return true;
+}
+
+static bool
+test_fp_mul(time_t a_sec, long a_nsec, double b,
+            time_t exp_sec, long exp_nsec)
+{
+    struct timespec a = {a_sec, a_nsec};
+    struct timespec res;
+
+    tlog_timespec_fp_mul(&a, b, &res);
+    if (res.tv_sec != exp_sec || res.tv_nsec != exp_nsec) {
+        fprintf(stderr, "fp_mul %ld.%09ld * %g: %ld.%09ld != %ld.%09ld\n",
+                (long)a_sec, a_nsec, b,
+                (long)res.tv_sec, res.tv_nsec, (long)exp_sec, exp_nsec);
+        return false;
+    }
+    return true;
+}
+
+int
+main(void)
+{
+    bool passed = true;
+
+#define PARSE_VALID(_str, _sec, _nsec) \
+    passed = test_parse(_str, true, _sec, _nsec) && passed
+#define PARSE_INVALID(_str) \
+    passed = test_parse(_str, false, 0, 0) && passed
+
+    PARSE_VALID("0", 0, 0);
+    PARSE_VALID("90", 90, 0);
+    PARSE_VALID("1:30", 90, 0);
+    PARSE_VALID("2:01:30", 7290, 0);
+    PARSE_VALID("120:00", 7200, 0);
+    PARSE_VALID("1.5", 1, 500000000);
+    PARSE_VALID("0:00:01.000000001", 1, 1);
+    PARSE_VALID("1.1234567891", 1, 123456789);
+    PARSE_INVALID("");
+    PARSE_INVALID(":1");
+    PARSE_INVALID("1:");
+    PARSE_INVALID("1:60");
+    PARSE_INVALID("1:60:00");
+    PARSE_INVALID("1:2:3:4");
+    PARSE_INVALID("1.");
+    PARSE_INVALID(".5");
+    PARSE_INVALID("-1");
+    PARSE_INVALID("1s");
+    PARSE_INVALID("99999999999999999999");
+
+    passed = test_add(0, 0, 0, 0, 0, 0) && passed;
+    passed = test_add(1, 500000000, 2, 499999999, 3, 999999999) && passed;
+    passed = test_add(1, 500000000, 2, 500000000, 4, 0) && passed;
+    passed = test_add(1, 999999999, 0, 999999999, 2, 999999998) && passed;
+
+    passed = test_fp_mul(0, 0, 3, 0, 0) && passed;
+    passed = test_fp_mul(1, 0, 0.5, 0, 500000000) && passed;
+    passed = test_fp_mul(3, 0, 1.0 / 3, 1, 0) && passed;
+    passed = test_fp_mul(2400, 1, 1, 2400, 1) && passed;
+    passed = test_fp_mul(1, 500000000, 4, 6, 0) && passed;
+    passed = test_fp_mul(0, 1, 0.25, 0, 0) && passed;
+
+    fprintf(stderr, "%s\n", (passed ? "PASS" : "FAIL"));
+    return !passed;
+}
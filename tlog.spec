@@ -10,6 +10,7 @@ Source:     https://github.com/Scribery/%{name}/releases/download/v%{version}/%{
 
 BuildRequires:  json-c-devel
 BuildRequires:  curl-devel
+BuildRequires:  zlib-devel
 BuildRequires:  m4
 # If it's not RHEL6 and older
 %if 0%{?rhel} == 0 || 0%{?rhel} >= 7
@@ -76,6 +77,9 @@ rm -r %{buildroot}/usr/include/%{name}
 %doc %{_defaultdocdir}/%{name}
 %attr(6755,%{name},%{name}) %{_bindir}/%{name}-rec
 %{_bindir}/%{name}-play
+%{_bindir}/%{name}-collectd
+%{_bindir}/%{name}-index
+%{_bindir}/%{name}-ls
 %{_libdir}/lib%{name}.so*
 %{_datadir}/%{name}
 %{_mandir}/man5/*